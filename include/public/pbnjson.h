@@ -293,6 +293,10 @@ extern "C" {
 #include "pbnjson/c/jobject.h"
 #include "pbnjson/c/jschema.h"
 #include "pbnjson/c/jparse_stream.h"
+#include "pbnjson/c/jtape.h"
+#include "pbnjson/c/jcolumns.h"
+#include "pbnjson/c/jindex.h"
+#include "pbnjson/c/jparse_async.h"
 
 #ifdef __cplusplus
 }
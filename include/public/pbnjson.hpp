@@ -216,5 +216,7 @@ int main(int argc, char *argv[]) {
 #include "pbnjson/cxx/JResolver.h"
 #include "pbnjson/cxx/JErrorHandler.h"
 #include "pbnjson/cxx/JValidator.h"
+#include "pbnjson/cxx/JArrayIndex.h"
+#include "pbnjson/cxx/JKey.h"
 
 #endif /* PJSONCXX_H_ */
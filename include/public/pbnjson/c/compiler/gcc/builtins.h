@@ -24,7 +24,7 @@
 #endif
 
 #define COMPILER_ISCONSTANT(var_or_value) __builtin_constant_p(var_or_value)
-#define COMPILER_PREFETCH(address, rw, locality) __builtin_prefetch(address)
+#define COMPILER_PREFETCH(address) __builtin_prefetch(address)
 #define COMPILER_EXPECT(value1, value2) __builtin_expect(value1, value2)
 
 #if __PJ_MINIMUM_GCC_VERSION(3, 3, 0)
@@ -34,4 +34,6 @@
 #if HAVE_GCC_ATOMICS
 	#define ATOMIC_ADD(addr, val) __sync_add_and_fetch(addr, val)
 	#define ATOMIC_SUB(addr, val) __sync_sub_and_fetch(addr, val)
+	#define ATOMIC_CAS(addr, old, val) __sync_bool_compare_and_swap(addr, old, val)
+	#define ATOMIC_LOAD(addr) __sync_fetch_and_add(addr, 0)
 #endif
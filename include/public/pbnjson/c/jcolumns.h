@@ -0,0 +1,133 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JCOLUMNS_H_
+#define JCOLUMNS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "japi.h"
+#include "jtypes.h"
+#include "jschema.h"
+#include "compiler/nonnull_attribute.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Type of the values of a column
+ */
+typedef enum {
+	JCOLUMN_AUTO = 0, /// decided by the values, it stays so for a column without any value
+	JCOLUMN_I64,      /// integers, m_values.i64
+	JCOLUMN_F64,      /// numbers, m_values.f64
+	JCOLUMN_BOOL,     /// booleans, a bit per row in m_values.bits
+	JCOLUMN_STRING,   /// strings, m_length + 1 offsets of the strings in m_data
+} JColumnType;
+
+/**
+ * Values of a field of the records, one per record (row).
+ *
+ * The buffers follow the layout of Apache Arrow: the bits of the validity bitmap and of the
+ * booleans go from the least significant one of the first byte, the strings (UTF-8, not
+ * terminated) follow each other in m_data with 32-bit offsets. A row without a value (the field
+ * is missing or JSON null) has its validity bit clear.
+ */
+typedef struct {
+	const char *m_path;   /// JSON Pointer (RFC 6901) of the field within a record, e.g. "/user/id"
+	JColumnType m_type;   /// the type requested, or JCOLUMN_AUTO; the type of the values once filled
+	size_t m_length;      /// number of the rows
+	size_t m_nullCount;   /// number of the rows without a value
+	uint8_t *m_validity;  /// bit per row, set if the row has a value
+	union {
+		int64_t *i64;
+		double *f64;
+		uint8_t *bits;
+		int32_t *offsets;
+	} m_values;
+	char *m_data;         /// the characters of the strings
+} jcolumn;
+
+/**
+ * Fill the columns with the fields of the records in one pass over the array.
+ *
+ * The type of a JCOLUMN_AUTO column is that of its first value: an integer column becomes
+ * a JCOLUMN_F64 one if any of its numbers has a fraction. A value of another type (or an object
+ * or array) fails the conversion, as does a fraction in a JCOLUMN_I64 column.
+ *
+ * @param arr The array of the records (objects, or arrays for the paths like "/0")
+ * @param columns The columns with the paths, and the types if they are known in advance. Release
+ *                the buffers with jcolumn_clear afterwards.
+ * @param count Number of the columns
+ * @return false if the values don't fit the columns or memory is out, the buffers are released then
+ *
+ * @see jcolumns_apply_schema
+ */
+PJSON_API bool jarray_to_columns(jvalue_ref arr, jcolumn *columns, size_t count) NON_NULL(1);
+
+/**
+ * Same as jarray_to_columns, but the rows are divided among several threads.
+ *
+ * NOTE: A lazy DOM (see jdom_parse_lazy) is converted by the calling thread alone, as its
+ *       accessors modify it. The records of the array shouldn't be modified meanwhile.
+ *
+ * @param threads Number of worker threads, 0 to use the number of online CPUs
+ *
+ * @see jarray_to_columns
+ */
+PJSON_API bool jarray_to_columns_parallel(jvalue_ref arr, jcolumn *columns, size_t count, int threads) NON_NULL(1);
+
+/**
+ * Decide the types of JCOLUMN_AUTO columns from the schema of the array, before the conversion.
+ *
+ * A field of type "integer", "number", "boolean" or "string" (along with "null" or not) in the
+ * schema of the "items" of the array gives the type of its column. The other columns stay as they are.
+ *
+ * @param schema The schema of the array, with the references resolved
+ * @param columns The columns with the paths
+ * @param count Number of the columns
+ */
+PJSON_API void jcolumns_apply_schema(jschema_ref schema, jcolumn *columns, size_t count) NON_NULL(1);
+
+/**
+ * Build the array of the records from the columns, the reverse of jarray_to_columns.
+ *
+ * Every record is an object with a member for every column that has a value in the row,
+ * nested objects are created along the paths. A column with the empty path "" gives the
+ * elements themselves (JSON null for a row without a value).
+ *
+ * @param columns The columns of the same length
+ * @param count Number of the columns
+ * @return The array, or jinvalid() if the columns don't fit each other or memory is out
+ */
+PJSON_API jvalue_ref jarray_from_columns(const jcolumn *columns, size_t count);
+
+/**
+ * Release the buffers of the column, the path and the type stay
+ *
+ * @param column The column filled by jarray_to_columns
+ */
+PJSON_API void jcolumn_clear(jcolumn *column) NON_NULL(1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JCOLUMNS_H_ */
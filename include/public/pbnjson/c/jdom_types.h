@@ -51,11 +51,26 @@ typedef enum {
 	 * structure will be m_len + 1 (m_str[m_len] is 0)
 	 */
 	DOMOPT_INPUT_NULL_TERMINATED,
+	/**
+	 * Not an optimization: fail parsing if a string or an object key isn't well-formed UTF-8.
+	 * The input isn't validated otherwise.
+	 */
+	DOMOPT_VALIDATE_UTF8 = 8,
+	/**
+	 * Share the repeated values of a document: the equal strings, numbers, booleans and small
+	 * containers are references to one instance. The shared strings, numbers and booleans are
+	 * frozen (see jvalue_freeze). Every repeated container is a copy of the shared one (see
+	 * jvalue_duplicate), it is modified as usual: its members are copied the first time they
+	 * are accessed, the other copies don't change.
+	 */
+	DOMOPT_DEDUPLICATE = 16,
 } JDOMOptimization;
 
 /**
  * The combination of both conditions allows us to ensure
  * that it is safe to create the DOM without actually copying anything out of the input string.
+ * Only the strings that differ from their representation in the input (i.e. contain escapes)
+ * are decoded into memory shared by the strings of the document.
  */
 #define DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE (DOMOPT_INPUT_OUTLIVES_DOM | DOMOPT_INPUT_NOCHANGE)
 
@@ -0,0 +1,102 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JINDEX_H_
+#define JINDEX_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "japi.h"
+#include "jtypes.h"
+#include "compiler/nonnull_attribute.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hash index of the elements of an array by the value of a field, e.g. of the records by "/id".
+ *
+ * Strings, numbers and booleans are the keys, the elements without the field (or with another
+ * value there) aren't found. Numbers are compared by their values, so 1 and 1.0 are the same key.
+ * If several elements have the same key, the first one is found.
+ *
+ * The index keeps up with the array: the elements appended are indexed on the next lookup, any
+ * other modification of the array rebuilds the index then. A frozen array (see jvalue_freeze)
+ * never changes.
+ *
+ * NOTE: The index doesn't see the elements modified in place, e.g. jobject_put(element, "id", ...)
+ * doesn't change the array. The elements found are checked to still have the key, and a key
+ * missing from the table is looked for through all the elements (the index is rebuilt if it's
+ * found), so such lookups are correct but slow. A lookup of a key none of the elements has scans
+ * the whole array (except for a frozen one) too. If another element gets the key of an indexed
+ * one, the indexed one is still found first. Call jarray_index_rebuild after modifying the keys.
+ *
+ * NOTE: The lookups update the index, an index shouldn't be used by several threads at once.
+ */
+typedef struct jarray_index *jarray_index_ref;
+
+/**
+ * Index the elements of the array by the value of the field.
+ *
+ * @param arr The array to index, the index keeps a reference to it
+ * @param keyPath JSON Pointer (RFC 6901) of the field within an element, "" for the elements themselves
+ * @return The index, or NULL if the path is invalid or memory is out. Release it with jarray_index_release.
+ */
+PJSON_API jarray_index_ref jarray_build_index(jvalue_ref arr, const char *keyPath) NON_NULL(1, 2);
+
+/**
+ * Release the index, the array stays as is
+ *
+ * @param index The index to release, set to NULL afterwards
+ */
+PJSON_API void jarray_index_release(jarray_index_ref *index);
+
+/**
+ * Find the position of the element with the key.
+ *
+ * @param index The index of the array
+ * @param key The value of the field to look for
+ * @return The position of the first element with the key, -1 if there is none
+ */
+PJSON_API ssize_t jarray_index_find(jarray_index_ref index, jvalue_ref key) NON_NULL(1, 2);
+
+/**
+ * Get the element with the key, the same as jarray_get of the position found by jarray_index_find.
+ *
+ * @return The element, or jinvalid() if there is none
+ */
+PJSON_API jvalue_ref jarray_index_get(jarray_index_ref index, jvalue_ref key) NON_NULL(1, 2);
+
+/**
+ * Index the array anew, after the keys of its elements were modified in place
+ *
+ * @return false if memory is out, the index finds nothing then
+ */
+PJSON_API bool jarray_index_rebuild(jarray_index_ref index) NON_NULL(1);
+
+/**
+ * @return The array the index is built for
+ */
+PJSON_API jvalue_ref jarray_index_array(jarray_index_ref index) NON_NULL(1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JINDEX_H_ */
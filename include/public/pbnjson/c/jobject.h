@@ -91,9 +91,27 @@ PJSON_API jvalue_ref jvalue_copy(jvalue_ref val);
  * be seen in the copy.
  *
  * The implementation may cheat however with immutable objects by still doing a reference count.
+ * Strings, numbers and booleans are shared. The copy of a frozen object or array takes constant
+ * time: its members are copied the first time they are accessed, only along the paths used.
  */
 PJSON_API jvalue_ref jvalue_duplicate(jvalue_ref val);
 
+/**
+ * Make the value and all the values within it immutable, so that they can be shared freely.
+ *
+ * The objects and arrays of a frozen tree can't be modified anymore, modifications fail
+ * (jobject_put, jarray_append, jarray_splice and the like return false). Modify a
+ * jvalue_duplicate of the tree instead, the copy isn't frozen.
+ *
+ * @param val The root of the tree
+ */
+PJSON_API void jvalue_freeze(jvalue_ref val);
+
+/**
+ * Check if the value is frozen (see jvalue_freeze and DOMOPT_DEDUPLICATE)
+ */
+PJSON_API bool jis_frozen(jvalue_ref val);
+
 /**
  * Check if two JSON values are identical
  *
@@ -103,6 +121,26 @@ PJSON_API jvalue_ref jvalue_duplicate(jvalue_ref val);
  */
 PJSON_API bool jvalue_equal(jvalue_ref val, jvalue_ref other) NON_NULL(1, 2);
 
+/**
+ * Give the memory that a long-lived value doesn't need back to the heap.
+ *
+ * The containers of the tree are shrunk to their content and the cached string
+ * representations are dropped (the results of jvalue_tostring for the values of the tree
+ * become invalid). The values referenced from elsewhere and the frozen values may be read
+ * meanwhile, they're skipped together with their members.
+ *
+ * With JCOMPACT_RELOCATE the tree is moved into a single block of memory in depth-first
+ * order and *val is replaced with the new root. The block is freed with the last value in
+ * it. The values referenced from elsewhere and the containers of lazily parsed documents
+ * stay where they are, the new tree refers them. If *val itself is referenced from
+ * elsewhere, it is left as is. The tree stays modifiable after the relocation.
+ *
+ * @param val A pointer to the reference to the value, owned by the caller
+ * @param flags JCOMPACT_SHRINK or JCOMPACT_RELOCATE
+ * @return false if the memory for the block can't be allocated, *val is only shrunk then
+ */
+PJSON_API bool jvalue_compact(jvalue_ref *val, JCompactFlags flags) NON_NULL(1);
+
 /**
  * Release ownership from *val.  *val has an undefined value afterwards.  It is an error
  * to call this on references for which ownership does not preside with the caller
@@ -114,6 +152,40 @@ PJSON_API bool jvalue_equal(jvalue_ref val, jvalue_ref other) NON_NULL(1, 2);
  */
 PJSON_API void j_release(jvalue_ref *val);
 
+/**
+ * Release ownership from *val like j_release, but if it was the last reference to an object
+ * or an array, leave its destruction to a background thread. The calling thread doesn't wait
+ * for the members of a big document to be freed.
+ *
+ * From the first deferred release on, the references to all values are counted atomically:
+ * the members the value shares with the values in use may lose their last reference on
+ * either thread. Nothing else is synchronized, the values in use shouldn't be modified by
+ * other threads. The deallocators of the strings within the value run on the background
+ * thread.
+ *
+ * Without the atomic operations of the compiler the value is released in place.
+ *
+ * @param val A pointer to a value reference to release ownership for
+ * @see j_release_set_deferred
+ * @see j_release_wait
+ */
+PJSON_API void j_release_deferred(jvalue_ref *val);
+
+/**
+ * Make j_release destroy the big containers in the background, as j_release_deferred does.
+ * The policy is global, it applies to all threads.
+ *
+ * @param members The number of members from which the objects and the arrays are handed
+ *                over, 0 to destroy all of them in place (the default)
+ */
+PJSON_API void j_release_set_deferred(size_t members);
+
+/**
+ * Wait until the values the calling thread handed over to the background are destroyed
+ * (see j_release_deferred). A thread waits for them at exit too.
+ */
+PJSON_API void j_release_wait(void);
+
 /**
  * Return a reference to a value representing an invalid JSON null value. It is
  * redundant (but not illegal) to copy or release ownership on this reference
@@ -388,6 +460,68 @@ PJSON_API bool jobject_set2(jvalue_ref obj, jvalue_ref key, jvalue_ref val);
  */
 PJSON_API bool jobject_put(jvalue_ref obj, jvalue_ref key, jvalue_ref val);
 
+/**
+ * Create a key for the lookups repeated on many objects, its hash is computed once.
+ *
+ * @param key The name of the key
+ * @return The key, or NULL if memory is out. Release it with jkey_release.
+ *
+ * @see jobject_get_key
+ * @see jkey_intern
+ */
+PJSON_API jkey_ref jkey_create(raw_buffer key);
+
+/**
+ * Get the key shared by the whole process for the name, like jkey_create otherwise.
+ *
+ * The interned keys live as long as the process and can be used by several threads at once,
+ * releasing them changes nothing. The objects and the shapes the members were set to by such
+ * a key refer the same string, and the lookups find it by its address.
+ *
+ * @param key The name of the key
+ * @return The key, or NULL if memory is out
+ */
+PJSON_API jkey_ref jkey_intern(raw_buffer key);
+
+/**
+ * @return Another reference to the key
+ */
+PJSON_API jkey_ref jkey_copy(jkey_ref key) NON_NULL(1);
+
+/**
+ * Release the key
+ *
+ * @param key The key to release, set to NULL afterwards
+ */
+PJSON_API void jkey_release(jkey_ref *key);
+
+/**
+ * @return The JSON string of the key, ownership remains with the key
+ */
+PJSON_API jvalue_ref jkey_string(jkey_ref key) NON_NULL(1);
+
+/**
+ * Grab a reference to a JSON value within the parent object that has the key, the same as
+ * jobject_get but without hashing the name of the key again.
+ *
+ * @param obj The reference to the parent object to retrieve the value from
+ * @param key The key created by jkey_create or jkey_intern
+ *
+ * @return A reference to the JSON value associated with key under obj, or jinvalid()
+ */
+PJSON_API jvalue_ref jobject_get_key(jvalue_ref obj, jkey_ref key) NON_NULL(2);
+
+/**
+ * Associate val with key in object obj, the same as jobject_set but the object refers the string
+ * of the key instead of a copy of the name.
+ *
+ * @param obj The JSON object to insert into
+ * @param key The key created by jkey_create or jkey_intern
+ * @param val The reference to a JSON object containing the value to associate with key
+ * @return True if the association was made, false otherwise
+ */
+PJSON_API bool jobject_set_key(jvalue_ref obj, jkey_ref key, jvalue_ref val) NON_NULL(2);
+
 /**
  * Return number of key-value pairs in object obj;
  *
@@ -496,6 +630,36 @@ PJSON_API ssize_t jarray_size(jvalue_ref arr) NON_NULL(1);
  */
 PJSON_API jvalue_ref jarray_get(jvalue_ref arr, ssize_t index) NON_NULL(1);
 
+/**
+ * Get the elements of an array of numbers parsed from the text without creating a value for each of them.
+ *
+ * The DOM parser stores the numbers of an array unboxed if their text can be restored exactly: integers, and decimal
+ * fractions of at most 15 significant digits without exponent. The array of integers only is stored as such, its
+ * elements are available through jarray_get_i64_span only. Any modification of the array moves the numbers into
+ * values, the span isn't valid afterwards.
+ *
+ * @param arr The reference to the array
+ * @param span The elements of the array, valid until the array is modified or released
+ * @param size The number of elements
+ * @return True if the elements are stored as doubles, false for an array of integers only. An empty array always
+ * succeeds.
+ *
+ * @see jarray_get_i64_span
+ */
+PJSON_API bool jarray_get_f64_span(jvalue_ref arr, const double **span, size_t *size) NON_NULL(1, 2, 3);
+
+/**
+ * Get the elements of an array of integers parsed from the text without creating a value for each of them.
+ *
+ * @param arr The reference to the array
+ * @param span The elements of the array, valid until the array is modified or released
+ * @param size The number of elements
+ * @return True if every element of the array is an integer stored unboxed, an empty array always succeeds.
+ *
+ * @see jarray_get_f64_span
+ */
+PJSON_API bool jarray_get_i64_span(jvalue_ref arr, const int64_t **span, size_t *size) NON_NULL(1, 2, 3);
+
 /**
  * All elements at position above index have their positions decremented by 1.
  *
@@ -819,6 +983,8 @@ PJSON_API jvalue_ref jnumber_create(raw_buffer raw);
  *               the created JSON reference.
  * @param strFree The deallocator to use on the string (if any) after this JSON object is freed (e.g. if you dynamically allocated
  *                the string and want this library to take care of automatically deallocating it).
+ *                NOTE: A small integer is a shared number with its own text (see jnumber_create_i64), the buffer is
+ *                      deallocated right away then.
  * @return The JSON number reference
  * @see jnumber_create
  */
@@ -843,6 +1009,9 @@ PJSON_API jvalue_ref jnumber_create_i32(int32_t number);
 /**
  * Create a JSON reference to a value representing the requested number.
  *
+ * The small integers, like the booleans, are shared instances of static program scope (see jnull):
+ * creating them allocates nothing, and copying or releasing them is redundant (but not illegal).
+ *
  * @param number The number the JSON value should represent
  * @return A reference to a JSON number representing the requested value.
  */
@@ -1077,6 +1246,9 @@ PJSON_API bool jis_boolean(jvalue_ref jval) NON_NULL(1);
 /**
  * Create a JSON boolean with the requested value
  *
+ * There are only two booleans of static program scope, it is redundant (but not illegal) to copy or
+ * release ownership on them.
+ *
  * @param value The value of the boolean
  * @return The reference to the boolean.
  */
@@ -0,0 +1,130 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JPARSE_ASYNC_H_
+#define JPARSE_ASYNC_H_
+
+#include <stdbool.h>
+#include <glib.h>
+#include "japi.h"
+#include "jschema.h"
+#include "jparse_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Parser of the input from a file descriptor (a socket, a pipe) which is fed as the data arrives.
+ * Nothing is buffered but the state of the parser, so a lot of slow connections can be parsed
+ * by a single thread. The parser is driven either by a GLib main loop (jparse_async_source_new)
+ * or by an epoll loop of the application (jparse_async_epoll_add, jparse_async_dispatch).
+ */
+typedef struct jparse_async *jparse_async_ref;
+
+/**
+ * @brief Callback invoked once the input from the file descriptor is over or parsing has failed
+ *
+ * @param ctxt User context passed to jparse_async_dom_new/jparse_async_sax_new
+ * @param value Parsed DOM (jparse_async_dom_new) or NULL (jparse_async_sax_new). It is jinvalid() if
+ *              parsing has failed. The value is released after the callback returns, use
+ *              jvalue_copy to keep it.
+ * @param error Description of the read, parse or validation error, NULL if the input is valid
+ */
+typedef void (*jparse_async_callback)(void *ctxt, jvalue_ref value, const char *error);
+
+/**
+ * @brief jparse_async_dom_new Create a parser of a DOM from a file descriptor
+ *
+ * The descriptor is switched to the non-blocking mode. It isn't closed by the parser.
+ *
+ * @param fd File descriptor to read the input from until the end of file
+ * @param optimizationMode Optimization flags
+ * @param schemaInfo The schema to use for validation of the input, along with any other callbacks necessary (such as schema resolver,
+ *                   error handler). The structure is copied, the schema should outlive the parser.
+ * @param callback The function to receive the result
+ * @param ctxt User context for the callback
+ * @return The parser or NULL on error. Release it with jparse_async_free.
+ */
+PJSON_API jparse_async_ref jparse_async_dom_new(int fd, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo,
+                                                jparse_async_callback callback, void *ctxt);
+
+/**
+ * @brief jparse_async_sax_new Create a SAX parser of the input from a file descriptor
+ *
+ * @param fd File descriptor to read the input from until the end of file
+ * @param schemaInfo The schema to use for validation of the input, the structure is copied
+ * @param parserCallbacks A pointer to a SAXCallbacks structure with pointers to functions that handle the appropriate
+ *                        parsing events
+ * @param parserCtxt Context that will be returned in the parsing callbacks
+ * @param callback The function to be called at the end of the input
+ * @param ctxt User context for the callback
+ * @return The parser or NULL on error. Release it with jparse_async_free.
+ *
+ * @see jparse_async_dom_new
+ */
+PJSON_API jparse_async_ref jparse_async_sax_new(int fd, JSchemaInfoRef schemaInfo,
+                                                PJSAXCallbacks *parserCallbacks, void *parserCtxt,
+                                                jparse_async_callback callback, void *ctxt);
+
+/**
+ * @brief jparse_async_dispatch Read and parse the input available from the file descriptor
+ *
+ * Call it whenever the descriptor becomes readable. The callback is invoked from here when
+ * the input is over or parsing fails.
+ *
+ * @param async The parser
+ * @return true if more input is expected, false if the parser has finished
+ */
+PJSON_API bool jparse_async_dispatch(jparse_async_ref async);
+
+/**
+ * @brief jparse_async_epoll_add Watch the file descriptor of the parser with an epoll instance
+ *
+ * The parser is stored in the data.ptr of the epoll event: pass it to jparse_async_dispatch
+ * when epoll_wait reports the event. The descriptor is removed from the epoll instance when
+ * the parser finishes.
+ *
+ * @param async The parser
+ * @param epfd The epoll instance
+ * @return false on error
+ */
+PJSON_API bool jparse_async_epoll_add(jparse_async_ref async, int epfd);
+
+/**
+ * @brief jparse_async_source_new Create a GLib event source which drives the parser
+ *
+ * The source owns the parser and releases it when the source is finalized. It is destroyed
+ * once the parser finishes.
+ *
+ * @param async The parser
+ * @return A new source, attach it to a main context with g_source_attach
+ */
+PJSON_API GSource *jparse_async_source_new(jparse_async_ref async);
+
+/**
+ * @brief jparse_async_free Release the parser. The callback isn't invoked if it hasn't finished.
+ * @param async The parser, may be NULL
+ */
+PJSON_API void jparse_async_free(jparse_async_ref async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JPARSE_ASYNC_H_ */
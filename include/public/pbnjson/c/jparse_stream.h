@@ -33,10 +33,17 @@ extern "C" {
 /**
  * Returns the DOM structure of the JSON document contained within the given file.
  *
+ * By default the file is read and parsed in chunks of bounded size, so the memory used is proportional
+ * to the DOM rather than to the file. Pipes and character devices (e.g. /dev/stdin) are accepted.
+ *
+ * NOTE: With JFileOptMMap the strings and numbers of the DOM reference the mapped file, which is kept
+ *       until the returned value is released. Values of the DOM shouldn't be used after that.
+ *
  * @param file The c-string representing the path to parse.
  * @param schemaInfo The schema to use for validation of the input, along with any other callbacks necessary (such as schema resolver,
  *                   error handler).
- * @param opts The optimization mode to use when parsing the file.
+ * @param opts The optimization mode to use when parsing the file. JFileOptMMap is ignored if the
+ *             file can't be mapped (isn't a regular file or is empty).
  * @return An opaque reference handle to the DOM.  Use jis_valid to determine whether or
  *         not parsing succeeded.
  */
@@ -84,6 +91,63 @@ PJSON_API bool jsax_parse_ex(PJSAXCallbacks *parser, raw_buffer input, JSchemaIn
  */
 PJSON_API bool jsax_parse(PJSAXCallbacks *parser, raw_buffer input, JSchemaInfoRef schemaInfo) NON_NULL(3);
 
+/**
+ * Returns the DOM structure of the JSON document, that is built on demand.
+ *
+ * The input is only scanned for its structure during the call. Objects and arrays are filled
+ * with their members the first time they are accessed (jobject_get, jarray_get, iterators, size
+ * and so on). Untouched parts of the document cost neither memory nor time.
+ * NOTE: Accessors of a lazy DOM modify it, it isn't safe to read it from several threads
+ *       at once without synchronization.
+ *
+ * @param input The input string to parse.
+ *              NOTE: Unless DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE is given, the input is copied,
+ *              as the DOM is materialized after the function returns.
+ * @param optimizationMode Additional information about the input string that lets us optimize the creation process of the DOM.
+ * @param schemaInfo The schema to use for validation of the input. Validation against anything
+ *                   but jschema_all() requires an additional pass over the input. If the schema
+ *                   inserts default values into the document, the document is built at once by
+ *                   jdom_parse, with the defaults.
+ * @return An opaque reference handle to the DOM.  Use jis_valid to determine whether or
+ *         not parsing succeeded. The documents nested deeper than jdom_parse accepts are
+ *         rejected too.
+ *
+ * @see jdom_parse
+ */
+PJSON_API jvalue_ref jdom_parse_lazy(raw_buffer input, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo) NON_NULL(3);
+
+/**
+ * Returns the DOM structure with only the requested parts of the JSON document.
+ *
+ * Everything outside of the paths is skipped without creating any values. Intermediate objects and
+ * arrays on the way to the requested values are kept (possibly empty).
+ * NOTE: The document is only checked to be well-formed, no schema is applied.
+ *
+ * @param input The input string to parse.
+ * @param paths Array of JSON Pointers (RFC 6901) to include, e.g. "/header/type" or "/items/0". The
+ *              empty pointer "" selects the whole document.
+ * @param pathsCount Number of the paths
+ * @return An opaque reference handle to the DOM.  Use jis_valid to determine whether or
+ *         not parsing succeeded.
+ */
+PJSON_API jvalue_ref jdom_parse_projection(raw_buffer input, const char * const *paths, size_t pathsCount);
+
+/**
+ * Parse the input using SAX callbacks, reporting only the events within the requested paths.
+ *
+ * @param parser A pointer to a SAXCallbacks structure with pointers to functions that handle the appropriate
+ *               parsing events.
+ * @param input The input string to parse
+ * @param paths Array of JSON Pointers (RFC 6901) to report
+ * @param pathsCount Number of the paths
+ * @param data The ctxt parameter during parsing.
+ * @return True if parsing succeeded, false otherwise.
+ *
+ * @see jdom_parse_projection
+ */
+PJSON_API bool jsax_parse_projection(PJSAXCallbacks *parser, raw_buffer input, const char * const *paths, size_t pathsCount,
+                                     void *data) NON_NULL(1);
+
 /**
  * @see jparse_stream.c for an example of how the library uses it to implement the dom_parse functionality.
  */
@@ -94,6 +158,16 @@ PJSON_API void jsax_changeContext(JSAXContextRef saxCtxt, void *userCtxt);
  */
 PJSON_API void* jsax_getContext(JSAXContextRef saxCtxt);
 
+/**
+ * @brief jsax_pause Pause parsing from within a callback
+ *
+ * It's honored only within jsaxparser_feed_ex and jsaxparser_resume, which return JSAXPARSER_PAUSED
+ * after the callback. No more callbacks are called until jsaxparser_resume.
+ *
+ * @param saxCtxt The context passed to the callback
+ */
+PJSON_API void jsax_pause(JSAXContextRef saxCtxt);
+
 /**
  * @brief jsaxparser_init Create and initialize SAX stream parser
  * @param schemaInfo The schema to use for validation of the input, along with any other callbacks necessary (such as schema resolver,
@@ -114,6 +188,42 @@ jsaxparser_ref jsaxparser_create(JSchemaInfoRef schemaInfo, PJSAXCallbacks *call
  */
 PJSON_API bool jsaxparser_feed(jsaxparser_ref parser, const char *buf, int buf_len);
 
+/**
+ * @brief Result of jsaxparser_feed_ex and jsaxparser_resume
+ */
+typedef enum {
+	JSAXPARSER_OK,      /// the whole input has been parsed
+	JSAXPARSER_PAUSED,  /// a callback has called jsax_pause
+	JSAXPARSER_ERROR,   /// see jsaxparser_get_error
+} jsaxparser_status;
+
+/**
+ * @brief jsaxparser_feed_ex Parse part of json from input buffer, the callbacks may pause parsing
+ *
+ * If a callback calls jsax_pause, the function returns JSAXPARSER_PAUSED and no callbacks are
+ * called until jsaxparser_resume. The rest of the buffer isn't copied: it should stay intact
+ * until jsaxparser_resume returns anything but JSAXPARSER_PAUSED. Neither jsaxparser_feed
+ * nor jsaxparser_end can be called while the parser is paused.
+ *
+ * @param parser Pointer to SAX parser
+ * @param buf Input buffer
+ * @param buf_len Input buffer length
+ * @param consumed Number of bytes of the buffer taken by the parser, the rest is parsed on resume.
+ *                 The parser may have taken the input a bit (up to 4KiB) past the value it has paused at,
+ *                 the events from it are kept for jsaxparser_resume. May be NULL.
+ * @return JSAXPARSER_OK if the whole buffer has been parsed
+ */
+PJSON_API jsaxparser_status jsaxparser_feed_ex(jsaxparser_ref parser, const char *buf, size_t buf_len, size_t *consumed);
+
+/**
+ * @brief jsaxparser_resume Continue parsing of the buffer passed to jsaxparser_feed_ex after a pause
+ * @param parser Pointer to SAX parser
+ * @param consumed Number of bytes of the buffer passed to jsaxparser_feed_ex taken by the parser
+ *                 so far, counted from its beginning. May be NULL.
+ * @return JSAXPARSER_OK if the rest of the buffer has been parsed, JSAXPARSER_PAUSED if paused again
+ */
+PJSON_API jsaxparser_status jsaxparser_resume(jsaxparser_ref parser, size_t *consumed);
+
 /**
  * @brief jsaxparser_end Finalize stream parsing
  * @param parser Pointer to SAX parser
@@ -134,6 +244,64 @@ PJSON_API void jsaxparser_release(jsaxparser_ref *parser);
  */
 PJSON_API const char* jsaxparser_get_error(jsaxparser_ref parser);
 
+/**
+ * @brief jsaxparser_set_string_chunks Deliver long string values by chunks of bounded size
+ *
+ * A string value longer than chunkSize bytes in the input is never kept by the parser as a whole:
+ * its unescaped contents are passed to callbacks->m_stringChunk in chunks of at most chunkSize bytes
+ * as the input is fed, and callbacks->m_stringEnd is called at its end. It is validated against the schema
+ * when it ends; the memory needed for it is constant unless the schema checks string contents with
+ * "pattern" or "enum". Shorter strings and object keys are passed to the m_string and m_objKey
+ * callbacks as usual. Should be called before the first jsaxparser_feed.
+ *
+ * @param parser Pointer to SAX parser
+ * @param callbacks Callbacks to receive the chunks, NULL to switch the delivery by chunks off
+ * @param chunkSize Maximal size of a chunk, greater than 0
+ * @return false on error
+ */
+PJSON_API bool jsaxparser_set_string_chunks(jsaxparser_ref parser, const PJSAXStringCallbacks *callbacks, size_t chunkSize);
+
+/**
+ * @brief jsaxparser_set_utf8_validation Reject strings and object keys which aren't well-formed UTF-8
+ *
+ * The input isn't checked for UTF-8 by default, malformed sequences are passed to the callbacks as is.
+ * With the validation on, overlong encodings, surrogates and code points above U+10FFFF fail parsing
+ * as well. Should be called before the first jsaxparser_feed.
+ *
+ * @param parser Pointer to SAX parser
+ * @param enable true to validate the strings
+ * @return false on error
+ *
+ * @see DOMOPT_VALIDATE_UTF8
+ */
+PJSON_API bool jsaxparser_set_utf8_validation(jsaxparser_ref parser, bool enable);
+
+/**
+ * @brief Callback invoked for every top-level value parsed in the multiple values mode
+ *
+ * It is also used by jdomparser_set_element_callback to report array elements.
+ *
+ * @param ctxt User context passed to jsaxparser_set_multiple_values/jdomparser_set_multiple_values
+ * @param value The parsed document for the DOM parser, NULL for the SAX parser. The value is released
+ *              after the callback returns, use jvalue_copy to keep it.
+ * @return false to stop parsing. jsaxparser_feed/jdomparser_feed will return false.
+ */
+typedef bool (*jparse_document_callback)(void *ctxt, jvalue_ref value);
+
+/**
+ * @brief jsaxparser_set_multiple_values Enable parsing of a stream of concatenated JSON values
+ *
+ * The parser accepts any number of top-level values one after another (optionally separated by whitespace),
+ * and every value is validated against the schema from scratch. Should be called before the first
+ * jsaxparser_feed.
+ *
+ * @param parser Pointer to SAX parser
+ * @param callback The function to be called after every top-level value, may be NULL
+ * @param ctxt User context for the callback
+ * @return false on error
+ */
+PJSON_API bool jsaxparser_set_multiple_values(jsaxparser_ref parser, jparse_document_callback callback, void *ctxt);
+
 /**
  * @brief jdomparser_create Create and initialize DOM stream parser
  * @param schemaInfo The schema to use for validation of the input, along with any other callbacks necessary (such as schema resolver,
@@ -179,6 +347,97 @@ PJSON_API const char* jdomparser_get_error(jdomparser_ref parser);
  */
 PJSON_API jvalue_ref jdomparser_get_result(jdomparser_ref parser);
 
+/**
+ * @brief jdomparser_set_multiple_values Enable parsing of a stream of concatenated JSON documents
+ *
+ * Every parsed document is passed to the callback and then dropped by the parser, so jdomparser_get_result
+ * returns jinvalid in this mode. Should be called before the first jdomparser_feed.
+ *
+ * @param parser Pointer to DOM parser
+ * @param callback The function to receive every document
+ * @param ctxt User context for the callback
+ * @return false on error
+ *
+ * @see jsaxparser_set_multiple_values
+ */
+PJSON_API bool jdomparser_set_multiple_values(jdomparser_ref parser, jparse_document_callback callback, void *ctxt);
+
+/**
+ * @brief jdomparser_set_element_callback Report the elements of a (huge) array one by one
+ *
+ * Every element of the array at the path is passed to the callback as a standalone value as soon as
+ * it is parsed, and then dropped by the parser. The array stays empty in the result of jdomparser_get_result,
+ * so the memory used is bounded by the biggest element rather than by the whole document. The elements
+ * are validated against the schema of the array items before they are reported. Should be called
+ * before the first jdomparser_feed.
+ *
+ * @param parser Pointer to DOM parser
+ * @param path JSON Pointer of the array, "" for the top-level array, e.g. "/items". If the value
+ *             at the path isn't an array, it is added to the DOM as usual.
+ * @param callback The function to receive every element, its document argument is the element
+ * @param ctxt User context for the callback
+ * @return false on error
+ */
+PJSON_API bool jdomparser_set_element_callback(jdomparser_ref parser, const char *path,
+                                               jparse_document_callback callback, void *ctxt);
+
+/**
+ * @brief Callback invoked for every record of newline-delimited JSON input
+ *
+ * Records are reported strictly in input order and always from the thread that called
+ * jdom_parse_lines/jsax_parse_lines.
+ *
+ * @param ctxt User context passed to jdom_parse_lines/jsax_parse_lines
+ * @param line 1-based line number of the record within the input
+ * @param value Parsed DOM of the record (jdom_parse_lines) or NULL (jsax_parse_lines). It is jinvalid() if
+ *              the record failed to parse. The value is released after the callback returns, use
+ *              jvalue_copy to keep it.
+ * @param error Description of the parse or validation error, NULL if the record is valid
+ * @return false to stop processing of the remaining records
+ */
+typedef bool (*jparse_lines_callback)(void *ctxt, size_t line, jvalue_ref value, const char *error);
+
+/**
+ * @brief jdom_parse_lines Parse newline-delimited JSON (NDJSON, JSON Lines)
+ *
+ * Every non-empty line of the input is parsed as a standalone JSON document and validated
+ * against the schema. Records are parsed by a pool of worker threads, the results are delivered
+ * in input order through the callback.
+ *
+ * @param input The input buffer. It must stay unchanged until the function returns.
+ * @param optimizationMode Optimization flags for the DOM of every record
+ * @param schemaInfo The schema to validate every record against. The error handlers of schemaInfo are
+ *                   not called, errors are reported per record through the callback instead.
+ * @param threads Number of worker threads, 0 to use the number of online CPUs
+ * @param callback The function to receive every record
+ * @param ctxt User context for the callback
+ * @return true if all records were parsed and validated successfully, false otherwise
+ */
+PJSON_API bool jdom_parse_lines(raw_buffer input, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo,
+                                int threads, jparse_lines_callback callback, void *ctxt) NON_NULL(3, 5);
+
+/**
+ * @brief jsax_parse_lines Parse newline-delimited JSON (NDJSON, JSON Lines) with SAX callbacks
+ *
+ * Same as jdom_parse_lines, but every record is fed to the SAX callbacks. NOTE: SAX callbacks are
+ * invoked concurrently from the worker threads, and data is shared between all of them. Only the
+ * completion callback is serialized and ordered.
+ *
+ * @param parser A pointer to a SAXCallbacks structure with pointers to functions that handle the appropriate
+ *               parsing events.
+ * @param input The input buffer
+ * @param schemaInfo The schema to validate every record against
+ * @param data The ctxt parameter for the SAX callbacks
+ * @param threads Number of worker threads, 0 to use the number of online CPUs
+ * @param callback The function to receive completion of every record, may be NULL
+ * @param ctxt User context for the callback
+ * @return true if all records were parsed and validated successfully, false otherwise
+ *
+ * @see jdom_parse_lines
+ */
+PJSON_API bool jsax_parse_lines(PJSAXCallbacks *parser, raw_buffer input, JSchemaInfoRef schemaInfo, void *data,
+                                int threads, jparse_lines_callback callback, void *ctxt) NON_NULL(3);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,6 +54,19 @@ typedef struct {
 	jsax_null m_null;
 } PJSAXCallbacks;
 
+typedef int (*jsax_string_chunk)(JSAXContextRef ctxt, const char *chunk, size_t chunkLen);
+typedef int (*jsax_string_end)(JSAXContextRef ctxt);
+
+/**
+ * Callbacks for string values delivered by chunks (see jsaxparser_set_string_chunks).
+ * Every long string is passed to m_stringChunk piece by piece, already unescaped, followed
+ * by m_stringEnd instead of a single m_string call. Both have to be set.
+ */
+typedef struct {
+	jsax_string_chunk m_stringChunk;
+	jsax_string_end m_stringEnd;
+} PJSAXStringCallbacks;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,171 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JTAPE_H_
+#define JTAPE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "japi.h"
+#include "jtypes.h"
+#include "jconversion.h"
+#include "jschema.h"
+#include "compiler/nonnull_attribute.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Immutable flat representation of a JSON document.
+ *
+ * The document is stored as a single array of 64-bit words (structure, booleans, nulls and
+ * integers) and a single arena for strings. It takes much less memory than a DOM and there
+ * are no per-value allocations. Use jvalue_from_tape to get a mutable DOM of any part of it.
+ */
+typedef struct jtape *jtape_ref;
+
+/**
+ * Position of a value within a tape. A cursor is valid as long as its tape isn't released.
+ */
+typedef struct {
+	jtape_ref m_tape;   /// NULL for the invalid cursor
+	size_t m_index;
+} jtape_cursor;
+
+/**
+ * Iterator over the members of an object or the elements of an array on a tape.
+ */
+typedef struct {
+	jtape_cursor m_cur;
+	bool m_object;
+} jtape_iter;
+
+/**
+ * Parse the input into a tape.
+ *
+ * @param input The input string to parse.
+ * @param schemaInfo The schema to use for validation of the input, along with any other callbacks necessary (such as schema resolver,
+ *                   error handler).
+ * @return The tape or NULL if parsing or validation failed. Release it with jtape_release.
+ */
+PJSON_API jtape_ref jtape_parse(raw_buffer input, JSchemaInfoRef schemaInfo) NON_NULL(2);
+
+/**
+ * Release the tape. All the cursors to the tape become invalid.
+ *
+ * @param tape The tape to release, set to NULL afterwards
+ */
+PJSON_API void jtape_release(jtape_ref *tape);
+
+/**
+ * @return Cursor to the top-level value of the tape
+ */
+PJSON_API jtape_cursor jtape_root(jtape_ref tape);
+
+/**
+ * @return true if the cursor points to a value, false for a not found key or an out-of-range index
+ */
+PJSON_API bool jtape_is_valid(jtape_cursor cur);
+
+/**
+ * @return The type of the value. The invalid cursor has the type JV_NULL.
+ */
+PJSON_API JValueType jtape_get_type(jtape_cursor cur);
+
+/**
+ * @return Number of members of the object or elements of the array, 0 for anything else
+ */
+PJSON_API size_t jtape_size(jtape_cursor cur);
+
+/**
+ * Find the value of a key in an object. Takes linear time in the number of members.
+ * If the key is duplicated, the first occurrence is found.
+ *
+ * @param obj Cursor to the object
+ * @param key The key to find
+ * @return Cursor to the value, invalid cursor if the key isn't there
+ */
+PJSON_API jtape_cursor jtape_find_key(jtape_cursor obj, raw_buffer key);
+
+/**
+ * Get an array element. Takes linear time in the index.
+ *
+ * @param arr Cursor to the array
+ * @param index Index of the element
+ * @return Cursor to the element, invalid cursor if the index is out of range
+ */
+PJSON_API jtape_cursor jtape_index(jtape_cursor arr, size_t index);
+
+/**
+ * Start iteration over an object or an array.
+ *
+ * @return false if the cursor points to neither an object nor an array
+ */
+PJSON_API bool jtape_iter_init(jtape_iter *iter, jtape_cursor container) NON_NULL(1);
+
+/**
+ * Advance to the next member of an object or element of an array.
+ *
+ * @param iter The iterator
+ * @param key Cursor to the key of an object member (a string), invalid for arrays. May be NULL.
+ * @param value Cursor to the value. May be NULL.
+ * @return false if there are no more values
+ */
+PJSON_API bool jtape_iter_next(jtape_iter *iter, jtape_cursor *key, jtape_cursor *value) NON_NULL(1);
+
+/**
+ * @return false if the value isn't a boolean
+ */
+PJSON_API bool jtape_get_boolean(jtape_cursor cur, bool *value) NON_NULL(2);
+
+/**
+ * Get a string without copying it. The buffer is null-terminated and lives as long as the tape.
+ *
+ * @return false if the value isn't a string
+ */
+PJSON_API bool jtape_get_string(jtape_cursor cur, raw_buffer *value) NON_NULL(2);
+
+/**
+ * @see jnumber_get_i32
+ */
+PJSON_API ConversionResultFlags jtape_get_i32(jtape_cursor cur, int32_t *value) NON_NULL(2);
+
+/**
+ * @see jnumber_get_i64
+ */
+PJSON_API ConversionResultFlags jtape_get_i64(jtape_cursor cur, int64_t *value) NON_NULL(2);
+
+/**
+ * @see jnumber_get_f64
+ */
+PJSON_API ConversionResultFlags jtape_get_f64(jtape_cursor cur, double *value) NON_NULL(2);
+
+/**
+ * Create a DOM of the value, e.g. to modify it.
+ *
+ * @param cur Cursor to the value
+ * @return A new DOM that doesn't depend on the tape, jinvalid() for the invalid cursor
+ */
+PJSON_API jvalue_ref jvalue_from_tape(jtape_cursor cur);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JTAPE_H_ */
@@ -41,6 +41,9 @@ typedef struct jvalue* jvalue_ref;
 typedef struct jsaxparser *jsaxparser_ref;
 typedef struct jdomparser *jdomparser_ref;
 
+/// Key of the object members with its hash computed beforehand, see jkey_create
+typedef struct jkey *jkey_ref;
+
 typedef struct {
 	GHashTableIter m_iter;
 } jobject_iter;
@@ -55,6 +58,11 @@ typedef enum {
 	SPLICE_COPY, /// the new array retains a copy of the individual elements from the first array
 } JSpliceOwnership;
 
+typedef enum {
+	JCOMPACT_SHRINK = 0,        /// shrink the storage of the containers to their content
+	JCOMPACT_RELOCATE = 1 << 0, /// also move the tree into a single block of memory in depth-first order
+} JCompactFlags;
+
 /**
  * A structure to represent strings that have length instead of being NULL-terminated.
  * This means it's friendly with Unicode encodings other than UTF-8 but more importantly allows
@@ -0,0 +1,86 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JARRAY_INDEX_CXX_H_
+#define JARRAY_INDEX_CXX_H_
+
+#include "japi.h"
+#include "JValue.h"
+#include "../c/jindex.h"
+
+#include <string>
+
+namespace pbnjson {
+
+/**
+ * Hash index of the elements of an array by the value of a field, for the repeated lookups
+ * of the records by a key:
+ *
+ * @code
+ * JArrayIndex byId(users, "/id");
+ * JValue user = byId[42];
+ * @endcode
+ *
+ * The index keeps up with the modifications of the array, see jarray_index_ref for the details.
+ *
+ * Not thread safe, the lookups update the index.
+ */
+class PJSONCXX_API JArrayIndex
+{
+public:
+	/**
+	 * Index the elements of the array.
+	 *
+	 * @param array The array to index, the index keeps a reference to it
+	 * @param keyPath JSON Pointer of the field within an element, "" for the elements themselves
+	 *
+	 * @see isValid
+	 */
+	JArrayIndex(const JValue &array, const std::string &keyPath);
+	~JArrayIndex();
+
+	/**
+	 * @return false if the value isn't an array or the path is invalid
+	 */
+	bool isValid() const;
+
+	/**
+	 * @return The position of the first element with the key, -1 if there is none
+	 */
+	ssize_t find(const JValue &key) const;
+
+	/**
+	 * @return The first element with the key, or an invalid value if there is none
+	 */
+	JValue operator[](const JValue &key) const;
+
+	/**
+	 * Index the array anew, after the keys of its elements were modified in place
+	 */
+	bool rebuild();
+
+private:
+	jarray_index_ref m_index;
+
+	JArrayIndex(const JArrayIndex &);
+	JArrayIndex& operator=(const JArrayIndex &);
+};
+
+}
+
+#endif /* JARRAY_INDEX_CXX_H_ */
@@ -0,0 +1,85 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JKEY_CXX_H_
+#define JKEY_CXX_H_
+
+#include "japi.h"
+#include "../c/jtypes.h"
+
+#include <string>
+
+namespace pbnjson {
+
+class JValue;
+
+/**
+ * Key of the object members with its hash computed once, for the lookups repeated on many
+ * objects:
+ *
+ * @code
+ * static const JKey timestamp = JKey::intern("timestamp");
+ * for (...)
+ *     total += event[timestamp].asNumber<int64_t>();
+ * @endcode
+ *
+ * @see jkey_create
+ * @see jkey_intern
+ */
+class PJSONCXX_API JKey
+{
+	friend class JValue;
+
+public:
+	/**
+	 * Create a key of its own
+	 *
+	 * @param name The name of the key
+	 */
+	explicit JKey(const std::string &name);
+
+	JKey(const JKey &other);
+	JKey& operator=(const JKey &other);
+	~JKey();
+
+	/**
+	 * Get the key shared by the whole process for the name, it can be used by several threads at once
+	 *
+	 * @param name The name of the key
+	 */
+	static JKey intern(const std::string &name);
+
+	/**
+	 * @return false if memory was out when the key was created
+	 */
+	bool isValid() const;
+
+	/**
+	 * @return The name of the key
+	 */
+	std::string name() const;
+
+private:
+	jkey_ref m_key;
+
+	explicit JKey(jkey_ref toOwn);
+};
+
+}
+
+#endif /* JKEY_CXX_H_ */
@@ -56,6 +56,15 @@ public:
 		int m_column;
 	};
 
+	/**
+	 * Result of feed with flow control and of resume
+	 */
+	enum FeedStatus {
+		FEED_DONE,    ///< the whole input has been parsed
+		FEED_PAUSED,  ///< a callback has called pause()
+		FEED_FAILED,  ///< see getError
+	};
+
 	JParser();
 	/**
 	 * @deprecated Will be removed in 3.0. Resolve schema with JSchemaFile
@@ -107,6 +116,29 @@ public:
 	 */
 	bool feed(const std::string &data) { return feed(data.data(), data.size()); }
 
+	/**
+	 * @brief feed parse input json chunk by chunk, the callbacks may pause parsing
+	 *
+	 * If a callback calls pause(), FEED_PAUSED is returned and no more callbacks are called
+	 * until resume. The rest of the buffer isn't copied, it should stay intact until resume
+	 * returns anything but FEED_PAUSED.
+	 *
+	 * @param buf input buffer
+	 * @param length input buffer size
+	 * @param consumed number of bytes of the buffer taken by the parser
+	 * @return FEED_DONE if the whole buffer has been parsed
+	 *
+	 * @see jsaxparser_feed_ex
+	 */
+	FeedStatus feed(const char *buf, size_t length, size_t &consumed);
+
+	/**
+	 * @brief resume Continue parsing of the buffer passed to feed after a pause
+	 * @param consumed number of bytes of the buffer taken by the parser so far
+	 * @return FEED_DONE if the rest of the buffer has been parsed, FEED_PAUSED if paused again
+	 */
+	FeedStatus resume(size_t &consumed);
+
 	/**
 	 * @brief end Finalize stream parsing. Final schema checks
 	 * @return false on error
@@ -209,6 +241,12 @@ protected:
 	JErrorHandler* errorHandlers() const;
 	void setErrorHandlers(JErrorHandler* errors);
 
+	/**
+	 * Pause parsing from within a callback, the callback should return true.
+	 * It's honored only when parsing with feed(buf, length, consumed) or resume.
+	 */
+	void pause();
+
 protected:
 	std::auto_ptr<JSchemaResolverWrapper> m_resolverWrapper;
 
@@ -41,6 +41,7 @@ namespace pbnjson {
 
 class JSchema;
 class JValueArrayElement;
+class JKey;
 
 /**
  * This class represents an opaque object containing a JSON value.
@@ -59,6 +60,7 @@ class PJSONCXX_API JValue
 	friend class JDomParser;
 	friend class JGenerator;
 	friend class JValidator;
+	friend class JArrayIndex;
 	friend JValue Object();
 	friend JValue Array();
 
@@ -179,6 +181,25 @@ public:
 	 * @return The reference to newly created JSON value.
 	 */
 	JValue duplicate() const;
+
+	/**
+	 * Make this JSON value and all the values within it immutable. Modifications of the frozen
+	 * objects and arrays fail, duplicate() returns a modifiable copy in constant time, the
+	 * members are copied as they are accessed.
+	 *
+	 * @see isFrozen()
+	 */
+	void freeze();
+
+	/**
+	 * Make the destructors and the assignments that drop the last reference to a big object
+	 * or array leave its destruction to a background thread (see j_release_set_deferred).
+	 * The policy applies to all threads.
+	 *
+	 * @param members The number of members from which the objects and the arrays are
+	 *                destroyed in the background, 0 to destroy all of them in place
+	 */
+	static void deferRelease(size_t members);
 	//@}
 
 	~JValue();
@@ -303,6 +324,14 @@ public:
 	 * @return The value associated with the key, or a JSON null if this isn't a JSON object.
 	 */
 	JValueArrayElement operator[](const raw_buffer& key) const;
+	/**
+	 * Look up the value by the key created beforehand, without hashing its name again.
+	 *
+	 * @param[in] key The key to look up
+	 * @return The value associated with the key, or a JSON null if this isn't a JSON object.
+	 * @see JKey
+	 */
+	JValueArrayElement operator[](const JKey& key) const;
 	//@}
 
 
@@ -392,6 +421,17 @@ public:
 	 */
 	bool put(const JValue& key, const JValue& value);
 
+	/**
+	 * Add a key/value pair to a JSON object by the key created beforehand, the object refers the
+	 * string of the key.
+	 *
+	 * @param[in] key
+	 * @param[in] value Any JSON object.
+	 * @return True if this object represents a JSON object & the key/value pair was successfully inserted.
+	 * @see JKey
+	 */
+	bool put(const JKey& key, const JValue& value);
+
 	/**
 	 * Convenience method for adding a value to a JSON object.
 	 *
@@ -506,6 +546,12 @@ public:
 	 * @return True if this is a JSON boolean, false otherwise.
 	 */
 	bool isBoolean() const;
+	/**
+	 * Determines whether or not this JSON value is frozen.
+	 * @return True if this JSON value can't be modified, false otherwise.
+	 * @see freeze()
+	 */
+	bool isFrozen() const;
 
 	//{@
 	/**
@@ -0,0 +1,701 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jcolumns.h>
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jobject_internal.h"
+#include "jpointer.h"
+#include "jschema_types_internal.h"
+#include "validation/validator.h"
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The rows of a thread start at a whole byte of the bitmaps, and take a cache line of them at least
+#define COLUMNS_ROWS_ALIGN 64
+
+/**
+ * The value of a column in a row. The numbers of a packed array aren't boxed, as boxing
+ * modifies the array: m_packed and m_index refer the number then.
+ */
+typedef struct {
+	jvalue_ref m_value;
+	const jpacked *m_packed;
+	ssize_t m_index;
+} column_cell;
+
+typedef enum {
+	CELL_NONE,  // no value, or JSON null
+	CELL_FOUND,
+	CELL_LAZY,  // a lazy container on the way, it can't be accessed by several threads
+} cell_result;
+
+/**
+ * What a range of rows has got in a column
+ */
+typedef struct {
+	JColumnType m_type; // integers decided by the values may become numbers in some ranges only
+	size_t m_nulls;
+	char *m_data;       // the strings of the rows, the offsets are relative to it
+	size_t m_size;
+	size_t m_capacity;
+} column_part;
+
+typedef struct columns_job columns_job;
+
+typedef struct {
+	const columns_job *m_job;
+	size_t m_begin;
+	size_t m_end;
+	column_part *m_parts; // one per column
+	bool m_failed;
+	bool m_lazy;          // stopped at a lazy container, see CELL_LAZY
+	pthread_t m_thread;
+} columns_range;
+
+struct columns_job {
+	jvalue_ref m_arr;
+	size_t m_rows;
+	jcolumn *m_columns;
+	size_t m_count;
+	jpointer_path *m_paths;
+	JColumnType *m_requested;
+	bool m_shared;        // the rows are divided among the threads
+};
+
+static cell_result column_find(jvalue_ref arr, size_t row, const jpointer_path *path, bool shared, column_cell *cell)
+{
+	jvalue_ref container = arr;
+	ssize_t index = row;
+	size_t i = 0;
+
+	for (;;) {
+		if (shared && jis_lazy(container))
+			return CELL_LAZY;
+
+		if (jis_packed(container)) {
+			// The numbers have no members
+			if (i < path->m_count)
+				return CELL_NONE;
+			cell->m_value = NULL;
+			cell->m_packed = jarray_deref(container)->m_packed;
+			cell->m_index = index;
+			return CELL_FOUND;
+		}
+
+		jvalue_ref value = jarray_get(container, index);
+		for (; i < path->m_count && jis_object(value); ++i) {
+			if (shared && jis_lazy(value))
+				return CELL_LAZY;
+			if (!jobject_get_exists(value, path->m_tokens[i], &value))
+				return CELL_NONE;
+		}
+
+		if (i == path->m_count) {
+			if (jis_null(value))
+				return CELL_NONE;
+			cell->m_value = value;
+			cell->m_packed = NULL;
+			return CELL_FOUND;
+		}
+
+		if (!jis_array(value))
+			return CELL_NONE;
+		// Even the size of a lazy array materializes it
+		if (shared && jis_lazy(value))
+			return CELL_LAZY;
+		index = jpointer_index(path->m_tokens[i++]);
+		if (index < 0 || index >= jarray_size(value))
+			return CELL_NONE;
+		container = value;
+	}
+}
+
+static bool cell_i64(const column_cell *cell, int64_t *result)
+{
+	if (cell->m_packed) {
+		if (cell->m_packed->m_type == PACKED_I64) {
+			*result = cell->m_packed->m_data.i64[cell->m_index];
+			return true;
+		}
+		double number = cell->m_packed->m_data.f64[cell->m_index];
+		if (!(number >= (double) INT64_MIN && number < (double) INT64_MAX))
+			return false;
+		*result = (int64_t) number;
+		return (double) *result == number;
+	}
+	return jis_number(cell->m_value) && jnumber_get_i64(cell->m_value, result) == CONV_OK;
+}
+
+static JColumnType cell_type(const column_cell *cell)
+{
+	// The integers of a packed array of numbers are integers as well
+	int64_t integer;
+	if (cell->m_packed)
+		return cell_i64(cell, &integer) ? JCOLUMN_I64 : JCOLUMN_F64;
+
+	switch (cell->m_value->m_type) {
+	case JV_NUM:
+		return jnumber_get_i64(cell->m_value, &integer) == CONV_OK ? JCOLUMN_I64 : JCOLUMN_F64;
+	case JV_BOOL:
+		return JCOLUMN_BOOL;
+	case JV_STR:
+		return JCOLUMN_STRING;
+	default:
+		return JCOLUMN_AUTO;
+	}
+}
+
+// The doubles closest to the numbers are fine
+static bool cell_f64(const column_cell *cell, double *result)
+{
+	if (cell->m_packed) {
+		*result = cell->m_packed->m_type == PACKED_I64
+		        ? (double) cell->m_packed->m_data.i64[cell->m_index]
+		        : cell->m_packed->m_data.f64[cell->m_index];
+		return true;
+	}
+	return jis_number(cell->m_value) &&
+	       (jnumber_get_f64(cell->m_value, result) & ~CONV_PRECISION_LOSS) == CONV_OK;
+}
+
+static inline void bitmap_set(uint8_t *bitmap, size_t row)
+{
+	bitmap[row / 8] |= 1 << (row % 8);
+}
+
+static inline bool bitmap_get(const uint8_t *bitmap, size_t row)
+{
+	return bitmap[row / 8] & (1 << (row % 8));
+}
+
+static bool part_append(column_part *part, raw_buffer str)
+{
+	if (str.m_len > INT32_MAX - part->m_size) {
+		PJ_LOG_ERR("PBNJSON_COLUMN_TOO_BIG", 0, "Strings of a column don't fit 32-bit offsets");
+		return false;
+	}
+	if (part->m_size + str.m_len > part->m_capacity) {
+		size_t capacity = part->m_capacity ? part->m_capacity : 256;
+		while (capacity < part->m_size + str.m_len)
+			capacity *= 2;
+		char *data = realloc(part->m_data, capacity);
+		CHECK_ALLOC_RETURN_VALUE(data, false);
+		part->m_data = data;
+		part->m_capacity = capacity;
+	}
+	memcpy(part->m_data + part->m_size, str.m_str, str.m_len);
+	part->m_size += str.m_len;
+	return true;
+}
+
+static bool column_put(columns_range *range, size_t col, size_t row, const column_cell *cell)
+{
+	const columns_job *job = range->m_job;
+	jcolumn *column = &job->m_columns[col];
+	column_part *part = &range->m_parts[col];
+
+	switch (part->m_type) {
+	case JCOLUMN_I64:
+		if (cell_i64(cell, &column->m_values.i64[row]))
+			break;
+		// A fraction turns the integers decided by the values into numbers
+		if (job->m_requested[col] != JCOLUMN_AUTO || (!cell->m_packed && !jis_number(cell->m_value)))
+			return false;
+		for (size_t i = range->m_begin; i < row; ++i)
+			column->m_values.f64[i] = (double) column->m_values.i64[i];
+		part->m_type = JCOLUMN_F64;
+		// fall through
+	case JCOLUMN_F64:
+		if (!cell_f64(cell, &column->m_values.f64[row]))
+			return false;
+		break;
+	case JCOLUMN_BOOL:
+		if (cell->m_packed || !jis_boolean(cell->m_value))
+			return false;
+		if (jboolean_deref_to_value(cell->m_value))
+			bitmap_set(column->m_values.bits, row);
+		break;
+	case JCOLUMN_STRING:
+		if (cell->m_packed || !jis_string(cell->m_value))
+			return false;
+		if (!part_append(part, jstring_get_fast(cell->m_value)))
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	bitmap_set(column->m_validity, row);
+	return true;
+}
+
+static void *columns_fill(void *arg)
+{
+	columns_range *range = arg;
+	const columns_job *job = range->m_job;
+
+	for (size_t row = range->m_begin; row < range->m_end; ++row) {
+		for (size_t col = 0; col < job->m_count; ++col) {
+			jcolumn *column = &job->m_columns[col];
+			column_part *part = &range->m_parts[col];
+
+			column_cell cell;
+			cell_result found = column_find(job->m_arr, row, &job->m_paths[col], job->m_shared, &cell);
+			if (found == CELL_LAZY) {
+				range->m_lazy = true;
+				return NULL;
+			}
+			if (found == CELL_NONE) {
+				++part->m_nulls;
+			} else if (!column_put(range, col, row, &cell)) {
+				PJ_LOG_ERR("PBNJSON_COLUMN_MISMATCH", 1, PMLOGKS("PATH", column->m_path),
+				           "Value of row %zu doesn't fit column %s", row, column->m_path);
+				range->m_failed = true;
+				return NULL;
+			}
+			if (part->m_type == JCOLUMN_STRING)
+				column->m_values.offsets[row + 1] = part->m_size;
+		}
+	}
+	return NULL;
+}
+
+void jcolumn_clear(jcolumn *column)
+{
+	free(column->m_validity);
+	free(column->m_values.i64);
+	free(column->m_data);
+	column->m_validity = NULL;
+	column->m_values.i64 = NULL;
+	column->m_data = NULL;
+	column->m_length = 0;
+	column->m_nullCount = 0;
+}
+
+static void columns_clear(columns_job *job)
+{
+	for (size_t col = 0; col < job->m_count; ++col) {
+		jcolumn_clear(&job->m_columns[col]);
+		job->m_columns[col].m_type = job->m_requested[col];
+	}
+}
+
+// The type of a column decided by the values is that of the first value
+static bool columns_decide(columns_job *job)
+{
+	for (size_t col = 0; col < job->m_count; ++col) {
+		jcolumn *column = &job->m_columns[col];
+		if (column->m_type != JCOLUMN_AUTO)
+			continue;
+
+		column_cell cell;
+		for (size_t row = 0; row < job->m_rows; ++row) {
+			if (column_find(job->m_arr, row, &job->m_paths[col], false, &cell) != CELL_FOUND)
+				continue;
+			column->m_type = cell_type(&cell);
+			if (column->m_type == JCOLUMN_AUTO) {
+				PJ_LOG_ERR("PBNJSON_COLUMN_MISMATCH", 1, PMLOGKS("PATH", column->m_path),
+				           "Value of row %zu doesn't fit column %s", row, column->m_path);
+				return false;
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+static bool columns_alloc(columns_job *job)
+{
+	size_t bitmap = (job->m_rows + 7) / 8 + 1;
+	for (size_t col = 0; col < job->m_count; ++col) {
+		jcolumn *column = &job->m_columns[col];
+		column->m_length = job->m_rows;
+		column->m_validity = calloc(bitmap, 1);
+		CHECK_ALLOC_RETURN_VALUE(column->m_validity, false);
+
+		switch (column->m_type) {
+		case JCOLUMN_I64:
+		case JCOLUMN_F64:
+			column->m_values.i64 = calloc(job->m_rows + 1, sizeof(int64_t));
+			break;
+		case JCOLUMN_BOOL:
+			column->m_values.bits = calloc(bitmap, 1);
+			break;
+		case JCOLUMN_STRING:
+			column->m_values.offsets = calloc(job->m_rows + 1, sizeof(int32_t));
+			break;
+		default:
+			// No values at all
+			continue;
+		}
+		CHECK_ALLOC_RETURN_VALUE(column->m_values.i64, false);
+	}
+	return true;
+}
+
+// Join the parts of the ranges: the integers widened in some of them, and the strings
+static bool columns_merge(columns_job *job, columns_range *ranges, size_t rangesCount)
+{
+	for (size_t col = 0; col < job->m_count; ++col) {
+		jcolumn *column = &job->m_columns[col];
+		size_t size = 0;
+		bool widened = false;
+		for (size_t i = 0; i < rangesCount; ++i) {
+			column_part *part = &ranges[i].m_parts[col];
+			column->m_nullCount += part->m_nulls;
+			size += part->m_size;
+			widened |= part->m_type != column->m_type;
+		}
+
+		if (widened) {
+			for (size_t i = 0; i < rangesCount; ++i) {
+				if (ranges[i].m_parts[col].m_type != JCOLUMN_I64)
+					continue;
+				for (size_t row = ranges[i].m_begin; row < ranges[i].m_end; ++row)
+					column->m_values.f64[row] = (double) column->m_values.i64[row];
+			}
+			column->m_type = JCOLUMN_F64;
+		}
+
+		if (column->m_type != JCOLUMN_STRING)
+			continue;
+		if (size > INT32_MAX) {
+			PJ_LOG_ERR("PBNJSON_COLUMN_TOO_BIG", 1, PMLOGKS("PATH", column->m_path), "Strings of a column don't fit 32-bit offsets");
+			return false;
+		}
+
+		// The only range keeps its strings where they are
+		if (rangesCount == 1 && ranges[0].m_parts[col].m_data) {
+			column->m_data = ranges[0].m_parts[col].m_data;
+			ranges[0].m_parts[col].m_data = NULL;
+			continue;
+		}
+
+		column->m_data = malloc(size + 1);
+		CHECK_ALLOC_RETURN_VALUE(column->m_data, false);
+		size_t base = 0;
+		for (size_t i = 0; i < rangesCount; ++i) {
+			column_part *part = &ranges[i].m_parts[col];
+			if (part->m_size)
+				memcpy(column->m_data + base, part->m_data, part->m_size);
+			if (base) {
+				for (size_t row = ranges[i].m_begin; row < ranges[i].m_end; ++row)
+					column->m_values.offsets[row + 1] += base;
+			}
+			base += part->m_size;
+		}
+	}
+	return true;
+}
+
+static bool columns_run(columns_job *job, size_t threads, bool *lazy)
+{
+	// Every thread gets whole bytes of the bitmaps
+	size_t chunk = (job->m_rows + threads - 1) / threads;
+	chunk = (chunk + COLUMNS_ROWS_ALIGN - 1) / COLUMNS_ROWS_ALIGN * COLUMNS_ROWS_ALIGN;
+	size_t rangesCount = chunk ? (job->m_rows + chunk - 1) / chunk : 1;
+	if (rangesCount <= 1) {
+		rangesCount = 1;
+		chunk = job->m_rows;
+	}
+	job->m_shared = rangesCount > 1;
+
+	columns_range *ranges = calloc(rangesCount, sizeof(columns_range));
+	column_part *parts = calloc(rangesCount * job->m_count + 1, sizeof(column_part));
+	if (!ranges || !parts) {
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Out of memory");
+		free(ranges);
+		free(parts);
+		return false;
+	}
+
+	for (size_t i = 0; i < rangesCount; ++i) {
+		ranges[i].m_job = job;
+		ranges[i].m_begin = i * chunk;
+		ranges[i].m_end = i + 1 < rangesCount ? (i + 1) * chunk : job->m_rows;
+		ranges[i].m_parts = parts + i * job->m_count;
+		for (size_t col = 0; col < job->m_count; ++col)
+			ranges[i].m_parts[col].m_type = job->m_columns[col].m_type;
+	}
+
+	// The calling thread takes the last range, and those the workers haven't started for
+	size_t started = 0;
+	for (; started + 1 < rangesCount; ++started) {
+		if (pthread_create(&ranges[started].m_thread, NULL, columns_fill, &ranges[started]) != 0)
+			break;
+	}
+	for (size_t i = started; i < rangesCount; ++i)
+		columns_fill(&ranges[i]);
+	for (size_t i = 0; i < started; ++i)
+		pthread_join(ranges[i].m_thread, NULL);
+
+	bool result = true;
+	*lazy = false;
+	for (size_t i = 0; i < rangesCount; ++i) {
+		result &= !ranges[i].m_failed;
+		*lazy |= ranges[i].m_lazy;
+	}
+	if (result && !*lazy)
+		result = columns_merge(job, ranges, rangesCount);
+
+	for (size_t i = 0; i < rangesCount * job->m_count; ++i)
+		free(parts[i].m_data);
+	free(parts);
+	free(ranges);
+	return result && !*lazy;
+}
+
+static bool columns_convert(jvalue_ref arr, jcolumn *columns, size_t count, int threads)
+{
+	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), false, "Attempt to convert %p that isn't an array into columns", arr);
+	CHECK_CONDITION_RETURN_VALUE(count && !columns, false, "No columns to fill");
+
+	columns_job job = {
+		.m_arr = arr,
+		.m_rows = jarray_size(arr),
+		.m_columns = columns,
+		.m_count = count,
+		.m_paths = calloc(count + 1, sizeof(jpointer_path)),
+		.m_requested = calloc(count + 1, sizeof(JColumnType)),
+	};
+	if (!job.m_paths || !job.m_requested) {
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Out of memory");
+		free(job.m_paths);
+		free(job.m_requested);
+		return false;
+	}
+
+	bool result = true;
+	for (size_t col = 0; col < count; ++col) {
+		job.m_requested[col] = columns[col].m_type;
+		columns[col].m_validity = NULL;
+		columns[col].m_values.i64 = NULL;
+		columns[col].m_data = NULL;
+		columns[col].m_nullCount = 0;
+		if (result)
+			result = jpointer_path_init(&job.m_paths[col], columns[col].m_path);
+	}
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
+
+	result = result && columns_decide(&job) && columns_alloc(&job);
+	if (result) {
+		bool lazy = false;
+		result = columns_run(&job, threads, &lazy);
+		// The lazy containers are accessed by the calling thread alone
+		if (lazy) {
+			columns_clear(&job);
+			result = columns_decide(&job) && columns_alloc(&job) && columns_run(&job, 1, &lazy);
+		}
+	}
+	if (!result)
+		columns_clear(&job);
+
+	for (size_t col = 0; col < count; ++col)
+		jpointer_path_clear(&job.m_paths[col]);
+	free(job.m_paths);
+	free(job.m_requested);
+	return result;
+}
+
+bool jarray_to_columns(jvalue_ref arr, jcolumn *columns, size_t count)
+{
+	return columns_convert(arr, columns, count, 1);
+}
+
+bool jarray_to_columns_parallel(jvalue_ref arr, jcolumn *columns, size_t count, int threads)
+{
+	return columns_convert(arr, columns, count, threads);
+}
+
+void jcolumns_apply_schema(jschema_ref schema, jcolumn *columns, size_t count)
+{
+	Validator *items = validator_member(schema->validator, NULL);
+	for (size_t col = 0; col < count; ++col) {
+		if (columns[col].m_type != JCOLUMN_AUTO)
+			continue;
+
+		jpointer_path path;
+		if (!jpointer_path_init(&path, columns[col].m_path))
+			continue;
+		Validator *v = items;
+		for (size_t i = 0; i < path.m_count && v; ++i)
+			v = validator_member(v, path.m_tokens[i].m_str);
+		jpointer_path_clear(&path);
+
+		switch (v ? validator_instance_type(v) : V_ANY) {
+		case V_INT:
+			columns[col].m_type = JCOLUMN_I64;
+			break;
+		case V_NUM:
+			columns[col].m_type = JCOLUMN_F64;
+			break;
+		case V_BOOL:
+			columns[col].m_type = JCOLUMN_BOOL;
+			break;
+		case V_STR:
+			columns[col].m_type = JCOLUMN_STRING;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// The value of the row, NULL if there is none
+static jvalue_ref column_value(const jcolumn *column, size_t row)
+{
+	if (column->m_validity && !bitmap_get(column->m_validity, row))
+		return NULL;
+
+	switch (column->m_type) {
+	case JCOLUMN_I64:
+		return jnumber_create_i64(column->m_values.i64[row]);
+	case JCOLUMN_F64:
+		return jnumber_create_f64(column->m_values.f64[row]);
+	case JCOLUMN_BOOL:
+		return jboolean_create(bitmap_get(column->m_values.bits, row));
+	case JCOLUMN_STRING: {
+		int32_t begin = column->m_values.offsets[row];
+		return jstring_create_copy(j_str_to_buffer(column->m_data + begin, column->m_values.offsets[row + 1] - begin));
+	}
+	default:
+		return NULL;
+	}
+}
+
+// Put the value along the path, creating the objects on the way
+static bool record_put(jvalue_ref record, jshape *shape, jvalue_ref *keys, size_t depth, jvalue_ref value)
+{
+	for (size_t i = 0; i + 1 < depth; ++i) {
+		jvalue_ref child;
+		if (!jobject_get_exists(record, jstring_get_fast(keys[i]), &child)) {
+			child = jobject_create_shaped(shape, 1);
+			if (!child || !jobject_put(record, jvalue_copy(keys[i]), child)) {
+				j_release(&value);
+				return false;
+			}
+		}
+		// A value of another column is in the way
+		if (!jis_object(child)) {
+			j_release(&value);
+			return false;
+		}
+		record = child;
+	}
+	return jobject_put(record, jvalue_copy(keys[depth - 1]), value);
+}
+
+static jvalue_ref columns_build(const jcolumn *columns, size_t count, jvalue_ref **keys, const jpointer_path *paths)
+{
+	size_t rows = count ? columns[0].m_length : 0;
+	jvalue_ref arr = jarray_create_hint(NULL, rows);
+	jshape *shape = jshape_create();
+	if (!jis_valid(arr) || !shape) {
+		j_release(&arr);
+		jshape_release(shape);
+		return jinvalid();
+	}
+
+	bool valid = true;
+	for (size_t row = 0; valid && row < rows; ++row) {
+		jvalue_ref record = NULL;
+		for (size_t col = 0; valid && col < count; ++col) {
+			jvalue_ref value = column_value(&columns[col], row);
+			if (!paths[col].m_count) {
+				record = value ? value : jnull();
+				break;
+			}
+			if (!value)
+				continue;
+			if (!record)
+				record = jobject_create_shaped(shape, count);
+			if (!record) {
+				j_release(&value);
+				valid = false;
+			} else if (!record_put(record, shape, keys[col], paths[col].m_count, value)) {
+				PJ_LOG_ERR("PBNJSON_COLUMN_MISMATCH", 1, PMLOGKS("PATH", columns[col].m_path),
+				           "Value of row %zu doesn't fit the record at %s", row, columns[col].m_path);
+				valid = false;
+			}
+		}
+		if (valid && !record)
+			record = jobject_create_shaped(shape, 0);
+		if (!valid || !record || !jarray_append(arr, record)) {
+			j_release(&record);
+			valid = false;
+		}
+	}
+
+	if (!valid)
+		j_release(&arr);
+	jshape_release(shape);
+	return valid ? arr : jinvalid();
+}
+
+jvalue_ref jarray_from_columns(const jcolumn *columns, size_t count)
+{
+	CHECK_CONDITION_RETURN_VALUE(count && !columns, jinvalid(), "No columns to build from");
+
+	jpointer_path *paths = calloc(count + 1, sizeof(jpointer_path));
+	jvalue_ref **keys = calloc(count + 1, sizeof(jvalue_ref *));
+	bool valid = paths && keys;
+	if (!valid)
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Out of memory");
+
+	for (size_t col = 0; valid && col < count; ++col) {
+		valid = jpointer_path_init(&paths[col], columns[col].m_path);
+		if (!valid)
+			break;
+		if (columns[col].m_length != columns[0].m_length || (!paths[col].m_count && count > 1)) {
+			PJ_LOG_ERR("PBNJSON_COLUMN_MISMATCH", 1, PMLOGKS("PATH", columns[col].m_path),
+			           "Column %s doesn't fit the others", columns[col].m_path);
+			valid = false;
+			break;
+		}
+
+		// The keys are shared by the records
+		keys[col] = calloc(paths[col].m_count + 1, sizeof(jvalue_ref));
+		valid = keys[col] != NULL;
+		for (size_t i = 0; valid && i < paths[col].m_count; ++i) {
+			keys[col][i] = jstring_create_copy(paths[col].m_tokens[i]);
+			valid = jis_valid(keys[col][i]);
+		}
+	}
+
+	jvalue_ref arr = valid ? columns_build(columns, count, keys, paths) : jinvalid();
+
+	for (size_t col = 0; paths && keys && col < count; ++col) {
+		for (size_t i = 0; keys[col] && i < paths[col].m_count; ++i)
+			j_release(&keys[col][i]);
+		free(keys[col]);
+		jpointer_path_clear(&paths[col]);
+	}
+	free(keys);
+	free(paths);
+	return arr;
+}
@@ -0,0 +1,307 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jindex.h>
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jobject_internal.h"
+#include "jpointer.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Entry of the hash table. The keys aren't kept, they are taken from the elements again
+ * when the hashes match.
+ */
+typedef struct {
+	uint32_t m_hash;
+	uint32_t m_slot;  // position + 1 of the element, 0 for an empty entry
+} index_entry;
+
+typedef struct jarray_index jarray_index;
+
+struct jarray_index {
+	jvalue_ref m_array;
+	jpointer_path m_path;
+	uint32_t m_version;     // of the array when it was indexed
+	bool m_stale;           // the array should be indexed anew
+	ssize_t m_indexed;      // the elements before it are in the table
+	size_t m_count;
+	size_t m_mask;
+	index_entry *m_entries;
+};
+
+static inline uint32_t hash_mix(uint64_t bits)
+{
+	bits *= UINT64_C(0x9E3779B97F4A7C15);
+	return (uint32_t) (bits >> 32) ^ (uint32_t) bits;
+}
+
+// The numbers equal by jnumber_compare have the same hash
+static bool key_hash(jvalue_ref key, uint32_t *hash)
+{
+	switch (key->m_type) {
+	case JV_STR: {
+		// djb2, the same as for the members of the objects
+		raw_buffer str = jstring_get_fast(key);
+		uint32_t h = 5381;
+		for (size_t i = 0; i < str.m_len; ++i)
+			h = h * 33 + str.m_str[i];
+		*hash = h;
+		return true;
+	}
+	case JV_NUM: {
+		int64_t integer;
+		double number;
+		if (jnumber_get_i64(key, &integer) == CONV_OK) {
+			*hash = hash_mix(integer);
+			return true;
+		}
+		if ((jnumber_get_f64(key, &number) & ~CONV_PRECISION_LOSS) != CONV_OK)
+			return false;
+		if (number >= (double) INT64_MIN && number < (double) INT64_MAX && number == (double) (int64_t) number) {
+			*hash = hash_mix((int64_t) number);
+		} else {
+			uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+			*hash = hash_mix(bits);
+		}
+		return true;
+	}
+	case JV_BOOL:
+		*hash = jboolean_deref_to_value(key) ? 1 : 0;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool keys_equal(jvalue_ref key, jvalue_ref other)
+{
+	if (key->m_type != other->m_type)
+		return false;
+
+	switch (key->m_type) {
+	case JV_STR:
+		return jstring_equal(key, other);
+	case JV_NUM:
+		return jnumber_compare(key, other) == 0;
+	case JV_BOOL:
+		return jboolean_deref_to_value(key) == jboolean_deref_to_value(other);
+	default:
+		return false;
+	}
+}
+
+static jvalue_ref element_key(const jarray_index *index, ssize_t position)
+{
+	jvalue_ref element = jarray_get(index->m_array, position);
+	return element ? jpointer_get(element, &index->m_path) : NULL;
+}
+
+static void index_place(jarray_index *index, index_entry entry)
+{
+	size_t i = entry.m_hash & index->m_mask;
+	while (index->m_entries[i].m_slot)
+		i = (i + 1) & index->m_mask;
+	index->m_entries[i] = entry;
+	++index->m_count;
+}
+
+static bool index_reserve(jarray_index *index, size_t count)
+{
+	// Half of the entries stay empty at least
+	size_t size = index->m_mask + 1;
+	if (index->m_entries && count * 2 <= size)
+		return true;
+	while (size < count * 2)
+		size *= 2;
+
+	index_entry *entries = calloc(size, sizeof(index_entry));
+	CHECK_ALLOC_RETURN_VALUE(entries, false);
+
+	index_entry *old = index->m_entries;
+	size_t oldSize = index->m_entries ? index->m_mask + 1 : 0;
+	index->m_entries = entries;
+	index->m_mask = size - 1;
+	index->m_count = 0;
+	for (size_t i = 0; i < oldSize; ++i) {
+		if (old[i].m_slot)
+			index_place(index, old[i]);
+	}
+	free(old);
+	return true;
+}
+
+static bool index_add(jarray_index *index, ssize_t position)
+{
+	jvalue_ref key = element_key(index, position);
+	uint32_t hash;
+	if (!key || !key_hash(key, &hash))
+		return true;
+
+	// The first element with the key is found
+	for (size_t i = hash & index->m_mask; index->m_entries[i].m_slot; i = (i + 1) & index->m_mask) {
+		if (index->m_entries[i].m_hash != hash)
+			continue;
+		jvalue_ref other = element_key(index, index->m_entries[i].m_slot - 1);
+		if (other && keys_equal(key, other))
+			return true;
+	}
+
+	if (!index_reserve(index, index->m_count + 1))
+		return false;
+	index_place(index, (index_entry) { hash, position + 1 });
+	return true;
+}
+
+static bool index_update(jarray_index *index)
+{
+	jarray *arr = jarray_deref(index->m_array);
+	ssize_t size = jarray_size(index->m_array);
+
+	if (index->m_stale || index->m_version != arr->m_version) {
+		free(index->m_entries);
+		index->m_entries = NULL;
+		index->m_mask = 0;
+		index->m_count = 0;
+		index->m_indexed = 0;
+		index->m_version = arr->m_version;
+		index->m_stale = false;
+	}
+
+	if (index->m_entries && index->m_indexed == size)
+		return true;
+
+	if (size >= UINT32_MAX) {
+		PJ_LOG_ERR("PBNJSON_INDEX_TOO_BIG", 0, "Array of %zd elements is too big to index", size);
+		index->m_stale = true;
+		return false;
+	}
+
+	if (!index_reserve(index, index->m_count + (size - index->m_indexed))) {
+		index->m_stale = true;
+		return false;
+	}
+	for (; index->m_indexed < size; ++index->m_indexed) {
+		if (!index_add(index, index->m_indexed)) {
+			index->m_stale = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+jarray_index_ref jarray_build_index(jvalue_ref arr, const char *keyPath)
+{
+	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), NULL, "Attempt to index %p that isn't an array", arr);
+
+	jarray_index *index = calloc(1, sizeof(jarray_index));
+	CHECK_ALLOC_RETURN_NULL(index);
+
+	if (!jpointer_path_init(&index->m_path, keyPath)) {
+		free(index);
+		return NULL;
+	}
+
+	index->m_array = jvalue_copy(arr);
+	index->m_stale = true;
+	if (!index_update(index)) {
+		jarray_index_release(&index);
+		return NULL;
+	}
+	return index;
+}
+
+void jarray_index_release(jarray_index_ref *index)
+{
+	CHECK_POINTER(index);
+	if (!*index)
+		return;
+
+	j_release(&(*index)->m_array);
+	jpointer_path_clear(&(*index)->m_path);
+	free((*index)->m_entries);
+	free(*index);
+	*index = NULL;
+}
+
+static ssize_t index_lookup(const jarray_index *index, jvalue_ref key, uint32_t hash)
+{
+	for (size_t i = hash & index->m_mask; index->m_entries[i].m_slot; i = (i + 1) & index->m_mask) {
+		if (index->m_entries[i].m_hash != hash)
+			continue;
+		ssize_t position = index->m_entries[i].m_slot - 1;
+		jvalue_ref other = element_key(index, position);
+		if (other && keys_equal(key, other))
+			return position;
+	}
+	return -1;
+}
+
+// The elements modified in place don't change the version of the array, their keys
+// may be anywhere but where the table has them
+static ssize_t index_scan(const jarray_index *index, jvalue_ref key)
+{
+	ssize_t size = jarray_size(index->m_array);
+	for (ssize_t position = 0; position < size; ++position) {
+		jvalue_ref other = element_key(index, position);
+		if (other && keys_equal(key, other))
+			return position;
+	}
+	return -1;
+}
+
+ssize_t jarray_index_find(jarray_index_ref index, jvalue_ref key)
+{
+	uint32_t hash;
+	if (!key_hash(key, &hash))
+		return -1;
+
+	if (index_update(index)) {
+		ssize_t position = index_lookup(index, key, hash);
+		if (position >= 0 || index->m_array->m_frozen)
+			return position;
+	}
+
+	ssize_t position = index_scan(index, key);
+	if (position >= 0) {
+		PJ_LOG_TRACE("Key of the element %zd was modified in place, indexing %p anew", position, index->m_array);
+		jarray_index_rebuild(index);
+	}
+	return position;
+}
+
+jvalue_ref jarray_index_get(jarray_index_ref index, jvalue_ref key)
+{
+	ssize_t position = jarray_index_find(index, key);
+	return position < 0 ? jinvalid() : jarray_get(index->m_array, position);
+}
+
+bool jarray_index_rebuild(jarray_index_ref index)
+{
+	index->m_stale = true;
+	return index_update(index);
+}
+
+jvalue_ref jarray_index_array(jarray_index_ref index)
+{
+	return index->m_array;
+}
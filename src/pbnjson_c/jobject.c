@@ -17,6 +17,7 @@
 // LICENSE@@@
 
 #include <stddef.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
@@ -35,6 +36,8 @@
 #include "jobject_internal.h"
 #include "liblog.h"
 #include "jvalue/num_conversion.h"
+#include "jvalue/stack.h"
+#include "jvalue/reclaim.h"
 
 #ifdef DBG_C_MEM
 #define PJ_LOG_MEM(...) PJ_LOG_INFO(__VA_ARGS__)
@@ -66,17 +69,32 @@ static int s_inGdb = 0;
 // even if it is malformed Unicode
 #define SAFE_TERM_NULL_LEN 7
 
+static jvalue_extra JNULL_EXTRA = {
+	.m_toString = "null",
+	.m_toStringDealloc = NULL
+};
+
 jvalue JNULL = {
 	.m_type = JV_NULL,
 	.m_refCnt = 1,
-	.m_toString = "null",
+	.m_extended = true,
+	.m_extra = &JNULL_EXTRA
+};
+
+static jvalue_extra JINVALID_EXTRA = {
+	.m_toString = "null /* invalid */",
 	.m_toStringDealloc = NULL
 };
 
 jvalue JINVALID = {
 	.m_type = JV_NULL,
 	.m_refCnt = 1,
-	.m_toString = "null /* invalid */",
+	.m_extended = true,
+	.m_extra = &JINVALID_EXTRA
+};
+
+static jvalue_extra JEMPTY_STR_EXTRA = {
+	.m_toString = "",
 	.m_toStringDealloc = NULL
 };
 
@@ -84,8 +102,8 @@ static jstring JEMPTY_STR = {
 	.m_value = {
 		.m_type = JV_STR,
 		.m_refCnt = 1,
-		.m_toString = "",
-		.m_toStringDealloc = NULL
+		.m_extended = true,
+		.m_extra = &JEMPTY_STR_EXTRA
 	},
 	.m_dealloc = NULL,
 	.m_data = {
@@ -94,16 +112,113 @@ static jstring JEMPTY_STR = {
 	}
 };
 
-static jvalue_ref jnumber_duplicate (jvalue_ref num) NON_NULL(1);
+/**
+ * The booleans and the small integers are shared like jnull(): creating them allocates nothing,
+ * copying and releasing them doesn't touch the reference counters. They are never modified, so
+ * that an array of such values is nothing but the pointers to them.
+ */
+#define JSMALL_INT_MIN (-128)
+#define JSMALL_INT_MAX 1023
+#define JSMALL_INT_COUNT (JSMALL_INT_MAX - JSMALL_INT_MIN + 1)
+#define JSMALL_INT_TEXT 6 // "-128" and "1023" with the terminating null
+
+/*
+ * JSMALL_INTS(f) is f(sign, digits) for each of the small integers, so that they're initialized
+ * statically like the booleans, with the canonical text written by the preprocessor
+ */
+#define JSMALL_1_9(f, s, p) f(s, p##1) f(s, p##2) f(s, p##3) f(s, p##4) f(s, p##5) \
+                            f(s, p##6) f(s, p##7) f(s, p##8) f(s, p##9)
+#define JSMALL_0_9(f, s, p) f(s, p##0) JSMALL_1_9(f, s, p)
+#define JSMALL_10_99(f, s) JSMALL_0_9(f, s, 1) JSMALL_0_9(f, s, 2) JSMALL_0_9(f, s, 3) \
+                           JSMALL_0_9(f, s, 4) JSMALL_0_9(f, s, 5) JSMALL_0_9(f, s, 6) \
+                           JSMALL_0_9(f, s, 7) JSMALL_0_9(f, s, 8) JSMALL_0_9(f, s, 9)
+#define JSMALL_00_99(f, s, p) JSMALL_0_9(f, s, p##0) JSMALL_0_9(f, s, p##1) JSMALL_0_9(f, s, p##2) \
+                              JSMALL_0_9(f, s, p##3) JSMALL_0_9(f, s, p##4) JSMALL_0_9(f, s, p##5) \
+                              JSMALL_0_9(f, s, p##6) JSMALL_0_9(f, s, p##7) JSMALL_0_9(f, s, p##8) \
+                              JSMALL_0_9(f, s, p##9)
+#define JSMALL_100_999(f, s) JSMALL_00_99(f, s, 1) JSMALL_00_99(f, s, 2) JSMALL_00_99(f, s, 3) \
+                             JSMALL_00_99(f, s, 4) JSMALL_00_99(f, s, 5) JSMALL_00_99(f, s, 6) \
+                             JSMALL_00_99(f, s, 7) JSMALL_00_99(f, s, 8) JSMALL_00_99(f, s, 9)
+#define JSMALL_INTS(f) \
+	JSMALL_1_9(f, -, ) JSMALL_10_99(f, -) JSMALL_0_9(f, -, 10) JSMALL_0_9(f, -, 11) \
+	f(-, 120) f(-, 121) f(-, 122) f(-, 123) f(-, 124) f(-, 125) f(-, 126) f(-, 127) f(-, 128) \
+	JSMALL_0_9(f, , ) JSMALL_10_99(f, ) JSMALL_100_999(f, ) JSMALL_0_9(f, , 100) JSMALL_0_9(f, , 101) \
+	f(, 1020) f(, 1021) f(, 1022) f(, 1023)
+
+#define JSMALL_INT_NATIVE(s, n) [s n - JSMALL_INT_MIN] = { \
+	.m_value = { .m_type = JV_NUM, .m_refCnt = 1 }, .m_type = NUM_INT, .value.integer = s n },
+#define JSMALL_INT_RAW(s, n) [s n - JSMALL_INT_MIN] = { \
+	.m_value = { .m_type = JV_NUM, .m_refCnt = 1 }, .m_type = NUM_RAW, \
+	.value.raw = { .m_str = #s #n, .m_len = sizeof(#s #n) - 1 } },
+
+static struct {
+	jbool m_false;
+	jbool m_true;
+	jnum m_ints[JSMALL_INT_COUNT]; // native ones, see jnumber_create_i64
+	jnum m_raws[JSMALL_INT_COUNT]; // with the canonical text, see jnumber_create_unsafe
+} s_scalars = {
+	.m_false = { .m_value = { .m_type = JV_BOOL, .m_refCnt = 1 }, .value = false },
+	.m_true = { .m_value = { .m_type = JV_BOOL, .m_refCnt = 1 }, .value = true },
+	.m_ints = { JSMALL_INTS(JSMALL_INT_NATIVE) },
+	.m_raws = { JSMALL_INTS(JSMALL_INT_RAW) },
+};
+
+static inline bool jis_shared_scalar(jvalue_ref val)
+{
+	return (uintptr_t) val - (uintptr_t) &s_scalars < sizeof(s_scalars);
+}
+
+// Only the numbers written the way the shared ones are written can be shared: no leading zeros,
+// no plus sign, fraction or exponent, and no negative zero
+static bool jsmall_int_parse(raw_buffer str, int *number)
+{
+	const char *c = str.m_str;
+	const char *end = c + str.m_len;
+	bool negative = c < end && *c == '-';
+	if (negative)
+		++c;
+	if (c == end || end - c >= JSMALL_INT_TEXT - 1 || (*c == '0' && end - c > 1))
+		return false;
+
+	int result = 0;
+	for (; c < end; ++c) {
+		if (*c < '0' || *c > '9')
+			return false;
+		result = result * 10 + (*c - '0');
+	}
+	if (negative) {
+		if (!result)
+			return false;
+		result = -result;
+	}
+	if (result < JSMALL_INT_MIN || result > JSMALL_INT_MAX)
+		return false;
+
+	*number = result;
+	return true;
+}
+
+const char *jscalar_text(jvalue_ref val)
+{
+	if (!jis_shared_scalar(val))
+		return NULL;
+	if (val->m_type == JV_BOOL)
+		return jboolean_deref(val)->value ? "true" : "false";
+	jnum *num = jnum_deref(val);
+	return num->m_type == NUM_RAW ? num->value.raw.m_str : s_scalars.m_raws[num->value.integer - JSMALL_INT_MIN].value.raw.m_str;
+}
+
 static bool jstring_equal_internal(jvalue_ref str, jvalue_ref other) NON_NULL(1, 2);
 static inline bool jstring_equal_internal2(jvalue_ref str, raw_buffer *other) NON_NULL(1, 2);
 static bool jstring_equal_internal3(raw_buffer *str, raw_buffer *other) NON_NULL(1, 2);
 
-static bool jis_const(jvalue_ref val)
+bool jis_const(jvalue_ref val)
 {
 	return val == &JNULL
+	    || jis_shared_scalar(val)
 	    || UNLIKELY(val == &JEMPTY_STR.m_value)
 	    || UNLIKELY(val == &JINVALID)
+	    || UNLIKELY(jis_interned_key(val))
 	;
 }
 
@@ -124,6 +239,42 @@ static void jvalue_init (jvalue_ref val, JValueType type)
 	val->m_type = type;
 }
 
+jvalue_extra *jvalue_extend (jvalue_ref val)
+{
+	if (val->m_extended)
+		return val->m_extra;
+
+	jvalue_extra *extra = calloc(1, sizeof(jvalue_extra));
+	CHECK_ALLOC_RETURN_NULL(extra);
+	if (val->m_inBlock)
+		extra->m_block = val->m_block;
+	val->m_extra = extra;
+	val->m_extended = true;
+	return extra;
+}
+
+void jvalue_forget_string (jvalue_ref val)
+{
+	jvalue_extra *extra = jvalue_extra_get(val);
+	if (!extra)
+		return;
+
+	if (extra->m_toStringDealloc) {
+		PJ_LOG_MEM("Freeing string representation of jvalue %p", extra->m_toString);
+		extra->m_toStringDealloc(extra->m_toString);
+	}
+	extra->m_toString = NULL;
+	extra->m_toStringDealloc = NULL;
+
+	// Nothing else in there, the value goes back to its header
+	if (!extra->m_backingBuffer.m_str && !jis_const(val)) {
+		val->m_extended = false;
+		if (val->m_inBlock)
+			val->m_block = extra->m_block;
+		free(extra);
+	}
+}
+
 jvalue_ref jvalue_copy (jvalue_ref val)
 {
 	SANITY_CHECK_POINTER(val);
@@ -132,56 +283,212 @@ jvalue_ref jvalue_copy (jvalue_ref val)
 
 	if (jis_const(val)) return val;
 
-	val->m_refCnt++;
+	jrefcnt_add(&val->m_refCnt, 1);
 	TRACE_REF("inc refcnt to %d", val, val->m_refCnt);
 	return val;
 }
 
-jvalue_ref jvalue_duplicate (jvalue_ref val)
+// The containers which members are walked into, the other values are handled as a whole
+static inline bool jvalue_walks (jvalue_ref val)
+{
+	return (val->m_type == JV_OBJECT || val->m_type == JV_ARRAY) && !jis_const(val) &&
+	       !jis_lazy(val) && !val->m_frozen && !jis_packed(val);
+}
+
+static bool jvalue_walk_push (jstack *stack, jvalue_ref container)
+{
+	jchild_iter *it = jstack_push(stack);
+	if (!it)
+		return false;
+	jchild_iter_init(it, container);
+	return true;
+}
+
+void jvalue_freeze (jvalue_ref val)
 {
-	jvalue_ref result = val;
 	SANITY_CHECK_POINTER(val);
+	CHECK_POINTER(val);
 
-	if (jis_const(val)) return result;
+	// The members of a frozen container are frozen already
+	if (jis_const(val) || val->m_frozen) return;
 
-	if (jis_object (val)) {
-		result = jobject_create_hint (jobject_size (val));
-		jobject_iter it;
-		jobject_key_value pair;
+	if (!jis_object(val) && (!jis_array(val) || jis_packed(val))) {
+		val->m_frozen = true;
+		return;
+	}
 
-		jobject_iter_init(&it, val);
-		while (jobject_iter_next(&it, &pair))
-		{
-			jvalue_ref valueCopy = jvalue_duplicate (pair.value);
-			if (!jobject_put (result, jvalue_copy (pair.key), valueCopy)) {
-				j_release (&result);
-				result = NULL;
-				break;
-			}
+	// The containers are frozen after their members, a walk cut short leaves them modifiable
+	jstack stack;
+	jstack_init(&stack, sizeof(jchild_iter), JVALUE_MAX_DEPTH);
+	bool walking = jvalue_walk_push(&stack, val);
+	while (walking && !jstack_empty(&stack)) {
+		jchild_iter *it = jstack_top(&stack);
+		jobject_key_value child;
+		if (!jchild_iter_next(it, &child)) {
+			it->m_container->m_frozen = true;
+			jstack_pop(&stack);
+		} else if (jis_const(child.value) || child.value->m_frozen) {
+			continue;
+		} else if (jis_object(child.value) || (jis_array(child.value) && !jis_packed(child.value))) {
+			walking = jvalue_walk_push(&stack, child.value);
+		} else {
+			child.value->m_frozen = true;
+		}
+	}
+	jstack_destroy(&stack);
+}
+
+bool jis_frozen (jvalue_ref val)
+{
+	SANITY_CHECK_POINTER(val);
+	CHECK_POINTER_RETURN_VALUE(val, false);
+
+	return val->m_frozen;
+}
+
+// The frozen values are shared, they aren't modified (see jvalue_freeze)
+static inline bool jcheck_mutable (jvalue_ref val)
+{
+	if (LIKELY(!val->m_frozen))
+		return true;
+
+	PJ_LOG_ERR("PBNJSON_FROZEN_MODIFY", 0, "Attempt to modify the frozen value %p", val);
+	return false;
+}
+
+static jvalue_ref jobject_create_same_shape (jvalue_ref obj) NON_NULL(1);
+
+// The copy of the value, or an empty container for the members copied by the walk
+static jvalue_ref jvalue_duplicate_node (jvalue_ref val)
+{
+	if (jis_const(val)) return val;
+
+	// Nothing to copy yet, the content of the document or of the frozen source is immutable
+	if (jis_lazy(val)) return jlazy_duplicate(val);
+
+	// string, number, & boolean are immutable, so no need to do an actual duplication
+	if (!jis_object(val) && !jis_array(val)) return jvalue_copy(val);
+
+	// The members are copied on access, only along the paths the copy is used through
+	if (val->m_frozen) return jview_create(val);
+
+	if (jis_shaped(val)) return jobject_create_same_shape(val);
+	if (jis_object(val)) return jobject_create_hint(jobject_size(val));
+	if (jis_packed(val)) return jpacked_duplicate(val);
+
+	ssize_t size = jarray_size(val);
+	return size ? jarray_create_hint(NULL, size) : jarray_create(NULL);
+}
+
+// The private copy of the value, or an empty container for the members copied by the walk.
+// Only the constants are shared, neither the values nor the shapes are.
+static jvalue_ref jvalue_duplicate_private_node (jvalue_ref val)
+{
+	if (jis_const(val)) return val;
+
+	// The copy of a frozen container is read through its source, it's the same content
+	val = jview_origin(val);
+	jlazy_ensure(val);
+
+	switch (val->m_type) {
+	case JV_STR:
+		return jstring_create_copy(jstring_deref(val)->m_data);
+	case JV_BOOL:
+		return jboolean_create(jboolean_deref(val)->value);
+	case JV_NUM:
+		switch (jnum_deref(val)->m_type) {
+		case NUM_RAW: return jnumber_create(jnum_deref(val)->value.raw);
+		case NUM_FLOAT: return jnumber_create_f64(jnum_deref(val)->value.floating);
+		default: return jnumber_create_i64(jnum_deref(val)->value.integer);
 		}
-	} else if (jis_array (val)) {
-		ssize_t arrSize = jarray_size (val);
-		result = jarray_create_hint (NULL, arrSize);
-		for (ssize_t i = arrSize - 1; i >= 0; i--) {
-			if (!jarray_append (result, jvalue_duplicate (jarray_get (val, i)))) {
-				j_release (&result);
-				result = NULL;
+	case JV_OBJECT:
+		return jobject_create_hint(jobject_size(val));
+	case JV_ARRAY:
+		if (jis_packed(val)) return jpacked_duplicate(val);
+		return jarray_size(val) ? jarray_create_hint(NULL, jarray_size(val)) : jarray_create(NULL);
+	default:
+		return NULL;
+	}
+}
+
+// The members of a private copy are copied from the frozen containers too
+static inline bool jvalue_private_walks (jvalue_ref val)
+{
+	if (jis_const(val))
+		return false;
+	val = jview_origin(val);
+	return (val->m_type == JV_OBJECT || val->m_type == JV_ARRAY) && !jis_packed(val);
+}
+
+typedef struct {
+	jchild_iter m_children;
+	jvalue_ref m_copy;
+} duplicate_frame;
+
+// The containers being filled aren't checked for cycles, the copies are new
+static void jvalue_duplicate_attach (duplicate_frame *frame, jobject_key_value child, jvalue_ref copy, bool priv)
+{
+	ssize_t index = frame->m_children.m_index;
+	jvalue_ref container = frame->m_copy;
+
+	if (jis_array(container)) {
+		*jarray_slot(jarray_deref(container), index) = copy;
+		jarray_deref(container)->m_size = index + 1;
+	} else if (jobject_deref(container)->m_shape) {
+		jobject_deref(container)->m_slots[index] = copy;
+	} else {
+		jvalue_ref key = priv && !jis_const(child.key) ? jstring_create_copy(jstring_deref(child.key)->m_data)
+		                                               : jvalue_copy(child.key);
+		g_hash_table_insert(jobject_deref(container)->m_members, key, copy);
+	}
+}
+
+static jvalue_ref jvalue_duplicate_walk (jvalue_ref val, bool priv)
+{
+	jvalue_ref result = priv ? jvalue_duplicate_private_node(val) : jvalue_duplicate_node(val);
+	if (!result || !(priv ? jvalue_private_walks(val) : jvalue_walks(val)))
+		return result;
+
+	// The copies of the containers are filled top down, each one right after its parent
+	jstack stack;
+	jstack_init(&stack, sizeof(duplicate_frame), JVALUE_MAX_DEPTH);
+	duplicate_frame *frame = jstack_push(&stack);
+	bool failed = !frame;
+	if (frame) {
+		jchild_iter_init(&frame->m_children, priv ? jview_origin(val) : val);
+		frame->m_copy = result;
+	}
+
+	while (!failed && !jstack_empty(&stack)) {
+		frame = jstack_top(&stack);
+		jobject_key_value child;
+		if (!jchild_iter_next(&frame->m_children, &child)) {
+			jstack_pop(&stack);
+			continue;
+		}
+
+		jvalue_ref copy = priv ? jvalue_duplicate_private_node(child.value) : jvalue_duplicate_node(child.value);
+		if (!copy) {
+			failed = true;
+			break;
+		}
+		jvalue_duplicate_attach(frame, child, copy, priv);
+
+		if (priv ? jvalue_private_walks(child.value) : jvalue_walks(child.value)) {
+			frame = jstack_push(&stack);
+			if (!frame) {
+				failed = true;
 				break;
 			}
+			jchild_iter_init(&frame->m_children, priv ? jview_origin(child.value) : child.value);
+			frame->m_copy = copy;
 		}
-		return result;
-	} else {
-		// string, number, & boolean are immutable, so no need to do an actual duplication
-#if 0
-		return jvalue_copy(val);
-#else
-		if (jis_string(val)) {
-			result = jstring_create_copy(jstring_get_fast(val));
-		} else if (jis_number(val)) {
-			result = jnumber_duplicate(val);
-		} else
-			result = jboolean_create(jboolean_deref_to_value(val));
-#endif
+	}
+	jstack_destroy(&stack);
+
+	if (failed) {
+		j_release(&result);
+		return NULL;
 	}
 
 	TRACE_REF("w/ refcnt of %d, deep copy to %p w/ refcnt of %d",
@@ -190,15 +497,33 @@ jvalue_ref jvalue_duplicate (jvalue_ref val)
 	return result;
 }
 
-static bool jarray_equal(jvalue_ref arr, jvalue_ref other) NON_NULL(1, 2);
-static bool jobject_equal(jvalue_ref obj, jvalue_ref other) NON_NULL(1, 2);
+jvalue_ref jvalue_duplicate (jvalue_ref val)
+{
+	SANITY_CHECK_POINTER(val);
+
+	return jvalue_duplicate_walk(val, false);
+}
 
-bool jvalue_equal(jvalue_ref val1, jvalue_ref val2)
+jvalue_ref jvalue_duplicate_private (jvalue_ref val)
 {
-	SANITY_CHECK_POINTER(val1);
-	SANITY_CHECK_POINTER(val2);
+	SANITY_CHECK_POINTER(val);
+
+	return jvalue_duplicate_walk(val, true);
+}
+
+typedef struct {
+	jchild_iter m_children;
+	jvalue_ref m_other;
+	bool m_sameShape; // the members are compared slot by slot
+} equal_frame;
+
+// Compare the values which aren't walked into, and the sizes of the containers otherwise
+static bool jvalue_equal_node (jvalue_ref val1, jvalue_ref val2, bool *walk)
+{
+	*walk = false;
 
-	if (val1 == val2)
+	// Copies of a frozen container are equal to it until they are accessed
+	if (val1 == val2 || jview_origin(val1) == jview_origin(val2))
 		return true;
 
 	if (val1->m_type != val2->m_type)
@@ -213,21 +538,219 @@ bool jvalue_equal(jvalue_ref val1, jvalue_ref val2)
 			return jnumber_compare(val1, val2) == 0;
 		case JV_STR:
 			return jstring_equal(val1, val2);
-		case JV_ARRAY:
-			return jarray_equal(val1, val2);
+		case JV_ARRAY: {
+			if (jarray_size(val1) != jarray_size(val2))
+				return false;
+
+			jpacked *packed = jarray_deref(val1)->m_packed;
+			jpacked *otherPacked = jarray_deref(val2)->m_packed;
+			if (packed && otherPacked && packed->m_type == otherPacked->m_type)
+				return jpacked_equal(val1, val2);
+
+			*walk = jarray_size(val1) > 0;
+			return true;
+		}
 		case JV_OBJECT:
-			return jobject_equal(val1, val2);
+			if (jobject_size(val1) != jobject_size(val2))
+				return false;
+
+			*walk = jobject_size(val1) > 0;
+			return true;
 	}
 
 	return false;
 }
 
+static bool jvalue_equal_push (jstack *stack, jvalue_ref val, jvalue_ref other)
+{
+	equal_frame *frame = jstack_push(stack);
+	if (!frame)
+		return false;
+
+	jchild_iter_init(&frame->m_children, val);
+	frame->m_other = other;
+	frame->m_sameShape = jis_shaped(val) && jobject_deref(val)->m_shape == jobject_deref(other)->m_shape;
+	return true;
+}
+
+bool jvalue_equal(jvalue_ref val1, jvalue_ref val2)
+{
+	SANITY_CHECK_POINTER(val1);
+	SANITY_CHECK_POINTER(val2);
+
+	bool walk;
+	if (!jvalue_equal_node(val1, val2, &walk))
+		return false;
+	if (!walk)
+		return true;
+
+	jstack stack;
+	jstack_init(&stack, sizeof(equal_frame), JVALUE_MAX_DEPTH);
+	bool result = jvalue_equal_push(&stack, val1, val2);
+	while (result && !jstack_empty(&stack)) {
+		equal_frame *frame = jstack_top(&stack);
+		jobject_key_value child;
+		if (!jchild_iter_next(&frame->m_children, &child)) {
+			jstack_pop(&stack);
+			continue;
+		}
+
+		jvalue_ref other = NULL;
+		if (!child.key)
+			other = jarray_get(frame->m_other, frame->m_children.m_index);
+		else if (frame->m_sameShape)
+			other = jobject_deref(frame->m_other)->m_slots[frame->m_children.m_index];
+		else if (!jobject_get_exists2(frame->m_other, child.key, &other))
+			result = false;
+
+		if (result)
+			result = jvalue_equal_node(child.value, other, &walk) &&
+			         (!walk || jvalue_equal_push(&stack, child.value, other));
+	}
+	jstack_destroy(&stack);
+
+	return result;
+}
+
 static void j_destroy_object (jvalue_ref obj) NON_NULL(1);
 static void j_destroy_array (jvalue_ref arr) NON_NULL(1);
 static void j_destroy_string (jvalue_ref str) NON_NULL(1);
 static void j_destroy_number (jvalue_ref num) NON_NULL(1);
 static inline void j_destroy_boolean (jvalue_ref boolean) NON_NULL(1);
 
+// The value which last reference is gone, its members are released already or pending
+static void j_destroy (jvalue_ref val)
+{
+	TRACE_REF("freeing because refcnt is 0: %s", val, jvalue_tostring(val, jschema_all()));
+	jvalue_forget_string(val);
+
+	switch (val->m_type) {
+		case JV_OBJECT:
+			j_destroy_object (val);
+			break;
+		case JV_ARRAY:
+			j_destroy_array (val);
+			break;
+		case JV_STR:
+			j_destroy_string (val);
+			break;
+		case JV_NUM:
+			j_destroy_number (val);
+			break;
+		case JV_BOOL:
+			j_destroy_boolean (val);
+			break;
+		case JV_NULL:
+			PJ_LOG_ERR("PBNJSON_INVALID_STATE", 0, "Invalid program state - should've already returned from j_release before this point");
+			assert(false);
+			break;
+	}
+
+	SANITY_CLEAR_VAR(val->m_refCnt, 0);
+	jblock *block = val->m_inBlock ? jvalue_block(val) : NULL;
+	jvalue_extra *extra = jvalue_extra_get(val);
+	if (extra) {
+		if (extra->m_backingBuffer.m_str) {
+			if (extra->m_backingBufferMMap) {
+				munmap((void *)extra->m_backingBuffer.m_str, extra->m_backingBuffer.m_len);
+			} else {
+				free((void *)extra->m_backingBuffer.m_str);
+			}
+		}
+		free(extra);
+	}
+
+	if (block) {
+		jblock_release(block);
+	} else {
+		PJ_LOG_MEM("Freeing %p", val);
+		free (val);
+	}
+}
+
+// The members released by the values being destroyed by the thread, see j_destroy_all
+static GPrivate s_pending = G_PRIVATE_INIT(NULL);
+
+// Destroy the value and the members it had the last references to one after another
+static void j_destroy_all (jvalue_ref val)
+{
+	// Only the containers release other values
+	if (val->m_type != JV_OBJECT && val->m_type != JV_ARRAY) {
+		j_destroy(val);
+		return;
+	}
+
+	jstack *pending = g_private_get(&s_pending);
+	if (pending) {
+		jvalue_ref *next = jstack_push(pending);
+		if (LIKELY(next != NULL)) {
+			*next = val;
+			return;
+		}
+		// Out of memory, the member goes away along with its parent
+		j_destroy(val);
+		return;
+	}
+
+	jstack stack;
+	jstack_init(&stack, sizeof(jvalue_ref), SIZE_MAX);
+	g_private_set(&s_pending, &stack);
+	j_destroy(val);
+	while (!jstack_empty(&stack)) {
+		val = *(jvalue_ref *) jstack_top(&stack);
+		jstack_pop(&stack);
+		if (!jstack_empty(&stack))
+			PREFETCH(*(jvalue_ref *) jstack_top(&stack));
+		j_destroy(val);
+	}
+	g_private_set(&s_pending, NULL);
+	jstack_destroy(&stack);
+}
+
+// The containers j_release hands over to the reclaiming threads, see j_release_set_deferred
+static bool j_release_defers (jvalue_ref val)
+{
+	size_t threshold = jreclaim_threshold();
+	if (!threshold || jis_lazy(val))
+		return false;
+
+	size_t members;
+	if (jis_object(val))
+		members = jobject_size(val);
+	else if (jis_array(val))
+		members = jarray_deref(val)->m_size;
+	else
+		return false;
+
+	// The members of a value being destroyed go along with it
+	if (members < threshold || g_private_get(&s_pending))
+		return false;
+
+	jreclaim_collect();
+	return jreclaim_defer(val);
+}
+
+// Once the values are reclaimed in the background, the members shared with a value being
+// reclaimed may lose their other references on either thread, the last one destroys them
+static void j_release_shared (jvalue_ref val)
+{
+	int32_t refs = jrefcnt_add(&val->m_refCnt, -1);
+	if (refs > 0) {
+		TRACE_REF("decrement ref cnt to %d: %s", val, refs, jvalue_tostring(val, jschema_all()));
+		return;
+	}
+	if (UNLIKELY(refs < 0)) {
+		PJ_LOG_ERR("PBNJSON_REF_CNT_ERR", 0, "reference counter messed up - memory corruption and/or random crashes are possible");
+		assert(false);
+		return;
+	}
+
+	// Nothing else refers the value, it goes away with the reference it had at last
+	val->m_refCnt = 1;
+	if (!j_release_defers(val))
+		j_destroy_all(val);
+}
+
 void j_release (jvalue_ref *val)
 {
 	SANITY_CHECK_POINTER(val);
@@ -236,7 +759,13 @@ void j_release (jvalue_ref *val)
 		SANITY_KILL_POINTER(*val);
 		return;
 	}
-	if (UNLIKELY(jis_const(*val))) {
+	if (jis_const(*val)) {
+		SANITY_KILL_POINTER(*val);
+		return;
+	}
+
+	if (UNLIKELY(jreclaim_started)) {
+		j_release_shared(*val);
 		SANITY_KILL_POINTER(*val);
 		return;
 	}
@@ -244,46 +773,7 @@ void j_release (jvalue_ref *val)
 	assert((*val)->m_refCnt > 0);
 
 	if ((*val)->m_refCnt == 1) {
-		TRACE_REF("freeing because refcnt is 0: %s", *val, jvalue_tostring(*val, jschema_all()));
-		if ((*val)->m_toStringDealloc) {
-			PJ_LOG_MEM("Freeing string representation of jvalue %p", (*val)->m_toString);
-			(*val)->m_toStringDealloc ((*val)->m_toString);
-		}
-		SANITY_KILL_POINTER((*val)->m_toString);
-
-		switch ( (*val)->m_type) {
-			case JV_OBJECT:
-				j_destroy_object (*val);
-				break;
-			case JV_ARRAY:
-				j_destroy_array (*val);
-				break;
-			case JV_STR:
-				j_destroy_string (*val);
-				break;
-			case JV_NUM:
-				j_destroy_number (*val);
-				break;
-			case JV_BOOL:
-				j_destroy_boolean (*val);
-				break;
-			case JV_NULL:
-				PJ_LOG_ERR("PBNJSON_INVALID_STATE", 0, "Invalid program state - should've already returned from j_release before this point");
-				assert(false);
-				break;
-		}
-
-		if ((*val)->m_backingBuffer.m_str) {
-			if ((*val)->m_backingBufferMMap) {
-				munmap((void *)(*val)->m_backingBuffer.m_str, (*val)->m_backingBuffer.m_len);
-			} else {
-				free((void *)(*val)->m_backingBuffer.m_str);
-			}
-		}
-
-		SANITY_CLEAR_VAR((*val)->m_refCnt, 0);
-		PJ_LOG_MEM("Freeing %p", *val);
-		free (*val);
+		j_destroy_all(*val);
 	} else if (UNLIKELY((*val)->m_refCnt < 0)) {
 		PJ_LOG_ERR("PBNJSON_REF_CNT_ERR", 0, "reference counter messed up - memory corruption and/or random crashes are possible");
 		assert(false);
@@ -294,6 +784,30 @@ void j_release (jvalue_ref *val)
 	SANITY_KILL_POINTER(*val);
 }
 
+void j_release_deferred (jvalue_ref *val)
+{
+	SANITY_CHECK_POINTER(val);
+	CHECK_POINTER(val);
+	jvalue_ref value = *val;
+	SANITY_KILL_POINTER(*val);
+	if (UNLIKELY(value == NULL) || jis_const(value))
+		return;
+
+	if (!jreclaim_start()) {
+		j_release(&value);
+		return;
+	}
+
+	jreclaim_collect();
+	if (jrefcnt_add(&value->m_refCnt, -1) > 0)
+		return;
+
+	// The scalars take no longer to destroy than to hand over
+	value->m_refCnt = 1;
+	if ((!jis_object(value) && !jis_array(value)) || !jreclaim_defer(value))
+		j_destroy_all(value);
+}
+
 jvalue_ref jinvalid ()
 { return &JINVALID; }
 
@@ -364,39 +878,61 @@ static bool check_insert_sanity(jvalue_ref parent, jvalue_ref child)
 		return false;
 	}
 
-	// Then check recursively child's children (if child is an array or an object)
-	if (jis_array(child)) {
-		for (int i = 0; i < jarray_size(child); i++) {
-			jvalue_ref arr_elem = jarray_get(child, i);
-			if(!check_insert_sanity(parent, arr_elem)) {
-				return false;
-			}
-		}
-	} else if (jis_object(child)) {
-		jobject_iter it;
-		jobject_key_value key_value;
-		jobject_iter_init(&it, child);
-		while (jobject_iter_next(&it, &key_value))
-		{
-			if(!check_insert_sanity(parent, key_value.value)) {
-				return false;
-			}
-		}
+	// Content of a lazy container comes from the parsed document or the frozen source only,
+	// and the frozen containers never refer a modifiable parent
+	if (!jvalue_walks(child)) {
+		return true;
 	}
 
-	return true;
+	// Then check child's children, and their children in turn
+	jstack stack;
+	jstack_init(&stack, sizeof(jchild_iter), JVALUE_MAX_DEPTH);
+	bool result = jvalue_walk_push(&stack, child);
+	while (result && !jstack_empty(&stack)) {
+		jobject_key_value grandchild;
+		if (!jchild_iter_next(jstack_top(&stack), &grandchild))
+			jstack_pop(&stack);
+		else if (UNLIKELY(grandchild.value == parent))
+			result = false;
+		else if (jvalue_walks(grandchild.value))
+			result = jvalue_walk_push(&stack, grandchild.value);
+	}
+	jstack_destroy(&stack);
+
+	return result;
+}
+
+static void j_destroy_slots (jobject *obj)
+{
+	for (size_t i = 0; i < jshape_size(obj->m_shape); i++)
+		j_release(&obj->m_slots[i]);
+	if (!obj->m_blockSlots)
+		free(obj->m_slots);
+	obj->m_slots = NULL;
+	obj->m_slotsCapacity = 0;
+	obj->m_blockSlots = false;
+	if (UNLIKELY(jreclaim_started))
+		jreclaim_release_shape(obj->m_shape);
+	else
+		jshape_release(obj->m_shape);
+	obj->m_shape = NULL;
 }
 
 static void j_destroy_object (jvalue_ref ref)
 {
-	g_hash_table_destroy(jobject_deref(ref)->m_members);
+	jlazy_release(ref);
+	if (jobject_deref(ref)->m_shape)
+		j_destroy_slots(jobject_deref(ref));
+	if (jobject_deref(ref)->m_members)
+		g_hash_table_destroy(jobject_deref(ref)->m_members);
 }
 
 /* Has table key routines */
 static guint _ObjKeyHash(gconstpointer key)
 {
 	jvalue_ref jkey = (jvalue_ref) key;
-	return key_hash(jkey);
+	const struct jkey *handle = jkey_of(jkey);
+	return handle ? handle->m_hash : key_hash(jkey);
 }
 
 static gboolean _ObjKeyEqual(gconstpointer a, gconstpointer b)
@@ -412,14 +948,19 @@ static void _ObjKeyValDestroy(gpointer data)
 	j_release(&jdata);
 }
 
+bool jobject_init(jobject *obj)
+{
+	obj->m_members = g_hash_table_new_full(_ObjKeyHash, _ObjKeyEqual,
+	                                       _ObjKeyValDestroy, _ObjKeyValDestroy);
+	return obj->m_members != NULL;
+}
+
 jvalue_ref jobject_create ()
 {
 	jobject *new_obj = (jobject *) calloc(1, sizeof(jobject));
 	CHECK_ALLOC_RETURN_NULL(new_obj);
 	jvalue_init((jvalue_ref)new_obj, JV_OBJECT);
-	new_obj->m_members = g_hash_table_new_full(_ObjKeyHash, _ObjKeyEqual,
-	                                           _ObjKeyValDestroy, _ObjKeyValDestroy);
-	if (!new_obj->m_members)
+	if (!jobject_init(new_obj))
 	{
 		free(new_obj);
 		return NULL;
@@ -428,6 +969,145 @@ jvalue_ref jobject_create ()
 	return (jvalue_ref)new_obj;
 }
 
+/**
+ * Create an object of a lazily parsed document. The hash table is created on
+ * materialization, the object takes over a reference to the document.
+ */
+jvalue_ref jobject_create_lazy(jlazy_doc *doc, size_t node)
+{
+	jobject *new_obj = (jobject *) calloc(1, sizeof(jobject));
+	CHECK_ALLOC_RETURN_NULL(new_obj);
+	jvalue_init((jvalue_ref)new_obj, JV_OBJECT);
+	new_obj->m_lazy.m_doc = doc;
+	new_obj->m_lazy.m_node = node;
+	TRACE_REF("created lazy", new_obj);
+	return (jvalue_ref)new_obj;
+}
+
+jvalue_ref jobject_create_shaped(jshape *shape, size_t capacityHint)
+{
+	assert(jshape_size(shape) == 0);
+
+	jobject *new_obj = (jobject *) calloc(1, sizeof(jobject));
+	CHECK_ALLOC_RETURN_NULL(new_obj);
+	jvalue_init((jvalue_ref)new_obj, JV_OBJECT);
+	if (capacityHint) {
+		new_obj->m_slots = malloc(sizeof(jvalue_ref) * capacityHint);
+		if (!new_obj->m_slots) {
+			free(new_obj);
+			return NULL;
+		}
+		new_obj->m_slotsCapacity = capacityHint;
+	}
+	new_obj->m_shape = jshape_copy(shape);
+	TRACE_REF("created shaped", new_obj);
+	return (jvalue_ref)new_obj;
+}
+
+static bool jobject_expand_slots (jobject *obj, size_t newSize)
+{
+	size_t capacity = MAX(newSize, obj->m_slotsCapacity * 2);
+	jvalue_ref *slots;
+	if (UNLIKELY(obj->m_blockSlots)) {
+		// The slots can't grow in the block, the object gets its own ones
+		slots = malloc(sizeof(jvalue_ref) * capacity);
+		if (slots != NULL) {
+			memcpy(slots, obj->m_slots, sizeof(jvalue_ref) * jshape_size(obj->m_shape));
+			obj->m_blockSlots = false;
+		}
+	} else {
+		slots = realloc(obj->m_slots, sizeof(jvalue_ref) * capacity);
+	}
+	CHECK_ALLOC_RETURN_VALUE(slots, false);
+
+	obj->m_slots = slots;
+	obj->m_slotsCapacity = capacity;
+	return true;
+}
+
+// Takes over key and val unless the object should leave its shape
+static bool jobject_put_shaped (jobject *obj, jvalue_ref key, jvalue_ref val)
+{
+	ssize_t slot = jshape_find(obj->m_shape, key);
+	if (slot >= 0) {
+		j_release(&obj->m_slots[slot]);
+		obj->m_slots[slot] = val;
+		j_release(&key);
+		return true;
+	}
+
+	jshape *next = jshape_transition(obj->m_shape, key);
+	if (!next)
+		return false;
+
+	size_t size = jshape_size(next);
+	if (size > obj->m_slotsCapacity && !jobject_expand_slots(obj, size)) {
+		jshape_release(next);
+		return false;
+	}
+
+	obj->m_slots[size - 1] = val;
+	jshape_release(obj->m_shape);
+	obj->m_shape = next;
+	j_release(&key);
+	return true;
+}
+
+// Move the members into a hash table, for the keys the shapes don't have
+static bool jobject_unshape (jobject *obj)
+{
+	if (!jobject_init(obj))
+		return false;
+
+	for (size_t i = 0; i < jshape_size(obj->m_shape); i++) {
+		g_hash_table_insert(obj->m_members, jvalue_copy(jshape_key(obj->m_shape, i)), obj->m_slots[i]);
+		obj->m_slots[i] = NULL;
+	}
+	j_destroy_slots(obj);
+	return true;
+}
+
+// Share the shape of the source with the object without members, the slots are left empty
+static bool jobject_share_shape (jobject *obj, jobject *source)
+{
+	size_t size = jshape_size(source->m_shape);
+	if (size > obj->m_slotsCapacity && !jobject_expand_slots(obj, size))
+		return false;
+
+	obj->m_shape = jshape_copy(source->m_shape);
+	for (size_t i = 0; i < size; i++)
+		obj->m_slots[i] = NULL;
+	return true;
+}
+
+// Share the shape of the source with the object without members, the members are duplicated
+static bool jobject_copy_shaped (jobject *obj, jobject *source)
+{
+	if (!jobject_share_shape(obj, source))
+		return false;
+
+	for (size_t i = 0; i < jshape_size(source->m_shape); i++)
+		obj->m_slots[i] = jvalue_duplicate(source->m_slots[i]);
+	return true;
+}
+
+// An object of the same shape with empty slots, filled by jvalue_duplicate
+static jvalue_ref jobject_create_same_shape (jvalue_ref obj)
+{
+	jshape *shape = jobject_deref(obj)->m_shape;
+
+	jvalue_ref result = jobject_create_shaped(jshape_root(shape), jshape_size(shape));
+	CHECK_POINTER_RETURN_NULL(result);
+
+	jshape_release(jobject_deref(result)->m_shape);
+	jobject_deref(result)->m_shape = NULL;
+	if (!jobject_share_shape(jobject_deref(result), jobject_deref(obj))) {
+		j_release(&result);
+		return NULL;
+	}
+	return result;
+}
+
 static jvalue_ref jobject_put_keyvalue(jvalue_ref obj, jobject_key_value item)
 {
 	assert(jis_string(item.key));
@@ -480,39 +1160,15 @@ bool jis_object (jvalue_ref val)
 	return val->m_type == JV_OBJECT;
 }
 
-static bool jobject_equal(jvalue_ref obj, jvalue_ref other)
-{
-	SANITY_CHECK_POINTER(obj);
-	SANITY_CHECK_POINTER(other);
-
-	assert(jis_object(obj));
-	assert(jis_object(other));
-
-	if (jobject_size(obj) != jobject_size(other))
-		return false;
-
-	jobject_iter it;
-	jobject_key_value pair;
-	jobject_iter_init(&it, obj);
-	while (jobject_iter_next(&it, &pair))
-	{
-		jvalue_ref val = NULL;
-		if (!jobject_get_exists2(other, pair.key, &val))
-			return false;
-
-		if (!jvalue_equal(pair.value, val))
-			return false;
-	}
-
-	return true;
-}
-
 size_t jobject_size(jvalue_ref obj)
 {
 	SANITY_CHECK_POINTER(obj);
 
 	CHECK_CONDITION_RETURN_VALUE(!jis_object(obj), 0, "Attempt to retrieve size from something not an object %p", obj);
 
+	jlazy_ensure(obj);
+	if (jobject_deref(obj)->m_shape)
+		return jshape_size(jobject_deref(obj)->m_shape);
 	if (!jobject_deref(obj)->m_members)
 		return 0;
 	return g_hash_table_size(jobject_deref(obj)->m_members);
@@ -542,10 +1198,15 @@ bool jobject_get_exists2 (jvalue_ref obj, jvalue_ref key, jvalue_ref *value)
 	CHECK_CONDITION_RETURN_VALUE(jis_null(obj), false, "Attempt to cast null %p to object", obj);
 	CHECK_CONDITION_RETURN_VALUE(!jis_object(obj), false, "Attempt to cast type %d to object (%d)", obj->m_type, JV_OBJECT);
 
-	if (!jobject_deref(obj)->m_members)
+	jlazy_ensure(obj);
+	if (jobject_deref(obj)->m_shape) {
+		ssize_t slot = jshape_find(jobject_deref(obj)->m_shape, key);
+		result = slot >= 0 ? jobject_deref(obj)->m_slots[slot] : NULL;
+	} else if (jobject_deref(obj)->m_members) {
+		result = g_hash_table_lookup(jobject_deref(obj)->m_members, key);
+	} else {
 		return false;
-
-	result = g_hash_table_lookup(jobject_deref(obj)->m_members, key);
+	}
 	if (!result)
 		return false;
 
@@ -564,6 +1225,15 @@ jvalue_ref jobject_get (jvalue_ref obj, raw_buffer key)
 	return jinvalid();
 }
 
+jvalue_ref jobject_get_key (jvalue_ref obj, jkey_ref key)
+{
+	jvalue_ref result = NULL;
+
+	if (jobject_get_exists2 (obj, &key->m_string.m_value, &result))
+		return result;
+	return jinvalid();
+}
+
 bool jobject_remove (jvalue_ref obj, raw_buffer key)
 {
 	SANITY_CHECK_POINTER(obj);
@@ -571,6 +1241,15 @@ bool jobject_remove (jvalue_ref obj, raw_buffer key)
 	CHECK_CONDITION_RETURN_VALUE(jis_null(obj), false, "Attempt to cast null %p to object", obj);
 	CHECK_CONDITION_RETURN_VALUE(!jis_object(obj), false, "Attempt to cast type %d to object (%d)", obj->m_type, JV_OBJECT);
 
+	if (!jcheck_mutable(obj))
+		return false;
+
+	jlazy_ensure(obj);
+	if (jobject_deref(obj)->m_shape) {
+		// The objects of the shape keep all of its keys
+		if (jshape_lookup(jobject_deref(obj)->m_shape, key) < 0 || !jobject_unshape(jobject_deref(obj)))
+			return false;
+	}
 	if (!jobject_deref(obj)->m_members)
 		return false;
 
@@ -593,7 +1272,8 @@ bool jobject_set (jvalue_ref obj, raw_buffer key, jvalue_ref val)
 {
 	jvalue_ref newKey, newVal;
 
-	if (!jobject_deref(obj)->m_members)
+	jlazy_ensure(obj);
+	if (!jobject_deref(obj)->m_members && !jobject_deref(obj)->m_shape)
 		return false;
 
 	newVal = jvalue_copy (val);
@@ -629,6 +1309,12 @@ bool jobject_set2(jvalue_ref obj, jvalue_ref key, jvalue_ref val)
 	return jobject_put(obj, new_key, new_val);
 }
 
+bool jobject_set_key (jvalue_ref obj, jkey_ref key, jvalue_ref val)
+{
+	// The object shares the string of the key
+	return jobject_set2(obj, &key->m_string.m_value, val);
+}
+
 bool jobject_put (jvalue_ref obj, jvalue_ref key, jvalue_ref val)
 {
 	SANITY_CHECK_POINTER(obj);
@@ -643,7 +1329,11 @@ bool jobject_put (jvalue_ref obj, jvalue_ref key, jvalue_ref val)
 			break;
 		}
 
-		if (!jobject_deref(obj)->m_members) {
+		if (!jcheck_mutable(obj))
+			break;
+
+		jlazy_ensure(obj);
+		if (!jobject_deref(obj)->m_members && !jobject_deref(obj)->m_shape) {
 			break;
 		}
 
@@ -677,6 +1367,13 @@ bool jobject_put (jvalue_ref obj, jvalue_ref key, jvalue_ref val)
 			break;
 		}
 
+		if (jobject_deref(obj)->m_shape) {
+			if (jobject_put_shaped(jobject_deref(obj), key, val))
+				return true;
+			if (!jobject_unshape(jobject_deref(obj)))
+				break;
+		}
+
 		g_hash_table_replace(jobject_deref(obj)->m_members, key, val);
 		return true;
 	} while (false);
@@ -687,12 +1384,38 @@ bool jobject_put (jvalue_ref obj, jvalue_ref key, jvalue_ref val)
 	return false;
 }
 
+/**
+ * Iteration over the slots of a shaped object. The callers allocate jobject_iter themselves, so
+ * it keeps its layout and the slots are iterated within the storage of its GHashTableIter. glib
+ * keeps the hash table in the first pointer of the iterator, NULL there tells the slots apart.
+ */
+typedef struct {
+	gpointer m_table; // NULL
+	jvalue_ref m_shaped;
+	size_t m_slot;
+} jslots_iter;
+
+_Static_assert(sizeof(jslots_iter) <= sizeof(GHashTableIter), "the slots should be iterated within GHashTableIter");
+
+static inline jslots_iter *jslots_iter_get(jobject_iter *iter)
+{
+	return (jslots_iter *) &iter->m_iter;
+}
+
 // JSON Object iterators
 bool jobject_iter_init(jobject_iter *iter, jvalue_ref obj)
 {
 	SANITY_CHECK_POINTER(obj);
 
 	CHECK_CONDITION_RETURN_VALUE(!jis_object(obj), false, "Cannot iterate over non-object");
+	jlazy_ensure(obj);
+	if (jobject_deref(obj)->m_shape) {
+		jslots_iter *slots = jslots_iter_get(iter);
+		slots->m_table = NULL;
+		slots->m_shaped = obj;
+		slots->m_slot = 0;
+		return true;
+	}
 	CHECK_CONDITION_RETURN_VALUE(!jobject_deref(obj)->m_members, false, "The object isn't iterable");
 
 	g_hash_table_iter_init(&iter->m_iter, jobject_deref(obj)->m_members);
@@ -701,10 +1424,63 @@ bool jobject_iter_init(jobject_iter *iter, jvalue_ref obj)
 
 bool jobject_iter_next(jobject_iter *iter, jobject_key_value *keyval)
 {
+	jslots_iter *slots = jslots_iter_get(iter);
+	if (!slots->m_table) {
+		jobject *obj = jobject_deref(slots->m_shaped);
+		if (slots->m_slot >= jshape_size(obj->m_shape))
+			return false;
+		keyval->key = jshape_key(obj->m_shape, slots->m_slot);
+		keyval->value = obj->m_slots[slots->m_slot];
+		slots->m_slot++;
+		return true;
+	}
+
 	return g_hash_table_iter_next(&iter->m_iter,
 	                              (gpointer *)&keyval->key, (gpointer *)&keyval->value);
 }
 
+void jchild_iter_init(jchild_iter *iter, jvalue_ref container)
+{
+	iter->m_container = container;
+	iter->m_index = -1;
+	if (jis_object(container)) {
+		jobject_iter_init(&iter->m_members, container);
+		iter->m_size = jobject_size(container);
+	} else {
+		iter->m_size = jarray_size(container);
+	}
+}
+
+bool jchild_iter_next(jchild_iter *iter, jobject_key_value *child)
+{
+	jvalue_ref container = iter->m_container;
+	ssize_t index = ++iter->m_index;
+	if (index >= iter->m_size)
+		return false;
+
+	if (container->m_type == JV_ARRAY) {
+		jarray *arr = jarray_deref(container);
+		child->key = NULL;
+		if (UNLIKELY(arr->m_packed)) {
+			child->value = jpacked_get(container, index);
+			return true;
+		}
+
+		child->value = *jarray_slot(arr, index);
+		if (UNLIKELY(child->value == NULL))
+			child->value = jinvalid();
+		if (index + 1 < iter->m_size)
+			PREFETCH(*jarray_slot(arr, index + 1));
+		return true;
+	}
+
+	if (!jobject_iter_next(&iter->m_members, child))
+		return false;
+	if (jobject_deref(container)->m_shape && index + 1 < iter->m_size)
+		PREFETCH(jobject_deref(container)->m_slots[index + 1]);
+	return true;
+}
+
 /************************* JSON OBJECT API **************************************/
 
 /************************* JSON ARRAY API  *************************************/
@@ -720,6 +1496,7 @@ static bool jarray_expand_capacity_unsafe (jvalue_ref arr, ssize_t newSize) NON_
 static void jarray_remove_unsafe (jvalue_ref arr, ssize_t index) NON_NULL(1);
 
 static bool valid_index_bounded (jvalue_ref arr, ssize_t index) NON_NULL(1);
+static inline bool jarray_ensure_unpacked (jvalue_ref arr) NON_NULL(1);
 static bool valid_index_bounded (jvalue_ref arr, ssize_t index)
 {
 	SANITY_CHECK_POINTER(arr);
@@ -731,12 +1508,24 @@ static bool valid_index_bounded (jvalue_ref arr, ssize_t index)
 	return true;
 }
 
+// The elements of a packed array get their values before the array is modified
+static inline bool jarray_ensure_unpacked (jvalue_ref arr)
+{
+	if (LIKELY(!jarray_deref(arr)->m_packed))
+		return true;
+	return jpacked_unpack(arr);
+}
+
 static void j_destroy_array (jvalue_ref arr)
 {
 	SANITY_CHECK_POINTER(arr);
+	jlazy_release(arr);
 	SANITY_CHECK_POINTER(jarray_deref(arr)->m_bigBucket);
 	assert(jis_array(arr));
 
+	if (jarray_deref(arr)->m_packed)
+		jpacked_release(arr);
+
 #ifdef DEBUG_FREED_POINTERS
 	for (ssize_t i = jarray_size(arr); i < jarray_deref(arr)->m_capacity; i++) {
 		jvalue_ref *outsideValue = jarray_get_unsafe(arr, i);
@@ -751,6 +1540,9 @@ static void j_destroy_array (jvalue_ref arr)
 
 	assert(jarray_size(arr) == 0);
 
+	if (jarray_deref(arr)->m_blockBucket)
+		return;
+
 	PJ_LOG_MEM("Destroying array bucket at %p", jarray_deref(arr)->m_bigBucket);
 	SANITY_FREE(free, jvalue_ref *, jarray_deref(arr)->m_bigBucket, jarray_deref(arr)->m_capacity - ARRAY_BUCKET_SIZE);
 }
@@ -766,6 +1558,19 @@ jvalue_ref jarray_create (jarray_opts opts)
 	return (jvalue_ref)new_array;
 }
 
+/**
+ * Create an array of a lazily parsed document. The array takes over a reference to the document.
+ */
+jvalue_ref jarray_create_lazy(jlazy_doc *doc, size_t node)
+{
+	jvalue_ref new_array = jarray_create(NULL);
+	CHECK_POINTER_RETURN_NULL(new_array);
+
+	jarray_deref(new_array)->m_lazy.m_doc = doc;
+	jarray_deref(new_array)->m_lazy.m_node = node;
+	return new_array;
+}
+
 jvalue_ref jarray_create_var (jarray_opts opts, ...)
 {
 	// jarray_create_hint will take care of the capacity for us
@@ -819,31 +1624,11 @@ bool jis_array (jvalue_ref val)
 	return val->m_type == JV_ARRAY;
 }
 
-static bool jarray_equal(jvalue_ref arr, jvalue_ref other)
-{
-	SANITY_CHECK_POINTER(arr);
-	SANITY_CHECK_POINTER(other);
-
-	assert(jis_array(arr));
-	assert(jis_array(other));
-
-	ssize_t size = jarray_size(arr);
-	if (size != jarray_size(other))
-		return false;
-
-	for (ssize_t i = 0; i < size; ++i)
-	{
-		if (!jvalue_equal(jarray_get(arr, i), jarray_get(other, i)))
-			return false;
-	}
-
-	return true;
-}
-
 ssize_t jarray_size (jvalue_ref arr)
 {
 	SANITY_CHECK_POINTER(arr);
 	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), 0, "Attempt to get array size of non-array %p", arr);
+	jlazy_ensure(arr);
 	return jarray_size_unsafe (arr);
 }
 
@@ -868,6 +1653,7 @@ static inline void jarray_size_decrement_unsafe (jvalue_ref arr)
 	assert(jis_array(arr));
 
 	--jarray_deref(arr)->m_size;
+	++jarray_deref(arr)->m_version;
 
 	assert(jarray_size_unsafe(arr) >= 0);
 }
@@ -883,6 +1669,7 @@ static inline void jarray_size_set_unsafe (jvalue_ref arr, ssize_t newSize)
 static jvalue_ref* jarray_get_unsafe (jvalue_ref arr, ssize_t index)
 {
 	assert(jis_array(arr));
+	assert(!jarray_deref(arr)->m_packed);
 	assert(index >= 0);
 	assert(index < jarray_deref(arr)->m_capacity);
 
@@ -899,6 +1686,9 @@ jvalue_ref jarray_get (jvalue_ref arr, ssize_t index)
 
 	CHECK_CONDITION_RETURN_VALUE(!valid_index_bounded(arr, index), jinvalid(), "Attempt to get array element from %p with out-of-bounds index value %zd", arr, index);
 
+	if (jarray_deref(arr)->m_packed)
+		return jpacked_get(arr, index);
+
 	result = * (jarray_get_unsafe (arr, index));
 	if (result == NULL)
 	// need to fix up in case we haven't assigned anything to that space - it's initialized to NULL (JSON undefined)
@@ -938,6 +1728,9 @@ bool jarray_remove (jvalue_ref arr, ssize_t index)
 {
 	CHECK_CONDITION_RETURN_VALUE(!valid_index_bounded(arr, index), false, "Attempt to get array element from %p with out-of-bounds index value %zd", arr, index);
 
+	if (!jcheck_mutable(arr) || !jarray_ensure_unpacked(arr))
+		return false;
+
 	jarray_remove_unsafe (arr, index);
 
 	return true;
@@ -961,7 +1754,17 @@ static bool jarray_expand_capacity_unsafe (jvalue_ref arr, ssize_t newSize)
 		// m_capacity is always a minimum of the bucket size
 		assert(OUTSIDE_ARR_BUCKET_RANGE(newSize));
 		assert(newSize > ARRAY_BUCKET_SIZE);
-		jvalue_ref *newBigBucket = realloc (jarray_deref(arr)->m_bigBucket, sizeof(jvalue_ref) * (newSize - ARRAY_BUCKET_SIZE));
+		jvalue_ref *newBigBucket;
+		if (UNLIKELY(jarray_deref(arr)->m_blockBucket)) {
+			// The bucket can't grow in the block, the array gets its own one
+			newBigBucket = malloc (sizeof(jvalue_ref) * (newSize - ARRAY_BUCKET_SIZE));
+			if (newBigBucket != NULL) {
+				memcpy(newBigBucket, jarray_deref(arr)->m_bigBucket, sizeof(jvalue_ref) * (jarray_deref(arr)->m_capacity - ARRAY_BUCKET_SIZE));
+				jarray_deref(arr)->m_blockBucket = false;
+			}
+		} else {
+			newBigBucket = realloc (jarray_deref(arr)->m_bigBucket, sizeof(jvalue_ref) * (newSize - ARRAY_BUCKET_SIZE));
+		}
 		if (UNLIKELY(newBigBucket == NULL)) {
 			assert(false);
 			return false;
@@ -984,6 +1787,10 @@ static bool jarray_put_unsafe (jvalue_ref arr, ssize_t index, jvalue_ref val)
 	jvalue_ref *old;
 	SANITY_CHECK_POINTER(arr);
 	assert(jis_array(arr));
+	jlazy_ensure(arr);
+
+	if (!jcheck_mutable(arr) || !jarray_ensure_unpacked(arr))
+		return false;
 
 	if (!check_insert_sanity(arr, val)) {
 		PJ_LOG_ERR("PBNJSON_ARR_PUT_HIERARCHY_ERR", 0, "Error in object hierarchy. Inserting jvalue would create an illegal cyclic dependency");
@@ -1000,6 +1807,7 @@ static bool jarray_put_unsafe (jvalue_ref arr, ssize_t index, jvalue_ref val)
 	*old = val;
 
 	if (index >= jarray_size_unsafe (arr)) jarray_size_set_unsafe (arr, index + 1);
+	else ++jarray_deref(arr)->m_version;
 
 	return true;
 }
@@ -1058,6 +1866,7 @@ bool jarray_append (jvalue_ref arr, jvalue_ref val)
 	SANITY_CHECK_POINTER(arr);
 
 	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), false, "Attempt to append into non-array %p", arr);
+	jlazy_ensure(arr);
 
 	if (UNLIKELY(val == NULL)) {
 		PJ_LOG_WARN("PBNJSON_NULL_IN_ARR_APPEND_FUNC", 0, "incorrect API use - please pass an actual reference to a JSON null if that's what you want - assuming that's the case");
@@ -1087,6 +1896,10 @@ bool jarray_insert(jvalue_ref arr, ssize_t index, jvalue_ref val)
 
 	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), false, "Array to insert into isn't a valid reference to a JSON DOM node: %p", arr);
 	CHECK_CONDITION_RETURN_VALUE(index < 0, false, "Invalid index - must be >= 0: %zd", index);
+	jlazy_ensure(arr);
+
+	if (!jcheck_mutable(arr) || !jarray_ensure_unpacked(arr))
+		return false;
 
 	if (!check_insert_sanity(arr, val)) {
 		PJ_LOG_ERR("PBNJSON_ARR_INS_HIERARCHY_ERR", 0, "Error in object hierarchy. Inserting jvalue would create an illegal cyclic dependency");
@@ -1097,6 +1910,7 @@ bool jarray_insert(jvalue_ref arr, ssize_t index, jvalue_ref val)
 		jvalue_ref *toMove, *hole;
 		// we increment the size of the array
 		jarray_put_unsafe(arr, jarray_size_unsafe(arr), jinvalid());
+		++jarray_deref(arr)->m_version;
 
 		// stopping at the first jis_null as an optimization is actually
 		// wrong because we change the array structure.  we have to move up
@@ -1143,6 +1957,7 @@ bool jarray_splice (jvalue_ref array, ssize_t index, ssize_t toRemove, jvalue_re
 	} else {
 		SANITY_CHECK_POINTER(array);
 		CHECK_CONDITION_RETURN_VALUE(!jis_array(array), false, "Array isn't valid %p", array);
+		jlazy_ensure(array);
 		if (index < 0) index = 0;
 	}
 	CHECK_CONDITION_RETURN_VALUE(begin >= end, false, "Invalid range to copy from second array: [%zd, %zd)", begin, end); // set notation
@@ -1155,6 +1970,13 @@ bool jarray_splice (jvalue_ref array, ssize_t index, ssize_t toRemove, jvalue_re
 		return false;
 	}
 
+	// The elements transferred are removed from array2
+	if (!jcheck_mutable(array) || (ownership == SPLICE_TRANSFER && !jcheck_mutable(array2)))
+		return false;
+
+	if (!jarray_ensure_unpacked(array) || !jarray_ensure_unpacked(array2))
+		return false;
+
 	for (i = index, j = begin; removable && j < end; i++, removable--, j++) {
 		assert(valid_index_bounded(array, i));
 		assert(valid_index_bounded(array2, j));
@@ -1228,6 +2050,61 @@ bool jarray_splice_append (jvalue_ref array, jvalue_ref arrayToAppend, JSpliceOw
 	return jarray_splice (array, jarray_size (array) - 1, 0, arrayToAppend, 0, jarray_size (arrayToAppend), ownership);
 }
 
+jvalue_ref jview_create (jvalue_ref source)
+{
+	assert(source->m_frozen && !jis_lazy(source));
+
+	// Neither members nor a document, the source stands for the content
+	jvalue_ref view = jis_object(source) ? jobject_create_lazy(NULL, 0) : jarray_create_lazy(NULL, 0);
+	CHECK_POINTER_RETURN_VALUE(view, jinvalid());
+
+	jlazy_deref(view)->m_source = jvalue_copy(source);
+	TRACE_REF("created copy of %p", view, source);
+	return view;
+}
+
+static bool jarray_copy_elements (jvalue_ref arr, jvalue_ref source)
+{
+	ssize_t size = jarray_deref(source)->m_size;
+	if (!jarray_expand_capacity_unsafe(arr, size))
+		return false;
+
+	for (ssize_t i = 0; i < size; i++)
+		*jarray_get_unsafe(arr, i) = jvalue_duplicate(*jarray_get_unsafe(source, i));
+	jarray_size_set_unsafe(arr, size);
+	return true;
+}
+
+void jview_materialize (jvalue_ref container)
+{
+	jlazy_ref *lazy = jlazy_deref(container);
+	jvalue_ref source = lazy->m_source;
+	assert(source && jis_frozen(source));
+
+	// The container is a regular one from now on, the accessors below won't get back here
+	lazy->m_source = NULL;
+
+	bool result;
+	if (jis_shaped(source)) {
+		result = jobject_copy_shaped(jobject_deref(container), jobject_deref(source));
+	} else if (jis_object(source)) {
+		result = jobject_init(jobject_deref(container));
+		jobject_iter it;
+		jobject_key_value pair;
+		jobject_iter_init(&it, source);
+		while (result && jobject_iter_next(&it, &pair))
+			g_hash_table_insert(jobject_deref(container)->m_members, jvalue_copy(pair.key), jvalue_duplicate(pair.value));
+	} else if (jis_packed(source)) {
+		result = jpacked_copy(container, source);
+	} else {
+		result = jarray_copy_elements(container, source);
+	}
+
+	if (UNLIKELY(!result))
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Failed to allocate members of the copy of %p", source);
+	j_release(&source);
+}
+
 bool jarray_has_duplicates(jvalue_ref arr)
 {
 	SANITY_CHECK_POINTER(arr);
@@ -1236,6 +2113,9 @@ bool jarray_has_duplicates(jvalue_ref arr)
 
 	ssize_t size = jarray_size(arr);
 
+	if (jarray_deref(arr)->m_packed)
+		return jpacked_has_duplicates(arr);
+
 	for (ssize_t i = 0; i < size - 1; ++i)
 	{
 		jvalue_ref jvali = *jarray_get_unsafe(arr, i);
@@ -1469,22 +2349,6 @@ static void j_destroy_number (jvalue_ref num)
 	SANITY_CLEAR_VAR(jnum_deref(num)->value.raw.m_len, 0);
 }
 
-jvalue_ref jnumber_duplicate (jvalue_ref num)
-{
-	assert (jis_number(num));
-
-	switch (jnum_deref(num)->m_type) {
-	case NUM_RAW:
-		return jnumber_create(jnum_deref(num)->value.raw);
-	case NUM_FLOAT:
-		return jnumber_create_f64(jnum_deref(num)->value.floating);
-	case NUM_INT:
-		return jnumber_create_i64(jnum_deref(num)->value.integer);
-	}
-	assert(false);
-	return jinvalid();
-}
-
 jvalue_ref jnumber_create (raw_buffer str)
 {
 	char *createdBuffer = NULL;
@@ -1496,6 +2360,11 @@ jvalue_ref jnumber_create (raw_buffer str)
 	CHECK_POINTER_RETURN_VALUE(str.m_str, jinvalid());
 	CHECK_CONDITION_RETURN_VALUE(str.m_len <= 0, jinvalid(), "Invalid length parameter for numeric string %s", str.m_str);
 
+	int small;
+	if (jsmall_int_parse(str, &small)) {
+		return &s_scalars.m_raws[small - JSMALL_INT_MIN].m_value;
+	}
+
 	createdBuffer = (char *) calloc (str.m_len + NUM_TERM_NULL, sizeof(char));
 	CHECK_ALLOC_RETURN_VALUE(createdBuffer, jinvalid());
 
@@ -1516,6 +2385,14 @@ jvalue_ref jnumber_create_unsafe (raw_buffer str, jdeallocator strFree)
 	CHECK_POINTER_RETURN_VALUE(str.m_str, jinvalid());
 	CHECK_CONDITION_RETURN_VALUE(str.m_len == 0, jinvalid(), "Invalid length parameter for numeric string %s", str.m_str);
 
+	// The shared number has its own text, the buffer isn't needed
+	int small;
+	if (jsmall_int_parse(str, &small)) {
+		if (strFree)
+			strFree((char *) str.m_str);
+		return &s_scalars.m_raws[small - JSMALL_INT_MIN].m_value;
+	}
+
 	jnum *new_number = (jnum *) calloc(1, sizeof(jnum));
 	CHECK_ALLOC_RETURN_NULL(new_number);
 	jvalue_init((jvalue_ref)new_number, JV_NUM);
@@ -1551,6 +2428,10 @@ jvalue_ref jnumber_create_i32 (int32_t number)
 
 jvalue_ref jnumber_create_i64 (int64_t number)
 {
+	if (number >= JSMALL_INT_MIN && number <= JSMALL_INT_MAX) {
+		return &s_scalars.m_ints[number - JSMALL_INT_MIN].m_value;
+	}
+
 	jnum *new_number = (jnum *) calloc(1, sizeof(jnum));
 	CHECK_ALLOC_RETURN_NULL(new_number);
 	jvalue_init((jvalue_ref)new_number, JV_NUM);
@@ -1840,12 +2721,7 @@ bool jis_boolean (jvalue_ref jval)
 
 jvalue_ref jboolean_create (bool value)
 {
-	jbool *new_bool = (jbool *) calloc(1, sizeof(jbool));
-	CHECK_ALLOC_RETURN_NULL(new_bool);
-	jvalue_init((jvalue_ref)new_bool, JV_BOOL);
-	new_bool->value = value;
-	TRACE_REF("created", new_bool);
-	return (jvalue_ref)new_bool;
+	return value ? &s_scalars.m_true.m_value : &s_scalars.m_false.m_value;
 }
 
 bool jboolean_deref_to_value (jvalue_ref boolean)
@@ -22,23 +22,80 @@
 #include <japi.h>
 #include <jtypes.h>
 #include <glib.h>
+#include <assert.h>
+#include <compiler/builtins.h>
 #include "jconversion.h"
 
 #define ARRAY_BUCKET_SIZE (1 << 4)
 #define OUTSIDE_ARR_BUCKET_RANGE(value) ((value) & (~(ARRAY_BUCKET_SIZE - 1)))
 
 
-struct jvalue {
-	JValueType m_type;
-	ssize_t m_refCnt;
+typedef struct jblock jblock;
+
+/**
+ * The parts of a value few values have, allocated with the first of them: the cached string
+ * representation (see jvalue_tostring) and the input a parsed root holds (see
+ * jdom_parse_file).
+ */
+typedef struct PJSON_LOCAL jvalue_extra {
+	jblock *m_block; // of the relocated value, it doesn't keep it itself once extended
 	char *m_toString;
 	jdeallocator m_toStringDealloc;
 	raw_buffer m_backingBuffer;
 	bool m_backingBufferMMap;
+} jvalue_extra;
+
+struct jvalue {
+	uint8_t m_type; // JValueType
+	bool m_inBlock;  // relocated by jvalue_compact, the memory belongs to the block
+	bool m_frozen;   // shared by its holders, it isn't modified anymore (see jvalue_freeze)
+	bool m_extended; // m_extra is allocated
+	int32_t m_refCnt;
+	union {
+		jblock *m_block;       // the value lives in the block, see m_inBlock
+		jvalue_extra *m_extra; // see m_extended
+	};
 };
 
 typedef struct PJSON_LOCAL jvalue jvalue;
 
+_Static_assert(sizeof(jvalue) == 8 + sizeof(void *), "every value starts with the header, it should stay small");
+
+static inline jvalue_extra *jvalue_extra_get(jvalue_ref val)
+{
+	return val->m_extended ? val->m_extra : NULL;
+}
+
+/**
+ * Get the parts of the value few values have, allocate them if they aren't yet
+ * @return The extra parts, or NULL if out of memory
+ */
+PJSON_LOCAL jvalue_extra *jvalue_extend(jvalue_ref val);
+
+/**
+ * Drop the cached string representation of the value
+ */
+PJSON_LOCAL void jvalue_forget_string(jvalue_ref val);
+
+static inline jblock *jvalue_block(jvalue_ref val)
+{
+	assert(val->m_inBlock);
+	return val->m_extended ? val->m_extra->m_block : val->m_block;
+}
+
+typedef struct jlazy_doc jlazy_doc;
+
+/**
+ * Link of an object or array to its not yet materialized content: a lazily parsed document
+ * (see jdom_parse_lazy), or a frozen container it is a copy of (see jvalue_duplicate). Both
+ * m_doc and m_source are NULL for a regular container.
+ */
+typedef struct PJSON_LOCAL {
+	jlazy_doc *m_doc;
+	size_t m_node;       // index of the container on the structural tape of the document
+	jvalue_ref m_source; // the frozen container, owned
+} jlazy_ref;
+
 typedef struct PJSON_LOCAL {
 	// m_value should always be the first field
 	jvalue m_value;
@@ -77,6 +134,63 @@ typedef struct PJSON_LOCAL {
 
 _Static_assert(offsetof(jstring, m_value) == 0, "jstring and jstring.m_value should have the same addresses");
 
+/**
+ * Key string with its hash computed beforehand (see jkey_create), the text follows it.
+ * The deallocator of the string tells the keys from the other strings.
+ */
+struct jkey {
+	// m_string should always be the first field
+	jstring m_string;
+	guint m_hash; // djb2 of the text, the objects and the shapes hash their keys the same way
+	const char *m_json; // the text as JSON, for the interned keys only (see jkey_intern)
+};
+
+_Static_assert(offsetof(struct jkey, m_string) == 0, "jkey and jkey.m_string should have the same addresses");
+
+// Deallocators of the keys, they have nothing to free: the text is allocated along with the key
+PJSON_LOCAL void jkey_text_dealloc(void *text);
+PJSON_LOCAL void jkey_interned_dealloc(void *text);
+
+/**
+ * @return The key handle the string belongs to, or NULL for any other string
+ */
+static inline const struct jkey *jkey_of(jvalue_ref str)
+{
+	jdeallocator dealloc = ((jstring *) str)->m_dealloc;
+	return dealloc == jkey_text_dealloc || dealloc == jkey_interned_dealloc ? (const struct jkey *) str : NULL;
+}
+
+// The interned keys live as long as the process, they are shared like jnull()
+static inline bool jis_interned_key(jvalue_ref val)
+{
+	return val->m_type == JV_STR && ((jstring *) val)->m_dealloc == jkey_interned_dealloc;
+}
+
+// The text of an interned key as JSON, it's shared between the threads like jscalar_text
+static inline const char *jkey_interned_text(jvalue_ref val)
+{
+	return jis_interned_key(val) ? ((const struct jkey *) val)->m_json : NULL;
+}
+
+typedef enum {
+	PACKED_I64,
+	PACKED_F64,
+} JPackedType;
+
+/**
+ * Unboxed elements of an array of numbers built by the DOM parser. Only the numbers which
+ * text can be restored exactly are packed, see jarray_append_packed.
+ */
+typedef struct PJSON_LOCAL {
+	JPackedType m_type;
+	ssize_t m_capacity;
+	union {
+		int64_t *i64;
+		double *f64;
+	} m_data;
+	jvalue_ref *m_boxed; // elements handed out by jarray_get, NULL until the first one
+} jpacked;
+
 typedef struct PJSON_LOCAL {
 	// m_value should always be the first field
 	jvalue m_value;
@@ -84,22 +198,176 @@ typedef struct PJSON_LOCAL {
 	jvalue_ref *m_bigBucket;
 	ssize_t m_size;
 	ssize_t m_capacity;
+	bool m_blockBucket; // m_bigBucket is a part of the block of the array, it's never freed
+	uint32_t m_version; // changes with the elements, but not with appending (see jarray_build_index)
+	jpacked *m_packed;  // the elements are stored here instead of the buckets
+	jlazy_ref m_lazy;
 } jarray;
 
 _Static_assert(offsetof(jarray, m_value) == 0, "jarray and jarray.m_value should have the same addresses");
 
+typedef struct jshape jshape;
+
 typedef struct PJSON_LOCAL {
 	// m_value should always be the first field
 	jvalue m_value;
-	GHashTable *m_members;
+	GHashTable *m_members; // NULL until a lazy object is materialized, or if the object is shaped
+	jshape *m_shape;       // the keys shared with similar objects, their values are in m_slots
+	jvalue_ref *m_slots;
+	size_t m_slotsCapacity;
+	bool m_blockSlots;     // m_slots is a part of the block of the object, it's never freed
+	jlazy_ref m_lazy;
 } jobject;
 
 _Static_assert(offsetof(jobject, m_value) == 0, "jobject and jobject.m_value should have the same addresses");
 
 extern PJSON_LOCAL jvalue JNULL;
 
+/**
+ * Position of a walk over the members of an object or the elements of an array, a frame of
+ * the walks over the trees without recursion (see jstack). The next child is prefetched while
+ * the current one is visited.
+ */
+typedef struct PJSON_LOCAL {
+	jvalue_ref m_container;
+	jobject_iter m_members; // iterates the members of an object
+	ssize_t m_index;        // position of the current child, the slot of a shaped object
+	ssize_t m_size;
+} jchild_iter;
+
+PJSON_LOCAL void jchild_iter_init(jchild_iter *iter, jvalue_ref container);
+
+/**
+ * Advance to the next child of the container
+ * @param iter The position initialized by jchild_iter_init
+ * @param child The member of an object, or the element of an array with the NULL key
+ * @return false after the last child
+ */
+PJSON_LOCAL bool jchild_iter_next(jchild_iter *iter, jobject_key_value *child);
+
+/**
+ * Check if the value is one of the static constants, never allocated or released
+ */
+PJSON_LOCAL bool jis_const(jvalue_ref val);
+
+/**
+ * The text of a shared boolean or small integer (see jboolean_create, jnumber_create_i64)
+ * @return NULL for any other value
+ */
+PJSON_LOCAL const char *jscalar_text(jvalue_ref val);
+
 PJSON_LOCAL bool jobject_init(jobject *obj);
 
+/**
+ * Create an object which keys are kept in a shape shared with similar objects
+ *
+ * The object stays shaped while it gets the keys in the same order as the other objects of
+ * the shape did, and becomes a regular one with a hash table otherwise.
+ *
+ * @param shape The shape without keys, see jshape_create and jshape_root
+ * @param capacityHint The expected number of keys
+ */
+PJSON_LOCAL jvalue_ref jobject_create_shaped(jshape *shape, size_t capacityHint);
+
+inline static bool jis_shaped(jvalue_ref val)
+{
+	return val->m_type == JV_OBJECT && ((jobject *) val)->m_shape;
+}
+
+// Beyond that the objects aren't shaped
+#define JSHAPE_MAX_KEYS 64
+#define JSHAPE_MAX_TRANSITIONS 8
+
+/**
+ * Create a shape without keys, the root of the shapes of similar objects
+ */
+PJSON_LOCAL jshape *jshape_create(void);
+
+PJSON_LOCAL jshape *jshape_copy(jshape *shape);
+
+PJSON_LOCAL void jshape_release(jshape *shape);
+
+/**
+ * Release several references to the shape at once
+ */
+PJSON_LOCAL void jshape_release_refs(jshape *shape, size_t refs);
+
+PJSON_LOCAL size_t jshape_size(const jshape *shape);
+
+PJSON_LOCAL jvalue_ref jshape_key(const jshape *shape, size_t slot);
+
+PJSON_LOCAL jshape *jshape_root(jshape *shape);
+
+/**
+ * Find the slot of the key
+ * @return The slot, or -1 if the shape doesn't have the key
+ */
+PJSON_LOCAL ssize_t jshape_lookup(const jshape *shape, raw_buffer key);
+
+/**
+ * Find the slot of the key string, the same as jshape_lookup but the string the shape has is
+ * found by its address, and the hash of a jkey_create key isn't computed again
+ */
+PJSON_LOCAL ssize_t jshape_find(const jshape *shape, jvalue_ref key);
+
+/**
+ * Get the shape with one more key, shared with the other objects which got the same key
+ * @return A new reference to the shape, or NULL if the object should leave the shapes
+ */
+PJSON_LOCAL jshape *jshape_transition(jshape *shape, jvalue_ref key);
+
+PJSON_LOCAL jvalue_ref jobject_create_lazy(jlazy_doc *doc, size_t node);
+
+PJSON_LOCAL jvalue_ref jarray_create_lazy(jlazy_doc *doc, size_t node);
+
+/**
+ * Check the structure of well-formed JSON input and return its root, with the containers
+ * materialized on demand.
+ * @param input The JSON text
+ * @param noCopy The input outlives the DOM and doesn't change, otherwise it is copied
+ * @return The root value or jinvalid() if the input is malformed
+ */
+PJSON_LOCAL jvalue_ref jlazy_parse(raw_buffer input, bool noCopy);
+
+/**
+ * Fill a lazy object or array with its direct members. Child containers stay lazy.
+ */
+PJSON_LOCAL void jlazy_materialize(jvalue_ref container);
+
+/**
+ * Drop the link of a lazy container to its document or source, if it wasn't materialized
+ */
+PJSON_LOCAL void jlazy_release(jvalue_ref container);
+
+/**
+ * Create another lazy container sharing the same document content or source
+ */
+PJSON_LOCAL jvalue_ref jlazy_duplicate(jvalue_ref container);
+
+/**
+ * Create a copy of the frozen container, filled on the first access
+ */
+PJSON_LOCAL jvalue_ref jview_create(jvalue_ref source);
+
+/**
+ * Deep copy sharing nothing with the value but the constants, not even the
+ * members of the frozen containers. The copy may be handed to another thread
+ * while the value is still in use (e.g. the defaults of a shared schema).
+ */
+PJSON_LOCAL jvalue_ref jvalue_duplicate_private(jvalue_ref val);
+
+/**
+ * Fill the copy of a frozen container with copies of its members. The child containers
+ * become copies filled on access in turn, the strings, numbers and booleans are shared.
+ */
+PJSON_LOCAL void jview_materialize(jvalue_ref container);
+
+/**
+ * Drop a value relocated by jvalue_compact from its block (see jvalue_block), the last one
+ * frees the block. The content of the value should be destroyed already.
+ */
+PJSON_LOCAL void jblock_release(jblock *block);
+
 extern PJSON_LOCAL int64_t jnumber_deref_i64(jvalue_ref num);
 
 extern PJSON_LOCAL bool jboolean_deref_to_value(jvalue_ref boolean);
@@ -120,4 +388,101 @@ inline static jarray* jarray_deref(jvalue_ref array) { return (jarray*)array; }
 
 inline static jobject* jobject_deref(jvalue_ref array) { return (jobject*)array; }
 
+inline static jvalue_ref *jarray_slot(jarray *arr, ssize_t index)
+{
+	if (OUTSIDE_ARR_BUCKET_RANGE(index))
+		return &arr->m_bigBucket[index - ARRAY_BUCKET_SIZE];
+	return &arr->m_smallBucket[index];
+}
+
+inline static bool jis_packed(jvalue_ref val)
+{
+	return val->m_type == JV_ARRAY && jarray_deref(val)->m_packed;
+}
+
+/**
+ * Append the number to the array without creating a value for it. The array should be empty
+ * or packed already.
+ *
+ * The number is packed if it's an integer, or if it's a decimal fraction of at most 15
+ * significant digits without exponent or trailing zeros: jarray_get then restores exactly
+ * the same text. The integers become doubles if a fraction follows them.
+ *
+ * @param arr The array built by the DOM parser
+ * @param number The text of a valid JSON number
+ * @return false if the number can't be packed, the caller appends it as a value then
+ */
+PJSON_LOCAL bool jarray_append_packed(jvalue_ref arr, raw_buffer number);
+
+/**
+ * The element of a packed array, boxed on the first access and owned by the array
+ */
+PJSON_LOCAL jvalue_ref jpacked_get(jvalue_ref arr, ssize_t index);
+
+/**
+ * Move the elements of a packed array into the buckets, before the array is modified
+ */
+PJSON_LOCAL bool jpacked_unpack(jvalue_ref arr);
+
+/**
+ * Free the packed elements and the ones handed out
+ */
+PJSON_LOCAL void jpacked_release(jvalue_ref arr);
+
+/**
+ * Shrink the packed storage to the elements
+ */
+PJSON_LOCAL void jpacked_shrink(jvalue_ref arr);
+
+PJSON_LOCAL bool jpacked_equal(jvalue_ref arr, jvalue_ref other);
+
+PJSON_LOCAL bool jpacked_has_duplicates(jvalue_ref arr);
+
+/**
+ * Fill the empty array with a copy of the packed elements of the source
+ */
+PJSON_LOCAL bool jpacked_copy(jvalue_ref arr, jvalue_ref source);
+
+PJSON_LOCAL jvalue_ref jpacked_duplicate(jvalue_ref arr);
+
+/**
+ * Restore the text of the packed element
+ * @return The length of the text, buf should fit JPACKED_TEXT_MAX bytes
+ */
+#define JPACKED_TEXT_MAX 32
+PJSON_LOCAL size_t jpacked_text(jvalue_ref arr, ssize_t index, char *buf);
+
+inline static jlazy_ref* jlazy_deref(jvalue_ref val)
+{
+	if (val->m_type == JV_OBJECT)
+		return &jobject_deref(val)->m_lazy;
+	if (val->m_type == JV_ARRAY)
+		return &jarray_deref(val)->m_lazy;
+	return NULL;
+}
+
+inline static bool jis_lazy(jvalue_ref val)
+{
+	jlazy_ref *lazy = jlazy_deref(val);
+	return lazy && (lazy->m_doc || lazy->m_source);
+}
+
+// The frozen container the value is a copy of, or the value itself if it was materialized
+inline static jvalue_ref jview_origin(jvalue_ref val)
+{
+	jlazy_ref *lazy = jlazy_deref(val);
+	return lazy && lazy->m_source ? lazy->m_source : val;
+}
+
+// Every accessor to the members of a container goes through it
+inline static void jlazy_ensure(jvalue_ref val)
+{
+	if (UNLIKELY(jis_lazy(val))) {
+		if (jlazy_deref(val)->m_source)
+			jview_materialize(val);
+		else
+			jlazy_materialize(val);
+	}
+}
+
 #endif /* JOBJECT_INTERNAL_H_ */
@@ -0,0 +1,241 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jparse_async.h>
+#include <jparse_stream.h>
+#include <jobject.h>
+#include "liblog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+// The input is read into a buffer on the stack of jparse_async_dispatch, so idle parsers
+// take no memory for it
+#define ASYNC_READ_SIZE (8 * 1024)
+
+// Reads per dispatch, the other descriptors of the loop get their turn after that
+#define ASYNC_MAX_READS 8
+
+struct jparse_async {
+	int m_fd;
+	int m_epfd;                     // -1 unless watched by jparse_async_epoll_add
+	JSchemaInfo m_schemaInfo;       // referenced by the parser
+	jdomparser_ref m_dom;           // either the DOM or the SAX parser, NULL once finished
+	jsaxparser_ref m_sax;
+	jparse_async_callback m_callback;
+	void *m_ctxt;
+};
+
+static jparse_async_ref jparse_async_new(int fd, JSchemaInfoRef schemaInfo, jparse_async_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_NULL(schemaInfo);
+	CHECK_POINTER_RETURN_NULL(callback);
+
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		PJ_LOG_ERR("PBNJSON_ASYNC_FD_ERR", 1, PMLOGKFV("ERRNO", "%d", errno), "Failed to make the descriptor non-blocking");
+		return NULL;
+	}
+
+	jparse_async_ref async = calloc(1, sizeof(struct jparse_async));
+	CHECK_POINTER_MSG_RETURN_NULL(async, "Out of memory");
+
+	async->m_fd = fd;
+	async->m_epfd = -1;
+	async->m_schemaInfo = *schemaInfo;
+	async->m_callback = callback;
+	async->m_ctxt = ctxt;
+	return async;
+}
+
+jparse_async_ref jparse_async_dom_new(int fd, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo,
+                                      jparse_async_callback callback, void *ctxt)
+{
+	jparse_async_ref async = jparse_async_new(fd, schemaInfo, callback, ctxt);
+	if (!async)
+		return NULL;
+
+	async->m_dom = jdomparser_create(&async->m_schemaInfo, optimizationMode);
+	if (!async->m_dom) {
+		free(async);
+		return NULL;
+	}
+	return async;
+}
+
+jparse_async_ref jparse_async_sax_new(int fd, JSchemaInfoRef schemaInfo,
+                                      PJSAXCallbacks *parserCallbacks, void *parserCtxt,
+                                      jparse_async_callback callback, void *ctxt)
+{
+	jparse_async_ref async = jparse_async_new(fd, schemaInfo, callback, ctxt);
+	if (!async)
+		return NULL;
+
+	async->m_sax = jsaxparser_create(&async->m_schemaInfo, parserCallbacks, parserCtxt);
+	if (!async->m_sax) {
+		free(async);
+		return NULL;
+	}
+	return async;
+}
+
+static void jparse_async_release_parser(jparse_async_ref async)
+{
+	if (async->m_dom)
+		jdomparser_release(&async->m_dom);
+	if (async->m_sax)
+		jsaxparser_release(&async->m_sax);
+	async->m_dom = NULL;
+	async->m_sax = NULL;
+}
+
+// Report the result and drop the parser right away, a finished connection takes no memory for it
+static void jparse_async_finish(jparse_async_ref async, bool parsed, const char *error)
+{
+	if (async->m_epfd != -1) {
+		epoll_ctl(async->m_epfd, EPOLL_CTL_DEL, async->m_fd, NULL);
+		async->m_epfd = -1;
+	}
+
+	if (!error && !parsed)
+		error = async->m_dom ? jdomparser_get_error(async->m_dom) : jsaxparser_get_error(async->m_sax);
+	if (!error && !parsed)
+		error = "Failed to parse the input";
+
+	jvalue_ref value = NULL;
+	if (async->m_dom)
+		value = error ? jinvalid() : jdomparser_get_result(async->m_dom);
+
+	async->m_callback(async->m_ctxt, value, error);
+
+	j_release(&value);
+	jparse_async_release_parser(async);
+}
+
+bool jparse_async_dispatch(jparse_async_ref async)
+{
+	CHECK_POINTER_RETURN_VALUE(async, false);
+
+	if (!async->m_dom && !async->m_sax)
+		return false;
+
+	char buf[ASYNC_READ_SIZE];
+	for (int reads = 0; reads < ASYNC_MAX_READS; ++reads) {
+		ssize_t len = read(async->m_fd, buf, sizeof(buf));
+		if (len > 0) {
+			bool fed = async->m_dom ? jdomparser_feed(async->m_dom, buf, len)
+			                        : jsaxparser_feed(async->m_sax, buf, len);
+			if (!fed) {
+				jparse_async_finish(async, false, NULL);
+				return false;
+			}
+		} else if (len == 0) {
+			bool parsed = async->m_dom ? jdomparser_end(async->m_dom) : jsaxparser_end(async->m_sax);
+			jparse_async_finish(async, parsed, NULL);
+			return false;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return true;
+		} else if (errno != EINTR) {
+			jparse_async_finish(async, false, g_strerror(errno));
+			return false;
+		}
+	}
+	return true;
+}
+
+bool jparse_async_epoll_add(jparse_async_ref async, int epfd)
+{
+	CHECK_POINTER_RETURN_VALUE(async, false);
+
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data.ptr = async,
+	};
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, async->m_fd, &event) == -1) {
+		PJ_LOG_ERR("PBNJSON_ASYNC_EPOLL_ERR", 1, PMLOGKFV("ERRNO", "%d", errno), "Failed to watch the descriptor");
+		return false;
+	}
+	async->m_epfd = epfd;
+	return true;
+}
+
+typedef struct {
+	GSource m_source;
+	GPollFD m_poll;
+	jparse_async_ref m_async;
+} JParseAsyncSource;
+
+static gboolean async_source_prepare(GSource *source, gint *timeout)
+{
+	*timeout = -1;
+	return FALSE;
+}
+
+static gboolean async_source_check(GSource *source)
+{
+	JParseAsyncSource *s = (JParseAsyncSource *) source;
+	return (s->m_poll.revents & (G_IO_IN | G_IO_HUP | G_IO_ERR)) != 0;
+}
+
+static gboolean async_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	JParseAsyncSource *s = (JParseAsyncSource *) source;
+	return jparse_async_dispatch(s->m_async);
+}
+
+static void async_source_finalize(GSource *source)
+{
+	JParseAsyncSource *s = (JParseAsyncSource *) source;
+	jparse_async_free(s->m_async);
+	s->m_async = NULL;
+}
+
+static GSourceFuncs async_source_funcs = {
+	async_source_prepare,
+	async_source_check,
+	async_source_dispatch,
+	async_source_finalize,
+};
+
+GSource *jparse_async_source_new(jparse_async_ref async)
+{
+	CHECK_POINTER_RETURN_NULL(async);
+
+	GSource *source = g_source_new(&async_source_funcs, sizeof(JParseAsyncSource));
+	JParseAsyncSource *s = (JParseAsyncSource *) source;
+	s->m_async = async;
+	s->m_poll.fd = async->m_fd;
+	s->m_poll.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+	g_source_add_poll(source, &s->m_poll);
+	g_source_set_name(source, "pbnjson async parser");
+	return source;
+}
+
+void jparse_async_free(jparse_async_ref async)
+{
+	if (!async)
+		return;
+
+	if (async->m_epfd != -1)
+		epoll_ctl(async->m_epfd, EPOLL_CTL_DEL, async->m_fd, NULL);
+	jparse_async_release_parser(async);
+	free(async);
+}
@@ -0,0 +1,345 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jparse_stream.h>
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jobject_internal.h"
+#include "jparse_stream_internal.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Records are handed out to the workers in batches to keep lock contention low
+#define LINES_BATCH_SIZE 64
+// Number of batches per worker, that may be parsed ahead of the delivery
+#define LINES_WINDOW_PER_THREAD 4
+
+typedef struct lines_record {
+	const char *str;
+	size_t len;
+	size_t line;
+} lines_record;
+
+typedef struct lines_result {
+	jvalue_ref value;
+	char *error;
+} lines_result;
+
+typedef struct lines_engine {
+	lines_record *records;
+	size_t records_count;
+	size_t batches_count;
+
+	bool dom;
+	JDOMOptimizationFlags optimization;
+	PJSAXCallbacks *sax;
+	void *sax_data;
+	JSchemaInfo schemaInfo;
+
+	// Ring of window * LINES_BATCH_SIZE results, batch b is stored in slot b % window
+	lines_result *results;
+	bool *batch_done;
+	size_t window;
+
+	pthread_mutex_t lock;
+	pthread_cond_t produced;
+	pthread_cond_t consumed;
+	size_t next_batch;
+	size_t delivered;
+	bool stop;
+} lines_engine;
+
+static bool is_blank(const char *str, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		if (str[i] != ' ' && str[i] != '\t' && str[i] != '\r')
+			return false;
+	}
+	return true;
+}
+
+// Split input on newlines, skipping empty lines
+static bool lines_split(lines_engine *e, raw_buffer input)
+{
+	size_t capacity = 0;
+	size_t line = 0;
+	const char *cur = input.m_str;
+	const char *end = input.m_str + input.m_len;
+
+	while (cur < end) {
+		const char *eol = memchr(cur, '\n', end - cur);
+		if (!eol)
+			eol = end;
+		++line;
+
+		if (!is_blank(cur, eol - cur)) {
+			if (e->records_count == capacity) {
+				capacity = capacity ? capacity * 2 : 256;
+				lines_record *records = realloc(e->records, capacity * sizeof(lines_record));
+				CHECK_ALLOC_RETURN_VALUE(records, false);
+				e->records = records;
+			}
+			lines_record *rec = &e->records[e->records_count++];
+			rec->str = cur;
+			rec->len = eol - cur;
+			rec->line = line;
+		}
+
+		cur = eol + 1;
+	}
+
+	e->batches_count = (e->records_count + LINES_BATCH_SIZE - 1) / LINES_BATCH_SIZE;
+	return true;
+}
+
+static char *lines_error(const char *error)
+{
+	return strdup(error ? error : "Unknown error");
+}
+
+static void lines_parse_record(lines_engine *e, const lines_record *rec, lines_result *res)
+{
+	res->value = e->dom ? jinvalid() : NULL;
+	res->error = NULL;
+
+	// The parsers are fed with int lengths, a longer line isn't cut short
+	if (rec->len > INT_MAX) {
+		res->error = lines_error("Line is too long");
+		return;
+	}
+
+	if (e->dom) {
+		struct jdomparser parser;
+		if (!jdomparser_init(&parser, &e->schemaInfo, e->optimization)) {
+			res->error = lines_error("Failed to initialize parser");
+			return;
+		}
+
+		if (jdomparser_feed(&parser, rec->str, rec->len) && jdomparser_end(&parser))
+			res->value = jdomparser_get_result(&parser);
+		else
+			res->error = lines_error(jdomparser_get_error(&parser));
+
+		jdomparser_deinit(&parser);
+	} else {
+		struct jsaxparser parser;
+		if (!jsaxparser_init(&parser, &e->schemaInfo, e->sax, e->sax_data)) {
+			res->error = lines_error("Failed to initialize parser");
+			return;
+		}
+
+		if (!jsaxparser_feed(&parser, rec->str, rec->len) || !jsaxparser_end(&parser))
+			res->error = lines_error(jsaxparser_get_error(&parser));
+
+		jsaxparser_deinit(&parser);
+	}
+}
+
+static void lines_parse_batch(lines_engine *e, size_t batch)
+{
+	lines_result *results = e->results + (batch % e->window) * LINES_BATCH_SIZE;
+	size_t first = batch * LINES_BATCH_SIZE;
+	size_t last = first + LINES_BATCH_SIZE;
+	if (last > e->records_count)
+		last = e->records_count;
+
+	for (size_t i = first; i < last; ++i)
+		lines_parse_record(e, &e->records[i], &results[i - first]);
+}
+
+static void lines_release_batch(lines_engine *e, size_t batch)
+{
+	lines_result *results = e->results + (batch % e->window) * LINES_BATCH_SIZE;
+	size_t count = e->records_count - batch * LINES_BATCH_SIZE;
+	if (count > LINES_BATCH_SIZE)
+		count = LINES_BATCH_SIZE;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (results[i].value)
+			j_release(&results[i].value);
+		free(results[i].error);
+		results[i].error = NULL;
+	}
+}
+
+static void *lines_worker(void *ctxt)
+{
+	lines_engine *e = (lines_engine *)ctxt;
+
+	for (;;) {
+		pthread_mutex_lock(&e->lock);
+		while (!e->stop && e->next_batch < e->batches_count && e->next_batch >= e->delivered + e->window)
+			pthread_cond_wait(&e->consumed, &e->lock);
+		if (e->stop || e->next_batch >= e->batches_count) {
+			pthread_mutex_unlock(&e->lock);
+			break;
+		}
+		size_t batch = e->next_batch++;
+		pthread_mutex_unlock(&e->lock);
+
+		lines_parse_batch(e, batch);
+
+		pthread_mutex_lock(&e->lock);
+		e->batch_done[batch % e->window] = true;
+		pthread_cond_signal(&e->produced);
+		pthread_mutex_unlock(&e->lock);
+	}
+
+	return NULL;
+}
+
+// Deliver results in input order. Returns false if any record failed or the callback stopped processing.
+static bool lines_deliver(lines_engine *e, int workers, jparse_lines_callback callback, void *ctxt)
+{
+	bool result = true;
+
+	for (size_t batch = 0; batch < e->batches_count; ++batch) {
+		size_t slot = batch % e->window;
+
+		if (workers) {
+			pthread_mutex_lock(&e->lock);
+			while (!e->batch_done[slot])
+				pthread_cond_wait(&e->produced, &e->lock);
+			pthread_mutex_unlock(&e->lock);
+		} else {
+			lines_parse_batch(e, batch);
+		}
+
+		bool stop = false;
+		lines_result *results = e->results + slot * LINES_BATCH_SIZE;
+		size_t first = batch * LINES_BATCH_SIZE;
+		for (size_t i = first; i < e->records_count && i < first + LINES_BATCH_SIZE && !stop; ++i) {
+			lines_result *res = &results[i - first];
+			if (res->error)
+				result = false;
+			if (callback && !callback(ctxt, e->records[i].line, res->value, res->error))
+				stop = true;
+		}
+		lines_release_batch(e, batch);
+
+		pthread_mutex_lock(&e->lock);
+		e->batch_done[slot] = false;
+		e->delivered = batch + 1;
+		if (stop)
+			e->stop = true;
+		pthread_cond_broadcast(&e->consumed);
+		pthread_mutex_unlock(&e->lock);
+
+		if (stop)
+			return false;
+	}
+
+	return result;
+}
+
+static bool lines_parse(lines_engine *e, raw_buffer input, JSchemaInfoRef schemaInfo, int threads,
+                        jparse_lines_callback callback, void *ctxt)
+{
+	// Errors are reported through the callback. The error handlers of the
+	// user aren't expected to be called from the worker threads.
+	e->schemaInfo.m_schema = schemaInfo->m_schema;
+	e->schemaInfo.m_resolver = schemaInfo->m_resolver;
+	e->schemaInfo.m_errHandler = NULL;
+
+	if (!lines_split(e, input)) {
+		free(e->records);
+		return false;
+	}
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
+	if ((size_t)threads > e->batches_count)
+		threads = e->batches_count;
+	// The calling thread parses by itself if there is nothing to parallelize
+	if (threads <= 1)
+		threads = 0;
+
+	e->window = threads ? threads * LINES_WINDOW_PER_THREAD : 1;
+	e->results = calloc(e->window * LINES_BATCH_SIZE, sizeof(lines_result));
+	e->batch_done = calloc(e->window, sizeof(bool));
+	if (!e->results || !e->batch_done) {
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Out of memory");
+		free(e->results);
+		free(e->batch_done);
+		free(e->records);
+		return false;
+	}
+
+	pthread_mutex_init(&e->lock, NULL);
+	pthread_cond_init(&e->produced, NULL);
+	pthread_cond_init(&e->consumed, NULL);
+
+	pthread_t *workers = threads ? malloc(threads * sizeof(pthread_t)) : NULL;
+	int started = 0;
+	for (; workers && started < threads; ++started) {
+		if (pthread_create(&workers[started], NULL, lines_worker, e) != 0)
+			break;
+	}
+
+	bool result = lines_deliver(e, started, callback, ctxt);
+
+	for (int i = 0; i < started; ++i)
+		pthread_join(workers[i], NULL);
+
+	// Drop the results parsed ahead of the stopped delivery
+	for (size_t batch = e->delivered; batch < e->next_batch; ++batch)
+		lines_release_batch(e, batch);
+
+	pthread_cond_destroy(&e->consumed);
+	pthread_cond_destroy(&e->produced);
+	pthread_mutex_destroy(&e->lock);
+
+	free(workers);
+	free(e->batch_done);
+	free(e->results);
+	free(e->records);
+
+	return result;
+}
+
+bool jdom_parse_lines(raw_buffer input, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo,
+                      int threads, jparse_lines_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_VALUE(schemaInfo, false);
+	CHECK_POINTER_RETURN_VALUE(callback, false);
+
+	lines_engine e = { 0 };
+	e.dom = true;
+	e.optimization = optimizationMode;
+
+	return lines_parse(&e, input, schemaInfo, threads, callback, ctxt);
+}
+
+bool jsax_parse_lines(PJSAXCallbacks *parser, raw_buffer input, JSchemaInfoRef schemaInfo, void *data,
+                      int threads, jparse_lines_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_VALUE(schemaInfo, false);
+
+	lines_engine e = { 0 };
+	e.dom = false;
+	e.sax = parser;
+	e.sax_data = data;
+
+	return lines_parse(&e, input, schemaInfo, threads, callback, ctxt);
+}
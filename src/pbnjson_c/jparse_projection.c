@@ -0,0 +1,479 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jparse_stream.h>
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jobject_internal.h"
+#include "jparse_stream_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Tree of the projected JSON Pointer paths. Every node is one reference token of a path.
+ */
+typedef struct projection_node {
+	char *key;        // unescaped reference token
+	size_t len;
+	long index;       // array index, if the token is a number, -1 otherwise
+	bool selected;    // the whole subtree is projected
+	struct projection_node *children;
+	size_t count;
+} projection_node;
+
+typedef struct projection_frame {
+	const projection_node *node;
+	long index;       // index of the next element for arrays, -1 for objects
+} projection_frame;
+
+typedef struct projection {
+	projection_node root;
+
+	// Receiver of the projected events
+	PJSAXCallbacks *callbacks;
+	PJSAXContext target;
+
+	// Containers on the path to a selected subtree
+	projection_frame *frames;
+	size_t depth;
+	size_t capacity;
+
+	// Nesting level within a skipped or selected subtree
+	size_t skip_depth;
+	size_t select_depth;
+
+	// The key is forwarded only when it turns out its value is projected
+	const projection_node *key_node;
+	char *key;
+	size_t key_len;
+	size_t key_capacity;
+} projection;
+
+typedef enum {
+	PROJECT_SKIP,
+	PROJECT_FORWARD,
+	PROJECT_ERROR,
+} ProjectionAction;
+
+typedef enum {
+	PROJECT_SCALAR,
+	PROJECT_OBJECT,
+	PROJECT_ARRAY,
+} ProjectionValue;
+
+static void projection_node_clear(projection_node *node)
+{
+	for (size_t i = 0; i < node->count; ++i) {
+		projection_node_clear(&node->children[i]);
+		free(node->children[i].key);
+	}
+	free(node->children);
+	node->children = NULL;
+	node->count = 0;
+}
+
+static long projection_index(const char *key, size_t len)
+{
+	if (len == 0 || len > 9 || (len > 1 && key[0] == '0'))
+		return -1;
+
+	long index = 0;
+	for (size_t i = 0; i < len; ++i) {
+		if (key[i] < '0' || key[i] > '9')
+			return -1;
+		index = index * 10 + (key[i] - '0');
+	}
+	return index;
+}
+
+static projection_node *projection_node_child(projection_node *node, const char *key, size_t len)
+{
+	for (size_t i = 0; i < node->count; ++i) {
+		if (node->children[i].len == len && memcmp(node->children[i].key, key, len) == 0)
+			return &node->children[i];
+	}
+
+	projection_node *children = realloc(node->children, (node->count + 1) * sizeof(projection_node));
+	CHECK_ALLOC_RETURN_NULL(children);
+	node->children = children;
+
+	projection_node *child = &node->children[node->count];
+	memset(child, 0, sizeof(projection_node));
+	child->key = strndup(key, len);
+	CHECK_ALLOC_RETURN_NULL(child->key);
+	child->len = len;
+	child->index = projection_index(key, len);
+	++node->count;
+
+	return child;
+}
+
+static bool projection_add_path(projection *p, const char *path)
+{
+	if (*path != '\0' && *path != '/') {
+		PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", path), "JSON Pointer should start with '/'");
+		return false;
+	}
+
+	char *key = malloc(strlen(path) + 1);
+	CHECK_ALLOC_RETURN_VALUE(key, false);
+
+	projection_node *node = &p->root;
+	// Subpaths of a selected path are projected anyway
+	while (*path && !node->selected) {
+		const char *token = path + 1;
+		const char *end = strchrnul(token, '/');
+
+		size_t len;
+		if (!jpointer_unescape(token, end - token, key, &len)) {
+			PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", path), "Invalid escape sequence in JSON Pointer");
+			free(key);
+			return false;
+		}
+
+		node = projection_node_child(node, key, len);
+		if (!node) {
+			free(key);
+			return false;
+		}
+		path = end;
+	}
+	free(key);
+
+	node->selected = true;
+	projection_node_clear(node);
+
+	return true;
+}
+
+static void projection_clear(projection *p)
+{
+	projection_node_clear(&p->root);
+	free(p->frames);
+	free(p->key);
+}
+
+static bool projection_init(projection *p, const char * const *paths, size_t pathsCount,
+                            PJSAXCallbacks *callbacks, void *data)
+{
+	memset(p, 0, sizeof(projection));
+	p->root.index = -1;
+	p->callbacks = callbacks;
+	p->target.ctxt = data;
+
+	for (size_t i = 0; i < pathsCount; ++i) {
+		if (!projection_add_path(p, paths[i])) {
+			projection_clear(p);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static const projection_node *projection_find(const projection_node *node, long index)
+{
+	for (size_t i = 0; i < node->count; ++i) {
+		if (node->children[i].index == index)
+			return &node->children[i];
+	}
+	return NULL;
+}
+
+static ProjectionAction projection_value(projection *p, ProjectionValue type)
+{
+	if (p->skip_depth) {
+		if (type != PROJECT_SCALAR)
+			++p->skip_depth;
+		return PROJECT_SKIP;
+	}
+
+	if (p->select_depth) {
+		if (type != PROJECT_SCALAR)
+			++p->select_depth;
+		return PROJECT_FORWARD;
+	}
+
+	const projection_node *node = &p->root;
+	projection_frame *frame = p->depth ? &p->frames[p->depth - 1] : NULL;
+	if (frame)
+		node = frame->index < 0 ? p->key_node : projection_find(frame->node, frame->index++);
+
+	// Intermediate nodes of the paths make sense only for containers
+	if (!node || (!node->selected && type == PROJECT_SCALAR)) {
+		if (type != PROJECT_SCALAR)
+			p->skip_depth = 1;
+		return PROJECT_SKIP;
+	}
+
+	if (frame && frame->index < 0 && p->callbacks->m_objKey &&
+	    !p->callbacks->m_objKey(&p->target, p->key, p->key_len))
+	{
+		return PROJECT_ERROR;
+	}
+
+	if (node->selected) {
+		if (type != PROJECT_SCALAR)
+			p->select_depth = 1;
+		return PROJECT_FORWARD;
+	}
+
+	if (p->depth == p->capacity) {
+		size_t capacity = p->capacity ? p->capacity * 2 : 8;
+		projection_frame *frames = realloc(p->frames, capacity * sizeof(projection_frame));
+		CHECK_ALLOC_RETURN_VALUE(frames, PROJECT_ERROR);
+		p->frames = frames;
+		p->capacity = capacity;
+	}
+	p->frames[p->depth].node = node;
+	p->frames[p->depth].index = type == PROJECT_ARRAY ? 0 : -1;
+	++p->depth;
+
+	return PROJECT_FORWARD;
+}
+
+static ProjectionAction projection_end(projection *p)
+{
+	if (p->skip_depth) {
+		--p->skip_depth;
+		return PROJECT_SKIP;
+	}
+
+	if (p->select_depth)
+		--p->select_depth;
+	else
+		--p->depth;
+	return PROJECT_FORWARD;
+}
+
+static inline projection *getProjection(JSAXContextRef ctxt)
+{
+	return (projection *)jsax_getContext(ctxt);
+}
+
+static int projection_obj_start(JSAXContextRef ctxt)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_OBJECT)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_objStart || p->callbacks->m_objStart(&p->target);
+	default:
+		return 0;
+	}
+}
+
+static int projection_obj_key(JSAXContextRef ctxt, const char *key, size_t keyLen)
+{
+	projection *p = getProjection(ctxt);
+	if (p->skip_depth)
+		return 1;
+
+	if (p->select_depth)
+		return !p->callbacks->m_objKey || p->callbacks->m_objKey(&p->target, key, keyLen);
+
+	const projection_node *node = p->frames[p->depth - 1].node;
+	p->key_node = NULL;
+	for (size_t i = 0; i < node->count; ++i) {
+		if (node->children[i].len == keyLen && memcmp(node->children[i].key, key, keyLen) == 0) {
+			p->key_node = &node->children[i];
+			break;
+		}
+	}
+
+	// Keep the key until its value is known to be projected. The parser doesn't
+	// guarantee that the key stays valid after the callback.
+	if (p->key_node) {
+		if (keyLen >= p->key_capacity) {
+			char *buf = realloc(p->key, keyLen + 1);
+			CHECK_ALLOC_RETURN_VALUE(buf, 0);
+			p->key = buf;
+			p->key_capacity = keyLen + 1;
+		}
+		memcpy(p->key, key, keyLen);
+		p->key_len = keyLen;
+	}
+
+	return 1;
+}
+
+static int projection_obj_end(JSAXContextRef ctxt)
+{
+	projection *p = getProjection(ctxt);
+	if (projection_end(p) == PROJECT_SKIP)
+		return 1;
+	return !p->callbacks->m_objEnd || p->callbacks->m_objEnd(&p->target);
+}
+
+static int projection_arr_start(JSAXContextRef ctxt)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_ARRAY)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_arrStart || p->callbacks->m_arrStart(&p->target);
+	default:
+		return 0;
+	}
+}
+
+static int projection_arr_end(JSAXContextRef ctxt)
+{
+	projection *p = getProjection(ctxt);
+	if (projection_end(p) == PROJECT_SKIP)
+		return 1;
+	return !p->callbacks->m_arrEnd || p->callbacks->m_arrEnd(&p->target);
+}
+
+static int projection_string(JSAXContextRef ctxt, const char *string, size_t stringLen)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_SCALAR)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_string || p->callbacks->m_string(&p->target, string, stringLen);
+	default:
+		return 0;
+	}
+}
+
+static int projection_number(JSAXContextRef ctxt, const char *number, size_t numberLen)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_SCALAR)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_number || p->callbacks->m_number(&p->target, number, numberLen);
+	default:
+		return 0;
+	}
+}
+
+static int projection_boolean(JSAXContextRef ctxt, bool value)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_SCALAR)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_boolean || p->callbacks->m_boolean(&p->target, value);
+	default:
+		return 0;
+	}
+}
+
+static int projection_null(JSAXContextRef ctxt)
+{
+	projection *p = getProjection(ctxt);
+	switch (projection_value(p, PROJECT_SCALAR)) {
+	case PROJECT_SKIP:
+		return 1;
+	case PROJECT_FORWARD:
+		return !p->callbacks->m_null || p->callbacks->m_null(&p->target);
+	default:
+		return 0;
+	}
+}
+
+static PJSAXCallbacks projection_callbacks = {
+	projection_obj_start,
+	projection_obj_key,
+	projection_obj_end,
+	projection_arr_start,
+	projection_arr_end,
+	projection_string,
+	projection_number,
+	projection_boolean,
+	projection_null
+};
+
+static PJSAXCallbacks dom_projection_callbacks = {
+	dom_object_start,
+	dom_object_key,
+	dom_object_end,
+	dom_array_start,
+	dom_array_end,
+	dom_string,
+	dom_number,
+	dom_boolean,
+	dom_null
+};
+
+static bool projection_parse(projection *p, raw_buffer input)
+{
+	// The document is only checked to be well-formed, a schema can't be
+	// applied to the document with subtrees removed
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	struct jsaxparser parser;
+	if (!jsaxparser_init(&parser, &schemaInfo, &projection_callbacks, p))
+		return false;
+
+	bool result = jsaxparser_feed(&parser, input.m_str, input.m_len) && jsaxparser_end(&parser);
+	if (!result)
+		PJ_LOG_WARN("PBNJSON_PROJECTION_ERR", 0, "Failed to parse the document for projection");
+
+	jsaxparser_deinit(&parser);
+
+	return result;
+}
+
+jvalue_ref jdom_parse_projection(raw_buffer input, const char * const *paths, size_t pathsCount)
+{
+	DomInfo topLevelContext = { 0 };
+
+	projection p;
+	if (!projection_init(&p, paths, pathsCount, &dom_projection_callbacks, &topLevelContext))
+		return jinvalid();
+
+	jvalue_ref result = jinvalid();
+	if (projection_parse(&p, input) && topLevelContext.m_value) {
+		result = topLevelContext.m_value;
+		topLevelContext.m_value = NULL;
+	}
+
+	if (jsax_getContext(&p.target) != &topLevelContext)
+		dom_cleanup(jsax_getContext(&p.target), &topLevelContext);
+	j_release(&topLevelContext.m_value);
+
+	projection_clear(&p);
+
+	return result;
+}
+
+bool jsax_parse_projection(PJSAXCallbacks *parser, raw_buffer input, const char * const *paths, size_t pathsCount,
+                           void *data)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+
+	projection p;
+	if (!projection_init(&p, paths, pathsCount, parser, data))
+		return false;
+
+	bool result = projection_parse(&p, input);
+
+	projection_clear(&p);
+
+	return result;
+}
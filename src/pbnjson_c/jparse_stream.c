@@ -25,8 +25,12 @@
 #include "jobject_internal.h"
 #include "jparse_stream_internal.h"
 #include "jtraverse.h"
+#include "jvalue/reclaim.h"
+#include "jvalue/stack.h"
+#include "jvalue/utf8.h"
 #include <assert.h>
 #include <errno.h>
+#include <stddef.h>
 #include <pthread.h>
 #include <string.h>
 
@@ -35,9 +39,22 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 
 #define DOM_POOL_SIZE 4
 
+// jdom_parse_file reads files that aren't mapped into memory by chunks of this size
+#define FILE_CHUNK_SIZE (64 * 1024)
+
+// Strings that can't reference the input are copied into chunks of this size,
+// the longer ones are allocated separately
+#define DOM_ARENA_CHUNK_SIZE 4096
+#define DOM_ARENA_MAX_STRING (DOM_ARENA_CHUNK_SIZE / 8)
+
+// jsaxparser_feed_ex passes the input to yajl by slices of this size to be able to pause
+// between them, at most one slice is parsed ahead while paused
+#define PAUSE_SLICE_SIZE 4096
+
 //Dummy PJSAXCallbacks for DOM parsing
 static int dummy_dom_boolean(void *context, int value) { return 1; }
 static int dummy_dom_string(void *context, const char *string, yajl_size_t len) { return 1; }
@@ -60,26 +77,84 @@ static yajl_callbacks no_callbacks =
 
 static bool jsax_parse_internal(PJSAXCallbacks *parser, raw_buffer input, JSchemaInfoRef schemaInfo, void **ctxt);
 
-static bool file_size(int fd, off_t *s)
+struct DomArenaChunk {
+	int32_t m_refCnt; // one per string allocated in the chunk, one while the parser appends to it
+	size_t m_used;
+	char m_data[DOM_ARENA_CHUNK_SIZE];
+};
+
+static void dom_arena_chunk_release(DomArenaChunk *chunk)
 {
-	struct stat finfo;
-	if (0 != fstat(fd, &finfo)) {
-		return false;
+	// The strings of the released documents may be freed by the reclaiming threads
+	if (chunk && jrefcnt_add(&chunk->m_refCnt, -1) == 0)
+		free(chunk);
+}
+
+// Every string in the arena is preceded by the pointer to its chunk
+static void dom_arena_string_free(void *str)
+{
+	DomArenaChunk *chunk;
+	memcpy(&chunk, (char *)str - sizeof(chunk), sizeof(chunk));
+	dom_arena_chunk_release(chunk);
+}
+
+static char *dom_arena_strdup(DomStrings *strings, const char *str, size_t strLen)
+{
+	size_t needed = sizeof(DomArenaChunk *) + strLen + 1;
+	needed = (needed + sizeof(DomArenaChunk *) - 1) & ~(sizeof(DomArenaChunk *) - 1);
+
+	DomArenaChunk *chunk = strings->m_arena;
+	if (!chunk || chunk->m_used + needed > DOM_ARENA_CHUNK_SIZE) {
+		chunk = malloc(sizeof(DomArenaChunk));
+		CHECK_ALLOC_RETURN_NULL(chunk);
+		chunk->m_refCnt = 1;
+		chunk->m_used = 0;
+		dom_arena_chunk_release(strings->m_arena);
+		strings->m_arena = chunk;
 	}
-	*s = finfo.st_size;
-	return true;
+
+	char *slot = chunk->m_data + chunk->m_used;
+	memcpy(slot, &chunk, sizeof(chunk));
+	slot += sizeof(chunk);
+	memcpy(slot, str, strLen);
+	slot[strLen] = '\0';
+
+	chunk->m_used += needed;
+	jrefcnt_add(&chunk->m_refCnt, 1);
+	return slot;
 }
 
-static inline jvalue_ref createOptimalString(JDOMOptimization opt, const char *str, size_t strLen)
+static inline bool isInputReferenced(JDOMOptimizationFlags flags)
 {
-	if (opt == DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE)
+	return (flags & DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE) == DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE;
+}
+
+static inline bool isInInput(const DomInfo *data, const char *str, size_t strLen)
+{
+	return isInputReferenced(data->m_optInformation) &&
+	       data->m_strings && data->m_strings->m_inputBegin &&
+	       str >= data->m_strings->m_inputBegin && str + strLen <= data->m_strings->m_inputEnd;
+}
+
+static inline jvalue_ref createOptimalString(const DomInfo *data, const char *str, size_t strLen)
+{
+	if (isInInput(data, str, strLen))
 		return jstring_create_nocopy(j_str_to_buffer(str, strLen));
+
+	// yajl decoded the string into its own buffer, which is reused for the next one
+	if (isInputReferenced(data->m_optInformation) && data->m_strings &&
+	    strLen <= DOM_ARENA_MAX_STRING)
+	{
+		char *copy = dom_arena_strdup(data->m_strings, str, strLen);
+		if (copy)
+			return jstring_create_nocopy_full(j_str_to_buffer(copy, strLen), dom_arena_string_free);
+	}
 	return jstring_create_copy(j_str_to_buffer(str, strLen));
 }
 
-static inline jvalue_ref createOptimalNumber(JDOMOptimization opt, const char *str, size_t strLen)
+static inline jvalue_ref createOptimalNumber(const DomInfo *data, const char *str, size_t strLen)
 {
-	if (opt == DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE)
+	if (isInInput(data, str, strLen))
 		return jnumber_create_unsafe(j_str_to_buffer(str, strLen), NULL);
 	return jnumber_create(j_str_to_buffer(str, strLen));
 }
@@ -94,6 +169,69 @@ static inline void changeDOMContext(JSAXContextRef ctxt, DomInfo *domCtxt)
 	jsax_changeContext(ctxt, domCtxt);
 }
 
+// The container of the context is the array which elements are reported one by one
+static inline bool isElementsArray(const DomInfo *data)
+{
+	return UNLIKELY(data->m_elements != NULL) && data->m_prev != NULL &&
+	       data->m_pathMatched == (ssize_t)data->m_elements->m_count && jis_array(data->m_prev->m_value);
+}
+
+static int dom_report_element(const DomInfo *data, jvalue_ref value)
+{
+	bool result = data->m_elements->m_callback(data->m_elements->m_ctxt, value);
+	j_release(&value);
+	return result;
+}
+
+static inline int dom_array_append(const DomInfo *data, jvalue_ref value)
+{
+	if (isElementsArray(data))
+		return dom_report_element(data, value);
+
+	jarray_append(data->m_prev->m_value, value);
+	return 1;
+}
+
+// A complete string, number or boolean is replaced by its canonical instance, see DOMOPT_DEDUPLICATE
+static inline jvalue_ref dom_intern(const DomInfo *data, jvalue_ref value)
+{
+	if (LIKELY(data->m_canon == NULL))
+		return value;
+	return jcanon_intern(data->m_canon, value);
+}
+
+// Match the path of a new container, which is about to be added to the container of data, against m_elements
+static void dom_track_path(const DomInfo *data, DomInfo *newChild)
+{
+	const DomElements *elements = data->m_elements;
+	newChild->m_elements = data->m_elements;
+	newChild->m_pathMatched = -1;
+
+	if (!elements)
+		return;
+	if (data->m_prev == NULL) {
+		newChild->m_pathMatched = 0;
+		return;
+	}
+	if (data->m_pathMatched < 0 || data->m_pathMatched >= (ssize_t)elements->m_count)
+		return;
+
+	raw_buffer token = elements->m_tokens[data->m_pathMatched];
+	raw_buffer key;
+	char index[24];
+	if (jis_array(data->m_prev->m_value)) {
+		key.m_str = index;
+		key.m_len = snprintf(index, sizeof(index), "%zd", jarray_size(data->m_prev->m_value));
+	} else if (jis_string(data->m_value)) {
+		key = jstring_get_fast(data->m_value);
+	} else {
+		return;
+	}
+
+	if (key.m_len == token.m_len && memcmp(key.m_str, token.m_str, key.m_len) == 0)
+		newChild->m_pathMatched = data->m_pathMatched + 1;
+}
+
 int dom_null(JSAXContextRef ctxt)
 {
 	DomInfo *data = getDOMContext(ctxt);
@@ -107,7 +245,8 @@ int dom_null(JSAXContextRef ctxt)
 
 	if (data->m_value == NULL) {
 		CHECK_CONDITION_RETURN_VALUE(!jis_array(data->m_prev->m_value), 0, "Improper place for null");
-		jarray_append(data->m_prev->m_value, jnull());
+		if (!dom_array_append(data, jnull()))
+			return 0;
 	} else if (jis_string(data->m_value)) {
 		CHECK_CONDITION_RETURN_VALUE(!jis_object(data->m_prev->m_value), 0, "Improper place for null");
 		jobject_put(data->m_prev->m_value, data->m_value, jnull());
@@ -128,10 +267,11 @@ int dom_boolean(JSAXContextRef ctxt, bool value)
 
 	if (data->m_value == NULL) {
 		CHECK_CONDITION_RETURN_VALUE(!jis_array(data->m_prev->m_value), 0, "Improper place for boolean");
-		jarray_append(data->m_prev->m_value, jboolean_create(value));
+		if (!dom_array_append(data, dom_intern(data, jboolean_create(value))))
+			return 0;
 	} else if (jis_string(data->m_value)) {
 		CHECK_CONDITION_RETURN_VALUE(!jis_object(data->m_prev->m_value), 0, "Improper place for boolean");
-		jobject_put(data->m_prev->m_value, data->m_value, jboolean_create(value));
+		jobject_put(data->m_prev->m_value, data->m_value, dom_intern(data, jboolean_create(value)));
 		data->m_value = NULL;
 	} else {
 		PJ_LOG_ERR("PBNJSON_BOOL_VALUE_WO_KEY", 0, "value portion of key-value pair without a key");
@@ -151,7 +291,14 @@ int dom_number(JSAXContextRef ctxt, const char *number, size_t numberLen)
 	CHECK_POINTER_RETURN_VALUE(number, 0);
 	CHECK_CONDITION_RETURN_VALUE(numberLen == 0, 0, "unexpected - numeric string doesn't actually contain a number");
 
-	jnum = createOptimalNumber(data->m_optInformation, number, numberLen);
+	// Arrays of numbers keep them unboxed until the elements are asked for
+	if (data->m_value == NULL && jis_array(data->m_prev->m_value) && !isElementsArray(data) &&
+	    jarray_append_packed(data->m_prev->m_value, j_str_to_buffer(number, numberLen)))
+	{
+		return 1;
+	}
+
+	jnum = dom_intern(data, createOptimalNumber(data, number, numberLen));
 
 	if (data->m_value == NULL) {
 		if (UNLIKELY(!jis_array(data->m_prev->m_value))) {
@@ -159,7 +306,8 @@ int dom_number(JSAXContextRef ctxt, const char *number, size_t numberLen)
 			j_release(&jnum);
 			return 0;
 		}
-		jarray_append(data->m_prev->m_value, jnum);
+		if (!dom_array_append(data, jnum))
+			return 0;
 	} else if (jis_string(data->m_value)) {
 		if (UNLIKELY(!jis_object(data->m_prev->m_value))) {
 			PJ_LOG_ERR("PBNJSON_OBJ_MISPLACED_NUM", 1, PMLOGKS("NUM", number), "Improper place for number");
@@ -182,7 +330,7 @@ int dom_string(JSAXContextRef ctxt, const char *string, size_t stringLen)
 	CHECK_CONDITION_RETURN_VALUE(data == NULL, 0, "string encountered without any context");
 	CHECK_CONDITION_RETURN_VALUE(data->m_prev == NULL, 0, "unexpected state - how is this possible?");
 
-	jvalue_ref jstr = createOptimalString(data->m_optInformation, string, stringLen);
+	jvalue_ref jstr = dom_intern(data, createOptimalString(data, string, stringLen));
 
 	if (data->m_value == NULL) {
 		if (UNLIKELY(!jis_array(data->m_prev->m_value))) {
@@ -190,7 +338,8 @@ int dom_string(JSAXContextRef ctxt, const char *string, size_t stringLen)
 			j_release(&jstr);
 			return 0;
 		}
-		jarray_append(data->m_prev->m_value, jstr);
+		if (!dom_array_append(data, jstr))
+			return 0;
 	} else if (jis_string(data->m_value)) {
 		if (UNLIKELY(!jis_object(data->m_prev->m_value))) {
 			PJ_LOG_ERR("PBNJSON_OBJ_MISPLACED_STR", 1, PMLOGKS("STRING", string), "Improper place for string");
@@ -207,6 +356,122 @@ int dom_string(JSAXContextRef ctxt, const char *string, size_t stringLen)
 	return 1;
 }
 
+// Bounds the memory taken by a bad hint, and by sizes of documents with arbitrary keys
+#define DOM_MAX_CAPACITY_HINT 1024
+#define DOM_MAX_LEARNED_PATHS 1024
+
+// The path of a new container in the context data, the same for all the elements of an array
+static guint dom_path_hash(const DomInfo *data)
+{
+	if (!data->m_sizes)
+		return 0;
+	if (data->m_prev == NULL)
+		return 1;
+	if (jis_array(data->m_prev->m_value))
+		return data->m_pathHash * 31 + 1;
+
+	raw_buffer key = jstring_get_fast(data->m_value);
+	guint hash = data->m_pathHash * 31 + 2;
+	for (size_t i = 0; i < key.m_len; ++i)
+		hash = hash * 31 + (unsigned char) key.m_str[i];
+	return hash;
+}
+
+// The schema knows the size best, the previous documents are the next best guess
+static size_t dom_capacity_hint(JSAXContextRef ctxt, const DomInfo *newChild)
+{
+	// The projections build the DOM without validation (see jdom_parse_projection)
+	size_t hint = ctxt->validation_state ? validation_state_capacity_hint(ctxt->validation_state) : 0;
+	if (!hint && newChild->m_sizes && newChild->m_sizes->m_table)
+		hint = GPOINTER_TO_SIZE(g_hash_table_lookup(newChild->m_sizes->m_table, GUINT_TO_POINTER(newChild->m_pathHash)));
+	return MIN(hint, DOM_MAX_CAPACITY_HINT);
+}
+
+static void dom_learn_size(const DomInfo *data, size_t size)
+{
+	DomSizes *sizes = data->m_sizes;
+	if (!sizes || isElementsArray(data))
+		return;
+
+	if (!sizes->m_table)
+		sizes->m_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+	if (g_hash_table_size(sizes->m_table) >= DOM_MAX_LEARNED_PATHS &&
+	    !g_hash_table_contains(sizes->m_table, GUINT_TO_POINTER(data->m_pathHash)))
+	{
+		return;
+	}
+	g_hash_table_insert(sizes->m_table, GUINT_TO_POINTER(data->m_pathHash), GSIZE_TO_POINTER(size));
+}
+
+// Replace the container of data, which is complete, by a copy of its canonical instance in the
+// parent. The canonical instance is frozen, the copy is copied on write (see jview_create).
+static void dom_intern_container(DomInfo *data)
+{
+	jvalue_ref container = data->m_prev->m_value;
+	jvalue_ref parent = data->m_prev->m_prev->m_value;
+	jvalue_ref key = data->m_key;
+	data->m_key = NULL;
+
+	jvalue_ref canonical = jcanon_intern(data->m_canon, jvalue_copy(container));
+	if (!canonical->m_frozen) {
+		j_release(&canonical);
+		j_release(&key);
+		return;
+	}
+
+	jvalue_ref view = jview_create(canonical);
+	j_release(&canonical);
+	if (jis_array(parent)) {
+		jvalue_ref *slot = jarray_slot(jarray_deref(parent), jarray_size(parent) - 1);
+		assert(*slot == container);
+		j_release(slot);
+		*slot = view;
+	} else {
+		jobject_put(parent, key, view);
+	}
+}
+
+// Fields of the context within a new container, inherited from the context it appears in
+static DomInfo *dom_child_new(DomInfo *data)
+{
+	DomInfo *newChild = calloc(1, sizeof(DomInfo));
+	if (UNLIKELY(newChild == NULL))
+		return NULL;
+
+	newChild->m_prev = data;
+	newChild->m_optInformation = data->m_optInformation;
+	newChild->m_strings = data->m_strings;
+	newChild->m_sizes = data->m_sizes;
+	newChild->m_canon = data->m_canon;
+	newChild->m_pathHash = dom_path_hash(data);
+	dom_track_path(data, newChild);
+	return newChild;
+}
+
+// Elements of an array are likely records with the same keys, they share the shapes of the previous one
+static jvalue_ref dom_object_create(const DomInfo *data, size_t hint)
+{
+	if (data->m_prev == NULL || !jis_array(data->m_prev->m_value) || isElementsArray(data))
+		return jobject_create_hint(hint);
+
+	jarray *siblings = jarray_deref(data->m_prev->m_value);
+	jvalue_ref sibling = NULL;
+	// A deduplicated sibling is a copy of its canonical instance (see dom_intern_container)
+	if (siblings->m_size > 0 && !siblings->m_packed)
+		sibling = jview_origin(*jarray_slot(siblings, siblings->m_size - 1));
+
+	if (sibling && jis_shaped(sibling)) {
+		jshape *shape = jobject_deref(sibling)->m_shape;
+		return jobject_create_shaped(jshape_root(shape), MAX(hint, jshape_size(shape)));
+	}
+
+	jshape *root = jshape_create();
+	CHECK_POINTER_RETURN_NULL(root);
+	jvalue_ref result = jobject_create_shaped(root, hint);
+	jshape_release(root);
+	return result;
+}
+
 int dom_object_start(JSAXContextRef ctxt)
 {
 	DomInfo *data = getDOMContext(ctxt);
@@ -215,8 +480,8 @@ int dom_object_start(JSAXContextRef ctxt)
 
 	CHECK_CONDITION_RETURN_VALUE(data == NULL, 0, "object encountered without any context");
 
-	newParent = jobject_create();
-	newChild = calloc(1, sizeof(DomInfo));
+	newChild = dom_child_new(data);
+	newParent = newChild ? dom_object_create(data, dom_capacity_hint(ctxt, newChild)) : NULL;
 
 	if (UNLIKELY(newChild == NULL || !jis_valid(newParent))) {
 		PJ_LOG_ERR("PBNJSON_OBJ_CALLOC_ERR", 0, "Failed to allocate space for new object");
@@ -224,14 +489,14 @@ int dom_object_start(JSAXContextRef ctxt)
 		free(newChild);
 		return 0;
 	}
-	newChild->m_prev = data;
-	newChild->m_optInformation = data->m_optInformation;
 	changeDOMContext(ctxt, newChild);
 
 	if (data->m_prev != NULL) {
 		if (jis_array(data->m_prev->m_value)) {
 			assert(data->m_value == NULL);
-			jarray_append(data->m_prev->m_value, jvalue_copy(newParent));
+			// An element reported separately is held by data->m_value only
+			if (!isElementsArray(data))
+				jarray_append(data->m_prev->m_value, jvalue_copy(newParent));
 		} else {
 			assert(jis_object(data->m_prev->m_value));
 			if (UNLIKELY(!jis_string(data->m_value)))
@@ -240,6 +505,8 @@ int dom_object_start(JSAXContextRef ctxt)
 				j_release(&newParent);
 				return 0;
 			}
+			if (newChild->m_canon)
+				newChild->m_key = jvalue_copy(data->m_value);
 			jobject_put(data->m_prev->m_value, data->m_value, jvalue_copy(newParent));
 		}
 	}
@@ -263,7 +530,7 @@ int dom_object_key(JSAXContextRef ctxt, const char *key, size_t keyLen)
 	// The alternate behaviour is to insert into the parent value with a null value.
 	// Then when inserting the value of the key/value pair into an object, we first remove the key & re-insert
 	// a key/value pair (we don't currently have a replace mechanism).
-	data->m_value = createOptimalString(data->m_optInformation, key, keyLen);
+	data->m_value = dom_intern(data, createOptimalString(data, key, keyLen));
 
 	return 1;
 }
@@ -276,16 +543,25 @@ int dom_object_end(JSAXContextRef ctxt)
 	CHECK_CONDITION_RETURN_VALUE(!jis_object(data->m_prev->m_value), 0, "object end encountered, but not in an object");
 
 	assert(data->m_prev != NULL);
+	dom_learn_size(data, jobject_size(data->m_prev->m_value));
 	changeDOMContext(ctxt, data->m_prev);
-	if (data->m_prev->m_prev != NULL)
+	int result = 1;
+	if (isElementsArray(data->m_prev))
+	{
+		result = dom_report_element(data->m_prev, data->m_prev->m_value);
+		data->m_prev->m_value = NULL;
+	}
+	else if (data->m_prev->m_prev != NULL)
 	{
+		if (data->m_canon)
+			dom_intern_container(data);
 		j_release(&data->m_prev->m_value);
 		// 0xdeadbeef may be written in debug mode, which fools the code
 		data->m_prev->m_value = NULL;
 	}
 	free(data);
 
-	return 1;
+	return result;
 }
 
 int dom_array_start(JSAXContextRef ctxt)
@@ -295,22 +571,27 @@ int dom_array_start(JSAXContextRef ctxt)
 	DomInfo *newChild;
 	CHECK_CONDITION_RETURN_VALUE(data == NULL, 0, "object encountered without any context");
 
-	newParent = jarray_create(NULL);
-	newChild = calloc(1, sizeof(DomInfo));
+	newChild = dom_child_new(data);
+	if (newChild) {
+		size_t hint = dom_capacity_hint(ctxt, newChild);
+		newParent = hint ? jarray_create_hint(NULL, hint) : jarray_create(NULL);
+	} else {
+		newParent = NULL;
+	}
 	if (UNLIKELY(newChild == NULL || !jis_valid(newParent))) {
 		PJ_LOG_ERR("PBNJSON_ARR_CALLOC_ERR", 0, "Failed to allocate space for new array node");
 		j_release(&newParent);
 		free(newChild);
 		return 0;
 	}
-	newChild->m_prev = data;
-	newChild->m_optInformation = data->m_optInformation;
 	changeDOMContext(ctxt, newChild);
 
 	if (data->m_prev != NULL) {
 		if (jis_array(data->m_prev->m_value)) {
 			assert(data->m_value == NULL);
-			jarray_append(data->m_prev->m_value, jvalue_copy(newParent));
+			// An element reported separately is held by data->m_value only
+			if (!isElementsArray(data))
+				jarray_append(data->m_prev->m_value, jvalue_copy(newParent));
 		} else {
 			assert(jis_object(data->m_prev->m_value));
 			if (UNLIKELY(!jis_string(data->m_value))) {
@@ -318,6 +599,8 @@ int dom_array_start(JSAXContextRef ctxt)
 				j_release(&newParent);
 				return 0;
 			}
+			if (newChild->m_canon)
+				newChild->m_key = jvalue_copy(data->m_value);
 			jobject_put(data->m_prev->m_value, data->m_value, jvalue_copy(newParent));
 		}
 	}
@@ -335,19 +618,28 @@ int dom_array_end(JSAXContextRef ctxt)
 	CHECK_CONDITION_RETURN_VALUE(!jis_array(data->m_prev->m_value), 0, "array end encountered, but not in an array");
 
 	assert(data->m_prev != NULL);
+	dom_learn_size(data, jarray_size(data->m_prev->m_value));
 	changeDOMContext(ctxt, data->m_prev);
-	if (data->m_prev->m_prev != NULL)
+	int result = 1;
+	if (isElementsArray(data->m_prev))
+	{
+		result = dom_report_element(data->m_prev, data->m_prev->m_value);
+		data->m_prev->m_value = NULL;
+	}
+	else if (data->m_prev->m_prev != NULL)
 	{
+		if (data->m_canon)
+			dom_intern_container(data);
 		j_release(&data->m_prev->m_value);
 		data->m_prev->m_value = NULL;
 	}
 	free(data);
 
-	return 1;
+	return result;
 }
 
 // Do not release original_ptr. It could be on a stack
-static void dom_cleanup(DomInfo *dom_info, DomInfo *original_ptr)
+void dom_cleanup(DomInfo *dom_info, DomInfo *original_ptr)
 {
 	while (dom_info && dom_info != original_ptr)
 	{
@@ -355,6 +647,7 @@ static void dom_cleanup(DomInfo *dom_info, DomInfo *original_ptr)
 		dom_info = dom_info->m_prev;
 
 		j_release(&cur_dom_info->m_value);
+		j_release(&cur_dom_info->m_key);
 		free(cur_dom_info);
 	}
 }
@@ -367,7 +660,19 @@ jvalue_ref jdom_parse(raw_buffer input, JDOMOptimizationFlags optimizationMode,
 		return jinvalid();
 	}
 
-	if (!jdomparser_feed(&parser, input.m_str, input.m_len) || !jdomparser_end((&parser))) {
+	// The length accepted by the parser is an int
+	const char *buf = input.m_str;
+	for (size_t left = input.m_len; left > 0; ) {
+		int bufLen = left > INT_MAX ? INT_MAX : (int)left;
+		if (!jdomparser_feed(&parser, buf, bufLen)) {
+			jdomparser_deinit(&parser);
+			return jinvalid();
+		}
+		buf += bufLen;
+		left -= bufLen;
+	}
+
+	if (!jdomparser_end(&parser)) {
 		jdomparser_deinit(&parser);
 		return jinvalid();
 	}
@@ -379,77 +684,172 @@ jvalue_ref jdom_parse(raw_buffer input, JDOMOptimizationFlags optimizationMode,
 	return jval;
 }
 
+// Validation pass of jdom_parse_lazy, which builds nothing
+static bool jdom_lazy_validate(raw_buffer input, JSchemaInfoRef schemaInfo, bool *defaults)
+{
+	struct jsaxparser parser;
+	if (!jsaxparser_init(&parser, schemaInfo, NULL, NULL))
+		return false;
+
+	// The length accepted by the parser is an int
+	bool parsed = true;
+	const char *buf = input.m_str;
+	for (size_t left = input.m_len; parsed && left > 0; ) {
+		int bufLen = left > INT_MAX ? INT_MAX : (int)left;
+		parsed = jsaxparser_feed(&parser, buf, bufLen);
+		buf += bufLen;
+		left -= bufLen;
+	}
+	parsed = parsed && jsaxparser_end(&parser);
+	*defaults = parser.internalCtxt.m_defaults;
+	jsaxparser_deinit(&parser);
+	return parsed;
+}
+
+jvalue_ref jdom_parse_lazy(raw_buffer input, JDOMOptimizationFlags optimizationMode, JSchemaInfoRef schemaInfo)
+{
+	CHECK_POINTER_RETURN_VALUE(schemaInfo, jinvalid());
+
+	// Validation needs every event of the document, it is done by a SAX pass without building anything
+	bool validated = schemaInfo->m_schema != jschema_all();
+	bool defaults = false;
+	if (validated && !jdom_lazy_validate(input, schemaInfo, &defaults))
+		return jinvalid();
+
+	// The tape has no place for the default values of the schema, such a document is built at once
+	if (defaults) {
+		PJ_LOG_TRACE("The schema inserts default values, the document is parsed eagerly");
+		return jdom_parse(input, optimizationMode, schemaInfo);
+	}
+
+	// JSON outside of strings is ASCII, checking the whole input is the cheapest way to check the strings
+	if ((optimizationMode & DOMOPT_VALIDATE_UTF8) && !jutf8_validate(input.m_str, input.m_len)) {
+		PJ_LOG_WARN("PBNJSON_INVALID_UTF8", 0, "The input isn't valid UTF-8");
+		return jinvalid();
+	}
+
+	jvalue_ref result = jlazy_parse(input, isInputReferenced(optimizationMode));
+
+	// Report the syntax error through the error handlers of schemaInfo
+	if (!jis_valid(result) && !validated)
+		jsax_parse(NULL, input, schemaInfo);
+
+	return result;
+}
+
+// Read the file chunk by chunk, the DOM keeps copies of the values only
+static jvalue_ref jdom_parse_fd(int fd, JSchemaInfoRef schemaInfo, int *err)
+{
+	struct jdomparser parser;
+	if (!jdomparser_init(&parser, schemaInfo, DOMOPT_NOOPT))
+		return jinvalid();
+
+	char *chunk = malloc(FILE_CHUNK_SIZE);
+	bool parsed = chunk != NULL;
+	if (UNLIKELY(!parsed))
+		*err = ENOMEM;
+
+	// Pages that have been parsed aren't needed anymore. Both hints fail for pipes, that's fine.
+	(void) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	off_t offset = 0;
+
+	while (parsed) {
+		ssize_t chunkSize = read(fd, chunk, FILE_CHUNK_SIZE);
+		if (chunkSize == 0)
+			break;
+		if (chunkSize < 0) {
+			if (errno == EINTR)
+				continue;
+			*err = errno;
+			parsed = false;
+			break;
+		}
+		parsed = jdomparser_feed(&parser, chunk, chunkSize);
+		(void) posix_fadvise(fd, offset, chunkSize, POSIX_FADV_DONTNEED);
+		offset += chunkSize;
+	}
+
+	jvalue_ref result = parsed && jdomparser_end(&parser) ? jdomparser_get_result(&parser) : jinvalid();
+
+	jdomparser_deinit(&parser);
+	free(chunk);
+
+	return result;
+}
+
 jvalue_ref jdom_parse_file(const char *file, JSchemaInfoRef schemaInfo, JFileOptimizationFlags flags)
 {
 	CHECK_POINTER_RETURN_NULL(file);
 	CHECK_POINTER_RETURN_NULL(schemaInfo);
 
 	int fd;
-	off_t fileSize;
+	struct stat finfo;
 	raw_buffer input = { 0 };
-	jvalue_ref result;
+	jvalue_ref result = jinvalid();
+	int err = 0;
 	char *err_msg;
 
 	fd = open(file, O_RDONLY);
-	if (fd == -1) {
+	if (fd == -1 || fstat(fd, &finfo) != 0) {
+		err = errno;
 		goto errno_parse_failure;
 	}
 
-	if (!file_size(fd, &fileSize)) {
-		goto errno_parse_failure;
+	// Pipes, character devices (e.g. /dev/stdin) and empty files can't be mapped
+	if (!(flags & JFileOptMMap) || !S_ISREG(finfo.st_mode) || finfo.st_size == 0) {
+		result = jdom_parse_fd(fd, schemaInfo, &err);
+		if (err)
+			goto errno_parse_failure;
+		close(fd);
+		return result;
 	}
 
-	input.m_len = fileSize;
-	if (input.m_len != fileSize) {
-		PJ_LOG_ERR("PBNJSON_BIG_FILE", 1, PMLOGKS("FILE", file), "File too big - currently unsupported by this API");
+	input.m_len = finfo.st_size;
+	if ((off_t)input.m_len != finfo.st_size) {
+		PJ_LOG_ERR("PBNJSON_BIG_FILE", 1, PMLOGKS("FILE", file), "File too big to be mapped - use the streaming mode");
 		close(fd);
+		return jinvalid();
 	}
 
-	if (flags & JFileOptMMap) {
-		input.m_str = (char *)mmap(NULL, input.m_len, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
-
-		if (input.m_str == NULL || input.m_str == MAP_FAILED) {
-			goto errno_parse_failure;
-		}
-	} else {
-		input.m_str = (char *)malloc(input.m_len + 1);
-		if (input.m_len != read(fd, (char *)input.m_str, input.m_len)) {
-			goto errno_parse_failure;
-		}
-		((char *)input.m_str)[input.m_len] = 0;
+	input.m_str = (char *)mmap(NULL, input.m_len, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+	if (input.m_str == NULL || input.m_str == MAP_FAILED) {
+		err = errno;
+		goto errno_parse_failure;
 	}
+	close(fd);
 
 	result = jdom_parse(input, DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE, schemaInfo);
+	// The constants don't refer the input
+	if (UNLIKELY(!jis_valid(result)) || jis_const(result)) {
+		munmap((void *)input.m_str, input.m_len);
+		return result;
+	}
 
-return_result:
-	close(fd);
-
-	if (UNLIKELY(!jis_valid(result))) {
-		if (input.m_str) {
-			if (flags & JFileOptMMap) {
-				munmap((void *)input.m_str, input.m_len);
-			} else {
-				free((void *)input.m_str);
-			}
-		}
-	} else {
-		result->m_backingBuffer = input;
-		result->m_backingBufferMMap = flags & JFileOptMMap;
+	jvalue_extra *extra = jvalue_extend(result);
+	if (UNLIKELY(!extra)) {
+		j_release(&result);
+		munmap((void *)input.m_str, input.m_len);
+		return jinvalid();
 	}
+	extra->m_backingBuffer = input;
+	extra->m_backingBufferMMap = true;
 
 	return result;
 
 errno_parse_failure:
-	err_msg = strdup(strerror(errno));
+	err_msg = strdup(strerror(err));
 	PJ_LOG_WARN("PBNJSON_PARCE_ERR", 3,
 	            PMLOGKS("FILE", file),
-	            PMLOGKFV("ERRNO", "%d", errno),
+	            PMLOGKFV("ERRNO", "%d", err),
 	            PMLOGKS("ERROR", err_msg),
-	            "Attempt to parse json document '%s' failed (%d) : %s", file, errno, err_msg);
+	            "Attempt to parse json document '%s' failed (%d) : %s", file, err, err_msg);
 	free(err_msg);
 
-	result = jinvalid();
-	goto return_result;
+	if (fd != -1)
+		close(fd);
+	j_release(&result);
+
+	return jinvalid();
 }
 
 void jsax_changeContext(JSAXContextRef saxCtxt, void *userCtxt)
@@ -462,16 +862,125 @@ void* jsax_getContext(JSAXContextRef saxCtxt)
 	return saxCtxt->ctxt;
 }
 
+// Tracks the end of every top-level value for the multiple values mode
+static inline int bounce_value_end(JSAXContextRef spring)
+{
+	if (spring->m_depth == 0 && spring->m_documentEnd)
+		return spring->m_documentEnd(spring);
+	return 1;
+}
+
+/**
+ * Events parsed while the parser is paused. yajl can't stop in the middle of its input
+ * and be resumed, so the events it reports after jsax_pause are kept here until
+ * jsaxparser_resume. The input is passed to yajl in slices, that bounds the number of them.
+ */
+struct JDeferredEvents {
+	bool m_pausable;    // within jsaxparser_feed_ex/jsaxparser_resume, jsax_pause is honored
+	bool m_paused;
+	GArray *m_events;   // JDeferredEvent
+	GByteArray *m_text; // texts of the events
+	guint m_next;       // the first event to deliver on resume
+	const char *m_input; // the input of jsaxparser_feed_ex, referenced while paused
+	size_t m_inputLen;
+	size_t m_consumed;
+	const char *m_error;
+};
+
+typedef struct {
+	SaxEventType m_type;
+	size_t m_offset;    // the text in JDeferredEvents.m_text
+	size_t m_len;
+} JDeferredEvent;
+
+static int deliver_event(JSAXContextRef spring, SaxEventType type, const char *text, size_t len)
+{
+	yajl_callbacks *handlers = spring->m_handlers;
+	switch (type) {
+	case SAX_EVENT_NULL:
+		return handlers->yajl_null(spring);
+	case SAX_EVENT_BOOLEAN:
+		return handlers->yajl_boolean(spring, len);
+	case SAX_EVENT_NUMBER:
+		return handlers->yajl_number(spring, text, len);
+	case SAX_EVENT_STRING:
+		return handlers->yajl_string(spring, (const unsigned char *) text, len);
+	case SAX_EVENT_KEY:
+		return handlers->yajl_map_key(spring, (const unsigned char *) text, len);
+	case SAX_EVENT_OBJ_START:
+		return handlers->yajl_start_map(spring);
+	case SAX_EVENT_OBJ_END:
+		return handlers->yajl_end_map(spring);
+	case SAX_EVENT_ARR_START:
+		return handlers->yajl_start_array(spring);
+	case SAX_EVENT_ARR_END:
+		return handlers->yajl_end_array(spring);
+	case SAX_EVENT_STRING_CHUNK:
+		return spring->m_stringChunks->m_callbacks.m_stringChunk(spring, text, len);
+	case SAX_EVENT_STRING_END:
+		return spring->m_stringChunks->m_callbacks.m_stringEnd(spring);
+	case SAX_EVENT_DOCUMENT_END:
+	{
+		jsaxparser_ref parser = (jsaxparser_ref)((char *)spring - offsetof(struct jsaxparser, internalCtxt));
+		return parser->document_end(parser);
+	}
+	}
+	return false;
+}
+
+int jsax_deliver(JSAXContextRef spring, SaxEventType type, const char *text, size_t len)
+{
+	JDeferredEvents *deferred = spring->m_deferred;
+	if (LIKELY(!deferred || !deferred->m_paused))
+		return deliver_event(spring, type, text, len);
+
+	JDeferredEvent e = { type, deferred->m_text->len, len };
+	if (text)
+		g_byte_array_append(deferred->m_text, (const guint8 *) text, len);
+	g_array_append_val(deferred->m_events, e);
+	return true;
+}
+
+void jsax_pause(JSAXContextRef saxCtxt)
+{
+	CHECK_POINTER(saxCtxt);
+
+	if (saxCtxt->m_deferred && saxCtxt->m_deferred->m_pausable)
+		saxCtxt->m_deferred->m_paused = true;
+}
+
+// The values nested deeper couldn't be walked through (see JVALUE_MAX_DEPTH)
+static int jsax_too_deep(JSAXContextRef spring)
+{
+	spring->m_tooDeep = true;
+	if (spring->m_errors && spring->m_errors->m_parser)
+		spring->m_errors->m_parser(spring->m_errors->m_ctxt, spring);
+	return false;
+}
+
 int my_bounce_start_map(void *ctxt)
 {
 	JSAXContextRef spring = (JSAXContextRef)ctxt;
 	assert(spring->m_handlers->yajl_start_map);
 
+	if (UNLIKELY(spring->m_depth >= JVALUE_MAX_DEPTH))
+		return jsax_too_deep(spring);
+
 	ValidationEvent e = validation_event_obj_start();
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_start_map(ctxt);
+	++spring->m_depth;
+	return jsax_deliver(spring, SAX_EVENT_OBJ_START, NULL, 0);
+}
+
+// Reported through the parser error handler, as the syntax errors are
+int jsax_invalid_utf8(JSAXContextRef spring)
+{
+	spring->m_invalidUtf8 = true;
+	if (spring->m_errors && spring->m_errors->m_parser)
+		spring->m_errors->m_parser(spring->m_errors->m_ctxt, spring);
+	return false;
 }
 
 int my_bounce_map_key(void *ctxt, const unsigned char *str, yajl_size_t strLen)
@@ -479,11 +988,14 @@ int my_bounce_map_key(void *ctxt, const unsigned char *str, yajl_size_t strLen)
 	JSAXContextRef spring = (JSAXContextRef)ctxt;
 	assert(spring->m_handlers->yajl_map_key);
 
+	if (UNLIKELY(spring->m_validateUtf8) && !jutf8_validate((const char *) str, strLen))
+		return jsax_invalid_utf8(spring);
+
 	ValidationEvent e = validation_event_obj_key((char const *) str, strLen);
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_map_key(ctxt, str, strLen);
+	return jsax_deliver(spring, SAX_EVENT_KEY, (const char *) str, strLen);
 }
 
 int my_bounce_end_map(void *ctxt)
@@ -495,7 +1007,8 @@ int my_bounce_end_map(void *ctxt)
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_end_map(ctxt);
+	--spring->m_depth;
+	return jsax_deliver(spring, SAX_EVENT_OBJ_END, NULL, 0) && bounce_value_end(spring);
 }
 
 int my_bounce_start_array(void *ctxt)
@@ -503,11 +1016,15 @@ int my_bounce_start_array(void *ctxt)
 	JSAXContextRef spring = (JSAXContextRef)ctxt;
 	assert(spring->m_handlers->yajl_start_array);
 
+	if (UNLIKELY(spring->m_depth >= JVALUE_MAX_DEPTH))
+		return jsax_too_deep(spring);
+
 	ValidationEvent e = validation_event_arr_start();
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_start_array(ctxt);
+	++spring->m_depth;
+	return jsax_deliver(spring, SAX_EVENT_ARR_START, NULL, 0);
 }
 
 int my_bounce_end_array(void *ctxt)
@@ -519,7 +1036,18 @@ int my_bounce_end_array(void *ctxt)
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_end_array(ctxt);
+	--spring->m_depth;
+	return jsax_deliver(spring, SAX_EVENT_ARR_END, NULL, 0) && bounce_value_end(spring);
+}
+
+// The empty string parsed by yajl in place of a long string delivered by chunks
+static int bounce_string_chunks_end(JSAXContextRef spring, JStringChunks *chunks)
+{
+	ValidationEvent e = validation_event_string(chunks->m_keepContent ? chunks->m_content : NULL, chunks->m_length);
+	if (!validation_check(&e, spring->validation_state, spring))
+		return false;
+
+	return jsax_deliver(spring, SAX_EVENT_STRING_END, NULL, 0) && bounce_value_end(spring);
 }
 
 int my_bounce_string(void *ctxt, const unsigned char *str, yajl_size_t strLen)
@@ -527,11 +1055,17 @@ int my_bounce_string(void *ctxt, const unsigned char *str, yajl_size_t strLen)
 	JSAXContextRef spring = (JSAXContextRef)ctxt;
 	assert(spring->m_handlers->yajl_string);
 
+	if (UNLIKELY(spring->m_stringChunks && spring->m_stringChunks->m_placeholder))
+		return bounce_string_chunks_end(spring, spring->m_stringChunks);
+
+	if (UNLIKELY(spring->m_validateUtf8) && !jutf8_validate((const char *) str, strLen))
+		return jsax_invalid_utf8(spring);
+
 	ValidationEvent e = validation_event_string((char const *) str, strLen);
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_string(ctxt, str, strLen);
+	return jsax_deliver(spring, SAX_EVENT_STRING, (const char *) str, strLen) && bounce_value_end(spring);
 }
 
 int my_bounce_number(void *ctxt, const char *numberVal, yajl_size_t numberLen)
@@ -543,7 +1077,7 @@ int my_bounce_number(void *ctxt, const char *numberVal, yajl_size_t numberLen)
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_number(ctxt, numberVal, numberLen);
+	return jsax_deliver(spring, SAX_EVENT_NUMBER, numberVal, numberLen) && bounce_value_end(spring);
 }
 
 int my_bounce_boolean(void *ctxt, int boolVal)
@@ -555,7 +1089,7 @@ int my_bounce_boolean(void *ctxt, int boolVal)
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_boolean(ctxt, boolVal);
+	return jsax_deliver(spring, SAX_EVENT_BOOLEAN, NULL, boolVal) && bounce_value_end(spring);
 }
 
 int my_bounce_null(void *ctxt)
@@ -567,7 +1101,7 @@ int my_bounce_null(void *ctxt)
 	if (!validation_check(&e, spring->validation_state, ctxt))
 		return false;
 
-	return spring->m_handlers->yajl_null(ctxt);
+	return jsax_deliver(spring, SAX_EVENT_NULL, NULL, 0) && bounce_value_end(spring);
 }
 
 static yajl_callbacks my_bounce =
@@ -679,6 +1213,7 @@ static struct TraverseCallbacks traverse = {
 static bool on_default_property(ValidationState *s, char const *key, jvalue_ref value, void *ctxt)
 {
 	JSAXContextRef spring = (JSAXContextRef) ctxt;
+	spring->m_defaults = true;
 
 	if (!spring->m_handlers->yajl_map_key(ctxt, (unsigned char const *) key, strlen(key)))
 		return false;
@@ -952,6 +1487,18 @@ const char *jsaxparser_get_error(jsaxparser_ref parser)
 {
 	SANITY_CHECK_POINTER(parser);
 
+	if (parser->internalCtxt.m_stringChunks && parser->internalCtxt.m_stringChunks->m_error)
+		return parser->internalCtxt.m_stringChunks->m_error;
+
+	if (parser->internalCtxt.m_deferred && parser->internalCtxt.m_deferred->m_error)
+		return parser->internalCtxt.m_deferred->m_error;
+
+	if (parser->internalCtxt.m_invalidUtf8)
+		return "Invalid UTF-8 in a string";
+
+	if (parser->internalCtxt.m_tooDeep)
+		return "The value is nested too deeply";
+
 	if (parser->schemaError)
 		return parser->schemaError;
 
@@ -961,15 +1508,40 @@ const char *jsaxparser_get_error(jsaxparser_ref parser)
 	return NULL;
 }
 
-bool jsaxparser_feed(jsaxparser_ref parser, const char *buf, int buf_len)
+bool jsaxparser_set_utf8_validation(jsaxparser_ref parser, bool enable)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+
+	parser->internalCtxt.m_validateUtf8 = enable;
+	return true;
+}
+
+bool jsaxparser_feed_yajl(jsaxparser_ref parser, const char *buf, int buf_len)
 {
 	parser->status = yajl_parse(parser->handle, (unsigned char *)buf, buf_len);
 
 	return jsaxparser_process_error(parser, buf, buf_len, false);
 }
 
+bool jsaxparser_feed(jsaxparser_ref parser, const char *buf, int buf_len)
+{
+	CHECK_CONDITION_RETURN_VALUE(parser->internalCtxt.m_deferred && parser->internalCtxt.m_deferred->m_paused,
+	                             false, "The parser is paused, jsaxparser_resume should be called first");
+
+	if (parser->internalCtxt.m_stringChunks)
+		return jsaxparser_feed_chunks(parser, buf, buf_len);
+
+	return jsaxparser_feed_yajl(parser, buf, buf_len);
+}
+
 bool jsaxparser_end(jsaxparser_ref parser)
 {
+	CHECK_CONDITION_RETURN_VALUE(parser->internalCtxt.m_deferred && parser->internalCtxt.m_deferred->m_paused,
+	                             false, "The parser is paused, jsaxparser_resume should be called first");
+
+	if (parser->internalCtxt.m_stringChunks && !jsaxparser_end_chunks(parser))
+		return false;
+
 #if YAJL_VERSION < 20000
 	parser->status = yajl_parse_complete(parser->handle);
 #else
@@ -979,6 +1551,94 @@ bool jsaxparser_end(jsaxparser_ref parser)
 	return jsaxparser_process_error(parser, "", 0, true);
 }
 
+// Deliver the deferred events, then the rest of the input in slices until it's over or paused again
+static jsaxparser_status jsaxparser_continue(jsaxparser_ref parser, JDeferredEvents *deferred, size_t *consumed)
+{
+	jsaxparser_status status = JSAXPARSER_OK;
+	deferred->m_pausable = true;
+
+	while (deferred->m_next < deferred->m_events->len) {
+		JDeferredEvent *e = &g_array_index(deferred->m_events, JDeferredEvent, deferred->m_next++);
+		const char *text = (const char *) deferred->m_text->data + e->m_offset;
+		if (!deliver_event(&parser->internalCtxt, e->m_type, text, e->m_len)) {
+			deferred->m_error = "Client cancelled parsing";
+			status = JSAXPARSER_ERROR;
+			goto out;
+		}
+		if (deferred->m_paused) {
+			status = JSAXPARSER_PAUSED;
+			goto out;
+		}
+	}
+	g_array_set_size(deferred->m_events, 0);
+	g_byte_array_set_size(deferred->m_text, 0);
+	deferred->m_next = 0;
+
+	while (deferred->m_consumed < deferred->m_inputLen) {
+		size_t len = MIN(PAUSE_SLICE_SIZE, deferred->m_inputLen - deferred->m_consumed);
+		if (!jsaxparser_feed(parser, deferred->m_input + deferred->m_consumed, len)) {
+			status = JSAXPARSER_ERROR;
+			break;
+		}
+		deferred->m_consumed += len;
+		if (deferred->m_paused) {
+			status = JSAXPARSER_PAUSED;
+			break;
+		}
+	}
+
+out:
+	deferred->m_pausable = false;
+	if (consumed)
+		*consumed = deferred->m_consumed;
+	if (status != JSAXPARSER_PAUSED) {
+		deferred->m_paused = false;
+		deferred->m_input = NULL;
+	}
+	return status;
+}
+
+jsaxparser_status jsaxparser_feed_ex(jsaxparser_ref parser, const char *buf, size_t buf_len, size_t *consumed)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, JSAXPARSER_ERROR);
+
+	JDeferredEvents *deferred = parser->internalCtxt.m_deferred;
+	if (!deferred) {
+		deferred = g_new0(JDeferredEvents, 1);
+		deferred->m_events = g_array_new(FALSE, FALSE, sizeof(JDeferredEvent));
+		deferred->m_text = g_byte_array_new();
+		parser->internalCtxt.m_deferred = deferred;
+	}
+	CHECK_CONDITION_RETURN_VALUE(deferred->m_paused, JSAXPARSER_ERROR,
+	                             "The parser is paused, jsaxparser_resume should be called first");
+
+	deferred->m_input = buf;
+	deferred->m_inputLen = buf_len;
+	deferred->m_consumed = 0;
+	return jsaxparser_continue(parser, deferred, consumed);
+}
+
+jsaxparser_status jsaxparser_resume(jsaxparser_ref parser, size_t *consumed)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, JSAXPARSER_ERROR);
+
+	JDeferredEvents *deferred = parser->internalCtxt.m_deferred;
+	CHECK_CONDITION_RETURN_VALUE(!deferred || !deferred->m_paused, JSAXPARSER_ERROR, "The parser isn't paused");
+
+	deferred->m_paused = false;
+	return jsaxparser_continue(parser, deferred, consumed);
+}
+
+static void jdeferred_events_free(JDeferredEvents *deferred)
+{
+	if (!deferred)
+		return;
+
+	g_array_free(deferred->m_events, TRUE);
+	g_byte_array_free(deferred->m_text, TRUE);
+	g_free(deferred);
+}
+
 void jsaxparser_deinit(jsaxparser_ref parser)
 {
 	if (parser->yajlError) {
@@ -993,6 +1653,11 @@ void jsaxparser_deinit(jsaxparser_ref parser)
 
 	validation_state_clear(&parser->validation_state);
 
+	jstring_chunks_free(parser->internalCtxt.m_stringChunks);
+	parser->internalCtxt.m_stringChunks = NULL;
+	jdeferred_events_free(parser->internalCtxt.m_deferred);
+	parser->internalCtxt.m_deferred = NULL;
+
 	if (parser->handle) {
 		yajl_free(parser->handle);
 		parser->handle = NULL;
@@ -1005,6 +1670,51 @@ static void *jsaxparser_get_sax_context(jsaxparser_ref parser)
 	return jsax_getContext(&parser->internalCtxt);
 }
 
+static bool jsaxparser_document_end(JSAXContextRef ctxt)
+{
+	jsaxparser_ref parser = (jsaxparser_ref)((char *)ctxt - offsetof(struct jsaxparser, internalCtxt));
+
+	// Every document is validated against the whole schema again
+	validation_state_clear(&parser->validation_state);
+	validation_state_init(&parser->validation_state,
+	                      parser->validator,
+	                      parser->uri_resolver,
+	                      &jparse_notification);
+
+	return jsax_deliver(ctxt, SAX_EVENT_DOCUMENT_END, NULL, 0);
+}
+
+static bool jsaxparser_notify_document(jsaxparser_ref parser)
+{
+	return !parser->document_callback || parser->document_callback(parser->document_ctxt, NULL);
+}
+
+static bool jsaxparser_enable_multiple_values(jsaxparser_ref parser,
+                                              bool (*document_end)(jsaxparser_ref parser),
+                                              jparse_document_callback callback,
+                                              void *ctxt)
+{
+#if YAJL_VERSION < 20000
+	PJ_LOG_ERR("PBNJSON_NO_MULTI_VALUES", 0, "Multiple values mode requires yajl 2");
+	return false;
+#else
+	parser->document_end = document_end;
+	parser->document_callback = callback;
+	parser->document_ctxt = ctxt;
+	parser->internalCtxt.m_documentEnd = jsaxparser_document_end;
+
+	yajl_config(parser->handle, yajl_allow_multiple_values, 1);
+	return true;
+#endif // YAJL_VERSION
+}
+
+bool jsaxparser_set_multiple_values(jsaxparser_ref parser, jparse_document_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+
+	return jsaxparser_enable_multiple_values(parser, jsaxparser_notify_document, callback, ctxt);
+}
+
 /**
  * DomParser pool type for YAJL parser
  */
@@ -1034,12 +1744,19 @@ jdomparser_ref jdomparser_alloc_memory()
 
 	if (i == DOM_POOL_SIZE)
 		res = malloc(sizeof(struct jdomparser));
+	if (res)
+		res->sizes.m_table = NULL;
 
 	return res;
 }
 
 void jdomparser_free_memory(jdomparser_ref parser)
 {
+	if (parser->sizes.m_table) {
+		g_hash_table_destroy(parser->sizes.m_table);
+		parser->sizes.m_table = NULL;
+	}
+
 	if (parser < &dompool.stack[0] || (char*)parser >= (char*)&dompool.stack + sizeof(dompool)) {
 		free(parser);
 	} else {
@@ -1056,8 +1773,9 @@ jdomparser_ref jdomparser_create(JSchemaInfoRef schemaInfo, JDOMOptimizationFlag
 	if (parser) {
 		if (!jdomparser_init(parser, schemaInfo, optimizationMode)) {
 			jdomparser_free_memory(parser);
-			parser = NULL;
+			return NULL;
 		}
+		jdomparser_learn_sizes(parser);
 	}
 
 	return parser;
@@ -1084,13 +1802,32 @@ static PJSAXCallbacks dom_callbacks = {
 bool jdomparser_init(jdomparser_ref parser, JSchemaInfoRef schemaInfo, JDOMOptimizationFlags optimizationMode)
 {
 	memset(&parser->topLevelContext, 0, sizeof(parser->topLevelContext));
+	memset(&parser->strings, 0, sizeof(parser->strings));
+	memset(&parser->elements, 0, sizeof(parser->elements));
+	parser->topLevelContext.m_optInformation = optimizationMode;
+	parser->topLevelContext.m_strings = &parser->strings;
+	parser->canon.m_table = NULL;
+	if (optimizationMode & DOMOPT_DEDUPLICATE)
+		parser->topLevelContext.m_canon = &parser->canon;
+
+	if (!jsaxparser_init(&parser->saxparser, schemaInfo, &dom_callbacks, &parser->topLevelContext))
+		return false;
+	parser->saxparser.internalCtxt.m_validateUtf8 = (optimizationMode & DOMOPT_VALIDATE_UTF8) != 0;
+	return true;
+}
 
-	return jsaxparser_init(&parser->saxparser, schemaInfo, &dom_callbacks, &parser->topLevelContext);
+void jdomparser_learn_sizes(jdomparser_ref parser)
+{
+	parser->topLevelContext.m_sizes = &parser->sizes;
 }
 
 bool jdomparser_feed(jdomparser_ref parser, const char *buf, int buf_len)
 {
-	return jsaxparser_feed(&parser->saxparser, buf, buf_len);
+	parser->strings.m_inputBegin = buf;
+	parser->strings.m_inputEnd = buf + buf_len;
+	bool result = jsaxparser_feed(&parser->saxparser, buf, buf_len);
+	parser->strings.m_inputBegin = parser->strings.m_inputEnd = NULL;
+	return result;
 }
 
 bool jdomparser_end(jdomparser_ref parser)
@@ -1105,6 +1842,12 @@ void jdomparser_deinit(jdomparser_ref parser)
 	}
 
 	j_release(&parser->topLevelContext.m_value);
+	jcanon_clear(&parser->canon);
+	dom_arena_chunk_release(parser->strings.m_arena);
+	parser->strings.m_arena = NULL;
+	free(parser->elements.m_path);
+	free(parser->elements.m_tokens);
+	memset(&parser->elements, 0, sizeof(parser->elements));
 
 	jsaxparser_deinit(&parser->saxparser);
 }
@@ -1116,5 +1859,88 @@ const char *jdomparser_get_error(jdomparser_ref parser)
 
 jvalue_ref jdomparser_get_result(jdomparser_ref parser)
 {
+	if (!parser->topLevelContext.m_value)
+		return jinvalid();
+
 	return jvalue_copy(parser->topLevelContext.m_value);
 }
+
+_Static_assert(offsetof(struct jdomparser, saxparser) == 0, "jdomparser and jdomparser.saxparser should have the same addresses");
+
+static bool jdomparser_notify_document(jsaxparser_ref saxparser)
+{
+	jdomparser_ref parser = (jdomparser_ref)saxparser;
+
+	// The parser doesn't keep the documents, the next one starts from scratch
+	jvalue_ref value = parser->topLevelContext.m_value;
+	parser->topLevelContext.m_value = NULL;
+	// The documents may go to other threads, they don't share values
+	jcanon_clear(&parser->canon);
+
+	bool result = !saxparser->document_callback || saxparser->document_callback(saxparser->document_ctxt, value);
+	j_release(&value);
+
+	return result;
+}
+
+bool jdomparser_set_multiple_values(jdomparser_ref parser, jparse_document_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+
+	return jsaxparser_enable_multiple_values(&parser->saxparser, jdomparser_notify_document, callback, ctxt);
+}
+
+bool jdomparser_set_element_callback(jdomparser_ref parser, const char *path,
+                                     jparse_document_callback callback, void *ctxt)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+	CHECK_POINTER_RETURN_VALUE(path, false);
+	CHECK_POINTER_RETURN_VALUE(callback, false);
+
+	if (*path != '\0' && *path != '/') {
+		PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", path), "JSON Pointer should start with '/'");
+		return false;
+	}
+
+	DomElements *elements = &parser->elements;
+	size_t count = 0;
+	for (const char *c = path; *c; ++c)
+		count += *c == '/';
+
+	// Unescaped tokens are never longer than the escaped ones
+	char *tokens = malloc(strlen(path) + 1);
+	raw_buffer *ranges = malloc((count ? count : 1) * sizeof(raw_buffer));
+	if (UNLIKELY(!tokens || !ranges)) {
+		PJ_LOG_ERR("PBNJSON_ELEMENTS_PATH_ERR", 0, "Failed to allocate space for the path");
+		free(tokens);
+		free(ranges);
+		return false;
+	}
+
+	char *dst = tokens;
+	for (size_t i = 0; i < count; ++i) {
+		const char *token = path + 1;
+		path = strchrnul(token, '/');
+
+		size_t len;
+		if (!jpointer_unescape(token, path - token, dst, &len)) {
+			PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", token), "Invalid escape sequence in JSON Pointer");
+			free(tokens);
+			free(ranges);
+			return false;
+		}
+		ranges[i] = j_str_to_buffer(dst, len);
+		dst += len + 1;
+	}
+
+	free(elements->m_path);
+	free(elements->m_tokens);
+	elements->m_path = tokens;
+	elements->m_tokens = ranges;
+	elements->m_count = count;
+	elements->m_callback = callback;
+	elements->m_ctxt = ctxt;
+	parser->topLevelContext.m_elements = elements;
+
+	return true;
+}
@@ -24,7 +24,10 @@
 #include <jparse_stream.h>
 #include "yajl_compat.h"
 #include "jschema_types_internal.h"
+#include "jpointer.h"
 #include "parser_memory_pool.h"
+#include "jvalue/canon.h"
+#include "jvalue/utf8.h"
 #include "validation/validation_state.h"
 #include "validation/validation_event.h"
 #include "validation/validation_api.h"
@@ -62,8 +65,72 @@ typedef int(* pj_yajl_end_map )(void *ctx);
 typedef int(* pj_yajl_start_array )(void *ctx);
 typedef int(* pj_yajl_end_array )(void *ctx);
 
+typedef struct DomArenaChunk DomArenaChunk;
+
+/**
+ * Where the string values of a document being parsed come from. The strings found
+ * verbatim in the chunk of input being fed are referenced in place if the input outlives
+ * the DOM. The ones that had to be unescaped (or were split between chunks) are
+ * decoded by yajl into its own buffer, they are copied into an arena shared by the document.
+ */
+typedef struct DomStrings {
+	const char *m_inputBegin; // the chunk of input being fed, NULL out of jdomparser_feed
+	const char *m_inputEnd;
+	DomArenaChunk *m_arena;   // the chunk the next strings are appended to
+} DomStrings;
+
+/**
+ * The array which elements are passed to a callback one by one instead of being
+ * added to the DOM (see jdomparser_set_element_callback)
+ */
+typedef struct DomElements {
+	char *m_path;           // unescaped reference tokens of the JSON Pointer, each null-terminated
+	raw_buffer *m_tokens;
+	size_t m_count;
+	jparse_document_callback m_callback;
+	void *m_ctxt;
+} DomElements;
+
+/**
+ * Sizes of the containers parsed so far by their paths (see jdomparser_learn_sizes). A container
+ * without a capacity hint from the schema gets the size seen last at the same path.
+ */
+typedef struct DomSizes {
+	GHashTable *m_table;      // path hash -> size, created on the first container
+} DomSizes;
+
 typedef struct DomInfo {
 	JDOMOptimization m_optInformation;
+	/**
+	 * Shared by all the contexts of a document, NULL if strings are always copied
+	 */
+	DomStrings *m_strings;
+	/**
+	 * Shared by all the contexts of a document, NULL unless elements are reported separately
+	 */
+	DomElements *m_elements;
+	/**
+	 * Number of reference tokens of m_elements->m_path matched by the path of m_prev->m_value,
+	 * -1 if it is off the path
+	 */
+	ssize_t m_pathMatched;
+	/**
+	 * Shared by all the contexts of the documents of a parser, NULL unless sizes are learned
+	 */
+	DomSizes *m_sizes;
+	/**
+	 * Hash of the path of m_prev->m_value, elements of an array share it. 0 unless m_sizes is set.
+	 */
+	guint m_pathHash;
+	/**
+	 * Shared by all the contexts of a document, NULL unless the values are deduplicated
+	 */
+	jcanon *m_canon;
+	/**
+	 * The key of m_prev->m_value in its parent object, kept to replace it by its canonical
+	 * instance. NULL unless m_canon is set.
+	 */
+	jvalue_ref m_key;
 	/**
 	 * This cannot be null unless we are in a top-level object or array.
 	 * m_prev->m_value is the object or array that is our parent.
@@ -78,8 +145,87 @@ typedef struct DomInfo {
 	jvalue_ref m_value;
 } DomInfo;
 
+/**
+ * Delivery of long string values by chunks (see jsaxparser_set_string_chunks). The input
+ * is scanned ahead of yajl: the beginning of a string value is held back until it's known
+ * to be short, then it's passed to yajl as usual. A long one is unescaped and delivered
+ * by chunks instead, and yajl gets an empty string in its place.
+ */
+typedef struct JStringChunks {
+	PJSAXStringCallbacks m_callbacks;
+	size_t m_chunkSize;
+	bool m_keepContent;       // the schema checks contents of strings, see string_validators_need_content
+	int m_state;              // where the scanner is in the input, see jparse_string_chunks.c
+	char *m_containers;       // '{' or '[' for every open container
+	size_t m_depth;
+	size_t m_capacity;
+	bool m_keyNext;           // the next string is an object key
+
+	char *m_held;             // the beginning of a string value not passed to yajl yet
+	size_t m_heldLen;
+	size_t m_rawLen;          // bytes of the string value in the input so far
+	bool m_rawEscape;
+
+	char *m_chunk;            // unescaped bytes of a long string not delivered yet
+	size_t m_chunkLen;
+	char m_escape[6];         // escape sequence split between bytes (or feeds)
+	size_t m_escapeLen;
+	unsigned m_highSurrogate; // a high surrogate waiting for the low one, 0 if none
+	size_t m_length;          // length of the long string unescaped
+	char *m_content;          // the whole long string, kept only if the schema checks it
+	size_t m_contentCapacity;
+	bool m_placeholder;       // the empty string yajl parses stands for the long string
+	jutf8_state m_utf8State;  // UTF-8 validation of the long string, if it's on
+
+	const char *m_error;
+} JStringChunks;
+
+/**
+ * Events passed to the SAX callbacks after they have been validated
+ */
+typedef enum {
+	SAX_EVENT_NULL,
+	SAX_EVENT_BOOLEAN,
+	SAX_EVENT_NUMBER,
+	SAX_EVENT_STRING,
+	SAX_EVENT_KEY,
+	SAX_EVENT_OBJ_START,
+	SAX_EVENT_OBJ_END,
+	SAX_EVENT_ARR_START,
+	SAX_EVENT_ARR_END,
+	SAX_EVENT_STRING_CHUNK,  // see jsaxparser_set_string_chunks
+	SAX_EVENT_STRING_END,
+	SAX_EVENT_DOCUMENT_END,  // see jsaxparser_set_multiple_values
+} SaxEventType;
+
+typedef struct JDeferredEvents JDeferredEvents;
 typedef struct __JSAXContext PJSAXContext;
 
+/**
+ * @brief jsax_deliver Pass a validated event to the callbacks, or keep it until jsaxparser_resume
+ * if the parser is paused
+ * @param spring Parser context
+ * @param type Type of the event
+ * @param text Text of a number, string, key or chunk, NULL for the rest
+ * @param len Length of the text, the value of a boolean
+ * @return false if the callback has failed
+ */
+int jsax_deliver(JSAXContextRef spring, SaxEventType type, const char *text, size_t len);
+
+/**
+ * @brief jsax_invalid_utf8 Fail parsing because of a string or a key which isn't valid UTF-8
+ * @param spring Parser context
+ * @return false, to be returned from the callback of yajl
+ */
+int jsax_invalid_utf8(JSAXContextRef spring);
+
+/**
+ * @brief dom_cleanup Release DOM contexts left after interrupted parsing
+ * @param dom_info Current DOM context
+ * @param original_ptr Top-level context, it isn't released
+ */
+void dom_cleanup(DomInfo *dom_info, DomInfo *original_ptr);
+
 struct jsaxparser {
 	yajl_handle handle;
 	PJSAXContext internalCtxt;
@@ -92,18 +238,49 @@ struct jsaxparser {
 	struct JErrorCallbacks errorHandler;
 	char *schemaError;
 	char *yajlError;
+	bool (*document_end)(jsaxparser_ref parser); // multiple values mode: a top-level value has been parsed
+	jparse_document_callback document_callback;
+	void *document_ctxt;
 	mem_pool_t memory_pool; //should be the last field
 };
 
 struct jdomparser {
 	struct jsaxparser saxparser;
 	DomInfo topLevelContext;
+	DomStrings strings;
+	DomElements elements;
+	DomSizes sizes;        // kept across jdomparser_deinit and jdomparser_init
+	jcanon canon;          // see DOMOPT_DEDUPLICATE
 };
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief jsaxparser_feed_yajl Pass part of the input directly to yajl
+ * @return false on error
+ */
+bool jsaxparser_feed_yajl(jsaxparser_ref parser, const char *buf, int buf_len);
+
+/**
+ * @brief jsaxparser_feed_chunks Feed the parser with the delivery of long strings by chunks on
+ * @return false on error
+ */
+bool jsaxparser_feed_chunks(jsaxparser_ref parser, const char *buf, int buf_len);
+
+/**
+ * @brief jsaxparser_end_chunks Check that no string is left unfinished at the end of the input
+ * @return false on error
+ */
+bool jsaxparser_end_chunks(jsaxparser_ref parser);
+
+/**
+ * @brief jstring_chunks_free Release the state of the delivery of long strings by chunks
+ * @param chunks The state, may be NULL
+ */
+void jstring_chunks_free(JStringChunks *chunks);
+
 /**
  * @brief jsaxparser_alloc_memory Create SAX parser
  * @return pointer to SAX parser
@@ -150,6 +327,17 @@ jdomparser_ref jdomparser_alloc_memory();
  */
 bool jdomparser_init(jdomparser_ref parser, JSchemaInfoRef schemaInfo, JDOMOptimizationFlags optimizationMode);
 
+/**
+ * @brief jdomparser_learn_sizes Pre-size the containers of the document after those of the previous ones
+ *
+ * Without a capacity hint from the schema, a container gets the size of the container seen last
+ * at the same path. The sizes are kept across jdomparser_deinit/jdomparser_init, so a parser
+ * reused for a stream of similar documents stops regrowing them. Call after jdomparser_init
+ * of a parser from jdomparser_alloc_memory.
+ * @param parser Pointer to DOM parser
+ */
+void jdomparser_learn_sizes(jdomparser_ref parser);
+
 /**
  * @brief jdomparser_deinit Deinitialize DOM parser
  * @param parser Pointer to DOM parser
@@ -0,0 +1,442 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jparse_stream.h>
+#include <glib.h>
+#include "liblog.h"
+#include "jparse_stream_internal.h"
+#include "validation/string_validator.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * yajl keeps a whole string token in its buffer before reporting it, so a long
+ * string value is found and delivered here instead. Only the lexical structure of
+ * the input is tracked (strings, comments, nesting), the grammar is left to yajl.
+ */
+enum {
+	SCAN_STRUCTURE,          // between tokens
+	SCAN_SLASH,              // '/' which starts a comment
+	SCAN_LINE_COMMENT,
+	SCAN_BLOCK_COMMENT,
+	SCAN_BLOCK_COMMENT_STAR,
+	SCAN_KEY,                // within an object key, it goes to yajl as is
+	SCAN_KEY_ESCAPE,
+	SCAN_VALUE,              // within a string value which may still turn out short
+	SCAN_LONG_VALUE,         // within a string value being delivered by chunks
+};
+
+static bool chunks_fail(jsaxparser_ref parser, const char *error)
+{
+	parser->internalCtxt.m_stringChunks->m_error = error;
+	if (parser->errorHandler.m_parser)
+		parser->errorHandler.m_parser(parser->errorHandler.m_ctxt, &parser->internalCtxt);
+	return false;
+}
+
+static bool chunks_flush(jsaxparser_ref parser, JStringChunks *chunks)
+{
+	if (!chunks->m_chunkLen)
+		return true;
+
+	size_t len = chunks->m_chunkLen;
+	chunks->m_chunkLen = 0;
+	if (!jsax_deliver(&parser->internalCtxt, SAX_EVENT_STRING_CHUNK, chunks->m_chunk, len)) {
+		chunks->m_error = "Client cancelled parsing";
+		return false;
+	}
+	return true;
+}
+
+static bool chunks_put(jsaxparser_ref parser, JStringChunks *chunks, const char *data, size_t len)
+{
+	if (chunks->m_keepContent) {
+		if (chunks->m_length + len > chunks->m_contentCapacity) {
+			size_t capacity = MAX(chunks->m_contentCapacity * 2, chunks->m_length + len);
+			char *content = realloc(chunks->m_content, capacity);
+			if (UNLIKELY(!content))
+				return chunks_fail(parser, "Out of memory");
+			chunks->m_content = content;
+			chunks->m_contentCapacity = capacity;
+		}
+		memcpy(chunks->m_content + chunks->m_length, data, len);
+	}
+	chunks->m_length += len;
+
+	// The runs between escapes come right from the input scan, decoded escapes are valid
+	if (parser->internalCtxt.m_validateUtf8) {
+		chunks->m_utf8State = jutf8_feed(chunks->m_utf8State, data, len);
+		if (UNLIKELY(chunks->m_utf8State == JUTF8_REJECT))
+			return jsax_invalid_utf8(&parser->internalCtxt);
+	}
+
+	while (len) {
+		size_t n = MIN(len, chunks->m_chunkSize - chunks->m_chunkLen);
+		memcpy(chunks->m_chunk + chunks->m_chunkLen, data, n);
+		chunks->m_chunkLen += n;
+		data += n;
+		len -= n;
+		if (chunks->m_chunkLen == chunks->m_chunkSize && !chunks_flush(parser, chunks))
+			return false;
+	}
+	return true;
+}
+
+// A high surrogate not followed by a low one is replaced the same way yajl does
+static bool chunks_drop_surrogate(jsaxparser_ref parser, JStringChunks *chunks)
+{
+	if (!chunks->m_highSurrogate)
+		return true;
+	chunks->m_highSurrogate = 0;
+	return chunks_put(parser, chunks, "?", 1);
+}
+
+static bool chunks_put_codepoint(jsaxparser_ref parser, JStringChunks *chunks, unsigned cp)
+{
+	char utf8[4];
+	size_t len;
+	if (cp < 0x80) {
+		utf8[0] = cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		utf8[0] = 0xC0 | (cp >> 6);
+		utf8[1] = 0x80 | (cp & 0x3F);
+		len = 2;
+	} else if (cp < 0x10000) {
+		utf8[0] = 0xE0 | (cp >> 12);
+		utf8[1] = 0x80 | ((cp >> 6) & 0x3F);
+		utf8[2] = 0x80 | (cp & 0x3F);
+		len = 3;
+	} else {
+		utf8[0] = 0xF0 | (cp >> 18);
+		utf8[1] = 0x80 | ((cp >> 12) & 0x3F);
+		utf8[2] = 0x80 | ((cp >> 6) & 0x3F);
+		utf8[3] = 0x80 | (cp & 0x3F);
+		len = 4;
+	}
+	return chunks_put(parser, chunks, utf8, len);
+}
+
+// Unescape the next byte of a long string. Escape sequences may be split between feeds.
+static bool chunks_unescape(jsaxparser_ref parser, JStringChunks *chunks, char c)
+{
+	if (!chunks->m_escapeLen) {
+		if (c == '\\') {
+			chunks->m_escape[chunks->m_escapeLen++] = c;
+			return true;
+		}
+		if ((unsigned char)c < 0x20)
+			return chunks_fail(parser, "Invalid character in a string");
+		return chunks_drop_surrogate(parser, chunks) && chunks_put(parser, chunks, &c, 1);
+	}
+
+	chunks->m_escape[chunks->m_escapeLen++] = c;
+	if (chunks->m_escapeLen == 2) {
+		static const char from[] = "\"\\/bfnrt";
+		static const char to[] = "\"\\/\b\f\n\r\t";
+
+		if (c == 'u')
+			return true;
+		const char *e = c ? strchr(from, c) : NULL;
+		if (!e)
+			return chunks_fail(parser, "Invalid escape sequence in a string");
+		chunks->m_escapeLen = 0;
+		return chunks_drop_surrogate(parser, chunks) && chunks_put(parser, chunks, &to[e - from], 1);
+	}
+
+	if (!g_ascii_isxdigit(c))
+		return chunks_fail(parser, "Invalid \\u escape sequence in a string");
+	if (chunks->m_escapeLen < sizeof(chunks->m_escape))
+		return true;
+
+	chunks->m_escapeLen = 0;
+	unsigned cp = 0;
+	for (size_t i = 2; i < sizeof(chunks->m_escape); ++i)
+		cp = (cp << 4) | g_ascii_xdigit_value(chunks->m_escape[i]);
+
+	if (cp >= 0xDC00 && cp <= 0xDFFF && chunks->m_highSurrogate) {
+		cp = 0x10000 + ((chunks->m_highSurrogate - 0xD800) << 10) + (cp - 0xDC00);
+		chunks->m_highSurrogate = 0;
+	} else {
+		if (!chunks_drop_surrogate(parser, chunks))
+			return false;
+		if (cp >= 0xD800 && cp <= 0xDBFF) {
+			chunks->m_highSurrogate = cp;
+			return true;
+		}
+		if (cp >= 0xDC00 && cp <= 0xDFFF)
+			cp = '?';
+	}
+	return chunks_put_codepoint(parser, chunks, cp);
+}
+
+// The string is long: the beginning of it (held back or in the current input) starts the delivery
+static bool chunks_begin(jsaxparser_ref parser, JStringChunks *chunks, const char *begin, const char *end)
+{
+	chunks->m_state = SCAN_LONG_VALUE;
+	chunks->m_length = 0;
+	chunks->m_chunkLen = 0;
+	chunks->m_escapeLen = 0;
+	chunks->m_highSurrogate = 0;
+	chunks->m_utf8State = JUTF8_ACCEPT;
+
+	// The held part starts with the opening quote
+	for (size_t i = 1; i < chunks->m_heldLen; ++i)
+		if (!chunks_unescape(parser, chunks, chunks->m_held[i]))
+			return false;
+	chunks->m_heldLen = 0;
+
+	for (const char *p = begin; p < end; ++p)
+		if (!chunks_unescape(parser, chunks, *p))
+			return false;
+	return true;
+}
+
+// yajl parses an empty string in place of the long one, the bounce callback recognizes it
+static bool chunks_finish(jsaxparser_ref parser, JStringChunks *chunks)
+{
+	if (!chunks_drop_surrogate(parser, chunks) || !chunks_flush(parser, chunks))
+		return false;
+	if (UNLIKELY(chunks->m_utf8State != JUTF8_ACCEPT))
+		return jsax_invalid_utf8(&parser->internalCtxt);
+
+	chunks->m_placeholder = true;
+	bool result = jsaxparser_feed_yajl(parser, "\"\"", 2);
+	chunks->m_placeholder = false;
+	chunks->m_state = SCAN_STRUCTURE;
+	return result;
+}
+
+static bool chunks_push(JStringChunks *chunks, char container)
+{
+	if (chunks->m_depth == chunks->m_capacity) {
+		size_t capacity = chunks->m_capacity ? chunks->m_capacity * 2 : 16;
+		char *containers = realloc(chunks->m_containers, capacity);
+		if (UNLIKELY(!containers))
+			return false;
+		chunks->m_containers = containers;
+		chunks->m_capacity = capacity;
+	}
+	chunks->m_containers[chunks->m_depth++] = container;
+	chunks->m_keyNext = container == '{';
+	return true;
+}
+
+static void chunks_structure(jsaxparser_ref parser, JStringChunks *chunks, char c)
+{
+	switch (c) {
+	case '/':
+		chunks->m_state = SCAN_SLASH;
+		break;
+	case '{':
+	case '[':
+		if (!chunks_push(chunks, c))
+			chunks_fail(parser, "Out of memory");
+		break;
+	case '}':
+	case ']':
+		if (chunks->m_depth)
+			--chunks->m_depth;
+		chunks->m_keyNext = false;
+		break;
+	case ',':
+		chunks->m_keyNext = chunks->m_depth && chunks->m_containers[chunks->m_depth - 1] == '{';
+		break;
+	case ':':
+		chunks->m_keyNext = false;
+		break;
+	}
+}
+
+bool jsaxparser_feed_chunks(jsaxparser_ref parser, const char *buf, int buf_len)
+{
+	JStringChunks *chunks = parser->internalCtxt.m_stringChunks;
+	const char *end = buf + buf_len;
+	const char *fed = buf;      // the input before it has been passed to yajl
+	const char *string = NULL;  // the opening quote of a string value within the input
+
+	for (const char *p = buf; p < end; ++p) {
+		char c = *p;
+		switch (chunks->m_state) {
+		case SCAN_STRUCTURE:
+			if (c != '"') {
+				chunks_structure(parser, chunks, c);
+				if (UNLIKELY(chunks->m_error))
+					return false;
+			} else if (chunks->m_keyNext) {
+				chunks->m_state = SCAN_KEY;
+			} else {
+				chunks->m_state = SCAN_VALUE;
+				chunks->m_rawLen = 0;
+				chunks->m_rawEscape = false;
+				string = p;
+			}
+			break;
+		case SCAN_SLASH:
+			// Anything but a comment is left for yajl to report
+			chunks->m_state = c == '/' ? SCAN_LINE_COMMENT : c == '*' ? SCAN_BLOCK_COMMENT : SCAN_STRUCTURE;
+			break;
+		case SCAN_LINE_COMMENT:
+			if (c == '\n')
+				chunks->m_state = SCAN_STRUCTURE;
+			break;
+		case SCAN_BLOCK_COMMENT:
+			if (c == '*')
+				chunks->m_state = SCAN_BLOCK_COMMENT_STAR;
+			break;
+		case SCAN_BLOCK_COMMENT_STAR:
+			if (c == '/')
+				chunks->m_state = SCAN_STRUCTURE;
+			else if (c != '*')
+				chunks->m_state = SCAN_BLOCK_COMMENT;
+			break;
+		case SCAN_KEY:
+			if (c == '\\')
+				chunks->m_state = SCAN_KEY_ESCAPE;
+			else if (c == '"')
+				chunks->m_state = SCAN_STRUCTURE;
+			break;
+		case SCAN_KEY_ESCAPE:
+			chunks->m_state = SCAN_KEY;
+			break;
+		case SCAN_VALUE:
+			if (chunks->m_rawEscape) {
+				chunks->m_rawEscape = false;
+			} else if (c == '\\') {
+				chunks->m_rawEscape = true;
+			} else if (c == '"') {
+				// A short string, it goes to yajl along with the rest of the input
+				if (chunks->m_heldLen && !jsaxparser_feed_yajl(parser, chunks->m_held, chunks->m_heldLen))
+					return false;
+				chunks->m_heldLen = 0;
+				chunks->m_state = SCAN_STRUCTURE;
+				string = NULL;
+				break;
+			}
+			if (++chunks->m_rawLen < chunks->m_chunkSize)
+				break;
+
+			if (string) {
+				if (string > fed && !jsaxparser_feed_yajl(parser, fed, string - fed))
+					return false;
+				if (!chunks_begin(parser, chunks, string + 1, p + 1))
+					return false;
+				string = NULL;
+			} else if (!chunks_begin(parser, chunks, buf, p + 1)) {
+				return false;
+			}
+			break;
+		case SCAN_LONG_VALUE:
+			if (!chunks->m_escapeLen && !chunks->m_highSurrogate) {
+				const char *run = p;
+				while (run < end && *run != '"' && *run != '\\' && (unsigned char)*run >= 0x20)
+					++run;
+				if (run > p) {
+					if (!chunks_put(parser, chunks, p, run - p))
+						return false;
+					p = run - 1;
+					break;
+				}
+			}
+			if (c != '"' || chunks->m_escapeLen) {
+				if (!chunks_unescape(parser, chunks, c))
+					return false;
+				break;
+			}
+			if (!chunks_finish(parser, chunks))
+				return false;
+			fed = p + 1;
+			break;
+		}
+	}
+
+	switch (chunks->m_state) {
+	case SCAN_VALUE:
+		// Hold the beginning of the string back until it's known whether it's long
+		if (string) {
+			if (string > fed && !jsaxparser_feed_yajl(parser, fed, string - fed))
+				return false;
+			fed = string;
+		}
+		memcpy(chunks->m_held + chunks->m_heldLen, fed, end - fed);
+		chunks->m_heldLen += end - fed;
+		return true;
+	case SCAN_LONG_VALUE:
+		return true;
+	default:
+		return end == fed || jsaxparser_feed_yajl(parser, fed, end - fed);
+	}
+}
+
+bool jsaxparser_end_chunks(jsaxparser_ref parser)
+{
+	JStringChunks *chunks = parser->internalCtxt.m_stringChunks;
+
+	if (chunks->m_state == SCAN_LONG_VALUE)
+		return chunks_fail(parser, "Premature end of input within a string");
+
+	// yajl reports the unterminated string
+	if (chunks->m_heldLen && !jsaxparser_feed_yajl(parser, chunks->m_held, chunks->m_heldLen))
+		return false;
+	chunks->m_heldLen = 0;
+	return true;
+}
+
+void jstring_chunks_free(JStringChunks *chunks)
+{
+	if (!chunks)
+		return;
+
+	free(chunks->m_containers);
+	free(chunks->m_held);
+	free(chunks->m_chunk);
+	free(chunks->m_content);
+	free(chunks);
+}
+
+bool jsaxparser_set_string_chunks(jsaxparser_ref parser, const PJSAXStringCallbacks *callbacks, size_t chunkSize)
+{
+	CHECK_POINTER_RETURN_VALUE(parser, false);
+
+	jstring_chunks_free(parser->internalCtxt.m_stringChunks);
+	parser->internalCtxt.m_stringChunks = NULL;
+	if (!callbacks)
+		return true;
+
+	CHECK_POINTER_RETURN_VALUE(callbacks->m_stringChunk, false);
+	CHECK_POINTER_RETURN_VALUE(callbacks->m_stringEnd, false);
+	CHECK_CONDITION_RETURN_VALUE(chunkSize == 0, false, "Chunk size should be positive");
+
+	JStringChunks *chunks = calloc(1, sizeof(JStringChunks));
+	if (chunks) {
+		chunks->m_held = malloc(chunkSize);
+		chunks->m_chunk = malloc(chunkSize);
+	}
+	if (UNLIKELY(!chunks || !chunks->m_held || !chunks->m_chunk)) {
+		PJ_LOG_ERR("PBNJSON_STRING_CHUNKS_ERR", 0, "Failed to allocate space for string chunks");
+		jstring_chunks_free(chunks);
+		return false;
+	}
+
+	chunks->m_callbacks = *callbacks;
+	chunks->m_chunkSize = chunkSize;
+	chunks->m_state = SCAN_STRUCTURE;
+	chunks->m_keepContent = string_validators_need_content(parser->validator, parser->uri_resolver);
+	parser->internalCtxt.m_stringChunks = chunks;
+	return true;
+}
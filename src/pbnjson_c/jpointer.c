@@ -0,0 +1,119 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jpointer.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool jpointer_unescape(const char *token, size_t len, char *dst, size_t *dst_len)
+{
+	size_t j = 0;
+	for (size_t i = 0; i < len; ++i) {
+		if (token[i] != '~') {
+			dst[j++] = token[i];
+			continue;
+		}
+		if (++i == len || (token[i] != '0' && token[i] != '1'))
+			return false;
+		dst[j++] = token[i] == '0' ? '~' : '/';
+	}
+	dst[j] = '\0';
+	*dst_len = j;
+	return true;
+}
+
+bool jpointer_path_init(jpointer_path *path, const char *pointer)
+{
+	CHECK_POINTER_RETURN_VALUE(pointer, false);
+	if (*pointer != '\0' && *pointer != '/') {
+		PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", pointer), "JSON Pointer should start with '/'");
+		return false;
+	}
+
+	size_t count = 0;
+	for (const char *c = pointer; *c; ++c) {
+		if (*c == '/')
+			++count;
+	}
+
+	// The tokens take no more room than the pointer, the slashes become the terminating nulls
+	raw_buffer *tokens = malloc(count * sizeof(raw_buffer) + strlen(pointer) + 1);
+	CHECK_ALLOC_RETURN_VALUE(tokens, false);
+
+	char *dst = (char *) (tokens + count);
+	const char *end = pointer;
+	for (size_t i = 0; i < count; ++i) {
+		const char *token = end + 1;
+		end = strchrnul(token, '/');
+
+		size_t len;
+		if (!jpointer_unescape(token, end - token, dst, &len)) {
+			PJ_LOG_ERR("PBNJSON_BAD_POINTER", 1, PMLOGKS("PATH", pointer), "Invalid escape sequence in JSON Pointer");
+			free(tokens);
+			return false;
+		}
+		tokens[i] = j_str_to_buffer(dst, len);
+		dst += len + 1;
+	}
+
+	path->m_tokens = tokens;
+	path->m_count = count;
+	return true;
+}
+
+void jpointer_path_clear(jpointer_path *path)
+{
+	free(path->m_tokens);
+	path->m_tokens = NULL;
+	path->m_count = 0;
+}
+
+ssize_t jpointer_index(raw_buffer token)
+{
+	if (!token.m_len || token.m_len > 18 || (token.m_str[0] == '0' && token.m_len > 1))
+		return -1;
+
+	ssize_t index = 0;
+	for (size_t i = 0; i < token.m_len; ++i) {
+		if (token.m_str[i] < '0' || token.m_str[i] > '9')
+			return -1;
+		index = index * 10 + (token.m_str[i] - '0');
+	}
+	return index;
+}
+
+jvalue_ref jpointer_get(jvalue_ref val, const jpointer_path *path)
+{
+	for (size_t i = 0; i < path->m_count; ++i) {
+		if (jis_object(val)) {
+			if (!jobject_get_exists(val, path->m_tokens[i], &val))
+				return NULL;
+		} else if (jis_array(val)) {
+			ssize_t index = jpointer_index(path->m_tokens[i]);
+			if (index < 0 || index >= jarray_size(val))
+				return NULL;
+			val = jarray_get(val, index);
+		} else {
+			return NULL;
+		}
+	}
+	return val;
+}
@@ -0,0 +1,67 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JPOINTER_H_
+#define JPOINTER_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <japi.h>
+#include <jtypes.h>
+
+/**
+ * JSON Pointer (RFC 6901) split into the unescaped reference tokens, each one null-terminated
+ */
+typedef struct {
+	raw_buffer *m_tokens;
+	size_t m_count;
+} jpointer_path;
+
+/**
+ * @brief jpointer_unescape Unescape JSON Pointer reference token ("~0" is "~", "~1" is "/")
+ * @param token The reference token
+ * @param len Length of the token
+ * @param dst Buffer for at least len + 1 characters, the result is null-terminated
+ * @param dst_len Length of the result
+ * @return false if the token has an invalid escape sequence
+ */
+PJSON_LOCAL bool jpointer_unescape(const char *token, size_t len, char *dst, size_t *dst_len);
+
+/**
+ * @brief jpointer_path_init Split the JSON Pointer into the reference tokens
+ * @param path The path to initialize, release it with jpointer_path_clear
+ * @param pointer The JSON Pointer, "" for the whole document
+ * @return false if the pointer is invalid or memory is out
+ */
+PJSON_LOCAL bool jpointer_path_init(jpointer_path *path, const char *pointer);
+
+PJSON_LOCAL void jpointer_path_clear(jpointer_path *path);
+
+/**
+ * @brief jpointer_index Index of an array element referred by the token
+ * @return The index, or -1 if the token isn't one
+ */
+PJSON_LOCAL ssize_t jpointer_index(raw_buffer token);
+
+/**
+ * @brief jpointer_get Find the value the path refers within the value
+ * @return The value, or NULL if there is none
+ */
+PJSON_LOCAL jvalue_ref jpointer_get(jvalue_ref val, const jpointer_path *path);
+
+#endif /* JPOINTER_H_ */
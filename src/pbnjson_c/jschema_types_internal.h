@@ -47,6 +47,14 @@ struct __JSAXContext
 	int m_error_code;
 	char *errorDescription;
 	ValidationState *validation_state;
+	int m_depth; /// nesting level within the current top-level value
+	bool (*m_documentEnd)(struct __JSAXContext *ctxt); /// called after every top-level value, if set
+	struct JStringChunks *m_stringChunks; /// delivery of long strings by chunks, NULL if it's off
+	struct JDeferredEvents *m_deferred; /// events parsed while paused, NULL until jsaxparser_feed_ex
+	bool m_validateUtf8; /// strings and keys are checked for UTF-8
+	bool m_invalidUtf8; /// a string or a key has failed the check
+	bool m_tooDeep; /// the value is nested deeper than JVALUE_MAX_DEPTH
+	bool m_defaults; /// a default value of the schema has been inserted
 };
 
 jschema_ref jschema_new(void);
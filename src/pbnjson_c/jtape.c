@@ -0,0 +1,513 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jtape.h>
+#include <jparse_stream.h>
+#include <jobject.h>
+
+#include "liblog.h"
+#include "jparse_stream_internal.h"
+#include "jvalue/num_conversion.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Every word of the tape is a type tag in the high byte and a payload:
+ *  - TAPE_NULL, TAPE_TRUE, TAPE_FALSE: no payload
+ *  - TAPE_STRING: offset of the string in the arena, where it is stored as
+ *    a 32-bit length, the bytes and a terminating null
+ *  - TAPE_INT: the next word is the int64_t value
+ *  - TAPE_RAW_NUMBER: offset of the textual number in the arena (same format as strings),
+ *    for the numbers that don't fit in int64_t losslessly
+ *  - TAPE_OBJECT, TAPE_ARRAY: index of the word past the matching end word
+ *  - TAPE_OBJECT_END, TAPE_ARRAY_END: number of members or elements
+ * Object members are stored as a key string followed by the value.
+ */
+#define TAPE_NULL        'n'
+#define TAPE_TRUE        't'
+#define TAPE_FALSE       'f'
+#define TAPE_STRING      '"'
+#define TAPE_INT         'l'
+#define TAPE_RAW_NUMBER  'r'
+#define TAPE_OBJECT      '{'
+#define TAPE_OBJECT_END  '}'
+#define TAPE_ARRAY       '['
+#define TAPE_ARRAY_END   ']'
+
+#define TAPE_TYPE_SHIFT 56
+#define TAPE_PAYLOAD_MASK ((UINT64_C(1) << TAPE_TYPE_SHIFT) - 1)
+
+struct jtape {
+	uint64_t *m_words;
+	size_t m_size;
+	size_t m_capacity;
+
+	char *m_arena;
+	size_t m_arenaSize;
+	size_t m_arenaCapacity;
+};
+
+static inline char tape_type(const struct jtape *tape, size_t index)
+{
+	return tape->m_words[index] >> TAPE_TYPE_SHIFT;
+}
+
+static inline uint64_t tape_payload(const struct jtape *tape, size_t index)
+{
+	return tape->m_words[index] & TAPE_PAYLOAD_MASK;
+}
+
+static inline raw_buffer tape_arena_string(const struct jtape *tape, size_t offset)
+{
+	uint32_t len;
+	memcpy(&len, tape->m_arena + offset, sizeof(len));
+	return j_str_to_buffer(tape->m_arena + offset + sizeof(len), len);
+}
+
+// Index of the value following the one at index
+static inline size_t tape_skip(const struct jtape *tape, size_t index)
+{
+	switch (tape_type(tape, index)) {
+	case TAPE_OBJECT:
+	case TAPE_ARRAY:
+		return tape_payload(tape, index);
+	case TAPE_INT:
+		return index + 2;
+	default:
+		return index + 1;
+	}
+}
+
+static const jtape_cursor INVALID_CURSOR = { NULL, 0 };
+
+/************************* TAPE BUILDER ****************************************/
+
+typedef struct tape_frame {
+	size_t open;   // index of the start word
+	size_t count;
+} tape_frame;
+
+typedef struct tape_builder {
+	struct jtape *tape;
+	tape_frame *frames;
+	size_t depth;
+	size_t framesCapacity;
+} tape_builder;
+
+static bool tape_reserve(struct jtape *tape, size_t words)
+{
+	if (tape->m_size + words <= tape->m_capacity)
+		return true;
+
+	size_t capacity = tape->m_capacity ? tape->m_capacity * 2 : 256;
+	while (capacity < tape->m_size + words)
+		capacity *= 2;
+	uint64_t *newWords = realloc(tape->m_words, capacity * sizeof(uint64_t));
+	CHECK_ALLOC_RETURN_VALUE(newWords, false);
+	tape->m_words = newWords;
+	tape->m_capacity = capacity;
+	return true;
+}
+
+static int tape_append(tape_builder *b, char type, uint64_t payload)
+{
+	if (!tape_reserve(b->tape, 1))
+		return 0;
+	b->tape->m_words[b->tape->m_size++] = ((uint64_t)(unsigned char)type << TAPE_TYPE_SHIFT) | payload;
+	return 1;
+}
+
+static int tape_append_arena(tape_builder *b, char type, const char *str, size_t len)
+{
+	struct jtape *tape = b->tape;
+	CHECK_CONDITION_RETURN_VALUE(len > UINT32_MAX, 0, "String is too long for the tape: %zu", len);
+
+	size_t needed = sizeof(uint32_t) + len + 1;
+	if (tape->m_arenaSize + needed > tape->m_arenaCapacity) {
+		size_t capacity = tape->m_arenaCapacity ? tape->m_arenaCapacity * 2 : 4096;
+		while (capacity < tape->m_arenaSize + needed)
+			capacity *= 2;
+		char *arena = realloc(tape->m_arena, capacity);
+		CHECK_ALLOC_RETURN_VALUE(arena, 0);
+		tape->m_arena = arena;
+		tape->m_arenaCapacity = capacity;
+	}
+
+	size_t offset = tape->m_arenaSize;
+	uint32_t len32 = len;
+	memcpy(tape->m_arena + offset, &len32, sizeof(len32));
+	memcpy(tape->m_arena + offset + sizeof(len32), str, len);
+	tape->m_arena[offset + sizeof(len32) + len] = '\0';
+	tape->m_arenaSize += needed;
+
+	return tape_append(b, type, offset);
+}
+
+static inline tape_builder *tape_get_builder(JSAXContextRef ctxt)
+{
+	return (tape_builder *)jsax_getContext(ctxt);
+}
+
+// Values within arrays are counted here, object members are counted by their keys
+static inline void tape_count_value(tape_builder *b)
+{
+	if (b->depth > 0 && tape_type(b->tape, b->frames[b->depth - 1].open) == TAPE_ARRAY)
+		++b->frames[b->depth - 1].count;
+}
+
+static int tape_null(JSAXContextRef ctxt)
+{
+	tape_builder *b = tape_get_builder(ctxt);
+	tape_count_value(b);
+	return tape_append(b, TAPE_NULL, 0);
+}
+
+static int tape_boolean(JSAXContextRef ctxt, bool value)
+{
+	tape_builder *b = tape_get_builder(ctxt);
+	tape_count_value(b);
+	return tape_append(b, value ? TAPE_TRUE : TAPE_FALSE, 0);
+}
+
+static int tape_number(JSAXContextRef ctxt, const char *number, size_t numberLen)
+{
+	tape_builder *b = tape_get_builder(ctxt);
+	tape_count_value(b);
+
+	// Integers are kept inline, anything else in the textual form to be converted without loss on demand
+	if (!memchr(number, '.', numberLen) && !memchr(number, 'e', numberLen) && !memchr(number, 'E', numberLen)) {
+		raw_buffer raw = j_str_to_buffer(number, numberLen);
+		int64_t value;
+		if (jstr_to_i64(&raw, &value) == CONV_OK) {
+			if (!tape_append(b, TAPE_INT, 0) || !tape_reserve(b->tape, 1))
+				return 0;
+			b->tape->m_words[b->tape->m_size++] = (uint64_t)value;
+			return 1;
+		}
+	}
+	return tape_append_arena(b, TAPE_RAW_NUMBER, number, numberLen);
+}
+
+static int tape_string(JSAXContextRef ctxt, const char *string, size_t stringLen)
+{
+	tape_builder *b = tape_get_builder(ctxt);
+	tape_count_value(b);
+	return tape_append_arena(b, TAPE_STRING, string, stringLen);
+}
+
+static int tape_object_key(JSAXContextRef ctxt, const char *key, size_t keyLen)
+{
+	tape_builder *b = tape_get_builder(ctxt);
+	assert(b->depth > 0);
+	++b->frames[b->depth - 1].count;
+	return tape_append_arena(b, TAPE_STRING, key, keyLen);
+}
+
+static int tape_open(tape_builder *b, char type)
+{
+	tape_count_value(b);
+
+	if (b->depth == b->framesCapacity) {
+		size_t capacity = b->framesCapacity ? b->framesCapacity * 2 : 32;
+		tape_frame *frames = realloc(b->frames, capacity * sizeof(tape_frame));
+		CHECK_ALLOC_RETURN_VALUE(frames, 0);
+		b->frames = frames;
+		b->framesCapacity = capacity;
+	}
+	b->frames[b->depth].open = b->tape->m_size;
+	b->frames[b->depth].count = 0;
+	++b->depth;
+
+	// The payload is patched when the container ends
+	return tape_append(b, type, 0);
+}
+
+static int tape_close(tape_builder *b, char type)
+{
+	assert(b->depth > 0);
+	tape_frame *frame = &b->frames[--b->depth];
+	if (!tape_append(b, type, frame->count))
+		return 0;
+	b->tape->m_words[frame->open] |= b->tape->m_size;
+	return 1;
+}
+
+static int tape_object_start(JSAXContextRef ctxt) { return tape_open(tape_get_builder(ctxt), TAPE_OBJECT); }
+static int tape_object_end(JSAXContextRef ctxt) { return tape_close(tape_get_builder(ctxt), TAPE_OBJECT_END); }
+static int tape_array_start(JSAXContextRef ctxt) { return tape_open(tape_get_builder(ctxt), TAPE_ARRAY); }
+static int tape_array_end(JSAXContextRef ctxt) { return tape_close(tape_get_builder(ctxt), TAPE_ARRAY_END); }
+
+static PJSAXCallbacks tape_callbacks = {
+	tape_object_start,
+	tape_object_key,
+	tape_object_end,
+	tape_array_start,
+	tape_array_end,
+	tape_string,
+	tape_number,
+	tape_boolean,
+	tape_null,
+};
+
+jtape_ref jtape_parse(raw_buffer input, JSchemaInfoRef schemaInfo)
+{
+	CHECK_POINTER_RETURN_NULL(schemaInfo);
+
+	struct jtape *tape = calloc(1, sizeof(struct jtape));
+	CHECK_ALLOC_RETURN_NULL(tape);
+
+	tape_builder builder = { .tape = tape };
+	struct jsaxparser parser;
+	bool parsed = false;
+	if (jsaxparser_init(&parser, schemaInfo, &tape_callbacks, &builder)) {
+		parsed = jsaxparser_feed(&parser, input.m_str, input.m_len) && jsaxparser_end(&parser);
+		jsaxparser_deinit(&parser);
+	}
+	free(builder.frames);
+
+	if (!parsed || tape->m_size == 0) {
+		jtape_release(&tape);
+		return NULL;
+	}
+
+	return tape;
+}
+
+void jtape_release(jtape_ref *tape)
+{
+	CHECK_POINTER(tape);
+	if (*tape) {
+		free((*tape)->m_words);
+		free((*tape)->m_arena);
+		free(*tape);
+		*tape = NULL;
+	}
+}
+
+/************************* NAVIGATION *****************************************/
+
+jtape_cursor jtape_root(jtape_ref tape)
+{
+	jtape_cursor cur = { tape, 0 };
+	return cur;
+}
+
+bool jtape_is_valid(jtape_cursor cur)
+{
+	return cur.m_tape != NULL;
+}
+
+JValueType jtape_get_type(jtape_cursor cur)
+{
+	if (!cur.m_tape)
+		return JV_NULL;
+
+	switch (tape_type(cur.m_tape, cur.m_index)) {
+	case TAPE_TRUE:
+	case TAPE_FALSE:
+		return JV_BOOL;
+	case TAPE_INT:
+	case TAPE_RAW_NUMBER:
+		return JV_NUM;
+	case TAPE_STRING:
+		return JV_STR;
+	case TAPE_ARRAY:
+		return JV_ARRAY;
+	case TAPE_OBJECT:
+		return JV_OBJECT;
+	default:
+		return JV_NULL;
+	}
+}
+
+size_t jtape_size(jtape_cursor cur)
+{
+	JValueType type = jtape_get_type(cur);
+	if (type != JV_OBJECT && type != JV_ARRAY)
+		return 0;
+	// The end word keeps the count
+	return tape_payload(cur.m_tape, tape_payload(cur.m_tape, cur.m_index) - 1);
+}
+
+jtape_cursor jtape_find_key(jtape_cursor obj, raw_buffer key)
+{
+	CHECK_CONDITION_RETURN_VALUE(jtape_get_type(obj) != JV_OBJECT, INVALID_CURSOR, "Attempt to find a key in a non-object");
+
+	const struct jtape *tape = obj.m_tape;
+	size_t end = tape_payload(tape, obj.m_index) - 1;
+	for (size_t i = obj.m_index + 1; i < end; i = tape_skip(tape, i + 1)) {
+		assert(tape_type(tape, i) == TAPE_STRING);
+		raw_buffer name = tape_arena_string(tape, tape_payload(tape, i));
+		if (name.m_len == key.m_len && memcmp(name.m_str, key.m_str, key.m_len) == 0) {
+			jtape_cursor value = { obj.m_tape, i + 1 };
+			return value;
+		}
+	}
+
+	return INVALID_CURSOR;
+}
+
+jtape_cursor jtape_index(jtape_cursor arr, size_t index)
+{
+	CHECK_CONDITION_RETURN_VALUE(jtape_get_type(arr) != JV_ARRAY, INVALID_CURSOR, "Attempt to index a non-array");
+
+	const struct jtape *tape = arr.m_tape;
+	size_t end = tape_payload(tape, arr.m_index) - 1;
+	if (index >= tape_payload(tape, end))
+		return INVALID_CURSOR;
+
+	size_t i = arr.m_index + 1;
+	while (index--)
+		i = tape_skip(tape, i);
+
+	jtape_cursor value = { arr.m_tape, i };
+	return value;
+}
+
+bool jtape_iter_init(jtape_iter *iter, jtape_cursor container)
+{
+	JValueType type = jtape_get_type(container);
+	CHECK_CONDITION_RETURN_VALUE(type != JV_OBJECT && type != JV_ARRAY, false, "Cannot iterate over non-container");
+
+	iter->m_cur.m_tape = container.m_tape;
+	iter->m_cur.m_index = container.m_index + 1;
+	iter->m_object = type == JV_OBJECT;
+	return true;
+}
+
+bool jtape_iter_next(jtape_iter *iter, jtape_cursor *key, jtape_cursor *value)
+{
+	const struct jtape *tape = iter->m_cur.m_tape;
+	if (!tape)
+		return false;
+
+	char type = tape_type(tape, iter->m_cur.m_index);
+	if (type == TAPE_OBJECT_END || type == TAPE_ARRAY_END)
+		return false;
+
+	if (key)
+		*key = iter->m_object ? iter->m_cur : INVALID_CURSOR;
+	if (iter->m_object)
+		++iter->m_cur.m_index;
+	if (value)
+		*value = iter->m_cur;
+	iter->m_cur.m_index = tape_skip(tape, iter->m_cur.m_index);
+	return true;
+}
+
+/************************* SCALARS ********************************************/
+
+bool jtape_get_boolean(jtape_cursor cur, bool *value)
+{
+	if (jtape_get_type(cur) != JV_BOOL)
+		return false;
+	*value = tape_type(cur.m_tape, cur.m_index) == TAPE_TRUE;
+	return true;
+}
+
+bool jtape_get_string(jtape_cursor cur, raw_buffer *value)
+{
+	if (jtape_get_type(cur) != JV_STR)
+		return false;
+	*value = tape_arena_string(cur.m_tape, tape_payload(cur.m_tape, cur.m_index));
+	return true;
+}
+
+ConversionResultFlags jtape_get_i32(jtape_cursor cur, int32_t *value)
+{
+	CHECK_CONDITION_RETURN_VALUE(jtape_get_type(cur) != JV_NUM, CONV_BAD_ARGS, "Trying to access non-number as a number");
+
+	if (tape_type(cur.m_tape, cur.m_index) == TAPE_INT)
+		return ji64_to_i32((int64_t)cur.m_tape->m_words[cur.m_index + 1], value);
+	raw_buffer raw = tape_arena_string(cur.m_tape, tape_payload(cur.m_tape, cur.m_index));
+	return jstr_to_i32(&raw, value);
+}
+
+ConversionResultFlags jtape_get_i64(jtape_cursor cur, int64_t *value)
+{
+	CHECK_CONDITION_RETURN_VALUE(jtape_get_type(cur) != JV_NUM, CONV_BAD_ARGS, "Trying to access non-number as a number");
+
+	if (tape_type(cur.m_tape, cur.m_index) == TAPE_INT) {
+		*value = (int64_t)cur.m_tape->m_words[cur.m_index + 1];
+		return CONV_OK;
+	}
+	raw_buffer raw = tape_arena_string(cur.m_tape, tape_payload(cur.m_tape, cur.m_index));
+	return jstr_to_i64(&raw, value);
+}
+
+ConversionResultFlags jtape_get_f64(jtape_cursor cur, double *value)
+{
+	CHECK_CONDITION_RETURN_VALUE(jtape_get_type(cur) != JV_NUM, CONV_BAD_ARGS, "Trying to access non-number as a number");
+
+	if (tape_type(cur.m_tape, cur.m_index) == TAPE_INT)
+		return ji64_to_double((int64_t)cur.m_tape->m_words[cur.m_index + 1], value);
+	raw_buffer raw = tape_arena_string(cur.m_tape, tape_payload(cur.m_tape, cur.m_index));
+	return jstr_to_double(&raw, value);
+}
+
+/************************* CONVERSION *****************************************/
+
+jvalue_ref jvalue_from_tape(jtape_cursor cur)
+{
+	if (!cur.m_tape)
+		return jinvalid();
+
+	const struct jtape *tape = cur.m_tape;
+	switch (tape_type(tape, cur.m_index)) {
+	case TAPE_NULL:
+		return jnull();
+	case TAPE_TRUE:
+		return jboolean_create(true);
+	case TAPE_FALSE:
+		return jboolean_create(false);
+	case TAPE_INT:
+		return jnumber_create_i64((int64_t)tape->m_words[cur.m_index + 1]);
+	case TAPE_RAW_NUMBER:
+		return jnumber_create(tape_arena_string(tape, tape_payload(tape, cur.m_index)));
+	case TAPE_STRING:
+		return jstring_create_copy(tape_arena_string(tape, tape_payload(tape, cur.m_index)));
+	case TAPE_ARRAY: {
+		size_t size = jtape_size(cur);
+		jvalue_ref arr = size ? jarray_create_hint(NULL, size) : jarray_create(NULL);
+		jtape_iter it;
+		jtape_cursor value;
+		jtape_iter_init(&it, cur);
+		while (jtape_iter_next(&it, NULL, &value)) {
+			if (!jarray_append(arr, jvalue_from_tape(value))) {
+				j_release(&arr);
+				return jinvalid();
+			}
+		}
+		return arr;
+	}
+	case TAPE_OBJECT: {
+		jvalue_ref obj = jobject_create_hint(jtape_size(cur));
+		jtape_iter it;
+		jtape_cursor key, value;
+		jtape_iter_init(&it, cur);
+		// Same as the DOM parser, members that can't be put (like empty keys) are dropped
+		while (jtape_iter_next(&it, &key, &value))
+			jobject_put(obj, jvalue_from_tape(key), jvalue_from_tape(value));
+		return obj;
+	}
+	default:
+		assert(false);
+		return jinvalid();
+	}
+}
@@ -22,40 +22,21 @@
 #include "jobject_internal.h"
 #include "jparse_stream_internal.h"
 #include "jtraverse.h"
+#include "jvalue/stack.h"
 
-static bool jkeyvalue_traverse(jobject_key_value jref, TraverseCallbacksRef tc, void *context)
+// The elements are passed as raw numbers living on the stack, none of them is boxed
+static bool jpacked_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *context)
 {
-	if (!tc->jobj_key(context, jref.key))
-		return false;
-	return jvalue_traverse(jref.value, tc, context);
-}
-
-static bool jobject_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *context)
-{
-	if (!tc->jobj_start(context, jref))
-		return false;
+	char buf[JPACKED_TEXT_MAX];
+	jnum element = {
+		.m_value = { .m_type = JV_NUM, .m_refCnt = 1 },
+		.m_type = NUM_RAW,
+	};
 
-	jobject_iter it;
-	jobject_iter_init(&it, jref);
-	jobject_key_value key_value;
-	while (jobject_iter_next(&it, &key_value))
+	for (ssize_t i = 0; i < jarray_deref(jref)->m_size; i++)
 	{
-		if (!jkeyvalue_traverse(key_value, tc, context))
-			return false;
-	}
-
-	return tc->jobj_end(context, jref);
-}
-
-static bool jarray_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *context)
-{
-	if (!tc->jarr_start(context, jref))
-		return false;
-
-	for (int i = 0; i < jarray_size(jref); i++)
-	{
-		jvalue_ref element = jarray_get(jref, i);
-		if (!jvalue_traverse(element, tc, context))
+		element.value.raw = j_str_to_buffer(buf, jpacked_text(jref, i, buf));
+		if (!tc->jnumber_raw(context, &element.m_value))
 			return false;
 	}
 
@@ -77,19 +58,70 @@ static bool jnumber_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *con
 	}
 }
 
-bool jvalue_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *context)
+// Deliver a scalar, or the start of a container which members are walked through then
+static bool jvalue_traverse_enter(jstack *stack, jvalue_ref jref, TraverseCallbacksRef tc, void *context)
 {
 	assert(jis_valid(jref));
 
+	// A copy of a frozen container is read through its source, the walk doesn't copy it
+	jref = jview_origin(jref);
+
 	switch (jref->m_type)
 	{
 	case JV_NULL   : return tc->jnull(context, jref);
-	case JV_OBJECT : return jobject_traverse(jref, tc, context);
-	case JV_ARRAY  : return jarray_traverse(jref, tc, context);
 	case JV_NUM    : return jnumber_traverse(jref, tc, context);
 	case JV_STR    : return tc->jstring(context, jref);
 	case JV_BOOL   : return tc->jbool(context, jref);
+	case JV_OBJECT :
+		if (!tc->jobj_start(context, jref))
+			return false;
+		break;
+	case JV_ARRAY  :
+		if (!tc->jarr_start(context, jref))
+			return false;
+
+		// A copy of a packed array is packed once it is filled
+		jlazy_ensure(jref);
+		if (jarray_deref(jref)->m_packed)
+			return jpacked_traverse(jref, tc, context);
+		break;
+	default:
+		return false;
+	}
+
+	jchild_iter *it = jstack_push(stack);
+	if (!it)
+		return false;
+	jchild_iter_init(it, jref);
+	return true;
+}
+
+bool jvalue_traverse(jvalue_ref jref, TraverseCallbacksRef tc, void *context)
+{
+	jstack stack;
+	jstack_init(&stack, sizeof(jchild_iter), JVALUE_MAX_DEPTH);
+
+	bool result = jvalue_traverse_enter(&stack, jref, tc, context);
+	while (result && !jstack_empty(&stack))
+	{
+		jchild_iter *it = jstack_top(&stack);
+		jobject_key_value child;
+		if (!jchild_iter_next(it, &child))
+		{
+			jvalue_ref container = it->m_container;
+			jstack_pop(&stack);
+			result = jis_object(container) ? tc->jobj_end(context, container) : tc->jarr_end(context, container);
+		}
+		else if (child.key && !tc->jobj_key(context, child.key))
+		{
+			result = false;
+		}
+		else
+		{
+			result = jvalue_traverse_enter(&stack, child.value, tc, context);
+		}
 	}
+	jstack_destroy(&stack);
 
-	return false;
+	return result;
 }
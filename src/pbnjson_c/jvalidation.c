@@ -180,7 +180,7 @@ static bool on_default_property(ValidationState *s, char const *key, jvalue_ref
 {
 	ValidationContext *ctxt = (ValidationContext *)_ctxt;
 	assert(ctxt->jvalue);
-	return jobject_put(ctxt->jvalue, jstring_create(key), jvalue_duplicate(value));
+	return jobject_put(ctxt->jvalue, jstring_create(key), jvalue_duplicate_private(value));
 }
 
 static Notification jvalue_apply_notification =
@@ -0,0 +1,273 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include "canon.h"
+#include <string.h>
+
+// Longer strings and bigger containers are rarely repeated, they aren't worth hashing
+#define JCANON_MAX_STRING 256
+#define JCANON_MAX_MEMBERS 16
+
+static guint canon_hash_bytes(guint hash, const void *data, size_t len)
+{
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < len; ++i)
+		hash = hash * 33 + bytes[i];
+	return hash;
+}
+
+// The children of a canonical container are canonical, they are compared by their addresses
+static bool canon_is_canonical(jvalue_ref val)
+{
+	return val->m_frozen || jis_const(val);
+}
+
+// The document refers the canonical containers through their copies (see dom_intern_container)
+static inline jvalue_ref canon_member(jvalue_ref val)
+{
+	return jview_origin(val);
+}
+
+static size_t packed_width(const jpacked *packed)
+{
+	return packed->m_type == PACKED_I64 ? sizeof(int64_t) : sizeof(double);
+}
+
+static bool canon_eligible(jvalue_ref val)
+{
+	switch (val->m_type) {
+	case JV_STR:
+		return jstring_deref(val)->m_data.m_len <= JCANON_MAX_STRING;
+	case JV_NUM:
+		return jnum_deref(val)->m_type == NUM_RAW;
+	case JV_BOOL:
+		return true;
+	case JV_ARRAY:
+		if (jis_lazy(val) || jarray_deref(val)->m_size > JCANON_MAX_MEMBERS)
+			return false;
+		if (jis_packed(val))
+			return true;
+		for (ssize_t i = 0; i < jarray_deref(val)->m_size; ++i) {
+			if (!canon_is_canonical(canon_member(*jarray_slot(jarray_deref(val), i))))
+				return false;
+		}
+		return true;
+	case JV_OBJECT: {
+		if (jis_lazy(val) || jobject_size(val) > JCANON_MAX_MEMBERS)
+			return false;
+		jobject_iter it;
+		jobject_key_value member;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &member)) {
+			if (!canon_is_canonical(canon_member(member.value)))
+				return false;
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static guint canon_hash(gconstpointer key)
+{
+	jvalue_ref val = (jvalue_ref) key;
+	guint hash = 5381 + val->m_type;
+
+	switch (val->m_type) {
+	case JV_STR:
+		return canon_hash_bytes(hash, jstring_deref(val)->m_data.m_str, jstring_deref(val)->m_data.m_len);
+	case JV_NUM:
+		return canon_hash_bytes(hash, jnum_deref(val)->value.raw.m_str, jnum_deref(val)->value.raw.m_len);
+	case JV_BOOL:
+		return hash * 33 + jboolean_deref(val)->value;
+	case JV_ARRAY: {
+		jarray *arr = jarray_deref(val);
+		if (arr->m_packed)
+			return canon_hash_bytes(hash * 33 + arr->m_packed->m_type, arr->m_packed->m_data.i64,
+			                        arr->m_size * packed_width(arr->m_packed));
+		for (ssize_t i = 0; i < arr->m_size; ++i)
+			hash = hash * 33 + g_direct_hash(canon_member(*jarray_slot(arr, i)));
+		return hash;
+	}
+	case JV_OBJECT: {
+		// The same members in any order
+		jobject_iter it;
+		jobject_key_value member;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &member)) {
+			raw_buffer name = jstring_deref(member.key)->m_data;
+			hash += canon_hash_bytes(g_direct_hash(canon_member(member.value)), name.m_str, name.m_len);
+		}
+		return hash;
+	}
+	default:
+		return hash;
+	}
+}
+
+static bool canon_array_equal(jarray *arr, jarray *other)
+{
+	if (arr->m_size != other->m_size || !arr->m_packed != !other->m_packed)
+		return false;
+
+	if (arr->m_packed) {
+		return arr->m_packed->m_type == other->m_packed->m_type &&
+		       memcmp(arr->m_packed->m_data.i64, other->m_packed->m_data.i64,
+		              arr->m_size * packed_width(arr->m_packed)) == 0;
+	}
+
+	for (ssize_t i = 0; i < arr->m_size; ++i) {
+		if (canon_member(*jarray_slot(arr, i)) != canon_member(*jarray_slot(other, i)))
+			return false;
+	}
+	return true;
+}
+
+static bool canon_object_equal(jvalue_ref obj, jvalue_ref other)
+{
+	// The shaped objects keep the order of the keys, the canonical one should have the same
+	if (jis_shaped(obj) != jis_shaped(other) || jobject_size(obj) != jobject_size(other))
+		return false;
+
+	jobject_iter it, otherIt;
+	jobject_key_value member, otherMember;
+	jobject_iter_init(&it, obj);
+	jobject_iter_init(&otherIt, other);
+	while (jobject_iter_next(&it, &member)) {
+		if (jis_shaped(obj)) {
+			jobject_iter_next(&otherIt, &otherMember);
+			if (!jstring_equal(member.key, otherMember.key))
+				return false;
+		} else if (!jobject_get_exists2(other, member.key, &otherMember.value)) {
+			return false;
+		}
+		if (canon_member(member.value) != canon_member(otherMember.value))
+			return false;
+	}
+	return true;
+}
+
+static gboolean canon_equal(gconstpointer a, gconstpointer b)
+{
+	jvalue_ref val = (jvalue_ref) a;
+	jvalue_ref other = (jvalue_ref) b;
+
+	if (val->m_type != other->m_type)
+		return false;
+
+	switch (val->m_type) {
+	case JV_STR:
+		return jbuffer_equal(jstring_deref(val)->m_data, jstring_deref(other)->m_data);
+	case JV_NUM:
+		return jbuffer_equal(jnum_deref(val)->value.raw, jnum_deref(other)->value.raw);
+	case JV_BOOL:
+		return jboolean_deref(val)->value == jboolean_deref(other)->value;
+	case JV_ARRAY:
+		return canon_array_equal(jarray_deref(val), jarray_deref(other));
+	case JV_OBJECT:
+		return canon_object_equal(val, other);
+	default:
+		return false;
+	}
+}
+
+static void canon_release(gpointer val)
+{
+	jvalue_ref ref = val;
+	j_release(&ref);
+}
+
+// The numbers of an array unpacked by a later element weren't interned one by one
+static void canon_intern_numbers(jcanon *canon, jarray *arr)
+{
+	for (ssize_t i = 0; i < arr->m_size; ++i) {
+		jvalue_ref *slot = jarray_slot(arr, i);
+		if ((*slot)->m_type == JV_NUM && !canon_is_canonical(*slot))
+			*slot = jcanon_intern(canon, *slot);
+	}
+}
+
+static void canon_unwrap(jvalue_ref *slot)
+{
+	jvalue_ref origin = canon_member(*slot);
+	if (origin != *slot) {
+		jvalue_copy(origin);
+		j_release(slot);
+		*slot = origin;
+	}
+}
+
+// The canonical container is shared as a whole, it refers the canonical members themselves
+static void canon_unwrap_members(jvalue_ref val)
+{
+	if (val->m_type == JV_ARRAY) {
+		jarray *arr = jarray_deref(val);
+		for (ssize_t i = 0; !arr->m_packed && i < arr->m_size; ++i)
+			canon_unwrap(jarray_slot(arr, i));
+	} else if (val->m_type == JV_OBJECT && jobject_deref(val)->m_shape) {
+		jobject *obj = jobject_deref(val);
+		for (size_t i = 0; i < jshape_size(obj->m_shape); ++i)
+			canon_unwrap(&obj->m_slots[i]);
+	} else if (val->m_type == JV_OBJECT) {
+		GHashTableIter it;
+		gpointer key, member;
+		g_hash_table_iter_init(&it, jobject_deref(val)->m_members);
+		while (g_hash_table_iter_next(&it, &key, &member)) {
+			jvalue_ref origin = canon_member(member);
+			if (origin != member)
+				g_hash_table_iter_replace(&it, jvalue_copy(origin));
+		}
+	}
+}
+
+jvalue_ref jcanon_intern(jcanon *canon, jvalue_ref val)
+{
+	if (canon_is_canonical(val))
+		return val;
+	if (val->m_type == JV_ARRAY && !jis_lazy(val) && !jis_packed(val) && jarray_deref(val)->m_size <= JCANON_MAX_MEMBERS)
+		canon_intern_numbers(canon, jarray_deref(val));
+	if (!canon_eligible(val))
+		return val;
+
+	if (!canon->m_table)
+		canon->m_table = g_hash_table_new_full(canon_hash, canon_equal, canon_release, NULL);
+
+	jvalue_ref canonical = g_hash_table_lookup(canon->m_table, val);
+	if (canonical) {
+		j_release(&val);
+		return jvalue_copy(canonical);
+	}
+
+	canon_unwrap_members(val);
+	val->m_frozen = true;
+	g_hash_table_add(canon->m_table, jvalue_copy(val));
+	return val;
+}
+
+void jcanon_clear(jcanon *canon)
+{
+	if (canon->m_table) {
+		g_hash_table_destroy(canon->m_table);
+		canon->m_table = NULL;
+	}
+}
@@ -0,0 +1,58 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JCANON_INTERNAL_H_
+#define JCANON_INTERNAL_H_
+
+#include <glib.h>
+#include <japi.h>
+#include <jtypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Canonical instances of the values of a document, the equal values are replaced by references
+ * to them (see DOMOPT_DEDUPLICATE)
+ */
+typedef struct jcanon {
+	GHashTable *m_table; // the canonical values, created with the first one
+} jcanon;
+
+/**
+ * Replace the value by its canonical instance. Strings, numbers, booleans and small containers
+ * of canonical values become canonical, they are frozen. The members of a container may be
+ * copies of the canonical containers (see jview_create), the canonical one refers them directly.
+ *
+ * @param canon The canonical values seen so far
+ * @param val The value, consumed
+ * @return The canonical instance of the value, or the value itself if it can't have one
+ */
+PJSON_LOCAL jvalue_ref jcanon_intern(jcanon *canon, jvalue_ref val);
+
+/**
+ * Forget the canonical instances, the values referring them keep them
+ */
+PJSON_LOCAL void jcanon_clear(jcanon *canon);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JCANON_INTERNAL_H_ */
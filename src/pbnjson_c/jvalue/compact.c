@@ -0,0 +1,376 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include "reclaim.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * Memory of a tree relocated by jvalue_compact. The values follow the header in depth-first
+ * order, the buckets of the arrays and the text of the strings and numbers after their values.
+ */
+struct jblock {
+	int32_t m_refCnt;           // number of values in the block not released yet
+	raw_buffer m_backingBuffer; // taken over from the relocated root
+	bool m_backingBufferMMap;
+};
+
+// Every value in the block is aligned for any of its fields
+#define BLOCK_ALIGN 8
+
+_Static_assert(__alignof__(jnum) <= BLOCK_ALIGN, "values in the block should be aligned");
+_Static_assert(__alignof__(jarray) <= BLOCK_ALIGN, "values in the block should be aligned");
+
+static size_t block_align(size_t size)
+{
+	return (size + BLOCK_ALIGN - 1) & ~(size_t)(BLOCK_ALIGN - 1);
+}
+
+/************************** SHRINKING ******************************/
+
+static void shrink_array(jarray *arr)
+{
+	ssize_t capacity = arr->m_size > ARRAY_BUCKET_SIZE ? arr->m_size : ARRAY_BUCKET_SIZE;
+	if (arr->m_blockBucket || arr->m_capacity == capacity)
+		return;
+
+	if (capacity == ARRAY_BUCKET_SIZE) {
+		free(arr->m_bigBucket);
+		arr->m_bigBucket = NULL;
+	} else {
+		jvalue_ref *bigBucket = realloc(arr->m_bigBucket, sizeof(jvalue_ref) * (capacity - ARRAY_BUCKET_SIZE));
+		if (!bigBucket)
+			return;
+		arr->m_bigBucket = bigBucket;
+	}
+	PJ_LOG_TRACE("Shrunk array %p from %zd to %zd elements", arr, arr->m_capacity, capacity);
+	arr->m_capacity = capacity;
+}
+
+static void shrink_slots(jobject *obj)
+{
+	size_t capacity = jshape_size(obj->m_shape);
+	if (obj->m_blockSlots || obj->m_slotsCapacity == capacity)
+		return;
+
+	if (capacity == 0) {
+		free(obj->m_slots);
+		obj->m_slots = NULL;
+	} else {
+		jvalue_ref *slots = realloc(obj->m_slots, sizeof(jvalue_ref) * capacity);
+		if (!slots)
+			return;
+		obj->m_slots = slots;
+	}
+	PJ_LOG_TRACE("Shrunk object %p from %zu to %zu slots", obj, obj->m_slotsCapacity, capacity);
+	obj->m_slotsCapacity = capacity;
+}
+
+// The shared and frozen values may be read by another thread meanwhile, they're left as is
+static void shrink(jvalue_ref val)
+{
+	if (!val || jis_const(val) || jis_lazy(val) || val->m_refCnt > 1 || val->m_frozen)
+		return;
+
+	jvalue_forget_string(val);
+
+	if (jis_packed(val)) {
+		jpacked_shrink(val);
+	} else if (val->m_type == JV_ARRAY) {
+		jarray *arr = jarray_deref(val);
+		shrink_array(arr);
+		for (ssize_t i = 0; i < arr->m_size; ++i)
+			shrink(*jarray_slot(arr, i));
+	} else if (jis_shaped(val)) {
+		// The keys belong to the shape
+		jobject *obj = jobject_deref(val);
+		shrink_slots(obj);
+		for (size_t i = 0; i < jshape_size(obj->m_shape); ++i)
+			shrink(obj->m_slots[i]);
+	} else if (val->m_type == JV_OBJECT) {
+		jobject_iter it;
+		jobject_key_value pair;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &pair)) {
+			shrink(pair.key);
+			shrink(pair.value);
+		}
+	}
+}
+
+/************************** RELOCATION *****************************/
+
+// The input a parsed root holds
+static raw_buffer *backing_buffer(jvalue_ref val)
+{
+	jvalue_extra *extra = jvalue_extra_get(val);
+	return (extra && extra->m_backingBuffer.m_str) ? &extra->m_backingBuffer : NULL;
+}
+
+// The value is shared, static, or depends on memory of its own: the new tree refers it
+static bool stays(jvalue_ref val)
+{
+	return jis_const(val)
+	    || val->m_refCnt > 1
+	    || jis_lazy(val)
+	    || jis_packed(val)
+	    || backing_buffer(val);
+}
+
+static size_t text_size(size_t len)
+{
+	return block_align(len + 1);
+}
+
+static size_t tree_size(jvalue_ref val);
+
+static size_t value_size(jvalue_ref val)
+{
+	switch (val->m_type) {
+	case JV_NULL:
+		return 0;
+	case JV_BOOL:
+		return block_align(sizeof(jbool));
+	case JV_NUM:
+		if (jnum_deref(val)->m_type == NUM_RAW)
+			return block_align(sizeof(jnum)) + text_size(jnum_deref(val)->value.raw.m_len);
+		return block_align(sizeof(jnum));
+	case JV_STR:
+		return block_align(sizeof(jstring)) + text_size(jstring_deref(val)->m_data.m_len);
+	case JV_ARRAY: {
+		jarray *arr = jarray_deref(val);
+		size_t size = block_align(sizeof(jarray));
+		if (arr->m_size > ARRAY_BUCKET_SIZE)
+			size += block_align(sizeof(jvalue_ref) * (arr->m_size - ARRAY_BUCKET_SIZE));
+		for (ssize_t i = 0; i < arr->m_size; ++i)
+			size += tree_size(*jarray_slot(arr, i));
+		return size;
+	}
+	case JV_OBJECT: {
+		size_t size = block_align(sizeof(jobject));
+		if (jis_shaped(val)) {
+			jobject *obj = jobject_deref(val);
+			size += block_align(sizeof(jvalue_ref) * jshape_size(obj->m_shape));
+			for (size_t i = 0; i < jshape_size(obj->m_shape); ++i)
+				size += tree_size(obj->m_slots[i]);
+			return size;
+		}
+		jobject_iter it;
+		jobject_key_value pair;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &pair))
+			size += tree_size(pair.key) + tree_size(pair.value);
+		return size;
+	}
+	}
+	assert(false);
+	return 0;
+}
+
+static size_t tree_size(jvalue_ref val)
+{
+	return (!val || stays(val)) ? 0 : value_size(val);
+}
+
+typedef struct {
+	jblock *m_block;
+	char *m_next;
+	bool m_failed;
+} block_cursor;
+
+static void *block_place(block_cursor *cursor, size_t size)
+{
+	void *res = cursor->m_next;
+	cursor->m_next += block_align(size);
+	return res;
+}
+
+static jvalue *block_place_value(block_cursor *cursor, jvalue_ref val, size_t size)
+{
+	jvalue *res = block_place(cursor, size);
+	memset(res, 0, size);
+	res->m_type = val->m_type;
+	res->m_refCnt = 1;
+	res->m_block = cursor->m_block;
+	res->m_inBlock = true;
+	res->m_frozen = val->m_frozen;
+	++cursor->m_block->m_refCnt;
+	return res;
+}
+
+static raw_buffer block_place_text(block_cursor *cursor, raw_buffer text)
+{
+	char *res = block_place(cursor, text.m_len + 1);
+	memcpy(res, text.m_str, text.m_len);
+	res[text.m_len] = '\0';
+	return j_str_to_buffer(res, text.m_len);
+}
+
+static jvalue_ref relocate_tree(block_cursor *cursor, jvalue_ref val);
+
+static jvalue_ref relocate_value(block_cursor *cursor, jvalue_ref val)
+{
+	switch (val->m_type) {
+	case JV_NULL:
+		return val;
+	case JV_BOOL: {
+		jbool *res = (jbool *) block_place_value(cursor, val, sizeof(jbool));
+		res->value = jboolean_deref(val)->value;
+		return &res->m_value;
+	}
+	case JV_NUM: {
+		jnum *res = (jnum *) block_place_value(cursor, val, sizeof(jnum));
+		res->m_type = jnum_deref(val)->m_type;
+		res->m_error = jnum_deref(val)->m_error;
+		res->value = jnum_deref(val)->value;
+		if (res->m_type == NUM_RAW)
+			res->value.raw = block_place_text(cursor, jnum_deref(val)->value.raw);
+		return &res->m_value;
+	}
+	case JV_STR: {
+		jstring *res = (jstring *) block_place_value(cursor, val, sizeof(jstring));
+		res->m_data = block_place_text(cursor, jstring_deref(val)->m_data);
+		return &res->m_value;
+	}
+	case JV_ARRAY: {
+		jarray *arr = jarray_deref(val);
+		jarray *res = (jarray *) block_place_value(cursor, val, sizeof(jarray));
+		res->m_size = arr->m_size;
+		res->m_capacity = ARRAY_BUCKET_SIZE;
+		if (arr->m_size > ARRAY_BUCKET_SIZE) {
+			res->m_capacity = arr->m_size;
+			res->m_bigBucket = block_place(cursor, sizeof(jvalue_ref) * (arr->m_size - ARRAY_BUCKET_SIZE));
+			res->m_blockBucket = true;
+		}
+		for (ssize_t i = 0; i < arr->m_size; ++i) {
+			jvalue_ref element = *jarray_slot(arr, i);
+			*jarray_slot(res, i) = element ? relocate_tree(cursor, element) : NULL;
+		}
+		return &res->m_value;
+	}
+	case JV_OBJECT: {
+		jobject *res = (jobject *) block_place_value(cursor, val, sizeof(jobject));
+		if (jis_shaped(val)) {
+			// The shape is shared with the objects outside of the block
+			jobject *obj = jobject_deref(val);
+			size_t size = jshape_size(obj->m_shape);
+			res->m_shape = jshape_copy(obj->m_shape);
+			res->m_slots = block_place(cursor, sizeof(jvalue_ref) * size);
+			res->m_slotsCapacity = size;
+			res->m_blockSlots = true;
+			for (size_t i = 0; i < size; ++i)
+				res->m_slots[i] = relocate_tree(cursor, obj->m_slots[i]);
+			return &res->m_value;
+		}
+		if (!jobject_init(res)) {
+			cursor->m_failed = true;
+			return &res->m_value;
+		}
+		jobject_iter it;
+		jobject_key_value pair;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &pair)) {
+			jvalue_ref key = relocate_tree(cursor, pair.key);
+			g_hash_table_insert(res->m_members, key, relocate_tree(cursor, pair.value));
+		}
+		return &res->m_value;
+	}
+	}
+	assert(false);
+	return jinvalid();
+}
+
+static jvalue_ref relocate_tree(block_cursor *cursor, jvalue_ref val)
+{
+	return stays(val) ? jvalue_copy(val) : relocate_value(cursor, val);
+}
+
+static bool relocate(jvalue_ref *val)
+{
+	jvalue_ref old = *val;
+	size_t headerSize = block_align(sizeof(jblock));
+	size_t size = headerSize + value_size(old);
+
+	jblock *block = malloc(size);
+	CHECK_ALLOC_RETURN_VALUE(block, false);
+	block->m_refCnt = 0;
+	block->m_backingBuffer = j_str_to_buffer(NULL, 0);
+	block->m_backingBufferMMap = false;
+
+	block_cursor cursor = {
+		.m_block = block,
+		.m_next = (char *) block + headerSize,
+		.m_failed = false,
+	};
+	jvalue_ref root = relocate_value(&cursor, old);
+	assert(cursor.m_failed || cursor.m_next == (char *) block + size);
+
+	if (UNLIKELY(cursor.m_failed)) {
+		// Frees the block with the last value in it
+		j_release(&root);
+		return false;
+	}
+
+	// The values that stayed may refer the input the root was parsed from
+	raw_buffer *input = backing_buffer(old);
+	if (input) {
+		block->m_backingBuffer = *input;
+		block->m_backingBufferMMap = jvalue_extra_get(old)->m_backingBufferMMap;
+		*input = j_str_to_buffer(NULL, 0);
+	}
+	PJ_LOG_TRACE("Relocated %p to %p, %zu bytes", old, root, size);
+
+	j_release(&old);
+	*val = root;
+	return true;
+}
+
+void jblock_release(jblock *block)
+{
+	assert(block->m_refCnt > 0);
+	if (jrefcnt_add(&block->m_refCnt, -1) > 0)
+		return;
+
+	if (block->m_backingBuffer.m_str) {
+		if (block->m_backingBufferMMap)
+			munmap((void *) block->m_backingBuffer.m_str, block->m_backingBuffer.m_len);
+		else
+			free((void *) block->m_backingBuffer.m_str);
+	}
+	PJ_LOG_TRACE("Freeing block %p", block);
+	free(block);
+}
+
+bool jvalue_compact(jvalue_ref *val, JCompactFlags flags)
+{
+	CHECK_POINTER_RETURN_VALUE(*val, false);
+
+	shrink(*val);
+
+	// Nothing to move, or somebody else refers the root
+	if (!(flags & JCOMPACT_RELOCATE) || jis_const(*val) || jis_lazy(*val) || jis_packed(*val) || (*val)->m_refCnt > 1)
+		return true;
+
+	return relocate(val);
+}
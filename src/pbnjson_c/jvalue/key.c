@@ -0,0 +1,139 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The interned keys by their names, they are never removed
+static GHashTable *s_interned = NULL;
+static pthread_mutex_t s_internLock = PTHREAD_MUTEX_INITIALIZER;
+
+void jkey_text_dealloc(void *text)
+{
+}
+
+void jkey_interned_dealloc(void *text)
+{
+}
+
+static guint key_hash(raw_buffer key)
+{
+	// djb2, the same as for the members of the objects
+	guint hash = 5381;
+	for (size_t i = 0; i < key.m_len; ++i)
+		hash = hash * 33 + key.m_str[i];
+	return hash;
+}
+
+static struct jkey *key_alloc(raw_buffer key, jdeallocator dealloc)
+{
+	CHECK_CONDITION_RETURN_VALUE(key.m_str == NULL, NULL, "Invalid key name NULL");
+
+	struct jkey *res = malloc(sizeof(struct jkey) + key.m_len + 1);
+	CHECK_ALLOC_RETURN_NULL(res);
+
+	char *text = (char *) (res + 1);
+	memcpy(text, key.m_str, key.m_len);
+	text[key.m_len] = '\0';
+
+	memset(&res->m_string, 0, sizeof(res->m_string));
+	res->m_string.m_value.m_type = JV_STR;
+	res->m_string.m_value.m_refCnt = 1;
+	res->m_string.m_dealloc = dealloc;
+	res->m_string.m_data = j_str_to_buffer(text, key.m_len);
+	res->m_hash = key_hash(key);
+	res->m_json = NULL;
+	return res;
+}
+
+jkey_ref jkey_create(raw_buffer key)
+{
+	return key_alloc(key, jkey_text_dealloc);
+}
+
+static guint interned_hash(gconstpointer key)
+{
+	return ((const struct jkey *) key)->m_hash;
+}
+
+static gboolean interned_equal(gconstpointer a, gconstpointer b)
+{
+	return jbuffer_equal(((const struct jkey *) a)->m_string.m_data, ((const struct jkey *) b)->m_string.m_data);
+}
+
+jkey_ref jkey_intern(raw_buffer key)
+{
+	CHECK_CONDITION_RETURN_VALUE(key.m_str == NULL, NULL, "Invalid key name NULL");
+
+	struct jkey wanted = {
+		.m_string = { .m_data = key },
+		.m_hash = key_hash(key),
+	};
+
+	pthread_mutex_lock(&s_internLock);
+	if (!s_interned)
+		s_interned = g_hash_table_new(interned_hash, interned_equal);
+	struct jkey *res = g_hash_table_lookup(s_interned, &wanted);
+	if (!res) {
+		res = key_alloc(key, jkey_text_dealloc);
+		if (res) {
+			// Generated beforehand and kept out of the string cache of the value: that cache
+			// is regenerated by every jvalue_tostring, which the shared values can't afford
+			const char *json = jvalue_tostring_simple(&res->m_string.m_value);
+			res->m_json = json ? strdup(json) : NULL;
+			jvalue_forget_string(&res->m_string.m_value);
+			if (res->m_json) {
+				res->m_string.m_dealloc = jkey_interned_dealloc;
+				g_hash_table_insert(s_interned, res, res);
+			} else {
+				PJ_LOG_ERR("PBNJSON_KEY_INTERN_ERR", 0, "Failed to generate the text of an interned key");
+				free(res);
+				res = NULL;
+			}
+		}
+	}
+	pthread_mutex_unlock(&s_internLock);
+	return res;
+}
+
+jkey_ref jkey_copy(jkey_ref key)
+{
+	jvalue_copy(&key->m_string.m_value);
+	return key;
+}
+
+void jkey_release(jkey_ref *key)
+{
+	CHECK_POINTER(key);
+	if (!*key)
+		return;
+
+	jvalue_ref str = &(*key)->m_string.m_value;
+	j_release(&str);
+	*key = NULL;
+}
+
+jvalue_ref jkey_string(jkey_ref key)
+{
+	return &key->m_string.m_value;
+}
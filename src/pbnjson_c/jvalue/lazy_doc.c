@@ -0,0 +1,549 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include "reclaim.h"
+#include "stack.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Every object and array of the document is recorded on the tape in pre-order.
+ * The children of the container at index i start at i + 1, the first node after
+ * its subtree is m_next.
+ */
+typedef struct jlazy_node {
+	size_t m_begin; // offset of the opening bracket
+	size_t m_end;   // offset past the closing bracket
+	size_t m_next;
+} jlazy_node;
+
+struct jlazy_doc {
+	int32_t m_refCnt; // number of lazy containers referring the document
+	raw_buffer m_input;
+	bool m_ownInput;  // m_input is a private copy of the input
+	bool m_noCopy;    // scalars may refer the input directly
+	jlazy_node *m_tape;
+	size_t m_tapeSize;
+	size_t m_tapeCapacity;
+};
+
+static void lazy_doc_release(jlazy_doc *doc)
+{
+	assert(doc->m_refCnt > 0);
+	if (jrefcnt_add(&doc->m_refCnt, -1) > 0)
+		return;
+
+	if (doc->m_ownInput)
+		free((void *)doc->m_input.m_str);
+	free(doc->m_tape);
+	free(doc);
+}
+
+/************************* STRUCTURAL SCANNER **********************************/
+
+// Whitespace and comments, same as accepted by the yajl configuration of the stream parser
+static bool lazy_skip_ws(const char *str, size_t len, size_t *pos)
+{
+	size_t i = *pos;
+	while (i < len) {
+		char c = str[i];
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			++i;
+		} else if (c == '/' && i + 1 < len && str[i + 1] == '/') {
+			const char *eol = memchr(str + i, '\n', len - i);
+			i = eol ? (size_t)(eol - str) + 1 : len;
+		} else if (c == '/' && i + 1 < len && str[i + 1] == '*') {
+			for (i += 2; i + 1 < len && !(str[i] == '*' && str[i + 1] == '/'); ++i)
+				;
+			if (i + 1 >= len)
+				return false;
+			i += 2;
+		} else {
+			break;
+		}
+	}
+	*pos = i;
+	return true;
+}
+
+static inline bool is_hex(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// Find the end of the string starting at pos, the position past the closing quote is stored to pos
+static bool lazy_scan_string(const char *str, size_t len, size_t *pos, bool *escaped)
+{
+	assert(str[*pos] == '"');
+	*escaped = false;
+	for (size_t i = *pos + 1; i < len; ++i) {
+		unsigned char c = str[i];
+		if (c == '"') {
+			*pos = i + 1;
+			return true;
+		}
+		if (c < 0x20)
+			return false;
+		if (c == '\\') {
+			*escaped = true;
+			if (++i == len)
+				return false;
+			switch (str[i]) {
+			case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				if (i + 4 >= len || !is_hex(str[i + 1]) || !is_hex(str[i + 2]) || !is_hex(str[i + 3]) || !is_hex(str[i + 4]))
+					return false;
+				i += 4;
+				break;
+			default:
+				return false;
+			}
+		}
+	}
+	return false;
+}
+
+static bool lazy_scan_number(const char *str, size_t len, size_t *pos)
+{
+	size_t i = *pos;
+	if (i < len && str[i] == '-')
+		++i;
+	if (i >= len || !is_digit(str[i]))
+		return false;
+	if (str[i] == '0')
+		++i;
+	else
+		while (i < len && is_digit(str[i]))
+			++i;
+	if (i < len && str[i] == '.') {
+		if (++i >= len || !is_digit(str[i]))
+			return false;
+		while (i < len && is_digit(str[i]))
+			++i;
+	}
+	if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+		++i;
+		if (i < len && (str[i] == '+' || str[i] == '-'))
+			++i;
+		if (i >= len || !is_digit(str[i]))
+			return false;
+		while (i < len && is_digit(str[i]))
+			++i;
+	}
+	*pos = i;
+	return true;
+}
+
+static bool lazy_scan_literal(const char *str, size_t len, size_t *pos, const char *literal, size_t literalLen)
+{
+	if (len - *pos < literalLen || memcmp(str + *pos, literal, literalLen) != 0)
+		return false;
+	*pos += literalLen;
+	return true;
+}
+
+static bool lazy_scan_scalar(const char *str, size_t len, size_t *pos)
+{
+	bool escaped;
+	switch (str[*pos]) {
+	case '"': return lazy_scan_string(str, len, pos, &escaped);
+	case 't': return lazy_scan_literal(str, len, pos, "true", 4);
+	case 'f': return lazy_scan_literal(str, len, pos, "false", 5);
+	case 'n': return lazy_scan_literal(str, len, pos, "null", 4);
+	default: return lazy_scan_number(str, len, pos);
+	}
+}
+
+static bool lazy_tape_push(jlazy_doc *doc, size_t begin)
+{
+	if (doc->m_tapeSize == doc->m_tapeCapacity) {
+		size_t capacity = doc->m_tapeCapacity ? doc->m_tapeCapacity * 2 : 64;
+		jlazy_node *tape = realloc(doc->m_tape, capacity * sizeof(jlazy_node));
+		CHECK_ALLOC_RETURN_VALUE(tape, false);
+		doc->m_tape = tape;
+		doc->m_tapeCapacity = capacity;
+	}
+	doc->m_tape[doc->m_tapeSize].m_begin = begin;
+	++doc->m_tapeSize;
+	return true;
+}
+
+/**
+ * Check that the input is well-formed JSON and record its containers on the tape.
+ * Nothing but the tape is allocated, the nesting depth is tracked by an explicit stack and
+ * limited to JVALUE_MAX_DEPTH.
+ */
+static bool lazy_scan(jlazy_doc *doc)
+{
+	const char *str = doc->m_input.m_str;
+	size_t len = doc->m_input.m_len;
+	size_t pos = 0;
+	size_t *stack = NULL;
+	size_t depth = 0, stackCapacity = 0;
+	bool result = false;
+
+	if (!lazy_skip_ws(str, len, &pos))
+		return false;
+
+	for (;;) {
+		// A value is expected at pos
+		if (pos >= len)
+			goto done;
+
+		if (str[pos] == '{' || str[pos] == '[') {
+			// The same limit as jdom_parse has, the deeper values couldn't be walked through
+			if (depth >= JVALUE_MAX_DEPTH) {
+				PJ_LOG_ERR("PBNJSON_MAX_DEPTH", 0, "The value is nested deeper than %d levels", JVALUE_MAX_DEPTH);
+				goto done;
+			}
+			if (depth == stackCapacity) {
+				stackCapacity = stackCapacity ? stackCapacity * 2 : 32;
+				size_t *newStack = realloc(stack, stackCapacity * sizeof(size_t));
+				if (!newStack)
+					goto done;
+				stack = newStack;
+			}
+			if (!lazy_tape_push(doc, pos))
+				goto done;
+			stack[depth++] = doc->m_tapeSize - 1;
+
+			char open = str[pos++];
+			if (!lazy_skip_ws(str, len, &pos) || pos >= len)
+				goto done;
+			if (str[pos] == (open == '{' ? '}' : ']'))
+				goto close;
+			if (open == '[')
+				continue;
+			goto key;
+		}
+
+		if (!lazy_scan_scalar(str, len, &pos))
+			goto done;
+
+	after_value:
+		if (!lazy_skip_ws(str, len, &pos))
+			goto done;
+		if (depth == 0) {
+			result = (pos == len);
+			goto done;
+		}
+		if (pos >= len)
+			goto done;
+		if (str[pos] == ',') {
+			++pos;
+			if (!lazy_skip_ws(str, len, &pos) || pos >= len)
+				goto done;
+			if (str[doc->m_tape[stack[depth - 1]].m_begin] == '[')
+				continue;
+			goto key;
+		}
+		if (str[pos] != (str[doc->m_tape[stack[depth - 1]].m_begin] == '{' ? '}' : ']'))
+			goto done;
+
+	close:
+		{
+			jlazy_node *node = &doc->m_tape[stack[--depth]];
+			node->m_end = ++pos;
+			node->m_next = doc->m_tapeSize;
+		}
+		goto after_value;
+
+	key:
+		{
+			bool escaped;
+			if (str[pos] != '"' || !lazy_scan_string(str, len, &pos, &escaped))
+				goto done;
+			if (!lazy_skip_ws(str, len, &pos) || pos >= len || str[pos] != ':')
+				goto done;
+			++pos;
+			if (!lazy_skip_ws(str, len, &pos))
+				goto done;
+		}
+	}
+
+done:
+	free(stack);
+	if (!result)
+		PJ_LOG_WARN("PBNJSON_LAZY_SYNTAX_ERR", 1, PMLOGKFV("OFFSET", "%zu", pos),
+		            "Malformed JSON at offset %zu", pos);
+	return result;
+}
+
+/************************* MATERIALIZATION *************************************/
+
+static size_t utf8_encode(uint32_t cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = 0xC0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3F);
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = 0xE0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3F);
+		out[2] = 0x80 | (cp & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3F);
+	out[2] = 0x80 | ((cp >> 6) & 0x3F);
+	out[3] = 0x80 | (cp & 0x3F);
+	return 4;
+}
+
+static uint32_t hex4(const char *str)
+{
+	uint32_t result = 0;
+	for (int i = 0; i < 4; ++i) {
+		char c = str[i];
+		result = (result << 4) | (is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+	}
+	return result;
+}
+
+// Unescape a scanned string body. The output never grows beyond the escaped length.
+static size_t lazy_unescape(const char *str, size_t len, char *out)
+{
+	char *o = out;
+	for (size_t i = 0; i < len; ++i) {
+		if (str[i] != '\\') {
+			*o++ = str[i];
+			continue;
+		}
+		switch (str[++i]) {
+		case 'b': *o++ = '\b'; break;
+		case 'f': *o++ = '\f'; break;
+		case 'n': *o++ = '\n'; break;
+		case 'r': *o++ = '\r'; break;
+		case 't': *o++ = '\t'; break;
+		case 'u': {
+			uint32_t cp = hex4(str + i + 1);
+			i += 4;
+			if (cp >= 0xD800 && cp < 0xDC00) {
+				// Surrogate pair
+				if (i + 6 < len && str[i + 1] == '\\' && str[i + 2] == 'u') {
+					uint32_t low = hex4(str + i + 3);
+					if (low >= 0xDC00 && low < 0xE000) {
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						i += 6;
+					} else {
+						cp = '?';
+					}
+				} else {
+					cp = '?';
+				}
+			} else if (cp >= 0xDC00 && cp < 0xE000) {
+				cp = '?';
+			}
+			o += utf8_encode(cp, o);
+			break;
+		}
+		default: *o++ = str[i]; break;
+		}
+	}
+	return o - out;
+}
+
+static jvalue_ref lazy_string(jlazy_doc *doc, size_t *pos)
+{
+	const char *str = doc->m_input.m_str;
+	size_t begin = *pos + 1;
+	bool escaped;
+	bool scanned = lazy_scan_string(str, doc->m_input.m_len, pos, &escaped);
+	assert(scanned);
+	(void)scanned;
+	size_t len = *pos - 1 - begin;
+
+	if (!escaped) {
+		if (doc->m_noCopy)
+			return jstring_create_nocopy(j_str_to_buffer(str + begin, len));
+		return jstring_create_copy(j_str_to_buffer(str + begin, len));
+	}
+
+	char *buffer = malloc(len + 1);
+	CHECK_ALLOC_RETURN_VALUE(buffer, jinvalid());
+	size_t unescapedLen = lazy_unescape(str + begin, len, buffer);
+	buffer[unescapedLen] = '\0';
+	return jstring_create_nocopy_full(j_str_to_buffer(buffer, unescapedLen), free);
+}
+
+static jvalue_ref lazy_value(jlazy_doc *doc, size_t *pos, size_t *child)
+{
+	const char *str = doc->m_input.m_str;
+	size_t begin = *pos;
+	jvalue_ref result;
+
+	switch (str[begin]) {
+	case '{':
+	case '[':
+		assert(doc->m_tape[*child].m_begin == begin);
+		result = str[begin] == '{'
+			? jobject_create_lazy(doc, *child)
+			: jarray_create_lazy(doc, *child);
+		if (result)
+			jrefcnt_add(&doc->m_refCnt, 1);
+		*pos = doc->m_tape[*child].m_end;
+		*child = doc->m_tape[*child].m_next;
+		return result ? result : jinvalid();
+	case '"':
+		return lazy_string(doc, pos);
+	case 't':
+		*pos += 4;
+		return jboolean_create(true);
+	case 'f':
+		*pos += 5;
+		return jboolean_create(false);
+	case 'n':
+		*pos += 4;
+		return jnull();
+	default:
+		lazy_scan_number(str, doc->m_input.m_len, pos);
+		if (doc->m_noCopy)
+			return jnumber_create_unsafe(j_str_to_buffer(str + begin, *pos - begin), NULL);
+		return jnumber_create(j_str_to_buffer(str + begin, *pos - begin));
+	}
+}
+
+void jlazy_materialize(jvalue_ref container)
+{
+	jlazy_ref *lazy = jlazy_deref(container);
+	assert(lazy && lazy->m_doc);
+
+	jlazy_doc *doc = lazy->m_doc;
+	size_t node = lazy->m_node;
+	// The container is a regular one from now on, the accessors below won't get back here
+	lazy->m_doc = NULL;
+
+	bool isObject = jis_object(container);
+	if (isObject && !jobject_init(jobject_deref(container))) {
+		PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Failed to allocate members of lazy object");
+		lazy_doc_release(doc);
+		return;
+	}
+
+	const char *str = doc->m_input.m_str;
+	size_t pos = doc->m_tape[node].m_begin + 1;
+	size_t end = doc->m_tape[node].m_end - 1; // closing bracket
+	size_t child = node + 1;
+
+	for (;;) {
+		lazy_skip_ws(str, end, &pos);
+		if (pos >= end)
+			break;
+		if (str[pos] == ',') {
+			++pos;
+			continue;
+		}
+
+		if (isObject) {
+			jvalue_ref key = lazy_string(doc, &pos);
+			lazy_skip_ws(str, end, &pos);
+			assert(str[pos] == ':');
+			++pos;
+			lazy_skip_ws(str, end, &pos);
+			jobject_put(container, key, lazy_value(doc, &pos, &child));
+		} else {
+			jarray_append(container, lazy_value(doc, &pos, &child));
+		}
+	}
+
+	lazy_doc_release(doc);
+}
+
+void jlazy_release(jvalue_ref container)
+{
+	jlazy_ref *lazy = jlazy_deref(container);
+	if (lazy && lazy->m_doc) {
+		lazy_doc_release(lazy->m_doc);
+		lazy->m_doc = NULL;
+	}
+	if (lazy && lazy->m_source) {
+		j_release(&lazy->m_source);
+		lazy->m_source = NULL;
+	}
+}
+
+jvalue_ref jlazy_duplicate(jvalue_ref container)
+{
+	jlazy_ref *lazy = jlazy_deref(container);
+	assert(lazy && (lazy->m_doc || lazy->m_source));
+
+	if (lazy->m_source)
+		return jview_create(lazy->m_source);
+
+	jvalue_ref result = jis_object(container)
+		? jobject_create_lazy(lazy->m_doc, lazy->m_node)
+		: jarray_create_lazy(lazy->m_doc, lazy->m_node);
+	CHECK_POINTER_RETURN_VALUE(result, jinvalid());
+	jrefcnt_add(&lazy->m_doc->m_refCnt, 1);
+	return result;
+}
+
+jvalue_ref jlazy_parse(raw_buffer input, bool noCopy)
+{
+	jlazy_doc *doc = calloc(1, sizeof(jlazy_doc));
+	CHECK_ALLOC_RETURN_VALUE(doc, jinvalid());
+	doc->m_refCnt = 1;
+	doc->m_noCopy = noCopy;
+
+	if (noCopy) {
+		doc->m_input = input;
+	} else {
+		// Materialization happens any time later, keep a copy of the input
+		char *copy = malloc(input.m_len + 1);
+		if (!copy) {
+			PJ_LOG_ERR("PBNJSON_NO_MEMORY", 0, "Failed to copy the input of lazy DOM");
+			free(doc);
+			return jinvalid();
+		}
+		memcpy(copy, input.m_str, input.m_len);
+		copy[input.m_len] = '\0';
+		doc->m_input = j_str_to_buffer(copy, input.m_len);
+		doc->m_ownInput = true;
+	}
+
+	if (!lazy_scan(doc)) {
+		lazy_doc_release(doc);
+		return jinvalid();
+	}
+
+	size_t pos = 0;
+	size_t child = 0;
+	lazy_skip_ws(doc->m_input.m_str, doc->m_input.m_len, &pos);
+	// A root container holds its own reference to the document, a scalar root is a copy
+	jvalue_ref result = lazy_value(doc, &pos, &child);
+	lazy_doc_release(doc);
+
+	return result;
+}
@@ -0,0 +1,425 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include "num_conversion.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// "%.15g" restores any decimal of up to DBL_DIG significant digits, unless it switches to
+// the exponent form
+#define PACKED_F64_DIGITS 15
+#define PACKED_F64_FORMAT "%.15g"
+#define PACKED_F64_MIN_EXPONENT (-4)
+
+// The largest integer restored by PACKED_F64_FORMAT
+#define PACKED_F64_MAX_INTEGER INT64_C(999999999999999)
+
+typedef struct {
+	bool m_isInteger;  // the text is restored by PRId64
+	bool m_isFraction; // the text is restored by PACKED_F64_FORMAT
+	int64_t m_integer;
+	double m_fraction;
+} packed_number;
+
+static inline bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static void packed_classify(raw_buffer number, packed_number *res)
+{
+	const char *p = number.m_str;
+	const char *end = p + number.m_len;
+
+	res->m_isInteger = false;
+	res->m_isFraction = false;
+
+	bool negative = p < end && *p == '-';
+	if (negative)
+		++p;
+	const char *intBegin = p;
+	while (p < end && is_digit(*p))
+		++p;
+	const char *intEnd = p;
+	const char *fracBegin = NULL;
+	const char *fracEnd = NULL;
+	if (p < end && *p == '.') {
+		fracBegin = ++p;
+		while (p < end && is_digit(*p))
+			++p;
+		fracEnd = p;
+	}
+
+	// The exponent form isn't restored
+	if (p != end || intBegin == intEnd)
+		return;
+	// Neither are the trailing zeros of a fraction
+	if (fracBegin && (fracBegin == fracEnd || fracEnd[-1] == '0'))
+		return;
+
+	if (!fracBegin) {
+		// 19 digits fit into uint64_t, "-0" is restored as "0"
+		size_t digits = intEnd - intBegin;
+		if (digits <= 19 && !(negative && *intBegin == '0')) {
+			uint64_t value = 0;
+			for (const char *q = intBegin; q < intEnd; ++q)
+				value = value * 10 + (*q - '0');
+			if (value <= (uint64_t)INT64_MAX + negative) {
+				res->m_isInteger = true;
+				res->m_integer = negative ? (int64_t)(0 - value) : (int64_t)value;
+			}
+		}
+	}
+
+	const char *first = intBegin;
+	while (first < intEnd && *first == '0')
+		++first;
+	if (first == intEnd && fracBegin) {
+		first = fracBegin;
+		while (first < fracEnd && *first == '0')
+			++first;
+	}
+
+	if (first == intEnd && !fracBegin) {
+		// Zero, the sign is kept by the format
+		res->m_isFraction = true;
+		res->m_fraction = negative ? -0.0 : 0.0;
+		return;
+	}
+
+	int exponent;
+	size_t digits;
+	if (first < intEnd) {
+		exponent = intEnd - first - 1;
+		digits = (intEnd - first) + (fracBegin ? fracEnd - fracBegin : 0);
+	} else {
+		exponent = -(int)(first - fracBegin) - 1;
+		digits = fracEnd - first;
+	}
+	if (digits > PACKED_F64_DIGITS || exponent < PACKED_F64_MIN_EXPONENT)
+		return;
+
+	// The same conversion as jnumber_get_f64 of the boxed element
+	res->m_isFraction = jstr_to_double(&number, &res->m_fraction) == CONV_OK;
+}
+
+static jpacked *packed_new(jarray *arr, JPackedType type)
+{
+	jpacked *packed = malloc(sizeof(jpacked));
+	CHECK_ALLOC_RETURN_NULL(packed);
+
+	// The capacity hinted for the buckets goes to the packed elements
+	packed->m_type = type;
+	packed->m_capacity = arr->m_capacity;
+	packed->m_data.i64 = malloc(sizeof(int64_t) * packed->m_capacity);
+	packed->m_boxed = NULL;
+	if (!packed->m_data.i64) {
+		free(packed);
+		return NULL;
+	}
+
+	assert(arr->m_size == 0 && !arr->m_blockBucket);
+	free(arr->m_bigBucket);
+	arr->m_bigBucket = NULL;
+	arr->m_capacity = ARRAY_BUCKET_SIZE;
+	arr->m_packed = packed;
+	return packed;
+}
+
+static bool packed_grow(jpacked *packed)
+{
+	ssize_t capacity = packed->m_capacity * 2;
+
+	int64_t *data = realloc(packed->m_data.i64, sizeof(int64_t) * capacity);
+	CHECK_ALLOC_RETURN_VALUE(data, false);
+	packed->m_data.i64 = data;
+
+	if (packed->m_boxed) {
+		jvalue_ref *boxed = realloc(packed->m_boxed, sizeof(jvalue_ref) * capacity);
+		CHECK_ALLOC_RETURN_VALUE(boxed, false);
+		memset(boxed + packed->m_capacity, 0, sizeof(jvalue_ref) * (capacity - packed->m_capacity));
+		packed->m_boxed = boxed;
+	}
+
+	packed->m_capacity = capacity;
+	return true;
+}
+
+// The integers are converted in place if their text stays the same
+static bool packed_to_f64(jarray *arr)
+{
+	jpacked *packed = arr->m_packed;
+	assert(packed->m_type == PACKED_I64);
+
+	for (ssize_t i = 0; i < arr->m_size; ++i) {
+		int64_t value = packed->m_data.i64[i];
+		if (value > PACKED_F64_MAX_INTEGER || value < -PACKED_F64_MAX_INTEGER)
+			return false;
+	}
+
+	for (ssize_t i = 0; i < arr->m_size; ++i) {
+		int64_t integer;
+		memcpy(&integer, &packed->m_data.i64[i], sizeof(integer));
+		double fraction = integer;
+		memcpy(&packed->m_data.f64[i], &fraction, sizeof(fraction));
+	}
+	packed->m_type = PACKED_F64;
+	return true;
+}
+
+bool jarray_append_packed(jvalue_ref arr, raw_buffer number)
+{
+	jarray *array = jarray_deref(arr);
+	jpacked *packed = array->m_packed;
+
+	if (!packed && (array->m_size || array->m_blockBucket || jis_lazy(arr)))
+		return false;
+
+	packed_number num;
+	packed_classify(number, &num);
+
+	if (!packed) {
+		if (!num.m_isInteger && !num.m_isFraction)
+			return false;
+		packed = packed_new(array, num.m_isInteger ? PACKED_I64 : PACKED_F64);
+		if (!packed)
+			return false;
+	} else if (packed->m_type == PACKED_I64 && !num.m_isInteger) {
+		if (!num.m_isFraction || !packed_to_f64(array))
+			return false;
+	} else if (packed->m_type == PACKED_F64 && !num.m_isFraction) {
+		return false;
+	}
+
+	if (array->m_size == packed->m_capacity && !packed_grow(packed))
+		return false;
+
+	if (packed->m_type == PACKED_I64)
+		packed->m_data.i64[array->m_size] = num.m_integer;
+	else
+		packed->m_data.f64[array->m_size] = num.m_fraction;
+	++array->m_size;
+	return true;
+}
+
+size_t jpacked_text(jvalue_ref arr, ssize_t index, char *buf)
+{
+	jpacked *packed = jarray_deref(arr)->m_packed;
+	assert(index >= 0 && index < jarray_deref(arr)->m_size);
+
+	if (packed->m_type == PACKED_I64)
+		return snprintf(buf, JPACKED_TEXT_MAX, "%" PRId64, packed->m_data.i64[index]);
+	return snprintf(buf, JPACKED_TEXT_MAX, PACKED_F64_FORMAT, packed->m_data.f64[index]);
+}
+
+jvalue_ref jpacked_get(jvalue_ref arr, ssize_t index)
+{
+	jpacked *packed = jarray_deref(arr)->m_packed;
+
+	if (UNLIKELY(!packed->m_boxed)) {
+		packed->m_boxed = calloc(packed->m_capacity, sizeof(jvalue_ref));
+		CHECK_ALLOC_RETURN_VALUE(packed->m_boxed, jinvalid());
+	}
+
+	if (!packed->m_boxed[index]) {
+		char buf[JPACKED_TEXT_MAX];
+		jvalue_ref element = jnumber_create(j_str_to_buffer(buf, jpacked_text(arr, index, buf)));
+		if (UNLIKELY(element == NULL || !jis_number(element)))
+			return jinvalid();
+		packed->m_boxed[index] = element;
+	}
+	return packed->m_boxed[index];
+}
+
+bool jpacked_unpack(jvalue_ref arr)
+{
+	jarray *array = jarray_deref(arr);
+	jpacked *packed = array->m_packed;
+	ssize_t size = array->m_size;
+
+	// Box everything first, a failure leaves the array as it was
+	for (ssize_t i = 0; i < size; ++i) {
+		if (UNLIKELY(!jis_number(jpacked_get(arr, i))))
+			return false;
+	}
+
+	jvalue_ref *bigBucket = NULL;
+	if (size > ARRAY_BUCKET_SIZE) {
+		bigBucket = malloc(sizeof(jvalue_ref) * (size - ARRAY_BUCKET_SIZE));
+		CHECK_ALLOC_RETURN_VALUE(bigBucket, false);
+	}
+
+	array->m_packed = NULL;
+	array->m_bigBucket = bigBucket;
+	array->m_capacity = size > ARRAY_BUCKET_SIZE ? size : ARRAY_BUCKET_SIZE;
+	for (ssize_t i = 0; i < size; ++i)
+		*jarray_slot(array, i) = packed->m_boxed[i];
+
+	free(packed->m_data.i64);
+	free(packed->m_boxed);
+	free(packed);
+	return true;
+}
+
+void jpacked_release(jvalue_ref arr)
+{
+	jarray *array = jarray_deref(arr);
+	jpacked *packed = array->m_packed;
+
+	if (packed->m_boxed) {
+		for (ssize_t i = 0; i < array->m_size; ++i)
+			j_release(&packed->m_boxed[i]);
+		free(packed->m_boxed);
+	}
+	free(packed->m_data.i64);
+	free(packed);
+
+	array->m_packed = NULL;
+	array->m_size = 0;
+}
+
+void jpacked_shrink(jvalue_ref arr)
+{
+	jarray *array = jarray_deref(arr);
+	jpacked *packed = array->m_packed;
+	ssize_t capacity = array->m_size;
+
+	if (packed->m_capacity == capacity)
+		return;
+
+	int64_t *data = realloc(packed->m_data.i64, sizeof(int64_t) * capacity);
+	if (!data)
+		return;
+	packed->m_data.i64 = data;
+
+	if (packed->m_boxed) {
+		jvalue_ref *boxed = realloc(packed->m_boxed, sizeof(jvalue_ref) * capacity);
+		if (!boxed)
+			return;
+		packed->m_boxed = boxed;
+	}
+	packed->m_capacity = capacity;
+}
+
+bool jpacked_equal(jvalue_ref arr, jvalue_ref other)
+{
+	jpacked *packed = jarray_deref(arr)->m_packed;
+	jpacked *otherPacked = jarray_deref(other)->m_packed;
+	ssize_t size = jarray_deref(arr)->m_size;
+
+	assert(packed->m_type == otherPacked->m_type);
+	assert(size == jarray_deref(other)->m_size);
+
+	for (ssize_t i = 0; i < size; ++i) {
+		if (packed->m_type == PACKED_I64 ? packed->m_data.i64[i] != otherPacked->m_data.i64[i]
+		                                 : packed->m_data.f64[i] != otherPacked->m_data.f64[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool jpacked_has_duplicates(jvalue_ref arr)
+{
+	jpacked *packed = jarray_deref(arr)->m_packed;
+	ssize_t size = jarray_deref(arr)->m_size;
+
+	for (ssize_t i = 0; i < size - 1; ++i) {
+		for (ssize_t j = i + 1; j < size; ++j) {
+			if (packed->m_type == PACKED_I64 ? packed->m_data.i64[i] == packed->m_data.i64[j]
+			                                 : packed->m_data.f64[i] == packed->m_data.f64[j])
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool jpacked_copy(jvalue_ref arr, jvalue_ref source)
+{
+	jpacked *packed = jarray_deref(source)->m_packed;
+	ssize_t size = jarray_deref(source)->m_size;
+	assert(jarray_deref(arr)->m_size == 0 && !jarray_deref(arr)->m_packed);
+
+	jarray_deref(arr)->m_capacity = size;
+	jpacked *copy = packed_new(jarray_deref(arr), packed->m_type);
+	if (!copy)
+		return false;
+	memcpy(copy->m_data.i64, packed->m_data.i64, sizeof(int64_t) * size);
+	jarray_deref(arr)->m_size = size;
+	return true;
+}
+
+jvalue_ref jpacked_duplicate(jvalue_ref arr)
+{
+	jvalue_ref result = jarray_create(NULL);
+	CHECK_POINTER_RETURN_NULL(result);
+
+	if (!jpacked_copy(result, arr))
+		j_release(&result);
+	return result;
+}
+
+bool jarray_get_f64_span(jvalue_ref arr, const double **span, size_t *size)
+{
+	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), false, "Attempt to get the numbers of non-array %p", arr);
+
+	ssize_t arrSize = jarray_size(arr);
+	jarray *array = jarray_deref(arr);
+	if (arrSize == 0) {
+		*span = NULL;
+		*size = 0;
+		return true;
+	}
+	// The integers aren't converted in place: the array may be shared or frozen, and the
+	// integers above 2^53 don't fit a double
+	if (!array->m_packed || array->m_packed->m_type != PACKED_F64)
+		return false;
+
+	*span = array->m_packed->m_data.f64;
+	*size = arrSize;
+	return true;
+}
+
+bool jarray_get_i64_span(jvalue_ref arr, const int64_t **span, size_t *size)
+{
+	CHECK_CONDITION_RETURN_VALUE(!jis_array(arr), false, "Attempt to get the numbers of non-array %p", arr);
+
+	ssize_t arrSize = jarray_size(arr);
+	jarray *array = jarray_deref(arr);
+	if (arrSize == 0) {
+		*span = NULL;
+		*size = 0;
+		return true;
+	}
+	if (!array->m_packed || array->m_packed->m_type != PACKED_I64)
+		return false;
+
+	*span = array->m_packed->m_data.i64;
+	*size = arrSize;
+	return true;
+}
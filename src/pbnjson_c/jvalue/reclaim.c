@@ -0,0 +1,318 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+#include <glib.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include "reclaim.h"
+#include "stack.h"
+
+#define JRECLAIM_THREADS 2
+
+// The shapes released one after another are mostly the same ones, they are given back together
+#define JRECLAIM_SHAPES_MERGED 8
+
+bool jreclaim_started = false;
+
+static size_t s_threshold;
+
+#ifdef ATOMIC_CAS
+
+typedef struct jreclaim_owner jreclaim_owner;
+
+// References to a shape given back to the owner
+typedef struct jreclaim_shape {
+	jshape *m_shape;
+	size_t m_refs;
+} jreclaim_shape;
+
+typedef struct jreclaim_job {
+	struct jreclaim_job *m_next;
+	jvalue_ref m_value;
+	jreclaim_owner *m_owner;
+	jstack m_shapes; // jreclaim_shape
+} jreclaim_job;
+
+// A thread which deferred the releases
+struct jreclaim_owner {
+	size_t m_pending;        // jobs not done yet
+	jreclaim_job *m_returned; // done jobs with the shapes to release
+};
+
+typedef struct jreclaimer {
+	jreclaim_job *m_jobs;
+	pthread_cond_t m_wakeup;
+} jreclaimer;
+
+static jreclaimer s_reclaimers[JRECLAIM_THREADS];
+static size_t s_threads;
+static size_t s_next;
+static pthread_once_t s_once = PTHREAD_ONCE_INIT;
+
+// Guards only the waits: the reclaimers for the jobs, the owners for the jobs to be done
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_done = PTHREAD_COND_INITIALIZER;
+
+static void jreclaim_owner_exit(gpointer data);
+
+static GPrivate s_owner = G_PRIVATE_INIT(jreclaim_owner_exit);
+static GPrivate s_job = G_PRIVATE_INIT(NULL); // the job of a reclaiming thread
+
+// The lists are only pushed to and taken as a whole, the pointers pushed again don't confuse them
+static bool jobs_push(jreclaim_job **list, jreclaim_job *job)
+{
+	jreclaim_job *head;
+	do {
+		head = ATOMIC_LOAD(list);
+		job->m_next = head;
+	} while (!ATOMIC_CAS(list, head, job));
+	return head == NULL;
+}
+
+static jreclaim_job *jobs_take(jreclaim_job **list)
+{
+	jreclaim_job *jobs;
+	do {
+		jobs = ATOMIC_LOAD(list);
+	} while (jobs && !ATOMIC_CAS(list, jobs, NULL));
+	return jobs;
+}
+
+static void jreclaim_run(jreclaim_job *job)
+{
+	jreclaim_owner *owner = job->m_owner;
+
+	jstack_init(&job->m_shapes, sizeof(jreclaim_shape), SIZE_MAX);
+	g_private_set(&s_job, job);
+	j_release(&job->m_value);
+	g_private_set(&s_job, NULL);
+
+	if (jstack_empty(&job->m_shapes)) {
+		jstack_destroy(&job->m_shapes);
+		free(job);
+	} else {
+		jobs_push(&owner->m_returned, job);
+	}
+
+	// The owner may be gone right after the last of its jobs
+	if (ATOMIC_DEC(&owner->m_pending) == 0) {
+		pthread_mutex_lock(&s_lock);
+		pthread_cond_broadcast(&s_done);
+		pthread_mutex_unlock(&s_lock);
+	}
+}
+
+static void *jreclaimer_main(void *data)
+{
+	jreclaimer *self = data;
+	for (;;) {
+		jreclaim_job *jobs = jobs_take(&self->m_jobs);
+		if (!jobs) {
+			pthread_mutex_lock(&s_lock);
+			while (!ATOMIC_LOAD(&self->m_jobs))
+				pthread_cond_wait(&self->m_wakeup, &s_lock);
+			pthread_mutex_unlock(&s_lock);
+			continue;
+		}
+
+		while (jobs) {
+			jreclaim_job *next = jobs->m_next;
+			jreclaim_run(jobs);
+			jobs = next;
+		}
+	}
+	return NULL;
+}
+
+static void jreclaim_start_threads(void)
+{
+	pthread_attr_t attr;
+	if (pthread_attr_init(&attr) != 0)
+		return;
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (size_t i = 0; i < JRECLAIM_THREADS; ++i) {
+		jreclaimer *reclaimer = &s_reclaimers[s_threads];
+		pthread_cond_init(&reclaimer->m_wakeup, NULL);
+		pthread_t thread;
+		if (pthread_create(&thread, &attr, jreclaimer_main, reclaimer) != 0) {
+			PJ_LOG_WARN("PBNJSON_RECLAIM_THREAD", 0, "Failed to start a reclaiming thread");
+			pthread_cond_destroy(&reclaimer->m_wakeup);
+			break;
+		}
+		++s_threads;
+	}
+	pthread_attr_destroy(&attr);
+
+	// Before any value reaches the reclaimers
+	jreclaim_started = s_threads > 0;
+}
+
+bool jreclaim_start(void)
+{
+	pthread_once(&s_once, jreclaim_start_threads);
+	return s_threads > 0;
+}
+
+static jreclaim_owner *jreclaim_owner_get(void)
+{
+	jreclaim_owner *owner = g_private_get(&s_owner);
+	if (!owner) {
+		owner = calloc(1, sizeof(jreclaim_owner));
+		CHECK_ALLOC_RETURN_NULL(owner);
+		g_private_set(&s_owner, owner);
+	}
+	return owner;
+}
+
+bool jreclaim_defer(jvalue_ref val)
+{
+	if (g_private_get(&s_job))
+		return false;
+
+	jreclaim_owner *owner = jreclaim_owner_get();
+	jreclaim_job *job = owner ? malloc(sizeof(jreclaim_job)) : NULL;
+	CHECK_ALLOC_RETURN_VALUE(job, false);
+
+	job->m_value = val;
+	job->m_owner = owner;
+	ATOMIC_INC(&owner->m_pending);
+
+	jreclaimer *reclaimer = &s_reclaimers[ATOMIC_INC(&s_next) % s_threads];
+	if (jobs_push(&reclaimer->m_jobs, job)) {
+		pthread_mutex_lock(&s_lock);
+		pthread_cond_signal(&reclaimer->m_wakeup);
+		pthread_mutex_unlock(&s_lock);
+	}
+	return true;
+}
+
+void jreclaim_release_shape(jshape *shape)
+{
+	jreclaim_job *job = g_private_get(&s_job);
+	if (!job) {
+		jshape_release(shape);
+		return;
+	}
+
+	jstack *shapes = &job->m_shapes;
+	for (size_t i = 0; i < shapes->m_size && i < JRECLAIM_SHAPES_MERGED; ++i) {
+		jreclaim_shape *ref = (jreclaim_shape *) jstack_top(shapes) - i;
+		if (ref->m_shape == shape) {
+			++ref->m_refs;
+			return;
+		}
+	}
+
+	// Out of memory, the shape stays
+	jreclaim_shape *ref = jstack_push(shapes);
+	if (ref) {
+		ref->m_shape = shape;
+		ref->m_refs = 1;
+	}
+}
+
+static void jreclaim_give_back(jreclaim_owner *owner)
+{
+	jreclaim_job *jobs = jobs_take(&owner->m_returned);
+	while (jobs) {
+		jreclaim_job *next = jobs->m_next;
+		while (!jstack_empty(&jobs->m_shapes)) {
+			jreclaim_shape *ref = jstack_top(&jobs->m_shapes);
+			jshape_release_refs(ref->m_shape, ref->m_refs);
+			jstack_pop(&jobs->m_shapes);
+		}
+		jstack_destroy(&jobs->m_shapes);
+		free(jobs);
+		jobs = next;
+	}
+}
+
+void jreclaim_collect(void)
+{
+	jreclaim_owner *owner = g_private_get(&s_owner);
+	if (owner && ATOMIC_LOAD(&owner->m_returned))
+		jreclaim_give_back(owner);
+}
+
+static void jreclaim_wait(jreclaim_owner *owner)
+{
+	pthread_mutex_lock(&s_lock);
+	while (ATOMIC_LOAD(&owner->m_pending))
+		pthread_cond_wait(&s_done, &s_lock);
+	pthread_mutex_unlock(&s_lock);
+	jreclaim_give_back(owner);
+}
+
+// The shapes of the thread can't outlive it
+static void jreclaim_owner_exit(gpointer data)
+{
+	jreclaim_owner *owner = data;
+	jreclaim_wait(owner);
+	free(owner);
+}
+
+void j_release_wait(void)
+{
+	jreclaim_owner *owner = g_private_get(&s_owner);
+	if (owner)
+		jreclaim_wait(owner);
+}
+
+#else
+
+bool jreclaim_start(void)
+{
+	return false;
+}
+
+bool jreclaim_defer(jvalue_ref val)
+{
+	return false;
+}
+
+void jreclaim_release_shape(jshape *shape)
+{
+	jshape_release(shape);
+}
+
+void jreclaim_collect(void)
+{
+}
+
+void j_release_wait(void)
+{
+}
+
+#endif /* ATOMIC_CAS */
+
+size_t jreclaim_threshold(void)
+{
+	return s_threshold;
+}
+
+void j_release_set_deferred(size_t members)
+{
+	if (members && !jreclaim_start())
+		PJ_LOG_WARN("PBNJSON_RECLAIM_UNAVAILABLE", 0, "The values are destroyed by the threads releasing them");
+	s_threshold = members;
+}
@@ -0,0 +1,88 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JRECLAIM_INTERNAL_H_
+#define JRECLAIM_INTERNAL_H_
+
+#include <japi.h>
+#include <jtypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <compiler/builtins.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jshape jshape;
+
+/**
+ * Set with the first value handed over to the reclaiming threads (see j_release_deferred).
+ * From then on the references are counted atomically, the threads may release the members
+ * shared with the values in use.
+ */
+PJSON_LOCAL extern bool jreclaim_started;
+
+/**
+ * Add delta to a reference counter of the values, the documents or the blocks
+ * @return The new count
+ */
+static inline int32_t jrefcnt_add(int32_t *counter, int32_t delta)
+{
+#ifdef ATOMIC_CAS
+	if (UNLIKELY(jreclaim_started))
+		return ATOMIC_ADD(counter, delta);
+#endif
+	return *counter += delta;
+}
+
+/**
+ * Start the reclaiming threads and count the references atomically from now on
+ * @return false if the values can't be reclaimed in the background, they are destroyed in place
+ */
+PJSON_LOCAL bool jreclaim_start(void);
+
+/**
+ * Hand the last reference to the container over to a reclaiming thread
+ * @return false if the calling thread is a reclaiming one, it destroys the value itself
+ */
+PJSON_LOCAL bool jreclaim_defer(jvalue_ref val);
+
+/**
+ * @return The number of members from which j_release defers the destruction of the
+ *         containers, 0 if it doesn't (see j_release_set_deferred)
+ */
+PJSON_LOCAL size_t jreclaim_threshold(void);
+
+/**
+ * Release the shape of an object destroyed by the thread. The shapes aren't shared between
+ * threads: a reclaiming thread gives the references back to the thread that deferred the
+ * release, the others release them in place.
+ */
+PJSON_LOCAL void jreclaim_release_shape(jshape *shape);
+
+/**
+ * Release the shapes the reclaiming threads gave back to the calling thread
+ */
+PJSON_LOCAL void jreclaim_collect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JRECLAIM_INTERNAL_H_ */
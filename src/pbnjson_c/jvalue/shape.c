@@ -0,0 +1,201 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <jobject.h>
+
+#include "../liblog.h"
+#include "../jobject_internal.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Ordered keys of the objects created one after another with the same keys. A shape refers
+ * its parent, the shape without the last key, and is known to the parent as one of its
+ * transitions: the objects that get the same next key move to the same shape.
+ */
+struct jshape {
+	ssize_t m_refCnt;
+	jshape *m_parent;
+	jshape *m_children;   // transitions, they refer the parent but not the other way round
+	jshape *m_next;       // the next transition of the parent
+	size_t m_transitions; // number of m_children
+	size_t m_count;
+	size_t m_indexMask;
+	jvalue_ref *m_keys;   // the last key is owned, the others belong to the parents
+	guint *m_hashes;
+	uint8_t *m_index;     // slot + 1 of the keys by hash, 0 for an empty entry
+};
+
+_Static_assert(JSHAPE_MAX_KEYS < UINT8_MAX, "slots should fit into the index");
+
+static guint shape_hash(raw_buffer key)
+{
+	// djb2, the same as for the members of the objects
+	guint hash = 5381;
+	for (size_t i = 0; i < key.m_len; ++i)
+		hash = hash * 33 + key.m_str[i];
+	return hash;
+}
+
+// The keys created by jkey_create have the hash already
+static guint shape_key_hash(jvalue_ref key)
+{
+	const struct jkey *handle = jkey_of(key);
+	return handle ? handle->m_hash : shape_hash(jstring_deref(key)->m_data);
+}
+
+static jshape *shape_alloc(size_t count)
+{
+	size_t indexSize = 2;
+	while (indexSize < 2 * count)
+		indexSize *= 2;
+
+	jshape *shape = calloc(1, sizeof(jshape) + count * (sizeof(jvalue_ref) + sizeof(guint)) + indexSize);
+	CHECK_ALLOC_RETURN_NULL(shape);
+
+	shape->m_refCnt = 1;
+	shape->m_count = count;
+	shape->m_indexMask = indexSize - 1;
+	shape->m_keys = (jvalue_ref *) (shape + 1);
+	shape->m_hashes = (guint *) (shape->m_keys + count);
+	shape->m_index = (uint8_t *) (shape->m_hashes + count);
+	return shape;
+}
+
+jshape *jshape_create(void)
+{
+	return shape_alloc(0);
+}
+
+jshape *jshape_copy(jshape *shape)
+{
+	++shape->m_refCnt;
+	return shape;
+}
+
+void jshape_release(jshape *shape)
+{
+	// The parents may go away with the last of their transitions
+	while (shape && --shape->m_refCnt == 0) {
+		jshape *parent = shape->m_parent;
+		if (parent) {
+			jshape **link = &parent->m_children;
+			while (*link != shape)
+				link = &(*link)->m_next;
+			*link = shape->m_next;
+			--parent->m_transitions;
+			j_release(&shape->m_keys[shape->m_count - 1]);
+		}
+		free(shape);
+		shape = parent;
+	}
+}
+
+void jshape_release_refs(jshape *shape, size_t refs)
+{
+	assert(refs > 0 && shape->m_refCnt >= (ssize_t) refs);
+	shape->m_refCnt -= refs - 1;
+	jshape_release(shape);
+}
+
+size_t jshape_size(const jshape *shape)
+{
+	return shape->m_count;
+}
+
+jvalue_ref jshape_key(const jshape *shape, size_t slot)
+{
+	assert(slot < shape->m_count);
+	return shape->m_keys[slot];
+}
+
+jshape *jshape_root(jshape *shape)
+{
+	while (shape->m_parent)
+		shape = shape->m_parent;
+	return shape;
+}
+
+static bool shape_key_equal(const jshape *shape, size_t slot, guint hash, raw_buffer key)
+{
+	raw_buffer other = jstring_deref(shape->m_keys[slot])->m_data;
+	return shape->m_hashes[slot] == hash && other.m_len == key.m_len &&
+	       memcmp(other.m_str, key.m_str, key.m_len) == 0;
+}
+
+// The key string may be NULL, otherwise the same string is found by its address first
+static ssize_t shape_find(const jshape *shape, jvalue_ref key, guint hash, raw_buffer name)
+{
+	for (size_t i = hash & shape->m_indexMask; shape->m_index[i]; i = (i + 1) & shape->m_indexMask) {
+		size_t slot = shape->m_index[i] - 1;
+		if (shape->m_keys[slot] == key || shape_key_equal(shape, slot, hash, name))
+			return slot;
+	}
+	return -1;
+}
+
+ssize_t jshape_lookup(const jshape *shape, raw_buffer key)
+{
+	if (!shape->m_count)
+		return -1;
+	return shape_find(shape, NULL, shape_hash(key), key);
+}
+
+ssize_t jshape_find(const jshape *shape, jvalue_ref key)
+{
+	if (!shape->m_count)
+		return -1;
+	return shape_find(shape, key, shape_key_hash(key), jstring_deref(key)->m_data);
+}
+
+jshape *jshape_transition(jshape *shape, jvalue_ref key)
+{
+	raw_buffer name = jstring_deref(key)->m_data;
+	guint hash = shape_key_hash(key);
+
+	for (jshape *child = shape->m_children; child; child = child->m_next) {
+		if (child->m_keys[child->m_count - 1] == key || shape_key_equal(child, child->m_count - 1, hash, name))
+			return jshape_copy(child);
+	}
+
+	// Too many keys, or the objects differ too much to share the shapes
+	if (shape->m_count >= JSHAPE_MAX_KEYS || shape->m_transitions >= JSHAPE_MAX_TRANSITIONS)
+		return NULL;
+
+	jshape *child = shape_alloc(shape->m_count + 1);
+	if (!child)
+		return NULL;
+
+	memcpy(child->m_keys, shape->m_keys, sizeof(jvalue_ref) * shape->m_count);
+	memcpy(child->m_hashes, shape->m_hashes, sizeof(guint) * shape->m_count);
+	child->m_keys[shape->m_count] = jvalue_copy(key);
+	child->m_hashes[shape->m_count] = hash;
+	for (size_t slot = 0; slot < child->m_count; ++slot) {
+		size_t i = child->m_hashes[slot] & child->m_indexMask;
+		while (child->m_index[i])
+			i = (i + 1) & child->m_indexMask;
+		child->m_index[i] = slot + 1;
+	}
+
+	child->m_parent = jshape_copy(shape);
+	child->m_next = shape->m_children;
+	shape->m_children = child;
+	++shape->m_transitions;
+	return child;
+}
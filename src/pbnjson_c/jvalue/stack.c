@@ -0,0 +1,103 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <glib.h>
+#include <stdlib.h>
+#include <compiler/builtins.h>
+
+#include "../liblog.h"
+#include "stack.h"
+
+// Deeper walks give their memory back to the heap
+#define JSTACK_CACHE_MAX (64 * 1024)
+#define JSTACK_INITIAL_FRAMES 32
+
+typedef struct jstack_cache {
+	char *m_frames;
+	size_t m_bytes;
+} jstack_cache;
+
+static void jstack_cache_free(gpointer data)
+{
+	jstack_cache *cache = data;
+	free(cache->m_frames);
+	free(cache);
+}
+
+static GPrivate s_cache = G_PRIVATE_INIT(jstack_cache_free);
+
+void jstack_init(jstack *stack, size_t frameSize, size_t limit)
+{
+	stack->m_frames = NULL;
+	stack->m_frameSize = frameSize;
+	stack->m_size = 0;
+	stack->m_capacity = 0;
+	stack->m_limit = limit;
+
+	// The walks started from within a walk don't find the memory in the cache, they allocate
+	jstack_cache *cache = g_private_get(&s_cache);
+	if (cache && cache->m_frames) {
+		stack->m_frames = cache->m_frames;
+		stack->m_capacity = cache->m_bytes / frameSize;
+		cache->m_frames = NULL;
+	}
+}
+
+void jstack_destroy(jstack *stack)
+{
+	if (!stack->m_frames)
+		return;
+
+	size_t bytes = stack->m_capacity * stack->m_frameSize;
+	if (bytes <= JSTACK_CACHE_MAX) {
+		jstack_cache *cache = g_private_get(&s_cache);
+		if (!cache) {
+			cache = calloc(1, sizeof(jstack_cache));
+			g_private_set(&s_cache, cache);
+		}
+		if (cache && !cache->m_frames) {
+			cache->m_frames = stack->m_frames;
+			cache->m_bytes = bytes;
+			stack->m_frames = NULL;
+			return;
+		}
+	}
+
+	free(stack->m_frames);
+	stack->m_frames = NULL;
+}
+
+void *jstack_push(jstack *stack)
+{
+	if (UNLIKELY(stack->m_size == stack->m_limit)) {
+		PJ_LOG_ERR("PBNJSON_MAX_DEPTH", 0, "The value is nested deeper than %zu levels", stack->m_limit);
+		return NULL;
+	}
+
+	if (UNLIKELY(stack->m_size == stack->m_capacity)) {
+		size_t capacity = stack->m_capacity ? stack->m_capacity * 2 : JSTACK_INITIAL_FRAMES;
+		if (capacity > stack->m_limit)
+			capacity = stack->m_limit;
+		char *frames = realloc(stack->m_frames, capacity * stack->m_frameSize);
+		CHECK_ALLOC_RETURN_NULL(frames);
+		stack->m_frames = frames;
+		stack->m_capacity = capacity;
+	}
+
+	return stack->m_frames + stack->m_size++ * stack->m_frameSize;
+}
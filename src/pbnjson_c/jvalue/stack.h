@@ -0,0 +1,86 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JSTACK_INTERNAL_H_
+#define JSTACK_INTERNAL_H_
+
+#include <japi.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Nesting level of the values which are still walked through. The parser rejects deeper
+ * documents, the serialization, the copies and the comparisons of deeper values fail.
+ */
+#define JVALUE_MAX_DEPTH 1000000
+
+/**
+ * Frames of a walk over a tree of values, in place of the recursion. The memory is taken from
+ * a cache of the thread and returned there, the walks no deeper than the previous ones don't
+ * allocate.
+ */
+typedef struct jstack {
+	char *m_frames;
+	size_t m_frameSize;
+	size_t m_size;     // frames in use
+	size_t m_capacity; // frames allocated
+	size_t m_limit;    // frames allowed
+} jstack;
+
+/**
+ * @param stack The stack to initialize
+ * @param frameSize Size of a frame in bytes
+ * @param limit The maximum number of frames, JVALUE_MAX_DEPTH for the walks into the values
+ */
+PJSON_LOCAL void jstack_init(jstack *stack, size_t frameSize, size_t limit);
+
+/**
+ * Give the memory of the stack back to the cache of the thread, or free it if it's too big
+ */
+PJSON_LOCAL void jstack_destroy(jstack *stack);
+
+/**
+ * Add a frame on top of the stack. The frames pushed before may move.
+ * @return The new frame, or NULL if the stack is at the limit or out of memory
+ */
+PJSON_LOCAL void *jstack_push(jstack *stack);
+
+static inline bool jstack_empty(const jstack *stack)
+{
+	return stack->m_size == 0;
+}
+
+static inline void *jstack_top(jstack *stack)
+{
+	return stack->m_frames + (stack->m_size - 1) * stack->m_frameSize;
+}
+
+static inline void jstack_pop(jstack *stack)
+{
+	--stack->m_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSTACK_INTERNAL_H_ */
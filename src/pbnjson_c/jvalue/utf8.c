@@ -0,0 +1,174 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include "utf8.h"
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define JUTF8_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define JUTF8_NEON 1
+#include <arm_neon.h>
+#endif
+
+enum {
+	NEED_1 = 2,          // one continuation byte left
+	NEED_2,
+	NEED_3,
+	AFTER_E0,            // the second byte of U+0800..U+0FFF, shorter ones are overlong
+	AFTER_ED,            // the second byte of U+D000..U+D7FF, the rest are surrogates
+	AFTER_F0,            // the second byte of U+10000..U+3FFFF, shorter ones are overlong
+	AFTER_F4,            // the second byte of U+100000..U+10FFFF
+};
+
+// The length of the ASCII prefix of [p, end), rounded down to whole words
+static size_t ascii_words(const char *p, const char *end)
+{
+	const char *begin = p;
+	for (; end - p >= 8; p += 8) {
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		if (word & UINT64_C(0x8080808080808080))
+			break;
+	}
+	return p - begin;
+}
+
+#if JUTF8_X86
+static size_t ascii_sse2(const char *p, const char *end)
+{
+	const char *begin = p;
+	for (; end - p >= 16; p += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p)))
+			break;
+	}
+	return (p - begin) + ascii_words(p, end);
+}
+
+__attribute__((target("avx2")))
+static size_t ascii_avx2(const char *p, const char *end)
+{
+	const char *begin = p;
+	for (; end - p >= 64; p += 64) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) p);
+		__m256i b = _mm256_loadu_si256((const __m256i *) (p + 32));
+		if (_mm256_movemask_epi8(_mm256_or_si256(a, b)))
+			break;
+	}
+	// Not emitted by the compiler here, the SSE code that follows would stall without it
+	_mm256_zeroupper();
+	return (p - begin) + ascii_sse2(p, end);
+}
+
+static size_t ascii_detect(const char *p, const char *end);
+
+// Picked on the first call, the race between threads writes the same value
+static size_t (*ascii_prefix)(const char *p, const char *end) = ascii_detect;
+
+static size_t ascii_detect(const char *p, const char *end)
+{
+	__builtin_cpu_init();
+	ascii_prefix = __builtin_cpu_supports("avx2") ? ascii_avx2 : ascii_sse2;
+	return ascii_prefix(p, end);
+}
+#elif JUTF8_NEON
+static size_t ascii_prefix(const char *p, const char *end)
+{
+	const char *begin = p;
+	for (; end - p >= 16; p += 16) {
+		if (vmaxvq_u8(vld1q_u8((const uint8_t *) p)) & 0x80)
+			break;
+	}
+	return (p - begin) + ascii_words(p, end);
+}
+#else
+#define ascii_prefix ascii_words
+#endif
+
+static inline jutf8_state utf8_lead(uint8_t c)
+{
+	if (c < 0x80)
+		return JUTF8_ACCEPT;
+	if (c < 0xC2)
+		return JUTF8_REJECT;
+	if (c < 0xE0)
+		return NEED_1;
+	if (c == 0xE0)
+		return AFTER_E0;
+	if (c == 0xED)
+		return AFTER_ED;
+	if (c < 0xF0)
+		return NEED_2;
+	if (c == 0xF0)
+		return AFTER_F0;
+	if (c < 0xF4)
+		return NEED_3;
+	if (c == 0xF4)
+		return AFTER_F4;
+	return JUTF8_REJECT;
+}
+
+static inline jutf8_state utf8_continuation(jutf8_state state, uint8_t c)
+{
+	if ((c & 0xC0) != 0x80)
+		return JUTF8_REJECT;
+
+	switch (state) {
+	case NEED_1:
+		return JUTF8_ACCEPT;
+	case NEED_2:
+		return NEED_1;
+	case NEED_3:
+		return NEED_2;
+	case AFTER_E0:
+		return c >= 0xA0 ? NEED_1 : JUTF8_REJECT;
+	case AFTER_ED:
+		return c < 0xA0 ? NEED_1 : JUTF8_REJECT;
+	case AFTER_F0:
+		return c >= 0x90 ? NEED_2 : JUTF8_REJECT;
+	case AFTER_F4:
+		return c < 0x90 ? NEED_2 : JUTF8_REJECT;
+	}
+	return JUTF8_REJECT;
+}
+
+jutf8_state jutf8_feed(jutf8_state state, const char *buf, size_t len)
+{
+	const char *p = buf;
+	const char *end = buf + len;
+
+	while (p < end && state != JUTF8_REJECT) {
+		uint8_t c = *p;
+		if (state != JUTF8_ACCEPT) {
+			state = utf8_continuation(state, c);
+			++p;
+		} else if (c < 0x80) {
+			// Short runs between multibyte sequences aren't worth a call to the vector code
+			uint64_t word;
+			if (end - p >= 8 && (memcpy(&word, p, sizeof(word)), !(word & UINT64_C(0x8080808080808080))))
+				p += 8 + ascii_prefix(p + 8, end);
+			else
+				++p;
+		} else {
+			state = utf8_lead(c);
+			++p;
+		}
+	}
+	return state;
+}
@@ -0,0 +1,65 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#ifndef JUTF8_INTERNAL_H_
+#define JUTF8_INTERNAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <japi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * State of the incremental UTF-8 validation: JUTF8_ACCEPT between complete sequences,
+ * JUTF8_REJECT once an invalid sequence has been seen, anything else within a sequence.
+ */
+typedef uint8_t jutf8_state;
+
+#define JUTF8_ACCEPT 0
+#define JUTF8_REJECT 1
+
+/**
+ * Validate the next part of a text split at arbitrary bytes.
+ *
+ * Overlong encodings, surrogates and code points above U+10FFFF are rejected. Runs of ASCII
+ * are skipped with vector instructions picked at run time.
+ *
+ * @param state The state after the previous part, JUTF8_ACCEPT at the beginning of the text
+ * @param buf The part of the text
+ * @param len The length of the part
+ * @return The state after the part. The text is valid if it's JUTF8_ACCEPT at the end.
+ */
+PJSON_LOCAL jutf8_state jutf8_feed(jutf8_state state, const char *buf, size_t len);
+
+/**
+ * Check that the text is well-formed UTF-8.
+ */
+static inline bool jutf8_validate(const char *buf, size_t len)
+{
+	return jutf8_feed(JUTF8_ACCEPT, buf, len) == JUTF8_ACCEPT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JUTF8_INTERNAL_H_ */
@@ -142,43 +142,60 @@ static struct TraverseCallbacks traverse = {
 	to_string_append_jarray_end,
 };
 
+// The string generated so far, if any
+static inline const char *cached_string(jvalue_ref val)
+{
+	jvalue_extra *extra = jvalue_extra_get(val);
+	return extra ? extra->m_toString : NULL;
+}
+
 //TODO inline this function to layer1
 static const char *jvalue_tostring_internal_layer2(jvalue_ref val, JSchemaInfoRef schemainfo, bool schemaNecessary)
 {
 	SANITY_CHECK_POINTER(val);
 	CHECK_POINTER_RETURN_VALUE(val, "null");
 
-	if (!val->m_toString) {
+	jvalue_extra *extra = jvalue_extra_get(val);
+	if (!extra || !extra->m_toString) {
 		if (schemaNecessary && !jvalue_check_schema(val, schemainfo)) {
 			return NULL;
 		}
+		// The shared scalars and keys aren't modified, their text is known beforehand
+		const char *text = jscalar_text(val);
+		if (!text)
+			text = jkey_interned_text(val);
+		if (text) {
+			return text;
+		}
+		extra = jvalue_extend(val);
+		if (extra == NULL) {
+			return NULL;
+		}
 		JStreamRef generating = jstreamInternal(TOP_None);
 		if (generating == NULL) {
 			return NULL;
 		}
 		bool parseok = jvalue_traverse(val, &traverse, generating);
 		StreamStatus error;
-		val->m_toString = generating->finish(generating, &error);
-		val->m_toStringDealloc = free;
-		assert (val->m_toString != NULL);
+		extra->m_toString = generating->finish(generating, &error);
+		extra->m_toStringDealloc = free;
+		assert (extra->m_toString != NULL);
 		if(!parseok) {
 			return NULL;
 		}
 	}
 
-	return val->m_toString;
+	return extra->m_toString;
 }
 
 static const char *jvalue_tostring_internal_layer1(jvalue_ref val, JSchemaInfoRef schemainfo, bool schemaNecessary)
 {
-	if (val->m_toStringDealloc)
-		val->m_toStringDealloc(val->m_toString);
-	val->m_toString = NULL;
+	jvalue_forget_string(val);
 
 	const char* result = jvalue_tostring_internal_layer2(val, schemainfo, schemaNecessary);
 
 	if (result == NULL) {
-		PJ_LOG_ERR("PBNJSON_JVAL_TO_STR_ERR", 1, PMLOGKS("STRING", val->m_toString), "Failed to generate string from jvalue. Error location: %s", val->m_toString);
+		PJ_LOG_ERR("PBNJSON_JVAL_TO_STR_ERR", 1, PMLOGKS("STRING", cached_string(val)), "Failed to generate string from jvalue. Error location: %s", cached_string(val));
 	}
 
 	return result;
@@ -239,6 +239,18 @@ static jvalue_ref get_default(Validator *v, ValidationState *s)
 	return a->def_value;
 }
 
+// The tuple of "items" gives the count, "minItems" and "maxItems" bound it
+static size_t capacity_hint(Validator *v, ValidationState *s)
+{
+	ArrayValidator *a = (ArrayValidator *) v;
+	size_t hint = a->items ? array_items_items_length(a->items) : 0;
+	if (a->min_items != -1 && (size_t) a->min_items > hint)
+		hint = a->min_items;
+	if (a->max_items != -1 && (size_t) a->max_items < hint)
+		hint = a->max_items;
+	return hint;
+}
+
 static Validator* set_items_generic(Validator *v, ArrayItems *items)
 {
 	return set_items(&array_validator_new()->base, items);
@@ -317,9 +329,22 @@ static bool equals(Validator *v, Validator *other)
 	return false;
 }
 
+static ValidatorType instance_type(Validator *v)
+{
+	return V_ARR;
+}
+
+// Only the same schema for all the elements describes an element without its index
+static Validator* member(Validator *v, char const *key)
+{
+	ArrayValidator *a = (ArrayValidator *) v;
+	return a->items ? a->items->generic_validator : NULL;
+}
+
 static ValidatorVtable generic_array_vtable =
 {
 	.check = check_generic,
+	.instance_type = instance_type,
 	.init_state = init_state_generic,
 	.cleanup_state = cleanup_state_generic,
 	.set_array_items = set_items_generic,
@@ -348,6 +373,9 @@ ValidatorVtable array_vtable =
 	.set_array_unique_items = set_unique_items,
 	.set_default = set_default,
 	.get_default = get_default,
+	.capacity_hint = capacity_hint,
+	.instance_type = instance_type,
+	.member = member,
 	.dump_enter = dump_enter,
 	.dump_exit = dump_exit,
 };
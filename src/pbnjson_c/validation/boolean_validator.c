@@ -91,11 +91,17 @@ static Validator* set_default_generic(Validator *v, jvalue_ref def_value)
 	return set_default(&boolean_validator_new()->base, def_value);
 }
 
+static ValidatorType instance_type(Validator *v)
+{
+	return V_BOOL;
+}
+
 static ValidatorVtable boolean_vtable =
 {
 	.ref = ref,
 	.unref = unref,
 	.check = check_generic,
+	.instance_type = instance_type,
 	.set_default = set_default,
 	.get_default = get_default,
 };
@@ -103,18 +109,21 @@ static ValidatorVtable boolean_vtable =
 static ValidatorVtable generic_boolean_vtable =
 {
 	.check = check_generic,
+	.instance_type = instance_type,
 	.set_default = set_default_generic,
 };
 
 static ValidatorVtable true_boolean_vtable =
 {
 	.check = check_true,
+	.instance_type = instance_type,
 	.set_default = set_default_generic,
 };
 
 static ValidatorVtable false_boolean_vtable =
 {
 	.check = check_false,
+	.instance_type = instance_type,
 	.set_default = set_default_generic,
 };
 
@@ -238,6 +238,31 @@ static void _visit(Validator *v,
 	}
 }
 
+// The only type besides null, as in {"type": ["integer", "null"]}
+static Validator* single_type(CombinedTypesValidator *c)
+{
+	Validator *single = NULL;
+	for (int i = 0; i < V_TYPES_NUM; ++i) {
+		if (i == V_NULL || !c->types[i])
+			continue;
+		if (single)
+			return NULL;
+		single = c->types[i];
+	}
+	return single;
+}
+
+static ValidatorType instance_type(Validator *v)
+{
+	Validator *single = single_type((CombinedTypesValidator *) v);
+	return single ? validator_instance_type(single) : V_ANY;
+}
+
+static Validator* member(Validator *v, char const *key)
+{
+	return validator_member(single_type((CombinedTypesValidator *) v), key);
+}
+
 ValidatorVtable combined_types_vtable =
 {
 	.check = _check,
@@ -259,6 +284,8 @@ ValidatorVtable combined_types_vtable =
 	.set_object_additional_properties = set_additional_properties,
 	.set_default = set_default,
 	.get_default = get_default,
+	.instance_type = instance_type,
+	.member = member,
 };
 
 CombinedTypesValidator* combined_types_validator_new(void)
@@ -302,9 +302,25 @@ static bool equals(Validator *v, Validator *other)
 	return false;
 }
 
+static ValidatorType instance_type(Validator *v)
+{
+	return ((NumberValidator *) v)->integer ? V_INT : V_NUM;
+}
+
+static ValidatorType instance_type_generic(Validator *v)
+{
+	return V_NUM;
+}
+
+static ValidatorType instance_type_integer_generic(Validator *v)
+{
+	return V_INT;
+}
+
 static ValidatorVtable generic_number_vtable =
 {
 	.check = check_generic,
+	.instance_type = instance_type_generic,
 	.set_number_maximum = set_maximum_generic,
 	.set_number_maximum_exclusive = set_maximum_exclusive_generic,
 	.set_number_minimum = set_minimum_generic,
@@ -316,6 +332,7 @@ static ValidatorVtable generic_number_vtable =
 static ValidatorVtable generic_integer_vtable =
 {
 	.check = check_integer_generic,
+	.instance_type = instance_type_integer_generic,
 	.set_number_maximum = set_maximum_integer_generic,
 	.set_number_maximum_exclusive = set_maximum_exclusive_integer_generic,
 	.set_number_minimum = set_minimum_integer_generic,
@@ -330,6 +347,7 @@ static ValidatorVtable number_vtable =
 	.unref = unref,
 	.check = _check,
 	.equals = equals,
+	.instance_type = instance_type,
 	.set_number_maximum = set_maximum,
 	.set_number_maximum_exclusive = set_maximum_exclusive,
 	.set_number_minimum = set_minimum,
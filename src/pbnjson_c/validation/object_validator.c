@@ -367,9 +367,15 @@ static bool equals(Validator *v, Validator *other)
 	return false;
 }
 
+static ValidatorType instance_type(Validator *v)
+{
+	return V_OBJ;
+}
+
 static ValidatorVtable generic_object_vtable =
 {
 	.check = check_generic,
+	.instance_type = instance_type,
 	.init_state = init_state_generic,
 	.cleanup_state = cleanup_state_generic,
 	.set_object_properties = set_properties_generic,
@@ -382,6 +388,27 @@ static ValidatorVtable generic_object_vtable =
 	.dump_exit = dump_exit,
 };
 
+// Most of the declared properties are expected, the required ones and "minProperties" at least
+static size_t capacity_hint(Validator *v, ValidationState *s)
+{
+	ObjectValidator *o = (ObjectValidator *) v;
+	size_t hint = o->properties ? object_properties_length(o->properties) : 0;
+	if (o->required && object_required_size(o->required) > hint)
+		hint = object_required_size(o->required);
+	if (o->min_properties != -1 && (size_t) o->min_properties > hint)
+		hint = o->min_properties;
+	if (o->max_properties != -1 && (size_t) o->max_properties < hint)
+		hint = o->max_properties;
+	return hint;
+}
+
+// Only the declared properties, the additional ones may be anything
+static Validator* member(Validator *v, char const *key)
+{
+	ObjectValidator *o = (ObjectValidator *) v;
+	return o->properties ? object_properties_lookup(o->properties, key) : NULL;
+}
+
 ValidatorVtable object_vtable =
 {
 	.check = _check,
@@ -397,6 +424,9 @@ ValidatorVtable object_vtable =
 	.set_object_min_properties = set_min_properties,
 	.set_default = set_default,
 	.get_default = get_default,
+	.capacity_hint = capacity_hint,
+	.instance_type = instance_type,
+	.member = member,
 	.visit = _visit,
 	.dump_enter = dump_enter,
 	.dump_exit = dump_exit,
@@ -163,6 +163,17 @@ static void _dump_enter(char const *key, Validator *v, void *ctxt)
 		fprintf((FILE *) ctxt, "($%s %s)", r->document, r->fragment);
 }
 
+// The schema referred, once it's resolved
+static ValidatorType instance_type(Validator *v)
+{
+	return validator_instance_type(((Reference *) v)->validator);
+}
+
+static Validator* member(Validator *v, char const *key)
+{
+	return validator_member(((Reference *) v)->validator, key);
+}
+
 static ValidatorVtable reference_vtable =
 {
 	.ref = ref,
@@ -172,6 +183,8 @@ static ValidatorVtable reference_vtable =
 	.init_state = _init_state,
 	.reactivate = _reactivate,
 	.check = _check,
+	.instance_type = instance_type,
+	.member = member,
 	.collect_uri_enter = _collect_uri_enter,
 	.collect_schemas = _collect_schemas,
 	.collect_uri_exit = _collect_uri_exit,
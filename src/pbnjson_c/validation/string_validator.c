@@ -21,6 +21,7 @@
 #include "validation_state.h"
 #include "validation_event.h"
 #include "parser_context.h"
+#include "uri_resolver.h"
 #include <jobject.h>
 #include <glib.h>
 #include <string.h>
@@ -35,8 +36,13 @@ static bool _check_conditions(StringValidator *v, ValidationEvent const *e,
 		return false;
 	}
 
+	// The contents of a string delivered by chunks aren't kept unless the schema
+	// needs them (see string_validators_need_content), only its length is known.
+	bool streamed = !e->value.string.ptr;
+
 	if (v->expected_value &&
-	    (strlen(v->expected_value) != e->value.string.len
+	    (streamed
+	    || strlen(v->expected_value) != e->value.string.len
 	    || strncmp(v->expected_value, e->value.string.ptr, e->value.string.len)))
 	{
 		validation_state_notify_error(s, VEC_UNEXPECTED_VALUE, c);
@@ -59,12 +65,9 @@ static bool _check_conditions(StringValidator *v, ValidationEvent const *e,
 
 	if (v->pattern)
 	{
-		size_t len = e->value.string.len;
-		char buf[len + 1];
-		memcpy(buf, e->value.string.ptr, len);
-		buf[len] = 0;
-		bool res = g_regex_match(v->pattern, buf, 0, NULL);
-		if (!res)
+		// Match in place: the string may be too long for a copy on the stack
+		if (streamed ||
+		    !g_regex_match_full(v->pattern, e->value.string.ptr, e->value.string.len, 0, 0, NULL, NULL))
 		{
 			validation_state_notify_error(s, VEC_STRING_NOT_PATTERN, c);
 			return false;
@@ -183,9 +186,15 @@ static bool equals(Validator *v, Validator *other)
 	return false;
 }
 
+static ValidatorType instance_type(Validator *v)
+{
+	return V_STR;
+}
+
 static ValidatorVtable generic_string_vtable =
 {
 	.check = check_generic,
+	.instance_type = instance_type,
 	.set_string_max_length = set_max_length_generic,
 	.set_string_min_length = set_min_length_generic,
 	.set_string_pattern = set_pattern_generic,
@@ -199,6 +208,7 @@ static ValidatorVtable string_vtable =
 	.equals = equals,
 	.ref = ref,
 	.unref = unref,
+	.instance_type = instance_type,
 	.set_string_max_length = set_max_length,
 	.set_string_min_length = set_min_length,
 	.set_string_pattern = set_pattern,
@@ -260,3 +270,45 @@ Validator* string_validator_instance(void)
 {
 	return STRING_VALIDATOR_GENERIC;
 }
+
+static void _find_content_check(char const *key, Validator *v, void *ctxt)
+{
+	if (v->vtable != &string_vtable)
+		return;
+	StringValidator *s = (StringValidator *) v;
+	if (s->pattern || s->expected_value)
+		*(bool *) ctxt = true;
+}
+
+bool string_validators_need_content(Validator *v, UriResolver *u)
+{
+	bool result = false;
+	if (v)
+	{
+		_find_content_check(NULL, v, &result);
+		validator_visit(v, _find_content_check, VISITOR_EXIT_VOID, &result);
+	}
+	if (!u)
+		return result;
+
+	// Referenced validators aren't visited from the root, check every fragment
+	GHashTableIter it1;
+	g_hash_table_iter_init(&it1, u->documents);
+	GHashTable *fragments = NULL;
+	while (!result && g_hash_table_iter_next(&it1, NULL, (void **) &fragments))
+	{
+		if (!fragments)
+			continue;
+		GHashTableIter it2;
+		g_hash_table_iter_init(&it2, fragments);
+		Validator *fv = NULL;
+		while (!result && g_hash_table_iter_next(&it2, NULL, (void **) &fv))
+		{
+			if (!fv)
+				continue;
+			_find_content_check(NULL, fv, &result);
+			validator_visit(fv, _find_content_check, VISITOR_EXIT_VOID, &result);
+		}
+	}
+	return result;
+}
@@ -65,6 +65,16 @@ void string_validator_set_pattern(StringValidator *v, GRegex *pattern);
 /** @brief Remember expected value (for enums) */
 void string_validator_add_expected_value(StringValidator *v, StringSpan *span);
 
+/** @brief Check if any string validator reachable from the schema matches contents of strings
+ *
+ * Only the length of a string is needed for the rest of the checks.
+ *
+ * @param[in] v Root validator of the schema
+ * @param[in] u Resolver with the referenced validators of the schema, may be NULL
+ * @return true if there's a validator with a pattern or an expected value (enum)
+ */
+bool string_validators_need_content(Validator *v, UriResolver *u);
+
 #ifdef __cplusplus
 }
 #endif
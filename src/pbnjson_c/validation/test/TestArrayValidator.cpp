@@ -498,3 +498,38 @@ TEST_F(TestArrayValidator, MaxItemsNegative)
 	EXPECT_EQ(VEC_ARRAY_TOO_LONG, error);
 	EXPECT_EQ(0, g_slist_length(s->validator_stack));
 }
+
+TEST_F(TestArrayValidator, CapacityHint)
+{
+	EXPECT_EQ(0, validation_state_capacity_hint(s));
+
+	array_items_add_item(items, NULL_VALIDATOR);
+	array_items_add_item(items, NULL_VALIDATOR);
+	array_items_add_item(items, NULL_VALIDATOR);
+	EXPECT_TRUE(validation_check(&(e = validation_event_arr_start()), s, NULL));
+	EXPECT_EQ(3, validation_state_capacity_hint(s));
+
+	array_validator_set_min_items(v, 5);
+	EXPECT_EQ(5, validation_state_capacity_hint(s));
+
+	array_validator_set_max_items(v, 4);
+	EXPECT_EQ(4, validation_state_capacity_hint(s));
+
+	// The items are validated by their own validators
+	EXPECT_TRUE(validation_check(&(e = validation_event_null()), s, this));
+	EXPECT_EQ(4, validation_state_capacity_hint(s));
+}
+
+TEST_F(TestArrayValidator, Member)
+{
+	EXPECT_EQ(V_ARR, validator_instance_type(&v->base));
+	EXPECT_EQ(NULL, validator_member(&v->base, NULL));
+
+	// Only the schema of all the items describes an element
+	array_items_add_item(items, NULL_VALIDATOR);
+	EXPECT_EQ(NULL, validator_member(&v->base, NULL));
+
+	array_items_set_generic_item(items, integer_validator_instance());
+	EXPECT_EQ(integer_validator_instance(), validator_member(&v->base, NULL));
+	EXPECT_EQ(V_INT, validator_instance_type(validator_member(&v->base, NULL)));
+}
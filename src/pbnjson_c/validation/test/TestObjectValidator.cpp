@@ -297,3 +297,31 @@ TEST_F(TestObjectValidator, MinProperties)
 	EXPECT_TRUE(validate_json_plain("{\"a\":null, \"b\":true}", &v->base));
 	EXPECT_TRUE(validate_json_plain("{\"a\":null, \"b\":true, \"c\":[]}", &v->base));
 }
+
+TEST_F(TestObjectValidator, CapacityHint)
+{
+	EXPECT_TRUE(validation_check(&(e = validation_event_obj_start()), s, NULL));
+	EXPECT_EQ(0, validation_state_capacity_hint(s));
+
+	object_properties_add_key(p, "a", NULL_VALIDATOR);
+	object_properties_add_key(p, "b", NULL_VALIDATOR);
+	EXPECT_EQ(2, validation_state_capacity_hint(s));
+
+	object_validator_set_min_properties(v, 3);
+	EXPECT_EQ(3, validation_state_capacity_hint(s));
+
+	object_validator_set_max_properties(v, 1);
+	EXPECT_EQ(1, validation_state_capacity_hint(s));
+}
+
+TEST_F(TestObjectValidator, Member)
+{
+	EXPECT_EQ(V_OBJ, validator_instance_type(&v->base));
+	EXPECT_EQ(NULL, validator_member(&v->base, "a"));
+
+	object_properties_add_key(p, "a", string_validator_instance());
+	object_properties_add_key(p, "b", number_validator_instance());
+	EXPECT_EQ(V_STR, validator_instance_type(validator_member(&v->base, "a")));
+	EXPECT_EQ(V_NUM, validator_instance_type(validator_member(&v->base, "b")));
+	EXPECT_EQ(NULL, validator_member(&v->base, "c"));
+}
@@ -75,7 +75,8 @@ ValidationEvent validation_event_number(const char *str, size_t len);
 
 /** @brief Create validation event for JSON string.
  *
- * @param[in] str Pointer to the string source
+ * @param[in] str Pointer to the string source, NULL if the string has been delivered
+ *                by chunks and only its length is known
  * @param[in] len Length of the string
  * @return Event for validation_check()
  */
@@ -109,6 +109,11 @@ void *validation_state_pop_context(ValidationState *s)
 	return ctxt;
 }
 
+size_t validation_state_capacity_hint(ValidationState *s)
+{
+	return validator_capacity_hint(validation_state_get_validator(s), s);
+}
+
 void validation_state_notify_error(ValidationState *s, ValidationErrorCode error, void *ctxt)
 {
 	if (!s->notify || !s->notify->error_func)
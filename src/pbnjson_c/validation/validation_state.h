@@ -162,6 +162,14 @@ void validation_state_push_context(ValidationState *s, void *ctxt);
 /** @brief Pop data from the context stack. */
 void *validation_state_pop_context(ValidationState *s);
 
+/** @brief Expected count of members of the container which has just started.
+ *
+ * Asks the current validator, the one that checks the members of the object
+ * or array after its start event has been validated.
+ * @return The count known from the schema, 0 if unknown.
+ */
+size_t validation_state_capacity_hint(ValidationState *s);
+
 /** @brief Engage error callback.
  *
  * @param[in] s This object
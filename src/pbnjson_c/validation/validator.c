@@ -19,6 +19,7 @@
 #include "validator.h"
 #include "uri_scope.h"
 #include "uri_resolver.h"
+#include <jobject.h>
 #include <assert.h>
 #include <stdio.h>
 
@@ -94,6 +95,36 @@ void validator_reactivate(Validator *v, ValidationState *s)
 	v->vtable->reactivate(v, s);
 }
 
+size_t validator_capacity_hint(Validator *v, ValidationState *s)
+{
+	if (!v)
+		return 0;
+	assert(v->vtable);
+	if (!v->vtable->capacity_hint)
+		return 0;
+	return v->vtable->capacity_hint(v, s);
+}
+
+ValidatorType validator_instance_type(Validator *v)
+{
+	if (!v)
+		return V_ANY;
+	assert(v->vtable);
+	if (!v->vtable->instance_type)
+		return V_ANY;
+	return v->vtable->instance_type(v);
+}
+
+Validator* validator_member(Validator *v, char const *key)
+{
+	if (!v)
+		return NULL;
+	assert(v->vtable);
+	if (!v->vtable->member)
+		return NULL;
+	return v->vtable->member(v, key);
+}
+
 Validator* validator_set_object_properties(Validator *v, ObjectProperties *p)
 {
 	assert(v && v->vtable);
@@ -383,6 +414,9 @@ Validator* validator_set_string_pattern(Validator *v, Pattern *pattern)
 Validator* validator_set_default(Validator *v, jvalue_ref def_value)
 {
 	assert(v && v->vtable);
+	// The schema may be shared by the threads, every document validated gets a private
+	// copy of the default (jvalue_duplicate_private), the default itself is never modified
+	jvalue_freeze(def_value);
 	if (v->vtable->set_default)
 		return v->vtable->set_default(v, def_value);
 	return v;
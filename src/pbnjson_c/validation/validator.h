@@ -91,6 +91,32 @@ typedef struct _ValidatorVtable
 	 */
 	void (*reactivate)(Validator *v, ValidationState *s);
 
+	/** @brief Expected count of members of the object or array being validated.
+	 *
+	 * Called right after the container start has been checked, while the validator
+	 * is the head of the stack. Lets a DOM builder pre-size the container.
+	 */
+	size_t (*capacity_hint)(Validator *v, ValidationState *s);
+
+	/** @} */
+
+
+	/** @name Inspection of the schema outside of the validation
+	 *  @{
+	 */
+
+	/** @brief The only type of the instances accepted by the validator, V_ANY if unknown.
+	 *
+	 * JSON null accepted along with another type doesn't count.
+	 */
+	ValidatorType (*instance_type)(Validator *v);
+
+	/** @brief Validator of the object member by the key, or of the array elements.
+	 *
+	 * Arrays ignore the key, the elements are described by the schema of "items".
+	 */
+	Validator* (*member)(Validator *v, char const *key);
+
 	/** @} */
 
 
@@ -227,6 +253,15 @@ bool validator_init_state(Validator *v, ValidationState *s);
 void validator_cleanup_state(Validator *v, ValidationState *s);
 void validator_reactivate(Validator *v, ValidationState *s);
 
+/** @brief Expected count of members of the container being validated, 0 if unknown. */
+size_t validator_capacity_hint(Validator *v, ValidationState *s);
+
+/** @brief The only type of the instances accepted by the validator, V_ANY if unknown. */
+ValidatorType validator_instance_type(Validator *v);
+
+/** @brief Validator of the object member by the key, or of the array elements, NULL if unknown. */
+Validator* validator_member(Validator *v, char const *key);
+
 /** @brief Visit validator and its descendants.
  *
  * Call enter_func and exit_func for every contained (descendant) validator of this one.
@@ -24,6 +24,22 @@ extern "C" {
 
 typedef struct _Validator Validator;
 
+/** @brief Expected validator type */
+typedef enum _ValidatorType
+{
+	V_NULL = 0,   /**< @brief JSON null */
+	V_NUM,        /**< @brief JSON number */
+	V_INT,        /**< @brief JSON integer number */
+	V_BOOL,       /**< @brief JSON boolean */
+	V_STR,        /**< @brief JSON string */
+	V_ARR,        /**< @brief JSON array */
+	V_OBJ,        /**< @brief JSON object */
+	V_ANY,        /**< @brief Any JSON type. TODO: It's obsolete, remove it. */
+
+	V_TYPES_NUM,  /**< @brief Count of JSON types. */
+
+} ValidatorType;
+
 /** @brief Validator visitor enter function.
  *
  * @param[in] key Key in the parent validator (property name, definition name etc)
@@ -0,0 +1,56 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <JArrayIndex.h>
+#include <pbnjson.h>
+
+namespace pbnjson {
+
+JArrayIndex::JArrayIndex(const JValue &array, const std::string &keyPath)
+	: m_index(array.isArray() ? jarray_build_index(array.peekRaw(), keyPath.c_str()) : NULL)
+{
+}
+
+JArrayIndex::~JArrayIndex()
+{
+	jarray_index_release(&m_index);
+}
+
+bool JArrayIndex::isValid() const
+{
+	return m_index != NULL;
+}
+
+ssize_t JArrayIndex::find(const JValue &key) const
+{
+	return m_index ? jarray_index_find(m_index, key.peekRaw()) : -1;
+}
+
+JValue JArrayIndex::operator[](const JValue &key) const
+{
+	if (!m_index)
+		return JValue::Invalid();
+	return JValue(jvalue_copy(jarray_index_get(m_index, key.peekRaw())));
+}
+
+bool JArrayIndex::rebuild()
+{
+	return m_index && jarray_index_rebuild(m_index);
+}
+
+}
@@ -123,7 +123,12 @@ bool JDomParser::begin(const JSchema &_schema, JErrorHandler *errors)
 	if (oldInterface && schemaInfo.m_schema->uri_resolver && !jschema_resolve_ex(schemaInfo.m_schema, &externalRefResolver))
 		return false;
 
-	return jdomparser_init(parser, &schemaInfo, m_optimization);
+	if (!jdomparser_init(parser, &schemaInfo, m_optimization))
+		return false;
+
+	// The parser is reused for the next documents, they get containers of the sizes seen before
+	jdomparser_learn_sizes(parser);
+	return true;
 }
 
 bool JDomParser::feed(const char *buf, int length)
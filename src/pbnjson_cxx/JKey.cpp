@@ -0,0 +1,71 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <JKey.h>
+#include <pbnjson.h>
+
+namespace pbnjson {
+
+JKey::JKey(const std::string &name)
+	: m_key(jkey_create(j_str_to_buffer(name.data(), name.size())))
+{
+}
+
+JKey::JKey(jkey_ref toOwn)
+	: m_key(toOwn)
+{
+}
+
+JKey::JKey(const JKey &other)
+	: m_key(other.m_key ? jkey_copy(other.m_key) : NULL)
+{
+}
+
+JKey& JKey::operator=(const JKey &other)
+{
+	if (m_key != other.m_key) {
+		jkey_release(&m_key);
+		m_key = other.m_key ? jkey_copy(other.m_key) : NULL;
+	}
+	return *this;
+}
+
+JKey::~JKey()
+{
+	jkey_release(&m_key);
+}
+
+JKey JKey::intern(const std::string &name)
+{
+	return JKey(jkey_intern(j_str_to_buffer(name.data(), name.size())));
+}
+
+bool JKey::isValid() const
+{
+	return m_key != NULL;
+}
+
+std::string JKey::name() const
+{
+	if (!m_key)
+		return std::string();
+	raw_buffer name = jstring_get_fast(jkey_string(m_key));
+	return std::string(name.m_str, name.m_len);
+}
+
+}
@@ -252,6 +252,33 @@ bool JParser::feed(const char *buf, int length)
 	return jsaxparser_feed(parser, buf, length);
 }
 
+static JParser::FeedStatus toFeedStatus(jsaxparser_status status)
+{
+	switch (status) {
+	case JSAXPARSER_OK:
+		return JParser::FEED_DONE;
+	case JSAXPARSER_PAUSED:
+		return JParser::FEED_PAUSED;
+	default:
+		return JParser::FEED_FAILED;
+	}
+}
+
+JParser::FeedStatus JParser::feed(const char *buf, size_t length, size_t &consumed)
+{
+	return toFeedStatus(jsaxparser_feed_ex(parser, buf, length, &consumed));
+}
+
+JParser::FeedStatus JParser::resume(size_t &consumed)
+{
+	return toFeedStatus(jsaxparser_resume(parser, &consumed));
+}
+
+void JParser::pause()
+{
+	jsax_pause(&parser->internalCtxt);
+}
+
 bool JParser::end()
 {
 	return jsaxparser_end(parser);
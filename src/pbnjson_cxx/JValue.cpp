@@ -21,6 +21,7 @@
 #include <pbnjson.h>
 #include <JSchema.h>
 #include <JGenerator.h>
+#include <JKey.h>
 #include <cassert>
 
 #ifdef DBG_CXX_MEM_STR
@@ -177,6 +178,16 @@ JValue JValue::duplicate() const
 	return jvalue_duplicate(this->peekRaw());
 }
 
+void JValue::freeze()
+{
+	jvalue_freeze(m_jval);
+}
+
+void JValue::deferRelease(size_t members)
+{
+	j_release_set_deferred(members);
+}
+
 JValue Object()
 {
 	return jobject_create();
@@ -290,6 +301,13 @@ JValueArrayElement JValue::operator[](const raw_buffer& key) const
 	return JValueArrayElement(jvalue_copy(jobject_get(m_jval, key)));
 }
 
+JValueArrayElement JValue::operator[](const JKey& key) const
+{
+	if (!key.m_key)
+		return JValue::Invalid();
+	return JValueArrayElement(jvalue_copy(jobject_get_key(m_jval, key.m_key)));
+}
+
 bool JValue::put(size_t index, const JValue& value)
 {
 #if PBNJSON_ZERO_COPY_STL_STR
@@ -314,6 +332,15 @@ bool JValue::put(const JValue& key, const JValue& value)
 	return jobject_set2(m_jval, key.peekRaw(), value.peekRaw());
 }
 
+bool JValue::put(const JKey& key, const JValue& value)
+{
+#if PBNJSON_ZERO_COPY_STL_STR
+	m_children.push_back(value.m_input);
+	m_children.insert(m_children.end(), value.m_children.begin(), value.m_children.end());
+#endif
+	return key.m_key && jobject_set_key(m_jval, key.m_key, value.peekRaw());
+}
+
 bool JValue::remove(const char *key)
 {
 	raw_buffer buf;
@@ -418,6 +445,11 @@ bool JValue::isBoolean() const
 	return jis_boolean(m_jval);
 }
 
+bool JValue::isFrozen() const
+{
+	return jis_frozen(m_jval);
+}
+
 template <>
 ConversionResultFlags JValue::asNumber<int32_t>(int32_t& number) const
 {
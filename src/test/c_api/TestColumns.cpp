@@ -0,0 +1,383 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <gtest/gtest.h>
+#include <pbnjson.h>
+#include <string>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+class TestColumns : public ::testing::Test
+{
+protected:
+	jvalue_ref arr;
+	jvalue_ref result;
+	jcolumn columns[4];
+
+	virtual void SetUp()
+	{
+		arr = NULL;
+		result = NULL;
+		memset(columns, 0, sizeof(columns));
+	}
+
+	virtual void TearDown()
+	{
+		for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); ++i)
+			jcolumn_clear(&columns[i]);
+		j_release(&arr);
+		j_release(&result);
+	}
+
+	jvalue_ref Parse(const char *input, JDOMOptimizationFlags flags = DOMOPT_NOOPT)
+	{
+		JSchemaInfo schemaInfo;
+		jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+		j_release(&arr);
+		arr = jdom_parse(j_cstr_to_buffer(input), flags, &schemaInfo);
+		return arr;
+	}
+
+	void Column(size_t i, const char *path, JColumnType type = JCOLUMN_AUTO)
+	{
+		columns[i].m_path = path;
+		columns[i].m_type = type;
+	}
+
+	static bool Valid(const jcolumn &column, size_t row)
+	{
+		return column.m_validity[row / 8] & (1 << (row % 8));
+	}
+
+	static string String(const jcolumn &column, size_t row)
+	{
+		return string(column.m_data + column.m_values.offsets[row],
+		              column.m_values.offsets[row + 1] - column.m_values.offsets[row]);
+	}
+
+	string Serialize(jvalue_ref value)
+	{
+		return jvalue_tostring_simple(value);
+	}
+};
+
+} // namespace
+
+TEST_F(TestColumns, Types)
+{
+	ASSERT_TRUE(jis_array(Parse(
+		"[{\"id\": 1, \"score\": 0.5, \"ok\": true, \"name\": \"a\"},"
+		" {\"id\": 2, \"score\": 2, \"ok\": false, \"name\": \"\"},"
+		" {\"id\": 3, \"score\": -1.25, \"ok\": true, \"name\": \"ccc\"}]")));
+
+	Column(0, "/id");
+	Column(1, "/score");
+	Column(2, "/ok");
+	Column(3, "/name");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 4));
+
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	ASSERT_EQ(3u, columns[0].m_length);
+	EXPECT_EQ(0u, columns[0].m_nullCount);
+	EXPECT_EQ(1, columns[0].m_values.i64[0]);
+	EXPECT_EQ(2, columns[0].m_values.i64[1]);
+	EXPECT_EQ(3, columns[0].m_values.i64[2]);
+
+	ASSERT_EQ(JCOLUMN_F64, columns[1].m_type);
+	EXPECT_DOUBLE_EQ(0.5, columns[1].m_values.f64[0]);
+	EXPECT_DOUBLE_EQ(2, columns[1].m_values.f64[1]);
+	EXPECT_DOUBLE_EQ(-1.25, columns[1].m_values.f64[2]);
+
+	ASSERT_EQ(JCOLUMN_BOOL, columns[2].m_type);
+	EXPECT_EQ(0x5, columns[2].m_values.bits[0]);
+
+	ASSERT_EQ(JCOLUMN_STRING, columns[3].m_type);
+	EXPECT_EQ(0, columns[3].m_values.offsets[0]);
+	EXPECT_EQ("a", String(columns[3], 0));
+	EXPECT_EQ("", String(columns[3], 1));
+	EXPECT_EQ("ccc", String(columns[3], 2));
+
+	result = jarray_from_columns(columns, 4);
+	EXPECT_TRUE(jvalue_equal(arr, result));
+}
+
+TEST_F(TestColumns, Nulls)
+{
+	ASSERT_TRUE(jis_array(Parse(
+		"[{\"a\": {\"b\": 1}}, {\"a\": null}, {}, {\"a\": {\"b\": null, \"c\": \"x\"}}, {\"a\": {\"b\": 4}}]")));
+
+	Column(0, "/a/b");
+	Column(1, "/a/c");
+	Column(2, "/missing");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 3));
+
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(3u, columns[0].m_nullCount);
+	EXPECT_TRUE(Valid(columns[0], 0));
+	EXPECT_FALSE(Valid(columns[0], 1));
+	EXPECT_FALSE(Valid(columns[0], 2));
+	EXPECT_FALSE(Valid(columns[0], 3));
+	EXPECT_TRUE(Valid(columns[0], 4));
+	EXPECT_EQ(4, columns[0].m_values.i64[4]);
+
+	ASSERT_EQ(JCOLUMN_STRING, columns[1].m_type);
+	EXPECT_EQ(4u, columns[1].m_nullCount);
+	EXPECT_EQ("x", String(columns[1], 3));
+	EXPECT_EQ("", String(columns[1], 4));
+
+	EXPECT_EQ(JCOLUMN_AUTO, columns[2].m_type);
+	EXPECT_EQ(5u, columns[2].m_nullCount);
+
+	result = jarray_from_columns(columns, 3);
+	EXPECT_EQ("[{\"a\":{\"b\":1}},{},{},{\"a\":{\"c\":\"x\"}},{\"a\":{\"b\":4}}]", Serialize(result));
+}
+
+TEST_F(TestColumns, Widening)
+{
+	ASSERT_TRUE(jis_array(Parse("[{\"v\": 1}, {\"v\": 2}, {\"v\": 2.5}, {\"v\": 3}]")));
+
+	Column(0, "/v");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 1));
+	ASSERT_EQ(JCOLUMN_F64, columns[0].m_type);
+	EXPECT_DOUBLE_EQ(1, columns[0].m_values.f64[0]);
+	EXPECT_DOUBLE_EQ(2, columns[0].m_values.f64[1]);
+	EXPECT_DOUBLE_EQ(2.5, columns[0].m_values.f64[2]);
+	EXPECT_DOUBLE_EQ(3, columns[0].m_values.f64[3]);
+
+	// The integers asked for don't widen
+	jcolumn_clear(&columns[0]);
+	Column(0, "/v", JCOLUMN_I64);
+	EXPECT_FALSE(jarray_to_columns(arr, columns, 1));
+	EXPECT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(NULL, columns[0].m_validity);
+	EXPECT_EQ(NULL, columns[0].m_values.i64);
+}
+
+TEST_F(TestColumns, Mismatch)
+{
+	ASSERT_TRUE(jis_array(Parse("[{\"v\": 1}, {\"v\": \"1\"}]")));
+	Column(0, "/v");
+	EXPECT_FALSE(jarray_to_columns(arr, columns, 1));
+	EXPECT_EQ(JCOLUMN_AUTO, columns[0].m_type);
+
+	ASSERT_TRUE(jis_array(Parse("[{\"v\": {}}]")));
+	EXPECT_FALSE(jarray_to_columns(arr, columns, 1));
+
+	Column(0, "v");
+	EXPECT_FALSE(jarray_to_columns(arr, columns, 1));
+	Column(0, "/~2");
+	EXPECT_FALSE(jarray_to_columns(arr, columns, 1));
+}
+
+TEST_F(TestColumns, Packed)
+{
+	ASSERT_TRUE(jis_array(Parse("[[1, 2.5], [3, 4], [5], [6, -7.5]]")));
+
+	Column(0, "/0");
+	Column(1, "/1");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 2));
+
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(1, columns[0].m_values.i64[0]);
+	EXPECT_EQ(3, columns[0].m_values.i64[1]);
+	EXPECT_EQ(5, columns[0].m_values.i64[2]);
+	EXPECT_EQ(6, columns[0].m_values.i64[3]);
+
+	ASSERT_EQ(JCOLUMN_F64, columns[1].m_type);
+	EXPECT_EQ(1u, columns[1].m_nullCount);
+	EXPECT_DOUBLE_EQ(2.5, columns[1].m_values.f64[0]);
+	EXPECT_DOUBLE_EQ(4, columns[1].m_values.f64[1]);
+	EXPECT_FALSE(Valid(columns[1], 2));
+	EXPECT_DOUBLE_EQ(-7.5, columns[1].m_values.f64[3]);
+
+	jcolumn_clear(&columns[0]);
+	jcolumn_clear(&columns[1]);
+	ASSERT_TRUE(jis_array(Parse("[1, 2, 3]")));
+	Column(0, "");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 1));
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(3, columns[0].m_values.i64[2]);
+
+	result = jarray_from_columns(columns, 1);
+	EXPECT_EQ("[1,2,3]", Serialize(result));
+}
+
+TEST_F(TestColumns, Escapes)
+{
+	ASSERT_TRUE(jis_array(Parse("[{\"a/b\": {\"~\": 1}}]")));
+	Column(0, "/a~1b/~0");
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 1));
+	EXPECT_EQ(1, columns[0].m_values.i64[0]);
+
+	result = jarray_from_columns(columns, 1);
+	EXPECT_TRUE(jvalue_equal(arr, result));
+}
+
+TEST_F(TestColumns, FromColumnsMismatch)
+{
+	int64_t ints[] = { 1, 2 };
+	Column(0, "/a");
+	Column(1, "/a/b");
+	columns[0].m_type = columns[1].m_type = JCOLUMN_I64;
+	columns[0].m_length = columns[1].m_length = 2;
+	columns[0].m_values.i64 = columns[1].m_values.i64 = ints;
+
+	result = jarray_from_columns(columns, 2);
+	EXPECT_FALSE(jis_valid(result));
+
+	columns[1].m_length = 1;
+	EXPECT_FALSE(jis_valid(jarray_from_columns(columns, 2)));
+
+	Column(1, "", JCOLUMN_I64);
+	columns[1].m_length = 2;
+	EXPECT_FALSE(jis_valid(jarray_from_columns(columns, 2)));
+
+	// Without the validity the rows have the values
+	result = jarray_from_columns(columns, 1);
+	EXPECT_EQ("[{\"a\":1},{\"a\":2}]", Serialize(result));
+
+	columns[0].m_values.i64 = columns[1].m_values.i64 = NULL;
+}
+
+TEST_F(TestColumns, Schema)
+{
+	jschema_ref schema = jschema_parse(j_cstr_to_buffer(
+		"{\"type\": \"array\", \"items\": {\"type\": \"object\", \"properties\": {"
+			"\"id\": {\"type\": \"integer\"},"
+			"\"score\": {\"type\": [\"number\", \"null\"]},"
+			"\"tag\": {\"type\": \"string\"},"
+			"\"user\": {\"type\": \"object\", \"properties\": {\"active\": {\"type\": \"boolean\"}}},"
+			"\"any\": {}"
+		"}}}"), JSCHEMA_DOM_NOOPT, NULL);
+	ASSERT_TRUE(schema != NULL);
+
+	jcolumn columns[6] = {};
+	columns[0].m_path = "/id";
+	columns[1].m_path = "/score";
+	columns[2].m_path = "/tag";
+	columns[3].m_path = "/user/active";
+	columns[4].m_path = "/any";
+	columns[5].m_path = "/tag";
+	columns[5].m_type = JCOLUMN_BOOL;
+	jcolumns_apply_schema(schema, columns, 6);
+
+	EXPECT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(JCOLUMN_F64, columns[1].m_type);
+	EXPECT_EQ(JCOLUMN_STRING, columns[2].m_type);
+	EXPECT_EQ(JCOLUMN_BOOL, columns[3].m_type);
+	EXPECT_EQ(JCOLUMN_AUTO, columns[4].m_type);
+	EXPECT_EQ(JCOLUMN_BOOL, columns[5].m_type);
+
+	// Every score is a number, even if the first one looks like an integer
+	ASSERT_TRUE(jis_array(Parse("[{\"id\": 1, \"score\": 1}, {\"id\": 2, \"score\": 1.5}]")));
+	ASSERT_TRUE(jarray_to_columns(arr, columns, 2));
+	EXPECT_EQ(JCOLUMN_F64, columns[1].m_type);
+	EXPECT_DOUBLE_EQ(1.5, columns[1].m_values.f64[1]);
+
+	jcolumn_clear(&columns[0]);
+	jcolumn_clear(&columns[1]);
+	jschema_release(&schema);
+}
+
+TEST_F(TestColumns, Parallel)
+{
+	const size_t rows = 10000;
+	arr = jarray_create(NULL);
+	for (size_t i = 0; i < rows; ++i) {
+		jvalue_ref record = jobject_create();
+		if (i % 7)
+			jobject_put(record, J_CSTR_TO_JVAL("id"), jnumber_create_i64(i));
+		jobject_put(record, J_CSTR_TO_JVAL("v"), i == rows - 3 ? jnumber_create_f64(0.5) : jnumber_create_i64(i));
+		jobject_put(record, J_CSTR_TO_JVAL("s"), jstring_create(i % 2 ? "odd" : "even"));
+		jarray_append(arr, record);
+	}
+
+	jcolumn sequential[3] = {};
+	sequential[0].m_path = columns[0].m_path = "/id";
+	sequential[1].m_path = columns[1].m_path = "/v";
+	sequential[2].m_path = columns[2].m_path = "/s";
+	ASSERT_TRUE(jarray_to_columns(arr, sequential, 3));
+	ASSERT_TRUE(jarray_to_columns_parallel(arr, columns, 3, 4));
+
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	ASSERT_EQ(JCOLUMN_F64, columns[1].m_type);
+	ASSERT_EQ(JCOLUMN_STRING, columns[2].m_type);
+	EXPECT_EQ(sequential[0].m_nullCount, columns[0].m_nullCount);
+	EXPECT_EQ(0, memcmp(sequential[0].m_validity, columns[0].m_validity, (rows + 7) / 8));
+	for (size_t i = 0; i < rows; ++i) {
+		if (i % 7)
+			ASSERT_EQ((int64_t) i, columns[0].m_values.i64[i]);
+		ASSERT_DOUBLE_EQ(sequential[1].m_values.f64[i], columns[1].m_values.f64[i]);
+		ASSERT_EQ(sequential[2].m_values.offsets[i + 1], columns[2].m_values.offsets[i + 1]);
+	}
+	EXPECT_EQ(0, memcmp(sequential[2].m_data, columns[2].m_data, sequential[2].m_values.offsets[rows]));
+
+	result = jarray_from_columns(columns, 3);
+	EXPECT_TRUE(jvalue_equal(arr, result));
+
+	for (size_t i = 0; i < 3; ++i)
+		jcolumn_clear(&sequential[i]);
+}
+
+TEST_F(TestColumns, ParallelLazy)
+{
+	string input = "[";
+	for (int i = 0; i < 1000; ++i)
+		input += (i ? ",{\"id\":" : "{\"id\":") + to_string(i) + "}";
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	arr = jdom_parse_lazy(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(arr));
+
+	Column(0, "/id");
+	ASSERT_TRUE(jarray_to_columns_parallel(arr, columns, 1, 4));
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	EXPECT_EQ(0u, columns[0].m_nullCount);
+	EXPECT_EQ(999, columns[0].m_values.i64[999]);
+}
+
+TEST_F(TestColumns, ParallelLazyArrays)
+{
+	string input = "[";
+	for (int i = 0; i < 1000; ++i)
+		input += (i ? ",{\"v\":[" : "{\"v\":[") + to_string(i) + ",\"s" + to_string(i) + "\"]}";
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	arr = jdom_parse_lazy(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(arr));
+
+	// The rows are materialized, the arrays within them aren't
+	for (ssize_t i = 0; i < jarray_size(arr); ++i)
+		ASSERT_EQ(1u, jobject_size(jarray_get(arr, i)));
+
+	Column(0, "/v/0");
+	Column(1, "/v/1");
+	ASSERT_TRUE(jarray_to_columns_parallel(arr, columns, 2, 4));
+	ASSERT_EQ(JCOLUMN_I64, columns[0].m_type);
+	ASSERT_EQ(JCOLUMN_STRING, columns[1].m_type);
+	EXPECT_EQ(0u, columns[0].m_nullCount);
+	EXPECT_EQ(999, columns[0].m_values.i64[999]);
+	EXPECT_EQ("s999", String(columns[1], 999));
+}
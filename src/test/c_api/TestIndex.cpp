@@ -0,0 +1,192 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <gtest/gtest.h>
+#include <pbnjson.h>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+class TestIndex : public ::testing::Test
+{
+protected:
+	jvalue_ref arr;
+	jarray_index_ref index;
+
+	virtual void SetUp()
+	{
+		arr = NULL;
+		index = NULL;
+	}
+
+	virtual void TearDown()
+	{
+		jarray_index_release(&index);
+		j_release(&arr);
+	}
+
+	jvalue_ref Parse(const char *input)
+	{
+		JSchemaInfo schemaInfo;
+		jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+		j_release(&arr);
+		arr = jdom_parse(j_cstr_to_buffer(input), DOMOPT_NOOPT, &schemaInfo);
+		return arr;
+	}
+
+	ssize_t Find(jvalue_ref key)
+	{
+		ssize_t position = jarray_index_find(index, key);
+		j_release(&key);
+		return position;
+	}
+
+	static jvalue_ref Record(int64_t id)
+	{
+		jvalue_ref record = jobject_create();
+		jobject_put(record, J_CSTR_TO_JVAL("id"), jnumber_create_i64(id));
+		return record;
+	}
+};
+
+} // namespace
+
+TEST_F(TestIndex, Keys)
+{
+	ASSERT_TRUE(jis_array(Parse(
+		"[{\"id\": 1, \"name\": \"a\"}, {\"id\": \"1\"}, {\"id\": 2.5}, {\"name\": \"b\"},"
+		" {\"id\": null}, {\"id\": true}, {\"id\": {}}, 5, {\"id\": 1.0, \"name\": \"dup\"}, {\"id\": 1e2}]")));
+
+	index = jarray_build_index(arr, "/id");
+	ASSERT_TRUE(index != NULL);
+	EXPECT_EQ(arr, jarray_index_array(index));
+
+	EXPECT_EQ(0, Find(jnumber_create_i64(1)));
+	EXPECT_EQ(0, Find(jnumber_create_f64(1.0)));
+	EXPECT_EQ(1, Find(jstring_create("1")));
+	EXPECT_EQ(2, Find(jnumber_create_f64(2.5)));
+	EXPECT_EQ(5, Find(jboolean_create(true)));
+	EXPECT_EQ(9, Find(jnumber_create_i64(100)));
+	EXPECT_EQ(-1, Find(jboolean_create(false)));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(2)));
+	EXPECT_EQ(-1, Find(jnull()));
+	EXPECT_EQ(-1, Find(jobject_create()));
+
+	jvalue_ref key = jnumber_create_i64(1);
+	EXPECT_TRUE(jvalue_equal(jarray_get(arr, 0), jarray_index_get(index, key)));
+	j_release(&key);
+	key = jnumber_create_i64(3);
+	EXPECT_FALSE(jis_valid(jarray_index_get(index, key)));
+	j_release(&key);
+}
+
+TEST_F(TestIndex, Paths)
+{
+	ASSERT_TRUE(jis_array(Parse("[{\"a/b\": [{\"~\": \"x\"}]}, {\"a/b\": [{\"~\": \"y\"}]}, \"z\"]")));
+
+	index = jarray_build_index(arr, "/a~1b/0/~0");
+	ASSERT_TRUE(index != NULL);
+	EXPECT_EQ(1, Find(jstring_create("y")));
+	jarray_index_release(&index);
+	EXPECT_EQ(NULL, index);
+
+	index = jarray_build_index(arr, "");
+	ASSERT_TRUE(index != NULL);
+	EXPECT_EQ(2, Find(jstring_create("z")));
+	jarray_index_release(&index);
+
+	EXPECT_EQ(NULL, jarray_build_index(arr, "a"));
+	EXPECT_EQ(NULL, jarray_build_index(arr, "/~"));
+	EXPECT_EQ(NULL, jarray_build_index(jarray_get(arr, 0), "/a"));
+}
+
+TEST_F(TestIndex, Modifications)
+{
+	arr = jarray_create(NULL);
+	for (int i = 0; i < 100; ++i)
+		jarray_append(arr, Record(i));
+
+	index = jarray_build_index(arr, "/id");
+	ASSERT_TRUE(index != NULL);
+	EXPECT_EQ(50, Find(jnumber_create_i64(50)));
+
+	// Appended
+	for (int i = 100; i < 1000; ++i)
+		jarray_append(arr, Record(i));
+	EXPECT_EQ(999, Find(jnumber_create_i64(999)));
+	EXPECT_EQ(50, Find(jnumber_create_i64(50)));
+
+	// Removed, the positions move
+	EXPECT_TRUE(jarray_remove(arr, 10));
+	EXPECT_EQ(49, Find(jnumber_create_i64(50)));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(10)));
+
+	// Inserted
+	EXPECT_TRUE(jarray_insert(arr, 0, Record(-1)));
+	EXPECT_EQ(0, Find(jnumber_create_i64(-1)));
+	EXPECT_EQ(50, Find(jnumber_create_i64(50)));
+
+	// Replaced
+	EXPECT_TRUE(jarray_put(arr, 0, Record(-2)));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(-1)));
+	EXPECT_EQ(0, Find(jnumber_create_i64(-2)));
+
+	// Removed and appended, the size is the same
+	EXPECT_TRUE(jarray_remove(arr, 0));
+	EXPECT_TRUE(jarray_append(arr, Record(-3)));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(-2)));
+	EXPECT_EQ(999, Find(jnumber_create_i64(-3)));
+
+	// The key modified in place is found by the new one only
+	jvalue_ref record = jarray_get(arr, 0);
+	EXPECT_TRUE(jobject_put(record, J_CSTR_TO_JVAL("id"), jnumber_create_i64(-4)));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(0)));
+	EXPECT_EQ(0, Find(jnumber_create_i64(-4)));
+	EXPECT_EQ(49, Find(jnumber_create_i64(50)));
+
+	// The key removed in place
+	EXPECT_TRUE(jobject_remove(jarray_get(arr, 1), j_cstr_to_buffer("id")));
+	EXPECT_EQ(-1, Find(jnumber_create_i64(1)));
+	EXPECT_TRUE(jobject_put(jarray_get(arr, 2), J_CSTR_TO_JVAL("id"), jnumber_create_i64(1)));
+	EXPECT_EQ(2, Find(jnumber_create_i64(1)));
+	EXPECT_TRUE(jarray_index_rebuild(index));
+	EXPECT_EQ(0, Find(jnumber_create_i64(-4)));
+}
+
+TEST_F(TestIndex, Frozen)
+{
+	ASSERT_TRUE(jis_array(Parse("[{\"id\": \"a\"}, {\"id\": \"b\"}]")));
+	jvalue_freeze(arr);
+
+	index = jarray_build_index(arr, "/id");
+	ASSERT_TRUE(index != NULL);
+	jvalue_ref record = Record(1);
+	EXPECT_FALSE(jarray_append(arr, record));
+	j_release(&record);
+	EXPECT_EQ(1, Find(jstring_create("b")));
+
+	// The index keeps the array
+	jvalue_ref released = arr;
+	arr = NULL;
+	j_release(&released);
+	jvalue_ref key = jstring_create("a");
+	EXPECT_TRUE(jis_object(jarray_index_get(index, key)));
+	j_release(&key);
+}
@@ -19,7 +19,10 @@
 #include <gtest/gtest.h>
 #include <pbnjson.h>
 #include <string>
+#include <cstring>
 #include <algorithm>
+#include <vector>
+#include <thread>
 
 #include <boost/scope_exit.hpp>
 
@@ -89,3 +92,769 @@ TEST(JobjRemove2, ObjectRemoveHashCollision)
 	ASSERT_FALSE(jobject_containskey(obj, j_cstr_to_buffer("ab")));
 	ASSERT_TRUE(jobject_containskey(obj, j_cstr_to_buffer("b")));
 }
+
+static jvalue_ref parse(const string &input)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	return jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+}
+
+TEST(JvalueCompact, ShrinkArray)
+{
+	jvalue_ref arr = jarray_create(NULL);
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+
+	for (int i = 0; i < 100; ++i)
+		ASSERT_TRUE(jarray_append(arr, jnumber_create_i32(i)));
+	for (int i = 0; i < 80; ++i)
+		ASSERT_TRUE(jarray_remove(arr, jarray_size(arr) - 1));
+
+	ASSERT_TRUE(jvalue_compact(&arr, JCOMPACT_SHRINK));
+	ASSERT_EQ(20, jarray_size(arr));
+	for (int i = 0; i < 20; ++i) {
+		int32_t n = -1;
+		EXPECT_EQ(CONV_OK, jnumber_get_i32(jarray_get(arr, i), &n));
+		EXPECT_EQ(i, n);
+	}
+
+	// Still grows afterwards
+	ASSERT_TRUE(jarray_append(arr, jnumber_create_i32(20)));
+	EXPECT_EQ(21, jarray_size(arr));
+}
+
+TEST(JvalueCompact, Relocate)
+{
+	string input = "{\"name\": \"config\", \"pi\": 3.14, \"on\": true, \"none\": null, \"list\": [";
+	for (int i = 0; i < 40; ++i)
+		input += (i ? ", " : "") + to_string(i);
+	input += "], \"nested\": {\"a\": [\"x\", {\"b\": \"\"}], \"c\": {}}}";
+
+	jvalue_ref doc = parse(input);
+	jvalue_ref expected = parse(input);
+	BOOST_SCOPE_EXIT((&doc)(&expected)) {
+		j_release(&doc);
+		j_release(&expected);
+	} BOOST_SCOPE_EXIT_END
+	ASSERT_TRUE(jis_object(doc));
+	ASSERT_TRUE(jvalue_tostring_simple(doc) != NULL);
+
+	jvalue_ref old = doc;
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	EXPECT_NE(old, doc);
+	EXPECT_TRUE(jvalue_equal(expected, doc));
+
+	// The relocated tree stays modifiable
+	jvalue_ref list = jobject_get(doc, j_cstr_to_buffer("list"));
+	for (int i = 40; i < 100; ++i)
+		ASSERT_TRUE(jarray_append(list, jnumber_create_i32(i)));
+	ASSERT_TRUE(jarray_remove(list, 0));
+	EXPECT_EQ(99, jarray_size(list));
+	ASSERT_TRUE(jobject_put(doc, jstring_create("name"), jstring_create("changed")));
+	ASSERT_TRUE(jobject_remove(doc, j_cstr_to_buffer("pi")));
+	EXPECT_TRUE(jstring_equal2(jobject_get(doc, j_cstr_to_buffer("name")), j_cstr_to_buffer("changed")));
+
+	// A value of the block outlives the root
+	jvalue_ref nested = jvalue_copy(jobject_get(doc, j_cstr_to_buffer("nested")));
+	j_release(&doc);
+	EXPECT_TRUE(jvalue_equal(jobject_get(expected, j_cstr_to_buffer("nested")), nested));
+	j_release(&nested);
+
+	// Compacting again moves it into a new block
+	doc = parse(input);
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	EXPECT_TRUE(jvalue_equal(expected, doc));
+}
+
+TEST(JvalueCompact, RelocateShared)
+{
+	jvalue_ref doc = parse("{\"a\": [1, 2], \"b\": {\"c\": \"d\"}}");
+	jvalue_ref shared = jvalue_copy(jobject_get(doc, j_cstr_to_buffer("a")));
+	BOOST_SCOPE_EXIT((&doc)(&shared)) {
+		j_release(&doc);
+		j_release(&shared);
+	} BOOST_SCOPE_EXIT_END
+
+	// Values referenced from elsewhere stay and are referred by the new tree
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	EXPECT_EQ(shared, jobject_get(doc, j_cstr_to_buffer("a")));
+	ASSERT_TRUE(jarray_append(shared, jnumber_create_i32(3)));
+	EXPECT_EQ(3, jarray_size(jobject_get(doc, j_cstr_to_buffer("a"))));
+
+	// The root referenced from elsewhere is left as is
+	jvalue_ref root = jvalue_copy(doc);
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	EXPECT_EQ(root, doc);
+	j_release(&root);
+}
+
+TEST(JvalueCompact, ShrinkShared)
+{
+	jvalue_ref doc = parse("{\"a\": [1, 2], \"b\": {\"c\": \"d\"}}");
+	jvalue_ref shared = jvalue_copy(jobject_get(doc, j_cstr_to_buffer("b")));
+	jvalue_ref frozen = parse("[1, 2, 3]");
+	BOOST_SCOPE_EXIT((&doc)(&shared)(&frozen)) {
+		j_release(&doc);
+		j_release(&shared);
+		j_release(&frozen);
+	} BOOST_SCOPE_EXIT_END
+
+	// The string representations of the shared and frozen values stay valid
+	const char *text = jvalue_tostring_simple(shared);
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_SHRINK));
+	EXPECT_STREQ("{\"c\":\"d\"}", text);
+
+	jvalue_freeze(frozen);
+	text = jvalue_tostring_simple(frozen);
+	ASSERT_TRUE(jvalue_compact(&frozen, JCOMPACT_SHRINK));
+	EXPECT_STREQ("[1,2,3]", text);
+}
+
+static string raw_text(jvalue_ref num)
+{
+	raw_buffer raw;
+	if (jnumber_get_raw(num, &raw) != CONV_OK)
+		return string();
+	return string(raw.m_str, raw.m_len);
+}
+
+TEST(JarrayPacked, Integers)
+{
+	jvalue_ref arr = parse("[1, -2, 0, 9223372036854775807, -9223372036854775808]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+
+	const int64_t *span = NULL;
+	size_t size = 0;
+	ASSERT_TRUE(jarray_get_i64_span(arr, &span, &size));
+	ASSERT_EQ(5u, size);
+	EXPECT_EQ(1, span[0]);
+	EXPECT_EQ(-2, span[1]);
+	EXPECT_EQ(0, span[2]);
+	EXPECT_EQ(INT64_MAX, span[3]);
+	EXPECT_EQ(INT64_MIN, span[4]);
+
+	// The elements are restored with the same text, and stay the same values
+	EXPECT_EQ("-2", raw_text(jarray_get(arr, 1)));
+	EXPECT_EQ("-9223372036854775808", raw_text(jarray_get(arr, 4)));
+	EXPECT_EQ(jarray_get(arr, 1), jarray_get(arr, 1));
+	EXPECT_STREQ("[1,-2,0,9223372036854775807,-9223372036854775808]", jvalue_tostring_simple(arr));
+
+	// Too big to be a double exactly
+	const double *doubles = NULL;
+	EXPECT_FALSE(jarray_get_f64_span(arr, &doubles, &size));
+}
+
+TEST(JarrayPacked, Fractions)
+{
+	jvalue_ref arr = parse("[1, 2.5, -0.125, 0.0001, -0, 123456789.012345]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+
+	const double *span = NULL;
+	size_t size = 0;
+	ASSERT_TRUE(jarray_get_f64_span(arr, &span, &size));
+	ASSERT_EQ(6u, size);
+	EXPECT_EQ(1.0, span[0]);
+	EXPECT_EQ(2.5, span[1]);
+	EXPECT_EQ(-0.125, span[2]);
+	EXPECT_DOUBLE_EQ(0.0001, span[3]);
+	EXPECT_EQ(0.0, span[4]);
+	EXPECT_DOUBLE_EQ(123456789.012345, span[5]);
+
+	const int64_t *integers = NULL;
+	EXPECT_FALSE(jarray_get_i64_span(arr, &integers, &size));
+	EXPECT_STREQ("[1,2.5,-0.125,0.0001,-0,123456789.012345]", jvalue_tostring_simple(arr));
+
+	// Integers stay integers, also the ones a double can't hold
+	jvalue_ref ints = parse("[3, 9007199254740993]");
+	EXPECT_FALSE(jarray_get_f64_span(ints, &span, &size));
+	ASSERT_TRUE(jarray_get_i64_span(ints, &integers, &size));
+	ASSERT_EQ(2u, size);
+	EXPECT_EQ(INT64_C(9007199254740993), integers[1]);
+	EXPECT_EQ("9007199254740993", raw_text(jarray_get(ints, 1)));
+	j_release(&ints);
+}
+
+TEST(JarrayPacked, NotPacked)
+{
+	// Texts which wouldn't be restored exactly, and mixed arrays stay boxed
+	const char *inputs[] = {
+		"[1.0, 2]",
+		"[1e3]",
+		"[0.1234567890123456]",
+		"[1, \"a\"]",
+		"[12345678901234567, 0.5]",
+		"[18446744073709551616]",
+	};
+	for (const char *input : inputs) {
+		jvalue_ref arr = parse(input);
+		const double *span = NULL;
+		size_t size = 0;
+		EXPECT_FALSE(jarray_get_f64_span(arr, &span, &size)) << input;
+		j_release(&arr);
+	}
+
+	jvalue_ref arr = parse("[12345678901234567, 0.5, 1.0]");
+	EXPECT_EQ("12345678901234567", raw_text(jarray_get(arr, 0)));
+	EXPECT_EQ("0.5", raw_text(jarray_get(arr, 1)));
+	EXPECT_EQ("1.0", raw_text(jarray_get(arr, 2)));
+	j_release(&arr);
+
+	// Nor are the arrays built with the API
+	arr = jarray_create_var(NULL, jnumber_create_i32(1), jnumber_create_i32(2), J_END_ARRAY_DECL);
+	const int64_t *span = NULL;
+	size_t size = 0;
+	EXPECT_FALSE(jarray_get_i64_span(arr, &span, &size));
+	j_release(&arr);
+}
+
+TEST(JarrayPacked, Modify)
+{
+	jvalue_ref arr = parse("[1, 2, 3]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+
+	jvalue_ref first = jarray_get(arr, 0);
+	ASSERT_TRUE(jarray_append(arr, jstring_create("four")));
+
+	// The elements handed out are kept
+	const int64_t *span = NULL;
+	size_t size = 0;
+	EXPECT_FALSE(jarray_get_i64_span(arr, &span, &size));
+	ASSERT_EQ(4, jarray_size(arr));
+	EXPECT_EQ(first, jarray_get(arr, 0));
+	EXPECT_EQ("3", raw_text(jarray_get(arr, 2)));
+	EXPECT_STREQ("[1,2,3,\"four\"]", jvalue_tostring_simple(arr));
+
+	ASSERT_TRUE(jarray_remove(arr, 0));
+	EXPECT_EQ("2", raw_text(jarray_get(arr, 0)));
+}
+
+TEST(JarrayPacked, Compare)
+{
+	jvalue_ref a = parse("[1, 2, 3]");
+	jvalue_ref b = parse("[1, 2, 3]");
+	jvalue_ref c = parse("[1, 2, 2.5]");
+	BOOST_SCOPE_EXIT((&a)(&b)(&c)) {
+		j_release(&a);
+		j_release(&b);
+		j_release(&c);
+	} BOOST_SCOPE_EXIT_END
+
+	EXPECT_TRUE(jvalue_equal(a, b));
+	EXPECT_FALSE(jvalue_equal(a, c));
+
+	jvalue_ref copy = jvalue_duplicate(a);
+	const int64_t *span = NULL;
+	size_t size = 0;
+	EXPECT_TRUE(jarray_get_i64_span(copy, &span, &size));
+	EXPECT_TRUE(jvalue_equal(a, copy));
+	ASSERT_TRUE(jarray_append(copy, jnumber_create_i32(4)));
+	EXPECT_FALSE(jvalue_equal(a, copy));
+	j_release(&copy);
+
+	// Boxed and packed arrays compare by value
+	jvalue_ref boxed = jarray_create_var(NULL, jnumber_create_i32(1), jnumber_create_i32(2), jnumber_create_i32(3),
+	                                     J_END_ARRAY_DECL);
+	EXPECT_TRUE(jvalue_equal(a, boxed));
+	j_release(&boxed);
+}
+
+static vector<string> keys(jvalue_ref obj)
+{
+	vector<string> result;
+	jobject_iter it;
+	jobject_key_value pair;
+	jobject_iter_init(&it, obj);
+	while (jobject_iter_next(&it, &pair)) {
+		raw_buffer key = jstring_get_fast(pair.key);
+		result.push_back(string(key.m_str, key.m_len));
+	}
+	return result;
+}
+
+TEST(JobjectShape, Records)
+{
+	jvalue_ref arr = parse("[{\"id\": 1, \"name\": \"a\", \"on\": true},"
+	                       " {\"id\": 2, \"name\": \"b\", \"on\": false},"
+	                       " {\"id\": 3, \"name\": \"c\", \"on\": true}]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+	ASSERT_EQ(3, jarray_size(arr));
+
+	// The records keep the order of their keys
+	vector<string> expected = { "id", "name", "on" };
+	for (int i = 0; i < 3; ++i) {
+		jvalue_ref record = jarray_get(arr, i);
+		EXPECT_EQ(expected, keys(record));
+		EXPECT_EQ(3u, jobject_size(record));
+
+		int32_t id = 0;
+		EXPECT_EQ(CONV_OK, jnumber_get_i32(jobject_get(record, j_cstr_to_buffer("id")), &id));
+		EXPECT_EQ(i + 1, id);
+		EXPECT_EQ(string(1, 'a' + i), jstring_get_fast(jobject_get(record, j_cstr_to_buffer("name"))).m_str);
+		EXPECT_FALSE(jobject_get_exists(record, j_cstr_to_buffer("nam"), NULL));
+	}
+	EXPECT_STREQ("[{\"id\":1,\"name\":\"a\",\"on\":true},{\"id\":2,\"name\":\"b\",\"on\":false},"
+	             "{\"id\":3,\"name\":\"c\",\"on\":true}]", jvalue_tostring_simple(arr));
+
+	jvalue_ref copy = jvalue_duplicate(jarray_get(arr, 1));
+	EXPECT_TRUE(jvalue_equal(jarray_get(arr, 1), copy));
+	ASSERT_TRUE(jobject_put(copy, J_CSTR_TO_JVAL("id"), jnumber_create_i32(5)));
+	EXPECT_FALSE(jvalue_equal(jarray_get(arr, 1), copy));
+	EXPECT_EQ(expected, keys(copy));
+	j_release(&copy);
+
+	// Relocated records share the shapes with the others
+	copy = parse("{\"id\": 1, \"name\": \"a\", \"on\": true}");
+	ASSERT_TRUE(jvalue_compact(&arr, JCOMPACT_RELOCATE));
+	EXPECT_TRUE(jvalue_equal(copy, jarray_get(arr, 0)));
+	ASSERT_TRUE(jobject_put(jarray_get(arr, 0), J_CSTR_TO_JVAL("extra"), jnull()));
+	EXPECT_EQ(4u, jobject_size(jarray_get(arr, 0)));
+	EXPECT_EQ(expected, keys(jarray_get(arr, 2)));
+	j_release(&copy);
+}
+
+TEST(JobjectShape, Diverge)
+{
+	jvalue_ref arr = parse("[{\"a\": 1, \"b\": 2}, {\"b\": 3, \"a\": 4}, {\"a\": 5}, {\"a\": 6, \"b\": 7, \"c\": 8}]");
+	jvalue_ref expected = parse("[{\"a\": 1, \"b\": 2, \"d\": \"new\"}, {\"a\": 4, \"b\": 3}, {\"a\": 5}, {\"a\": 6, \"c\": 8}]");
+	BOOST_SCOPE_EXIT((&arr)(&expected)) {
+		j_release(&arr);
+		j_release(&expected);
+	} BOOST_SCOPE_EXIT_END
+
+	EXPECT_EQ(vector<string>({ "b", "a" }), keys(jarray_get(arr, 1)));
+
+	// New keys and removals don't affect the other records
+	ASSERT_TRUE(jobject_put(jarray_get(arr, 0), J_CSTR_TO_JVAL("d"), jstring_create("new")));
+	ASSERT_TRUE(jobject_remove(jarray_get(arr, 3), j_cstr_to_buffer("b")));
+	EXPECT_FALSE(jobject_remove(jarray_get(arr, 2), j_cstr_to_buffer("b")));
+	EXPECT_TRUE(jvalue_equal(expected, arr));
+	EXPECT_EQ(vector<string>({ "a", "b", "d" }), keys(jarray_get(arr, 0)));
+	EXPECT_EQ(vector<string>({ "a" }), keys(jarray_get(arr, 2)));
+
+	// Records with too many keys, or too different ones, aren't shaped
+	string input = "[";
+	for (int i = 0; i < 20; ++i) {
+		input += i ? ", {" : "{";
+		for (int j = 0; j < 100; ++j)
+			input += (j ? ", \"" : "\"") + to_string((i + j) % 100) + "\": " + to_string(j);
+		input += "}";
+	}
+	input += "]";
+	jvalue_ref wide = parse(input);
+	ASSERT_EQ(20, jarray_size(wide));
+	for (int i = 0; i < 20; ++i) {
+		jvalue_ref record = jarray_get(wide, i);
+		ASSERT_EQ(100u, jobject_size(record));
+		int32_t n = -1;
+		EXPECT_EQ(CONV_OK, jnumber_get_i32(jobject_get(record, j_cstr_to_buffer(to_string((i + 99) % 100).c_str())), &n));
+		EXPECT_EQ(99, n);
+	}
+	j_release(&wide);
+}
+
+TEST(JvalueFreeze, Modify)
+{
+	jvalue_ref obj = parse("{\"a\": {\"b\": [1, \"x\", {\"c\": true}]}, \"d\": [1, 2, 3]}");
+	jvalue_ref expected = parse("{\"a\": {\"b\": [1, \"x\", {\"c\": true}]}, \"d\": [1, 2, 3]}");
+	BOOST_SCOPE_EXIT((&obj)(&expected)) {
+		j_release(&obj);
+		j_release(&expected);
+	} BOOST_SCOPE_EXIT_END
+
+	jvalue_freeze(obj);
+	jvalue_ref a = jobject_get(obj, j_cstr_to_buffer("a"));
+	jvalue_ref b = jobject_get(a, j_cstr_to_buffer("b"));
+	jvalue_ref d = jobject_get(obj, j_cstr_to_buffer("d"));
+	EXPECT_TRUE(jis_frozen(obj));
+	EXPECT_TRUE(jis_frozen(b));
+	EXPECT_TRUE(jis_frozen(jarray_get(b, 2)));
+
+	// None of the containers of the tree can be modified
+	EXPECT_FALSE(jobject_put(obj, J_CSTR_TO_JVAL("e"), jnull()));
+	EXPECT_FALSE(jobject_set(a, j_cstr_to_buffer("b"), jnull()));
+	EXPECT_FALSE(jobject_remove(obj, j_cstr_to_buffer("d")));
+	EXPECT_FALSE(jobject_put(jarray_get(b, 2), J_CSTR_TO_JVAL("c"), jboolean_create(false)));
+	EXPECT_FALSE(jarray_set(b, 0, jnull()));
+	EXPECT_FALSE(jarray_remove(b, 0));
+	EXPECT_FALSE(jarray_remove(d, 0));
+	EXPECT_FALSE(jarray_insert(b, 0, jnull()));
+
+	jvalue_ref other = parse("[4, 5]");
+	EXPECT_FALSE(jarray_splice_append(d, other, SPLICE_COPY));
+	// The elements transferred would be removed from the frozen array
+	EXPECT_FALSE(jarray_splice_append(other, b, SPLICE_TRANSFER));
+	EXPECT_TRUE(jarray_splice_append(other, b, SPLICE_COPY));
+	EXPECT_EQ(5, jarray_size(other));
+	j_release(&other);
+
+	EXPECT_TRUE(jvalue_equal(expected, obj));
+
+	// A copy can be modified
+	jvalue_ref copy = jvalue_duplicate(obj);
+	EXPECT_FALSE(jis_frozen(copy));
+	EXPECT_TRUE(jobject_put(copy, J_CSTR_TO_JVAL("e"), jnull()));
+	EXPECT_TRUE(jarray_append(jobject_get(jobject_get(copy, j_cstr_to_buffer("a")), j_cstr_to_buffer("b")), jnull()));
+	EXPECT_TRUE(jvalue_equal(expected, obj));
+	j_release(&copy);
+}
+
+TEST(JvalueDuplicate, CopyOnWrite)
+{
+	const string input = "{\"name\": \"template\", \"a\": {\"b\": {\"c\": 1, \"d\": [1, 2, 3]}, \"e\": [\"x\", {\"f\": null}]},"
+	                     " \"g\": [0.5, 1.5], \"h\": {\"i\": true}}";
+	jvalue_ref original = parse(input);
+	jvalue_ref expected = parse(input);
+	BOOST_SCOPE_EXIT((&original)(&expected)) {
+		j_release(&original);
+		j_release(&expected);
+	} BOOST_SCOPE_EXIT_END
+
+	// The elements keep their order in a deep copy too
+	jvalue_ref deep = jvalue_duplicate(original);
+	EXPECT_TRUE(jvalue_equal(expected, deep));
+	// The strings, numbers and booleans are shared
+	EXPECT_EQ(jobject_get(original, j_cstr_to_buffer("name")), jobject_get(deep, j_cstr_to_buffer("name")));
+	j_release(&deep);
+
+	jvalue_freeze(original);
+	jvalue_ref copy = jvalue_duplicate(original);
+	jvalue_ref other = jvalue_duplicate(original);
+	EXPECT_FALSE(jis_frozen(copy));
+	EXPECT_TRUE(jvalue_equal(original, copy));
+	EXPECT_TRUE(jvalue_equal(copy, other));
+
+	// Only the containers on the path are copied, the rest stays shared
+	jvalue_ref b = jobject_get(jobject_get(copy, j_cstr_to_buffer("a")), j_cstr_to_buffer("b"));
+	ASSERT_TRUE(jobject_put(b, J_CSTR_TO_JVAL("c"), jnumber_create_i32(2)));
+	ASSERT_TRUE(jarray_append(jobject_get(b, j_cstr_to_buffer("d")), jnumber_create_i32(4)));
+	ASSERT_TRUE(jarray_put(jobject_get(copy, j_cstr_to_buffer("g")), 0, jnumber_create_f64(2.5)));
+	EXPECT_FALSE(jis_frozen(b));
+	EXPECT_TRUE(jis_frozen(jobject_get(jobject_get(original, j_cstr_to_buffer("a")), j_cstr_to_buffer("b"))));
+
+	jvalue_ref modified = parse("{\"name\": \"template\", \"a\": {\"b\": {\"c\": 2, \"d\": [1, 2, 3, 4]}, \"e\": [\"x\", {\"f\": null}]},"
+	                            " \"g\": [2.5, 1.5], \"h\": {\"i\": true}}");
+	EXPECT_TRUE(jvalue_equal(modified, copy));
+	EXPECT_TRUE(jvalue_equal(expected, original));
+	EXPECT_TRUE(jvalue_equal(expected, other));
+	j_release(&modified);
+
+	// A copy of a copy doesn't see the modifications of either
+	jvalue_ref second = jvalue_duplicate(other);
+	ASSERT_TRUE(jobject_remove(other, j_cstr_to_buffer("h")));
+	EXPECT_TRUE(jvalue_equal(expected, second));
+	EXPECT_FALSE(jvalue_equal(expected, other));
+
+	j_release(&second);
+	j_release(&other);
+	j_release(&copy);
+}
+
+TEST(JvalueDeep, Walks)
+{
+	// Objects and arrays nested one into another, far deeper than the recursion would go
+	const size_t depth = 50000;
+	jvalue_ref root = jarray_create(NULL);
+	jvalue_ref deepest = root;
+	for (size_t i = 0; i < depth; ++i)
+	{
+		jvalue_ref child = (i % 2) ? jarray_create(NULL) : jobject_create();
+		jvalue_ref leaf = jnumber_create_i64(i);
+		if (jis_array(deepest))
+		{
+			ASSERT_TRUE(jarray_append(deepest, leaf));
+			ASSERT_TRUE(jarray_append(deepest, child));
+		}
+		else
+		{
+			ASSERT_TRUE(jobject_put(deepest, J_CSTR_TO_JVAL("leaf"), leaf));
+			ASSERT_TRUE(jobject_put(deepest, J_CSTR_TO_JVAL("child"), child));
+		}
+		deepest = child;
+	}
+
+	// Nothing inside can take its ancestor
+	jvalue_ref ancestor = jvalue_copy(root);
+	EXPECT_FALSE(jarray_append(deepest, ancestor));
+	j_release(&ancestor);
+
+	jvalue_ref copy = jvalue_duplicate(root);
+	ASSERT_TRUE(jis_array(copy));
+	EXPECT_TRUE(jvalue_equal(root, copy));
+	EXPECT_TRUE(jarray_append(deepest, jnull()));
+	EXPECT_FALSE(jvalue_equal(root, copy));
+
+	jvalue_freeze(copy);
+	EXPECT_TRUE(jis_frozen(copy));
+	jvalue_ref view = jvalue_duplicate(copy);
+	EXPECT_TRUE(jvalue_equal(copy, view));
+
+	j_release(&view);
+	j_release(&copy);
+	j_release(&root);
+}
+
+TEST(JvalueDeferred, Release)
+{
+	// Records with shapes, a member kept by the caller and a copy of a frozen template
+	string input = "[";
+	for (int i = 0; i < 1000; ++i)
+		input += string(i ? ", " : "") + "{\"id\": " + to_string(i) + ", \"name\": \"n\", \"pos\": {\"x\": 1, \"y\": 2}}";
+	input += "]";
+	jvalue_ref doc = parse(input);
+	jvalue_ref kept = jvalue_copy(jarray_get(doc, 10));
+
+	const string templateInput = "{\"a\": {\"b\": [1, 2]}, \"c\": \"d\"}";
+	jvalue_ref templ = parse(templateInput);
+	jvalue_freeze(templ);
+	jvalue_ref copy = jvalue_duplicate(templ);
+	ASSERT_TRUE(jarray_append(jobject_get(jobject_get(copy, j_cstr_to_buffer("a")), j_cstr_to_buffer("b")),
+	                          jnumber_create_i32(3)));
+	ASSERT_TRUE(jarray_append(doc, copy));
+
+	j_release_deferred(&doc);
+	jvalue_ref other = parse(input);
+	j_release_wait();
+	EXPECT_TRUE(jvalue_equal(kept, jarray_get(other, 10)));
+
+	// The kept record still shares the shapes of the released ones
+	ASSERT_TRUE(jobject_put(kept, J_CSTR_TO_JVAL("extra"), jnull()));
+	EXPECT_EQ(4u, jobject_size(kept));
+	jvalue_ref expected = parse(templateInput);
+	EXPECT_TRUE(jvalue_equal(expected, templ));
+	j_release(&expected);
+	j_release(&templ);
+	j_release(&kept);
+
+	// The big containers released the usual way are handed over too
+	j_release_set_deferred(100);
+	j_release(&other);
+	j_release_set_deferred(0);
+	j_release_wait();
+}
+
+static bool release_previous_deferred(void *ctxt, jvalue_ref value)
+{
+	jvalue_ref *previous = (jvalue_ref *) ctxt;
+	j_release_deferred(previous);
+	*previous = jvalue_copy(value);
+	return true;
+}
+
+TEST(JvalueDeferred, ArenaStrings)
+{
+	// The escaped strings of the released documents share the chunks with the ones being parsed
+	string input;
+	for (int i = 0; i < 200; ++i) {
+		input += "[";
+		for (int j = 0; j < 20; ++j)
+			input += string(j ? ", " : "") + "\"line\\n" + to_string(i * 20 + j) + "\"";
+		input += "]";
+	}
+
+	jvalue_ref previous = NULL;
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE);
+	ASSERT_TRUE(parser != NULL);
+	ASSERT_TRUE(jdomparser_set_multiple_values(parser, release_previous_deferred, &previous));
+	ASSERT_TRUE(jdomparser_feed(parser, input.c_str(), input.size()));
+	ASSERT_TRUE(jdomparser_end(parser));
+	jdomparser_release(&parser);
+
+	raw_buffer last = jstring_get_fast(jarray_get(previous, 19));
+	EXPECT_EQ("line\n3999", string(last.m_str, last.m_len));
+	j_release_deferred(&previous);
+	j_release_wait();
+}
+
+TEST(JvalueShared, Scalars)
+{
+	// The booleans and the small integers are the same instances whenever created
+	EXPECT_EQ(jboolean_create(true), jboolean_create(true));
+	EXPECT_NE(jboolean_create(true), jboolean_create(false));
+	EXPECT_EQ(jnumber_create_i32(5), jnumber_create_i64(5));
+	EXPECT_EQ(jnumber_create(j_cstr_to_buffer("-12")), jnumber_create(j_cstr_to_buffer("-12")));
+	jvalue_ref num = jnumber_create_i32(7);
+	EXPECT_EQ(num, jvalue_copy(num));
+	j_release(&num);
+
+	// The parsed numbers keep their text, only the canonical ones are shared
+	jvalue_ref arr = parse("[1, 1, 1.0, -0, 1e2, 1024, -128, true, true]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+	EXPECT_EQ(jarray_get(arr, 0), jarray_get(arr, 1));
+	EXPECT_EQ(jarray_get(arr, 7), jarray_get(arr, 8));
+	EXPECT_EQ(jarray_get(arr, 6), jnumber_create(j_cstr_to_buffer("-128")));
+	EXPECT_EQ("1", raw_text(jarray_get(arr, 0)));
+	EXPECT_EQ("1.0", raw_text(jarray_get(arr, 2)));
+	EXPECT_EQ("-0", raw_text(jarray_get(arr, 3)));
+	EXPECT_EQ("1024", raw_text(jarray_get(arr, 5)));
+	EXPECT_STREQ("[1,1,1.0,-0,1e2,1024,-128,true,true]", jvalue_tostring_simple(arr));
+	EXPECT_STREQ("5", jvalue_tostring_simple(jnumber_create_i32(5)));
+	EXPECT_STREQ("false", jvalue_tostring_simple(jboolean_create(false)));
+
+	// The shared values don't change along with the containers they are in
+	jvalue_freeze(arr);
+	EXPECT_FALSE(jis_frozen(jarray_get(arr, 0)));
+	jvalue_ref copy = jvalue_duplicate(arr);
+	ASSERT_TRUE(jarray_set(copy, 0, jnumber_create_i32(2)));
+	int64_t n = -1;
+	EXPECT_EQ(CONV_OK, jnumber_get_i64(jarray_get(arr, 0), &n));
+	EXPECT_EQ(1, n);
+	EXPECT_EQ(jnumber_create_i32(2), jarray_get(copy, 0));
+	j_release(&copy);
+
+	// The buffer handed over to the number isn't needed
+	char *text = strdup("42");
+	num = jnumber_create_unsafe(j_cstr_to_buffer(text), free);
+	EXPECT_EQ(jnumber_create(j_cstr_to_buffer("42")), num);
+	EXPECT_EQ("42", raw_text(num));
+	j_release(&num);
+
+	// Each of the statically initialized numbers has its value and its canonical text
+	for (int i = -128; i <= 1023; ++i) {
+		string expected = to_string(i);
+		jvalue_ref native = jnumber_create_i64(i);
+		jvalue_ref raw = jnumber_create(j_cstr_to_buffer(expected.c_str()));
+		n = 0;
+		EXPECT_EQ(CONV_OK, jnumber_get_i64(raw, &n));
+		EXPECT_EQ(i, n);
+		EXPECT_EQ(expected, raw_text(raw));
+		EXPECT_EQ(expected, jvalue_tostring_simple(native));
+		EXPECT_EQ(0, jnumber_compare(native, raw));
+	}
+}
+
+static jvalue_ref key_of(jvalue_ref obj, jvalue_ref value)
+{
+	jobject_iter it;
+	jobject_key_value pair;
+	jobject_iter_init(&it, obj);
+	while (jobject_iter_next(&it, &pair)) {
+		if (pair.value == value)
+			return pair.key;
+	}
+	return NULL;
+}
+
+TEST(JobjectKey, Lookup)
+{
+	jvalue_ref arr = parse("[{\"id\": 1, \"name\": \"a\"}, {\"id\": 2, \"name\": \"b\"}, {\"name\": \"c\"}, 5]");
+	jvalue_ref obj = jobject_create();
+	jkey_ref id = jkey_create(j_cstr_to_buffer("id"));
+	jkey_ref empty = jkey_create(j_cstr_to_buffer(""));
+	BOOST_SCOPE_EXIT((&arr)(&obj)(&id)(&empty)) {
+		j_release(&arr);
+		j_release(&obj);
+		jkey_release(&id);
+		jkey_release(&empty);
+	} BOOST_SCOPE_EXIT_END
+	ASSERT_TRUE(id != NULL);
+	ASSERT_TRUE(empty != NULL);
+	EXPECT_EQ("id", string(jstring_get_fast(jkey_string(id)).m_str));
+
+	// Shaped records
+	for (int i = 0; i < 2; ++i) {
+		int64_t n = -1;
+		EXPECT_EQ(CONV_OK, jnumber_get_i64(jobject_get_key(jarray_get(arr, i), id), &n));
+		EXPECT_EQ(i + 1, n);
+	}
+	EXPECT_FALSE(jis_valid(jobject_get_key(jarray_get(arr, 2), id)));
+	EXPECT_FALSE(jis_valid(jobject_get_key(jarray_get(arr, 3), id)));
+	EXPECT_FALSE(jis_valid(jobject_get_key(jarray_get(arr, 0), empty)));
+
+	// The object refers the string of the key, and finds it by name as well
+	ASSERT_TRUE(jobject_set_key(obj, id, jnumber_create_i32(7)));
+	ASSERT_TRUE(jobject_put(obj, J_CSTR_TO_JVAL("other"), jnull()));
+	EXPECT_EQ(jobject_get(obj, j_cstr_to_buffer("id")), jobject_get_key(obj, id));
+	EXPECT_EQ(jkey_string(id), key_of(obj, jobject_get_key(obj, id)));
+	EXPECT_FALSE(jobject_set_key(obj, empty, jnull()));
+	EXPECT_FALSE(jobject_set_key(jarray_get(arr, 3), id, jnull()));
+
+	// A record gets the key of its own
+	ASSERT_TRUE(jobject_set_key(jarray_get(arr, 2), id, jnumber_create_i32(3)));
+	EXPECT_EQ(jnumber_create_i32(3), jobject_get_key(jarray_get(arr, 2), id));
+
+	// The members outlive the key
+	jkey_ref copy = jkey_copy(id);
+	EXPECT_EQ(id, copy);
+	jkey_release(&copy);
+	EXPECT_EQ(NULL, copy);
+	jkey_release(&id);
+	EXPECT_STREQ("{\"id\":7,\"other\":null}", jvalue_tostring_simple(obj));
+	EXPECT_STREQ("[{\"id\":1,\"name\":\"a\"},{\"id\":2,\"name\":\"b\"},{\"name\":\"c\",\"id\":3},5]",
+	             jvalue_tostring_simple(arr));
+}
+
+TEST(JobjectKey, Interned)
+{
+	jvalue_ref arr = parse("[{\"id\": 1}, {\"id\": 2}]");
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+
+	// The same key whenever interned, it isn't released
+	jkey_ref extra = jkey_intern(j_cstr_to_buffer("extra"));
+	ASSERT_TRUE(extra != NULL);
+	EXPECT_EQ(extra, jkey_intern(j_cstr_to_buffer("extra")));
+	EXPECT_NE(extra, jkey_intern(j_cstr_to_buffer("extr")));
+	jkey_ref own = jkey_create(j_cstr_to_buffer("extra"));
+	EXPECT_NE(extra, own);
+	jkey_release(&own);
+	jkey_ref released = extra;
+	jkey_release(&released);
+	const char *text = jvalue_tostring_simple(jkey_string(extra));
+	EXPECT_STREQ("\"extra\"", text);
+	EXPECT_EQ(text, jvalue_tostring_simple(jkey_string(extra)));
+
+	// The records share the shape with the string of the key
+	for (int i = 0; i < 2; ++i)
+		ASSERT_TRUE(jobject_set_key(jarray_get(arr, i), extra, jnumber_create_i32(i)));
+	for (int i = 0; i < 2; ++i) {
+		jvalue_ref record = jarray_get(arr, i);
+		EXPECT_EQ(jnumber_create_i32(i), jobject_get_key(record, extra));
+		EXPECT_EQ(jnumber_create_i32(i), jobject_get(record, j_cstr_to_buffer("extra")));
+		EXPECT_EQ(jkey_string(extra), key_of(record, jobject_get_key(record, extra)));
+	}
+
+	// Frozen and duplicated along with the records
+	jvalue_freeze(arr);
+	EXPECT_FALSE(jis_frozen(jkey_string(extra)));
+	jvalue_ref copy = jvalue_duplicate(arr);
+	ASSERT_TRUE(jobject_set_key(jarray_get(copy, 0), extra, jnull()));
+	EXPECT_STREQ("[{\"id\":1,\"extra\":null},{\"id\":2,\"extra\":1}]", jvalue_tostring_simple(copy));
+	EXPECT_STREQ("[{\"id\":1,\"extra\":0},{\"id\":2,\"extra\":1}]", jvalue_tostring_simple(arr));
+	j_release(&copy);
+}
+
+TEST(JobjectKey, InternedThreads)
+{
+	// The text of a shared key isn't regenerated under the other threads
+	jkey_ref key = jkey_intern(j_cstr_to_buffer("shared"));
+	ASSERT_TRUE(key != NULL);
+	std::vector<std::thread> threads;
+	std::vector<int> mismatches(4, 0);
+	for (size_t i = 0; i < mismatches.size(); ++i) {
+		threads.emplace_back([key, &mismatches, i]() {
+			for (int n = 0; n < 10000; ++n) {
+				if (strcmp("\"shared\"", jvalue_tostring_simple(jkey_string(key))))
+					++mismatches[i];
+			}
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+	EXPECT_EQ(std::vector<int>(4, 0), mismatches);
+}
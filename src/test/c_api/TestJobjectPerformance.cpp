@@ -20,7 +20,12 @@
 #include <pbnjson.h>
 #include <string>
 #include <vector>
+#include <set>
 #include <algorithm>
+#include <functional>
+#include <chrono>
+#include <iostream>
+#include <malloc.h>
 
 #include <boost/scope_exit.hpp>
 #include <boost/lexical_cast.hpp>
@@ -182,3 +187,527 @@ TEST_F(JobjPerformanceRemove, RemoveStringsFromObject)
 	for (auto const &key : keys)
 		jobject_remove(obj, j_cstr_to_buffer(key.c_str()));
 }
+
+// Bytes taken from the heap, including the overhead of the allocator
+static size_t HeapInUse()
+{
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+	return info.uordblks + info.hblkhd;
+}
+
+TEST(JobjMemory, Compact)
+{
+	// Typical long-lived configuration or cache: many small records
+	string input = "{\"entries\": [";
+	for (size_t i = 0; i < 20000; ++i)
+	{
+		string n = boost::lexical_cast<string>(i);
+		input += (i ? ", " : "");
+		input += "{\"id\": " + n + ", \"name\": \"entry " + n + "\", \"enabled\": true, "
+		         "\"weight\": 0.5, \"tags\": [\"a\", \"b\", \"c\"]}";
+	}
+	input += "], \"version\": \"1.0\"}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref doc = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_object(doc));
+	BOOST_SCOPE_EXIT((&doc)) {
+		j_release(&doc);
+	} BOOST_SCOPE_EXIT_END
+
+	// Half of the entries are evicted, the array keeps its capacity
+	jvalue_ref entries = jobject_get(doc, j_cstr_to_buffer("entries"));
+	while (jarray_size(entries) > 10000)
+		jarray_remove(entries, jarray_size(entries) - 1);
+	size_t parsed = HeapInUse() - base;
+
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_SHRINK));
+	size_t shrunk = HeapInUse() - base;
+
+	ASSERT_TRUE(jvalue_compact(&doc, JCOMPACT_RELOCATE));
+	size_t relocated = HeapInUse() - base;
+
+	cout << "Heap used by the DOM, bytes:" << endl;
+	cout << "parsed:\t\t" << parsed << endl;
+	cout << "shrunk:\t\t" << shrunk << " (saved " << parsed - shrunk << ")" << endl;
+	cout << "relocated:\t" << relocated << " (saved " << parsed - relocated << ")" << endl;
+
+	EXPECT_LT(shrunk, parsed);
+	EXPECT_LT(relocated, shrunk);
+}
+
+TEST(JobjMemory, ValueHeader)
+{
+	// Booleans and short strings, the values are little more than their headers
+	const size_t count = 100000;
+	string input = "[";
+	for (size_t i = 0; i < count; ++i)
+		input += string(i ? ", " : "") + (i % 2 ? "true" : "false") + ", \"v" + boost::lexical_cast<string>(i % 10) + "\"";
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref doc = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(doc));
+	size_t perValue = (HeapInUse() - base) / (2 * count);
+	j_release(&doc);
+
+	cout << "Heap used per value, bytes: " << perValue << endl;
+
+	// The string caches and the backing buffers of the roots don't take room in every value
+	EXPECT_LT(perValue, 80u);
+}
+
+TEST(JobjMemory, SharedScalars)
+{
+	// Flags and counters, none of the elements takes room of its own
+	const size_t count = 100000;
+	string input = "[";
+	for (size_t i = 0; i < count; ++i)
+		input += string(i ? ", " : "") + (i % 3 ? boost::lexical_cast<string>(i % 100) : "true");
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref doc = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(doc));
+	size_t perValue = (HeapInUse() - base) / count;
+	j_release(&doc);
+
+	cout << "Heap used per element, bytes: " << perValue << endl;
+
+	// Only the slots of the array
+	EXPECT_LE(perValue, 2 * sizeof(jvalue_ref));
+}
+
+TEST(JobjMemory, PackedNumbers)
+{
+	// Samples of a sensor, or coordinates of a shape
+	string input = "[";
+	for (size_t i = 0; i < 100000; ++i)
+		input += (i ? ", " : "") + boost::lexical_cast<string>(i * 0.25);
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref arr = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(arr));
+	BOOST_SCOPE_EXIT((&arr)) {
+		j_release(&arr);
+	} BOOST_SCOPE_EXIT_END
+	size_t packed = HeapInUse() - base;
+
+	const double *span = NULL;
+	size_t size = 0;
+	ASSERT_TRUE(jarray_get_f64_span(arr, &span, &size));
+	ASSERT_EQ(100000u, size);
+	EXPECT_EQ(0.25, span[1]);
+
+	// Any modification moves the elements into values
+	ASSERT_TRUE(jarray_append(arr, jnull()));
+	size_t boxed = HeapInUse() - base;
+
+	cout << "Heap used by the array of 100000 numbers, bytes:" << endl;
+	cout << "packed:\t" << packed << endl;
+	cout << "boxed:\t" << boxed << endl;
+
+	EXPECT_LT(packed * 4, boxed);
+}
+
+TEST(JobjMemory, ShapedRecords)
+{
+	// Rows of a table, the objects share their keys
+	string input = "[";
+	for (size_t i = 0; i < 20000; ++i)
+	{
+		string n = boost::lexical_cast<string>(i);
+		input += (i ? ", " : "");
+		input += "{\"id\": " + n + ", \"name\": \"entry " + n + "\", \"enabled\": true, \"weight\": 0.5}";
+	}
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref parsed = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_array(parsed));
+	BOOST_SCOPE_EXIT((&parsed)) {
+		j_release(&parsed);
+	} BOOST_SCOPE_EXIT_END
+	size_t shaped = HeapInUse() - base;
+
+	// The same records built one by one have a hash table each
+	base = HeapInUse();
+	jvalue_ref built = jarray_create(NULL);
+	BOOST_SCOPE_EXIT((&built)) {
+		j_release(&built);
+	} BOOST_SCOPE_EXIT_END
+	for (size_t i = 0; i < 20000; ++i)
+	{
+		string name = "entry " + boost::lexical_cast<string>(i);
+		jvalue_ref record = jobject_create();
+		jobject_put(record, jstring_create("id"), jnumber_create_i64(i));
+		jobject_put(record, jstring_create("name"), jstring_create(name.c_str()));
+		jobject_put(record, jstring_create("enabled"), jboolean_create(true));
+		jobject_put(record, jstring_create("weight"), jnumber_create_f64(0.5));
+		jarray_append(built, record);
+	}
+	size_t hashed = HeapInUse() - base;
+
+	cout << "Heap used by 20000 records, bytes:" << endl;
+	cout << "shaped:\t" << shaped << endl;
+	cout << "hashed:\t" << hashed << endl;
+
+	EXPECT_TRUE(jvalue_equal(parsed, built));
+	EXPECT_LT(shaped, hashed);
+}
+
+// Count the strings, numbers and booleans of the tree, and the distinct instances of them.
+// The containers don't count, the repeated ones are copied as their members are accessed.
+static void CountValues(jvalue_ref val, size_t &total, set<jvalue_ref> &distinct)
+{
+	if (jis_object(val))
+	{
+		jobject_iter it;
+		jobject_key_value pair;
+		jobject_iter_init(&it, val);
+		while (jobject_iter_next(&it, &pair))
+			CountValues(pair.value, total, distinct);
+	}
+	else if (jis_array(val))
+	{
+		for (ssize_t i = 0; i < jarray_size(val); ++i)
+			CountValues(jarray_get(val, i), total, distinct);
+	}
+	else
+	{
+		++total;
+		distinct.insert(val);
+	}
+}
+
+TEST(JobjMemory, Deduplicate)
+{
+	// Catalog: the items repeat a few option blocks and enumerations
+	const char *colors[] = { "red", "green", "blue" };
+	const char *sizes[] = { "S", "M", "L", "XL" };
+	string input = "{\"items\": [";
+	for (size_t i = 0; i < 20000; ++i)
+	{
+		string n = boost::lexical_cast<string>(i);
+		input += (i ? ", " : "");
+		input += "{\"id\": " + n + ", \"type\": \"item\", \"status\": \"active\", "
+		         "\"options\": {\"color\": \"" + colors[i % 3] + "\", \"size\": \"" + sizes[i % 4] + "\", "
+		         "\"gift\": false, \"delivery\": [\"post\", \"pickup\"]}}";
+	}
+	input += "]}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	size_t base = HeapInUse();
+	jvalue_ref plain = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_object(plain));
+	BOOST_SCOPE_EXIT((&plain)) {
+		j_release(&plain);
+	} BOOST_SCOPE_EXIT_END
+	size_t plainSize = HeapInUse() - base;
+
+	base = HeapInUse();
+	jvalue_ref deduplicated = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_DEDUPLICATE, &schemaInfo);
+	ASSERT_TRUE(jis_object(deduplicated));
+	BOOST_SCOPE_EXIT((&deduplicated)) {
+		j_release(&deduplicated);
+	} BOOST_SCOPE_EXIT_END
+	size_t deduplicatedSize = HeapInUse() - base;
+
+	size_t total = 0;
+	set<jvalue_ref> distinct;
+	CountValues(deduplicated, total, distinct);
+
+	cout << "Values: " << total << ", distinct: " << distinct.size()
+	     << " (ratio " << double(total) / distinct.size() << ")" << endl;
+	cout << "Heap used by the DOM, bytes:" << endl;
+	cout << "plain:\t\t" << plainSize << endl;
+	cout << "deduplicated:\t" << deduplicatedSize << " (saved " << plainSize - deduplicatedSize << ")" << endl;
+
+	EXPECT_TRUE(jvalue_equal(plain, deduplicated));
+	EXPECT_LT(distinct.size() * 4, total);
+	EXPECT_LT(deduplicatedSize * 2, plainSize);
+}
+
+TEST(JobjMemory, DuplicateTemplate)
+{
+	// Response template of about 200 KB, every request fills in a few fields of its copy
+	string input = "{\"status\": \"\", \"request\": 0, \"sections\": [";
+	for (size_t i = 0; i < 2000; ++i)
+	{
+		string n = boost::lexical_cast<string>(i);
+		input += (i ? ", " : "");
+		input += "{\"id\": " + n + ", \"title\": \"section " + n + "\", \"visible\": true, "
+		         "\"items\": [1, 2, 3], \"style\": {\"font\": \"sans\", \"size\": 12}}";
+	}
+	input += "]}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	jvalue_ref templ = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_TRUE(jis_object(templ));
+	BOOST_SCOPE_EXIT((&templ)) {
+		j_release(&templ);
+	} BOOST_SCOPE_EXIT_END
+
+	auto serve = [](jvalue_ref templ, vector<jvalue_ref> &responses)
+	{
+		for (size_t i = 0; i < 100; ++i)
+		{
+			jvalue_ref response = jvalue_duplicate(templ);
+			jobject_put(response, J_CSTR_TO_JVAL("status"), J_CSTR_TO_JVAL("ok"));
+			jobject_put(response, J_CSTR_TO_JVAL("request"), jnumber_create_i32(i));
+			jvalue_ref section = jarray_get(jobject_get(response, J_CSTR_TO_BUF("sections")), i);
+			jobject_put(section, J_CSTR_TO_JVAL("visible"), jboolean_create(false));
+			responses.push_back(response);
+		}
+	};
+
+	vector<jvalue_ref> responses;
+	auto release = [&responses]()
+	{
+		for (auto &response : responses)
+			j_release(&response);
+		responses.clear();
+	};
+
+	size_t base = HeapInUse();
+	serve(templ, responses);
+	size_t copied = HeapInUse() - base;
+	release();
+
+	jvalue_freeze(templ);
+	base = HeapInUse();
+	serve(templ, responses);
+	size_t shared = HeapInUse() - base;
+	// The template itself stays intact
+	bool visible = false;
+	jboolean_get(jobject_get(jarray_get(jobject_get(templ, J_CSTR_TO_BUF("sections")), 0), J_CSTR_TO_BUF("visible")), &visible);
+	EXPECT_TRUE(visible);
+	release();
+
+	cout << "Heap used by 100 copies of the template, bytes:" << endl;
+	cout << "copied:\t" << copied << endl;
+	cout << "frozen:\t" << shared << " (saved " << copied - shared << ")" << endl;
+
+	EXPECT_LT(shared * 5, copied);
+}
+
+TEST(JobjPerformanceDeep, Nesting)
+{
+	// Every operation walks through all the levels without recursion
+	const size_t depth = 100000;
+	string input;
+	for (size_t i = 0; i < depth; ++i)
+		input += (i % 2) ? "[1," : "{\"a\":";
+	input += "0";
+	for (size_t i = depth; i-- > 0; )
+		input += (i % 2) ? "]" : "}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	auto measure = [](const char *name, function<void()> code)
+	{
+		auto start = chrono::steady_clock::now();
+		code();
+		chrono::duration<double, milli> spent = chrono::steady_clock::now() - start;
+		cout << name << ":\t" << spent.count() << " ms" << endl;
+	};
+
+	jvalue_ref doc, copy;
+	measure("parse", [&]() { doc = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo); });
+	ASSERT_TRUE(jis_object(doc));
+
+	measure("stringify", [&]() { EXPECT_EQ(input, jvalue_tostring(doc, jschema_all())); });
+	measure("duplicate", [&]() { copy = jvalue_duplicate(doc); });
+	ASSERT_TRUE(jis_object(copy));
+	measure("equal", [&]() { EXPECT_TRUE(jvalue_equal(doc, copy)); });
+	measure("insert", [&]() {
+		jvalue_ref parent = jarray_create(NULL);
+		EXPECT_TRUE(jarray_append(parent, jvalue_copy(copy)));
+		j_release(&parent);
+	});
+	measure("freeze", [&]() { jvalue_freeze(copy); });
+	measure("release", [&]() {
+		j_release(&copy);
+		j_release(&doc);
+	});
+}
+
+TEST(JobjPerformanceRelease, Latency)
+{
+	// Requests that parse a document and drop it, the last release takes as long as the
+	// document is big unless it's left to the background
+	string input = "[";
+	for (int i = 0; i < 20000; ++i)
+		input += string(i ? "," : "") + "{\"id\":" + to_string(i) + ",\"name\":\"user" + to_string(i) +
+		         "\",\"tags\":[\"a\",\"b\"],\"pos\":{\"x\":1.5,\"y\":2}}";
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	const size_t requests = 100;
+	auto serve = [&](void (*release)(jvalue_ref *))
+	{
+		vector<double> spent;
+		for (size_t i = 0; i < requests; ++i)
+		{
+			jvalue_ref doc = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+			EXPECT_TRUE(jis_array(doc));
+			auto start = chrono::steady_clock::now();
+			release(&doc);
+			spent.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+		}
+		sort(spent.begin(), spent.end());
+		return spent;
+	};
+	auto report = [&](const char *name, const vector<double> &spent)
+	{
+		cout << name << ":\tp50 " << spent[requests / 2] << " us, p99 " << spent[requests * 99 / 100] << " us" << endl;
+		return spent[requests * 99 / 100];
+	};
+
+	double inPlace = report("in place", serve(j_release));
+	double deferred = report("deferred", serve(j_release_deferred));
+	j_release_wait();
+
+	EXPECT_LT(deferred * 5, inPlace);
+}
+
+TEST(JobjPerformanceIndex, Lookup)
+{
+	// Looking up the records by id: a scan over the array against the index
+	for (size_t size : { 1000, 100000, 1000000 })
+	{
+		jvalue_ref arr = jarray_create_hint(NULL, size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			jvalue_ref record = jobject_create();
+			jobject_put(record, J_CSTR_TO_JVAL("id"), jnumber_create_i64(i * 7));
+			jobject_put(record, J_CSTR_TO_JVAL("name"), jstring_create("record"));
+			jarray_append(arr, record);
+		}
+
+		// Spread over the array in any run of them
+		vector<jvalue_ref> keys;
+		for (size_t i = 0; i < 1000; ++i)
+			keys.push_back(jnumber_create_i64((i * 613 % 1000 * (size / 1000) + i % 7) * 7));
+
+		auto lookup = [&](function<ssize_t(jvalue_ref)> find, size_t count)
+		{
+			auto start = chrono::steady_clock::now();
+			for (size_t i = 0; i < count; ++i)
+				EXPECT_GE(find(keys[i % keys.size()]), 0);
+			return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / count;
+		};
+
+		double scan = lookup([&](jvalue_ref key)
+		{
+			for (ssize_t i = 0; i < jarray_size(arr); ++i)
+			{
+				jvalue_ref id = jobject_get(jarray_get(arr, i), J_CSTR_TO_BUF("id"));
+				if (jnumber_compare(id, key) == 0)
+					return i;
+			}
+			return (ssize_t) -1;
+		}, max<size_t>(10, 10000000 / size));
+
+		auto start = chrono::steady_clock::now();
+		jarray_index_ref index = jarray_build_index(arr, "/id");
+		chrono::duration<double, milli> build = chrono::steady_clock::now() - start;
+		ASSERT_TRUE(index != NULL);
+
+		double indexed = lookup([&](jvalue_ref key) { return jarray_index_find(index, key); }, 100000);
+
+		cout << size << " elements:\tscan " << scan << " ns, index " << indexed << " ns"
+		     << " (built in " << build.count() << " ms)" << endl;
+		if (size >= 100000)
+			EXPECT_LT(indexed * 100, scan);
+
+		jarray_index_release(&index);
+		for (jvalue_ref key : keys)
+			j_release(&key);
+		j_release(&arr);
+	}
+}
+
+TEST(JobjPerformanceKey, Lookup)
+{
+	// The records parsed share the shapes, the ones a member is removed from use hash tables
+	string input = "[";
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		input += i ? ", " : "";
+		input += "{\"id\": " + to_string(i) + ", \"type\": \"event\", \"source\": \"sensor\", \"level\": 3,"
+		         " \"message\": \"ok\", \"timestamp\": " + to_string(1400000000 + i) + "}";
+	}
+	input += "]";
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	jvalue_ref shaped = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	ASSERT_EQ(1000, jarray_size(shaped));
+
+	jvalue_ref hashed = jarray_create(NULL);
+	for (ssize_t i = 0; i < jarray_size(shaped); ++i)
+		jarray_append(hashed, jvalue_duplicate(jarray_get(shaped, i)));
+	for (ssize_t i = 0; i < jarray_size(hashed); ++i)
+		jobject_remove(jarray_get(hashed, i), J_CSTR_TO_BUF("message"));
+
+	jkey_ref created = jkey_create(J_CSTR_TO_BUF("timestamp"));
+	jkey_ref interned = jkey_intern(J_CSTR_TO_BUF("timestamp"));
+
+	auto lookup = [](jvalue_ref records, function<jvalue_ref(jvalue_ref)> get)
+	{
+		size_t found = 0;
+		auto start = chrono::steady_clock::now();
+		for (int run = 0; run < 1000; ++run)
+		{
+			for (ssize_t i = 0; i < jarray_size(records); ++i)
+			{
+				if (jis_number(get(jarray_get(records, i))))
+					++found;
+			}
+		}
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (1000 * jarray_size(records));
+		EXPECT_EQ(1000u * 1000, found);
+		return ns;
+	};
+
+	for (jvalue_ref records : { shaped, hashed })
+	{
+		double byName = lookup(records, [](jvalue_ref obj) { return jobject_get(obj, J_CSTR_TO_BUF("timestamp")); });
+		double byKey = lookup(records, [&](jvalue_ref obj) { return jobject_get_key(obj, created); });
+		double byInterned = lookup(records, [&](jvalue_ref obj) { return jobject_get_key(obj, interned); });
+		cout << (records == shaped ? "shaped" : "hashed") << " records:\tname " << byName << " ns, key "
+		     << byKey << " ns, interned key " << byInterned << " ns" << endl;
+	}
+
+	jkey_release(&created);
+	jkey_release(&interned);
+	j_release(&hashed);
+	j_release(&shaped);
+}
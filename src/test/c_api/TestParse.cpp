@@ -25,6 +25,10 @@
 #include <memory>
 #include <algorithm>
 #include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 #include <cxx/JSchemaFile.h>
 
 void j_release_ref(jvalue * val) {
@@ -220,6 +224,52 @@ TEST(TestParse, testParseFile)
 	for (const auto &task : tasks) TestParse_testParseFile(task);
 }
 
+TEST(TestParse, parseFileStreaming)
+{
+	// Bigger than a few chunks of the reader, with values split between the chunks
+	std::string input = "[";
+	for (int i = 0; i < 5000; ++i)
+		input += std::string(i ? ", " : "") + "{\"key\\u0020" + std::to_string(i) + "\": \"value " + std::to_string(i) + "\", \"n\": " + std::to_string(i * 7) + "}";
+	input += "]";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	jptr_value expected{ jdom_parse(j_str_to_buffer(input.data(), input.size()), DOMOPT_NOOPT, &schemaInfo) };
+	ASSERT_TRUE(jis_array(expected));
+
+	char fileName[] = "/tmp/pbnjson_parse_file_XXXXXX";
+	int fd = mkstemp(fileName);
+	ASSERT_NE(-1, fd);
+	ASSERT_EQ((ssize_t)input.size(), write(fd, input.data(), input.size()));
+	close(fd);
+
+	jptr_value streamed{ jdom_parse_file(fileName, &schemaInfo, JFileOptNoOpt) };
+	EXPECT_TRUE(jvalue_equal(expected, streamed));
+	jptr_value mapped{ jdom_parse_file(fileName, &schemaInfo, JFileOptMMap) };
+	EXPECT_TRUE(jvalue_equal(expected, mapped));
+	unlink(fileName);
+
+	// A pipe can't be mapped, it is read the same way regardless of the flags
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+	std::thread writer([&]() {
+		for (size_t i = 0; i < input.size(); ) {
+			ssize_t written = write(fds[1], input.data() + i, std::min<size_t>(1000, input.size() - i));
+			if (written <= 0)
+				break;
+			i += written;
+		}
+		close(fds[1]);
+	});
+	std::string pipeName = "/dev/fd/" + std::to_string(fds[0]);
+	jptr_value piped{ jdom_parse_file(pipeName.c_str(), &schemaInfo, JFileOptMMap) };
+	writer.join();
+	close(fds[0]);
+	EXPECT_TRUE(jvalue_equal(expected, piped));
+
+	EXPECT_FALSE(jis_valid(jdom_parse_file("/nonexistent/file.json", &schemaInfo, JFileOptNoOpt)));
+}
+
 struct test_sax_context {
 	int null_counter;
 	int boolean_counter;
@@ -433,3 +483,762 @@ TEST(TestParse, domparser)
 	j_release(&jval);
 	jschema_release(&schema);
 }
+
+struct test_lines_context
+{
+	std::vector<size_t> lines;
+	std::vector<bool> valid;
+	std::vector<int> values;
+	size_t stop_after;
+
+	test_lines_context() : stop_after(std::numeric_limits<size_t>::max()) {}
+
+	static bool on_record(void *ctxt, size_t line, jvalue_ref value, const char *error)
+	{
+		test_lines_context *self = static_cast<test_lines_context *>(ctxt);
+		self->lines.push_back(line);
+		self->valid.push_back(error == NULL);
+
+		int32_t num = -1;
+		if (error == NULL && value)
+			jnumber_get_i32(jobject_get(value, j_cstr_to_buffer("id")), &num);
+		self->values.push_back(num);
+
+		return self->lines.size() < self->stop_after;
+	}
+};
+
+TEST(TestParse, parseLines)
+{
+	jptr_schema schema{ jschema_parse(j_cstr_to_buffer(
+		"{\"type\": \"object\", \"properties\": {\"id\": {\"type\": \"integer\"}}, \"required\": [\"id\"]}"),
+		JSCHEMA_DOM_NOOPT, NULL) };
+	ASSERT_TRUE(schema.get() != NULL);
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+
+	std::string input;
+	const size_t records = 1000;
+	for (size_t i = 0; i < records; ++i) {
+		if (i == 10)
+			input += "\r\n";
+		if (i == 500)
+			input += "{\"id\": \"wrong\"}\n";
+		input += "{\"id\": " + std::to_string(i) + "}\n";
+	}
+	input += "{\"id\": 1000";
+
+	for (int threads : {1, 4, 0}) {
+		test_lines_context context;
+		EXPECT_FALSE(jdom_parse_lines(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo,
+		                              threads, &test_lines_context::on_record, &context));
+
+		ASSERT_EQ(records + 2, context.lines.size());
+		for (size_t i = 0, id = 0; i < context.lines.size(); ++i) {
+			if (i == 500 || i == records + 1) {
+				EXPECT_FALSE(context.valid[i]);
+				continue;
+			}
+			EXPECT_TRUE(context.valid[i]);
+			EXPECT_EQ((int)id, context.values[i]);
+			++id;
+		}
+		EXPECT_EQ(1u, context.lines[0]);
+		EXPECT_EQ(12u, context.lines[10]);
+		EXPECT_EQ(502u, context.lines[500]);
+		EXPECT_EQ(records + 3, context.lines.back());
+	}
+}
+
+TEST(TestParse, parseLinesStop)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	std::string input;
+	for (size_t i = 0; i < 10000; ++i)
+		input += "{\"id\": " + std::to_string(i) + "}\n";
+
+	test_lines_context context;
+	context.stop_after = 100;
+	EXPECT_FALSE(jdom_parse_lines(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo,
+	                              4, &test_lines_context::on_record, &context));
+	ASSERT_EQ(100u, context.lines.size());
+	EXPECT_EQ(99, context.values.back());
+}
+
+TEST(TestParse, saxParseLines)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	std::string input = "[1, 2]\n\n{\"a\": null}\n[\n";
+
+	test_lines_context context;
+	EXPECT_FALSE(jsax_parse_lines(NULL, j_str_to_buffer(input.c_str(), input.size()), &schemaInfo, NULL,
+	                              2, &test_lines_context::on_record, &context));
+	ASSERT_EQ(3u, context.lines.size());
+	EXPECT_TRUE(context.valid[0]);
+	EXPECT_TRUE(context.valid[1]);
+	EXPECT_FALSE(context.valid[2]);
+	EXPECT_EQ(3u, context.lines[1]);
+	EXPECT_EQ(4u, context.lines[2]);
+}
+
+static bool collect_documents(void *ctxt, jvalue_ref value)
+{
+	std::vector<jvalue_ref> *documents = static_cast<std::vector<jvalue_ref> *>(ctxt);
+	documents->push_back(value ? jvalue_copy(value) : NULL);
+	return true;
+}
+
+TEST(TestParse, domparserMultipleValues)
+{
+	jptr_schema schema{ jschema_parse(j_cstr_to_buffer(
+		"{\"type\": \"object\", \"properties\": {\"id\": {\"type\": \"integer\"}}}"),
+		JSCHEMA_DOM_NOOPT, NULL) };
+	ASSERT_TRUE(schema.get() != NULL);
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+
+	std::vector<jvalue_ref> documents;
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(parser != NULL);
+	ASSERT_TRUE(jdomparser_set_multiple_values(parser, collect_documents, &documents));
+
+	// Documents split between the chunks arbitrarily
+	std::string input = "{\"id\": 1}{\"id\": 2}\n {\"id\":3, \"x\": [1, {}]}";
+	for (size_t i = 0; i < input.size(); i += 5)
+		ASSERT_TRUE(jdomparser_feed(parser, input.c_str() + i, std::min<size_t>(5, input.size() - i)));
+	ASSERT_TRUE(jdomparser_end(parser));
+	EXPECT_FALSE(jis_valid(jdomparser_get_result(parser)));
+
+	ASSERT_EQ(3u, documents.size());
+	for (size_t i = 0; i < documents.size(); ++i) {
+		int32_t id = 0;
+		ASSERT_TRUE(jis_object(documents[i]));
+		EXPECT_EQ(CONV_OK, jnumber_get_i32(jobject_get(documents[i], j_cstr_to_buffer("id")), &id));
+		EXPECT_EQ((int32_t)i + 1, id);
+		j_release(&documents[i]);
+	}
+	documents.clear();
+
+	// Every document is validated on its own
+	const char invalid[] = "{\"id\": 4} {\"id\": \"5\"}";
+	ASSERT_FALSE(jdomparser_feed(parser, invalid, sizeof(invalid) - 1));
+	EXPECT_TRUE(jdomparser_get_error(parser) != NULL);
+	ASSERT_EQ(1u, documents.size());
+	j_release(&documents[0]);
+
+	jdomparser_release(&parser);
+}
+
+TEST(TestParse, domparserLearnedSizes)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	std::vector<jvalue_ref> documents;
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(parser != NULL);
+	ASSERT_TRUE(jdomparser_set_multiple_values(parser, collect_documents, &documents));
+
+	// Sizes learned from the earlier documents are only hints for the later ones
+	std::string input;
+	const int sizes[] = { 3, 10, 1, 0, 50 };
+	for (int size : sizes) {
+		input += "{\"a\": [";
+		for (int i = 0; i < size; ++i)
+			input += (i ? ", [" : "[") + std::to_string(i) + "]";
+		input += "], \"b\": {\"c\": []}}";
+	}
+	for (size_t i = 0; i < input.size(); i += 7)
+		ASSERT_TRUE(jdomparser_feed(parser, input.c_str() + i, std::min<size_t>(7, input.size() - i)));
+	ASSERT_TRUE(jdomparser_end(parser));
+
+	ASSERT_EQ(sizeof(sizes) / sizeof(sizes[0]), documents.size());
+	for (size_t i = 0; i < documents.size(); ++i) {
+		jvalue_ref a = jobject_get(documents[i], j_cstr_to_buffer("a"));
+		ASSERT_TRUE(jis_array(a));
+		ASSERT_EQ(sizes[i], jarray_size(a));
+		for (int j = 0; j < sizes[i]; ++j) {
+			int32_t n = -1;
+			ASSERT_EQ(1, jarray_size(jarray_get(a, j)));
+			EXPECT_EQ(CONV_OK, jnumber_get_i32(jarray_get(jarray_get(a, j), 0), &n));
+			EXPECT_EQ(j, n);
+		}
+		jvalue_ref c = jobject_get(jobject_get(documents[i], j_cstr_to_buffer("b")), j_cstr_to_buffer("c"));
+		EXPECT_TRUE(jis_array(c));
+		EXPECT_EQ(0, jarray_size(c));
+		j_release(&documents[i]);
+	}
+
+	jdomparser_release(&parser);
+}
+
+TEST(TestParse, saxparserMultipleValues)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	test_sax_context context;
+	std::vector<jvalue_ref> documents;
+	jsaxparser_ref parser = jsaxparser_create(&schemaInfo, &context.callbacks, &context);
+	ASSERT_TRUE(parser != NULL);
+	ASSERT_TRUE(jsaxparser_set_multiple_values(parser, collect_documents, &documents));
+
+	const char input[] = "[1, \"a\"] {\"b\": null} true 12";
+	ASSERT_TRUE(jsaxparser_feed(parser, input, sizeof(input) - 1));
+	ASSERT_TRUE(jsaxparser_end(parser));
+	jsaxparser_release(&parser);
+
+	EXPECT_EQ(4u, documents.size());
+	EXPECT_EQ(1, context.array_start_counter);
+	EXPECT_EQ(1, context.object_start_counter);
+	EXPECT_EQ(2, context.number_counter);
+	EXPECT_EQ(1, context.boolean_counter);
+	EXPECT_EQ(1, context.null_counter);
+}
+
+TEST(TestParse, parseProjection)
+{
+	const char *paths[] = { "/header/type", "/payload/items/1", "/a~1b", "/payload/meta" };
+	const char *input =
+		"{\"header\": {\"type\": \"x\", \"skip\": [1, 2, {\"type\": 3}]}, \"big\": [{\"a\": 1}, \"s\"],"
+		" \"payload\": {\"items\": [10, {\"k\": [1]}, 30], \"meta\": {\"m\": [true]}, \"id\": 5},"
+		" \"a/b\": null, \"header2\": 1}";
+
+	jptr_value parsed{ jdom_parse_projection(j_cstr_to_buffer(input), paths, 4) };
+	ASSERT_TRUE(jis_object(parsed));
+	EXPECT_EQ(3, jobject_size(parsed));
+
+	jvalue_ref header = jobject_get(parsed, j_cstr_to_buffer("header"));
+	EXPECT_EQ(1, jobject_size(header));
+	raw_buffer type = jstring_get_fast(jobject_get(header, j_cstr_to_buffer("type")));
+	EXPECT_EQ(std::string("x"), std::string(type.m_str, type.m_len));
+
+	jvalue_ref payload = jobject_get(parsed, j_cstr_to_buffer("payload"));
+	EXPECT_EQ(2, jobject_size(payload));
+	jvalue_ref items = jobject_get(payload, j_cstr_to_buffer("items"));
+	ASSERT_EQ(1, jarray_size(items));
+	EXPECT_TRUE(jis_object(jarray_get(items, 0)));
+	EXPECT_TRUE(jis_array(jobject_get(jobject_get(payload, j_cstr_to_buffer("meta")), j_cstr_to_buffer("m"))));
+	EXPECT_TRUE(jis_null(jobject_get(parsed, j_cstr_to_buffer("a/b"))));
+
+	const char *whole[] = { "" };
+	parsed = jdom_parse_projection(j_cstr_to_buffer(input), whole, 1);
+	EXPECT_EQ(5, jobject_size(parsed));
+
+	const char *invalid[] = { "header" };
+	EXPECT_FALSE(jis_valid(jdom_parse_projection(j_cstr_to_buffer(input), invalid, 1)));
+	EXPECT_FALSE(jis_valid(jdom_parse_projection(j_cstr_to_buffer("{\"header\": [}"), paths, 4)));
+}
+
+TEST(TestParse, saxParseProjection)
+{
+	const char *paths[] = { "/a/1" };
+	const char *input = "{\"a\": [{\"x\": \"s\"}, {\"y\": [1, null]}, 3], \"b\": {\"c\": true}}";
+
+	test_sax_context context;
+	ASSERT_TRUE(jsax_parse_projection(&context.callbacks, j_cstr_to_buffer(input), paths, 1, &context));
+
+	EXPECT_EQ(2, context.object_start_counter);
+	EXPECT_EQ(2, context.object_key_counter);
+	EXPECT_EQ(2, context.array_start_counter);
+	EXPECT_EQ(1, context.number_counter);
+	EXPECT_EQ(1, context.null_counter);
+	EXPECT_EQ(0, context.string_counter);
+	EXPECT_EQ(0, context.boolean_counter);
+}
+
+TEST(TestParse, parseLazy)
+{
+	const char input[] =
+		"{\"a\": [1, {\"b\": [true, null]}, \"s\\n\\u00e9\\ud83d\\ude00\"], /* comment */"
+		" \"c\": {\"d\": -2.5, \"e\": {}}, \"f\": []}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	jptr_value eager{ jdom_parse(j_cstr_to_buffer(input), DOMOPT_NOOPT, &schemaInfo) };
+	jptr_value lazy{ jdom_parse_lazy(j_cstr_to_buffer(input), DOMOPT_NOOPT, &schemaInfo) };
+	ASSERT_TRUE(jis_object(lazy));
+
+	jvalue_ref c = jobject_get(lazy, j_cstr_to_buffer("c"));
+	ASSERT_TRUE(jis_object(c));
+	double d = 0;
+	EXPECT_EQ(CONV_OK, jnumber_get_f64(jobject_get(c, j_cstr_to_buffer("d")), &d));
+	EXPECT_EQ(-2.5, d);
+
+	jvalue_ref a = jobject_get(lazy, j_cstr_to_buffer("a"));
+	ASSERT_EQ(3, jarray_size(a));
+	raw_buffer s = jstring_get_fast(jarray_get(a, 2));
+	EXPECT_EQ(std::string("s\n\xc3\xa9\xf0\x9f\x98\x80"), std::string(s.m_str, s.m_len));
+
+	// Whatever is accessed first, the lazy DOM is the same as the eager one
+	EXPECT_TRUE(jvalue_equal(eager, lazy));
+
+	// A lazy subtree survives the root and can be modified
+	jvalue_ref b = jvalue_copy(jobject_get(jarray_get(a, 1), j_cstr_to_buffer("b")));
+	jptr_value copy{ jvalue_duplicate(b) };
+	lazy = jinvalid();
+	EXPECT_TRUE(jarray_append(b, jnumber_create_i32(3)));
+	EXPECT_EQ(3, jarray_size(b));
+	EXPECT_EQ(2, jarray_size(copy));
+	j_release(&b);
+
+	jptr_value scalar{ jdom_parse_lazy(j_cstr_to_buffer(" \"x\" "), DOMOPT_NOOPT, &schemaInfo) };
+	EXPECT_TRUE(jis_string(scalar));
+
+	EXPECT_FALSE(jis_valid(jdom_parse_lazy(j_cstr_to_buffer("{\"a\": [1, }"), DOMOPT_NOOPT, &schemaInfo)));
+	EXPECT_FALSE(jis_valid(jdom_parse_lazy(j_cstr_to_buffer("[1] 2"), DOMOPT_NOOPT, &schemaInfo)));
+	EXPECT_FALSE(jis_valid(jdom_parse_lazy(j_cstr_to_buffer("[01]"), DOMOPT_NOOPT, &schemaInfo)));
+
+	// The defaults of the schema are inserted as jdom_parse does
+	jptr_schema schema{ jschema_parse(j_cstr_to_buffer(
+		"{\"type\": \"object\", \"properties\": {\"a\": {\"type\": \"integer\"}, \"b\": {\"default\": [1]}}}"),
+		JSCHEMA_DOM_NOOPT, NULL) };
+	ASSERT_TRUE(schema.get() != NULL);
+	JSchemaInfo defaultsInfo;
+	jschema_info_init(&defaultsInfo, schema.get(), NULL, NULL);
+	jptr_value withDefaults{ jdom_parse_lazy(j_cstr_to_buffer("{\"a\": 1}"), DOMOPT_NOOPT, &defaultsInfo) };
+	jptr_value expected{ jdom_parse(j_cstr_to_buffer("{\"a\": 1, \"b\": [1]}"), DOMOPT_NOOPT, &schemaInfo) };
+	EXPECT_TRUE(jvalue_equal(expected, withDefaults));
+	jptr_value withValues{ jdom_parse_lazy(j_cstr_to_buffer("{\"a\": 1, \"b\": 2}"), DOMOPT_NOOPT, &defaultsInfo) };
+	EXPECT_EQ(2, jobject_size(withValues));
+	EXPECT_FALSE(jis_valid(jdom_parse_lazy(j_cstr_to_buffer("{\"a\": true}"), DOMOPT_NOOPT, &defaultsInfo)));
+}
+
+TEST(TestParse, parseNoCopyEscapedStrings)
+{
+	// Enough escaped strings to fill a few chunks of the arena
+	std::string input = "{\"plain\": \"abc\", \"esc\\taped\": \"x\\ny\", \"list\": [";
+	for (int i = 0; i < 1000; ++i)
+		input += std::string(i ? ", " : "") + "\"\\u00e9" + std::to_string(i) + "\"";
+	input += "], \"num\": 12.5}";
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	jptr_value expected{ jdom_parse(j_cstr_to_buffer(input.c_str()), DOMOPT_NOOPT, &schemaInfo) };
+
+	std::string buffer = input;
+	jptr_value dom{ jdom_parse(j_str_to_buffer(buffer.data(), buffer.size()), DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE, &schemaInfo) };
+	ASSERT_TRUE(jis_object(dom));
+	EXPECT_TRUE(jvalue_equal(expected, dom));
+
+	// Strings found verbatim reference the input, the unescaped ones don't
+	auto inInput = [&buffer](raw_buffer s) { return s.m_str >= buffer.data() && s.m_str < buffer.data() + buffer.size(); };
+	EXPECT_TRUE(inInput(jstring_get_fast(jobject_get(dom, j_cstr_to_buffer("plain")))));
+	raw_buffer escaped = jstring_get_fast(jobject_get(dom, j_cstr_to_buffer("esc\taped")));
+	EXPECT_FALSE(inInput(escaped));
+	EXPECT_EQ(std::string("x\ny"), std::string(escaped.m_str, escaped.m_len));
+
+	// The unescaped strings stay valid when the rest of the document is gone
+	jvalue_ref list = jvalue_copy(jobject_get(dom, j_cstr_to_buffer("list")));
+	dom = jinvalid();
+	raw_buffer last = jstring_get_fast(jarray_get(list, 999));
+	EXPECT_EQ(std::string("\xc3\xa9" "999"), std::string(last.m_str, last.m_len));
+	j_release(&list);
+
+	// A string split between chunks isn't referenced in place either
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE);
+	ASSERT_TRUE(parser);
+	for (size_t i = 0; i < buffer.size(); i += 7)
+		ASSERT_TRUE(jdomparser_feed(parser, buffer.data() + i, std::min<size_t>(7, buffer.size() - i)));
+	ASSERT_TRUE(jdomparser_end(parser));
+	jptr_value chunked{ jdomparser_get_result(parser) };
+	jdomparser_release(&parser);
+	EXPECT_TRUE(jvalue_equal(expected, chunked));
+}
+
+static bool stop_after_two(void *ctxt, jvalue_ref value)
+{
+	return collect_documents(ctxt, value) && static_cast<std::vector<jvalue_ref> *>(ctxt)->size() < 2;
+}
+
+TEST(TestParse, domparserElements)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	std::vector<jvalue_ref> elements;
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(parser != NULL);
+	ASSERT_TRUE(jdomparser_set_element_callback(parser, "/data/a~1b", collect_documents, &elements));
+
+	std::string input = "{\"meta\": {\"n\": [1]}, \"data\": {\"a/b\": [{\"id\": [0]}, 1, [2, {}], \"3\"], \"x\": [4]}}";
+	for (size_t i = 0; i < input.size(); i += 3)
+		ASSERT_TRUE(jdomparser_feed(parser, input.c_str() + i, std::min<size_t>(3, input.size() - i)));
+	ASSERT_TRUE(jdomparser_end(parser));
+
+	// The array is left empty, everything else is in the DOM
+	jptr_value result{ jdomparser_get_result(parser) };
+	jdomparser_release(&parser);
+	jptr_value expected{ jdom_parse(j_cstr_to_buffer(
+		"{\"meta\": {\"n\": [1]}, \"data\": {\"a/b\": [], \"x\": [4]}}"), DOMOPT_NOOPT, &schemaInfo) };
+	EXPECT_TRUE(jvalue_equal(expected, result));
+
+	jptr_value all{ jarray_create(NULL) };
+	for (auto element : elements)
+		jarray_append(all, element);
+	jptr_value expectedElements{ jdom_parse(j_cstr_to_buffer("[{\"id\": [0]}, 1, [2, {}], \"3\"]"), DOMOPT_NOOPT, &schemaInfo) };
+	EXPECT_TRUE(jvalue_equal(expectedElements, all));
+	elements.clear();
+
+	// Elements of the top-level array, the callback stops parsing
+	parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(jdomparser_set_element_callback(parser, "", stop_after_two, &elements));
+	const char topLevel[] = "[{\"a\": 1}, [], {\"b\": 2}]";
+	EXPECT_FALSE(jdomparser_feed(parser, topLevel, sizeof(topLevel) - 1));
+	jdomparser_release(&parser);
+	ASSERT_EQ(2u, elements.size());
+	EXPECT_TRUE(jis_object(elements[0]));
+	EXPECT_TRUE(jis_array(elements[1]));
+	for (auto &element : elements)
+		j_release(&element);
+
+	parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	EXPECT_FALSE(jdomparser_set_element_callback(parser, "items", collect_documents, &elements));
+	EXPECT_FALSE(jdomparser_set_element_callback(parser, "/a~2", collect_documents, &elements));
+	jdomparser_release(&parser);
+}
+
+TEST(TestParse, domparserElementsValidation)
+{
+	jptr_schema schema{ jschema_parse(j_cstr_to_buffer(
+		"{\"type\": \"object\", \"properties\": {\"items\": {\"type\": \"array\", \"items\": {\"type\": \"integer\"}}}}"),
+		JSCHEMA_DOM_NOOPT, NULL) };
+	ASSERT_TRUE(schema.get() != NULL);
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+
+	std::vector<jvalue_ref> elements;
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(jdomparser_set_element_callback(parser, "/items", collect_documents, &elements));
+
+	// The invalid element isn't reported
+	const char input[] = "{\"items\": [1, 2, \"3\", 4]}";
+	EXPECT_FALSE(jdomparser_feed(parser, input, sizeof(input) - 1));
+	EXPECT_TRUE(jdomparser_get_error(parser) != NULL);
+	jdomparser_release(&parser);
+
+	ASSERT_EQ(2u, elements.size());
+	for (auto &element : elements)
+		j_release(&element);
+}
+
+struct test_string_chunks_context : test_sax_context {
+	std::string chunks;
+	size_t max_chunk;
+	int end_counter;
+	bool validate_utf8;
+	PJSAXStringCallbacks string_callbacks;
+
+	test_string_chunks_context()
+		: max_chunk(0)
+		, end_counter(0)
+		, validate_utf8(false)
+	{
+		string_callbacks.m_stringChunk = jsax_string_chunk;
+		string_callbacks.m_stringEnd = jsax_string_end;
+	}
+
+	static int jsax_string_chunk(JSAXContextRef ctxt, const char *chunk, size_t chunkLen) {
+		test_string_chunks_context *self = reinterpret_cast<test_string_chunks_context*>(jsax_getContext(ctxt));
+		self->chunks.append(chunk, chunkLen);
+		self->max_chunk = std::max(self->max_chunk, chunkLen);
+		return 1;
+	}
+
+	static int jsax_string_end(JSAXContextRef ctxt) {
+		test_string_chunks_context *self = reinterpret_cast<test_string_chunks_context*>(jsax_getContext(ctxt));
+		self->chunks += '|';
+		self->end_counter++;
+		return 1;
+	}
+
+	bool Parse(JSchemaInfo *schemaInfo, const std::string &input, size_t step) {
+		jsaxparser_ref parser = jsaxparser_create(schemaInfo, &callbacks, this);
+		EXPECT_TRUE(parser != NULL);
+		EXPECT_TRUE(jsaxparser_set_string_chunks(parser, &string_callbacks, 16));
+		EXPECT_TRUE(jsaxparser_set_utf8_validation(parser, validate_utf8));
+		bool result = true;
+		for (size_t i = 0; result && i < input.size(); i += step)
+			result = jsaxparser_feed(parser, input.data() + i, std::min(step, input.size() - i));
+		result = result && jsaxparser_end(parser);
+		jsaxparser_release(&parser);
+		return result;
+	}
+};
+
+TEST(TestParse, saxparserStringChunks)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	const std::string input =
+		"{\"short\": \"a\\\"b\", /* \"not a string\" */ \"long\": \"0123456789\\n0123456789\\u00e9"
+		"\\ud83d\\ude00 \\\"0123456789\\\"\", \"k\": [\"x\", \"abcdefghijklmnopqrstuvwxyz\"]}";
+	const std::string expected =
+		"0123456789\n0123456789\xc3\xa9\xf0\x9f\x98\x80 \"0123456789\"|abcdefghijklmnopqrstuvwxyz|";
+
+	for (size_t step : {1, 3, 7, 1000}) {
+		test_string_chunks_context context;
+		ASSERT_TRUE(context.Parse(&schemaInfo, input, step)) << "step " << step;
+		EXPECT_EQ(expected, context.chunks) << "step " << step;
+		EXPECT_GE(16u, context.max_chunk);
+		EXPECT_EQ(2, context.end_counter);
+		EXPECT_EQ(2, context.string_counter);
+		EXPECT_EQ(3, context.object_key_counter);
+		EXPECT_EQ(1, context.array_end_counter);
+	}
+
+	test_string_chunks_context context;
+	EXPECT_FALSE(context.Parse(&schemaInfo, "[\"0123456789abcdefghij\\x\"]", 1));
+	EXPECT_FALSE(context.Parse(&schemaInfo, "[\"0123456789abcdefghij", 1));
+}
+
+TEST(TestParse, saxparserStringChunksValidation)
+{
+	const std::string input = "{\"a\": \"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\"}";
+
+	JSchemaInfo schemaInfo;
+	jschema_ref schema = jschema_parse(j_cstr_to_buffer(
+		"{\"properties\": {\"a\": {\"type\": \"string\", \"maxLength\": 20}}}"), JSCHEMA_DOM_NOOPT, NULL);
+	ASSERT_TRUE(schema != NULL);
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+	{
+		test_string_chunks_context context;
+		EXPECT_FALSE(context.Parse(&schemaInfo, input, 5));
+		EXPECT_EQ(0, context.end_counter);
+	}
+	jschema_release(&schema);
+
+	schema = jschema_parse(j_cstr_to_buffer(
+		"{\"properties\": {\"a\": {\"type\": \"string\", \"pattern\": \"^a+$\"}}}"), JSCHEMA_DOM_NOOPT, NULL);
+	ASSERT_TRUE(schema != NULL);
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+	{
+		test_string_chunks_context context;
+		EXPECT_TRUE(context.Parse(&schemaInfo, input, 5));
+		EXPECT_EQ(1, context.end_counter);
+		EXPECT_FALSE(context.Parse(&schemaInfo, "{\"a\": \"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab\"}", 5));
+	}
+	jschema_release(&schema);
+}
+
+TEST(TestParse, validateUtf8)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	const std::string valid = "[\"h\xc3\xa9llo\", {\"\xe2\x82\xac\": \"\xf0\x9f\x98\x80 \\u00e9\"}, "
+		"\"0123456789012345678901234567890123456789012345678901234567890123456789\xf4\x8f\xbf\xbf\"]";
+	for (JDOMOptimizationFlags opt : {0u, (unsigned) DOMOPT_INPUT_OUTLIVES_WITH_NOCHANGE}) {
+		jvalue_ref parsed = jdom_parse(j_str_to_buffer(valid.data(), valid.size()), opt | DOMOPT_VALIDATE_UTF8, &schemaInfo);
+		ASSERT_TRUE(jis_array(parsed));
+		EXPECT_TRUE(jstring_equal2(jarray_get(parsed, 0), J_CSTR_TO_BUF("h\xc3\xa9llo")));
+		j_release(&parsed);
+	}
+
+	const char *invalid[] = {
+		"\xc3\x28",              // not a continuation byte
+		"\xc0\xaf",              // overlong
+		"\xe0\x80\xaf",          // overlong
+		"\xed\xa0\x80",          // surrogate
+		"\xf4\x90\x80\x80",      // above U+10FFFF
+		"\xe2\x82",              // truncated
+		"\xff",
+		"01234567890123456789012345678901234567890123456789012345678901234567\x80xyz",
+	};
+	for (const char *str : invalid) {
+		for (std::string input : {"[\"" + std::string(str) + "\"]", "{\"" + std::string(str) + "\": 1}"}) {
+			raw_buffer buf = j_str_to_buffer(input.data(), input.size());
+
+			jvalue_ref parsed = jdom_parse(buf, DOMOPT_NOOPT, &schemaInfo);
+			EXPECT_TRUE(jis_valid(parsed)) << input;
+			j_release(&parsed);
+
+			parsed = jdom_parse(buf, DOMOPT_VALIDATE_UTF8, &schemaInfo);
+			EXPECT_FALSE(jis_valid(parsed)) << input;
+			j_release(&parsed);
+
+			parsed = jdom_parse_lazy(buf, DOMOPT_VALIDATE_UTF8, &schemaInfo);
+			EXPECT_FALSE(jis_valid(parsed)) << input;
+			j_release(&parsed);
+		}
+	}
+
+	// A sequence split between feeds
+	test_sax_context context;
+	jsaxparser_ref parser = jsaxparser_create(&schemaInfo, &context.callbacks, &context);
+	ASSERT_TRUE(parser != NULL);
+	EXPECT_TRUE(jsaxparser_set_utf8_validation(parser, true));
+	EXPECT_TRUE(jsaxparser_feed(parser, "[\"\xe2\x82", 4));
+	EXPECT_TRUE(jsaxparser_feed(parser, "\xac\", \"\xe2\x82", 7));
+	EXPECT_FALSE(jsaxparser_feed(parser, "\"]", 2));
+	EXPECT_STREQ("Invalid UTF-8 in a string", jsaxparser_get_error(parser));
+	EXPECT_EQ(1, context.string_counter);
+	jsaxparser_release(&parser);
+}
+
+TEST(TestParse, parseTooDeep)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	// A million levels are still fine, the values nested deeper are rejected
+	const size_t limit = 1000000;
+	std::string input = std::string(limit, '[') + std::string(limit, ']');
+	jvalue_ref parsed = jdom_parse(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	EXPECT_TRUE(jis_array(parsed));
+	j_release(&parsed);
+
+	input = "{\"a\": " + std::string(limit, '[') + std::string(limit, ']') + "}";
+	jdomparser_ref parser = jdomparser_create(&schemaInfo, DOMOPT_NOOPT);
+	ASSERT_TRUE(parser != NULL);
+	EXPECT_FALSE(jdomparser_feed(parser, input.c_str(), input.size()));
+	EXPECT_STREQ("The value is nested too deeply", jdomparser_get_error(parser));
+	jdomparser_release(&parser);
+
+	// The lazy DOM has the same limit
+	parsed = jdom_parse_lazy(j_str_to_buffer(input.c_str() + 6, 2 * limit), DOMOPT_NOOPT, &schemaInfo);
+	EXPECT_TRUE(jis_array(parsed));
+	j_release(&parsed);
+	parsed = jdom_parse_lazy(j_str_to_buffer(input.c_str(), input.size()), DOMOPT_NOOPT, &schemaInfo);
+	EXPECT_FALSE(jis_valid(parsed));
+}
+
+TEST(TestParse, saxparserStringChunksUtf8)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	for (size_t step : {1, 5, 1000}) {
+		test_string_chunks_context context;
+		context.validate_utf8 = true;
+		EXPECT_TRUE(context.Parse(&schemaInfo, "[\"0123456789\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\\u00e9 0123456789\"]", step));
+		EXPECT_FALSE(context.Parse(&schemaInfo, "[\"0123456789abcdef\xe2\x82\\u00e9\"]", step));
+		EXPECT_FALSE(context.Parse(&schemaInfo, "[\"0123456789abcdef\xe2\x82\"]", step));
+		EXPECT_FALSE(context.Parse(&schemaInfo, "[\"0123456789abcdef\xed\xbf\xbf\"]", step));
+	}
+}
+
+struct test_pause_context : test_sax_context {
+	int pause_every;
+
+	test_pause_context(int every)
+		: pause_every(every)
+	{
+		callbacks.m_number = jsax_number_pause;
+	}
+
+	static int jsax_number_pause(JSAXContextRef ctxt, const char *number, size_t numberLen) {
+		test_pause_context *self = reinterpret_cast<test_pause_context*>(jsax_getContext(ctxt));
+		if (++self->number_counter % self->pause_every == 0)
+			jsax_pause(ctxt);
+		return 1;
+	}
+};
+
+TEST(TestParse, saxparserPause)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	std::string input = "[";
+	for (int i = 0; i < 3000; ++i)
+		input += std::to_string(i) + ",";
+	input += "{\"end\": true}]";
+
+	test_pause_context context(100);
+	jsaxparser_ref parser = jsaxparser_create(&schemaInfo, &context.callbacks, &context);
+	ASSERT_TRUE(parser != NULL);
+
+	size_t consumed = 0, prev_consumed = 0;
+	int pauses = 0;
+	jsaxparser_status status = jsaxparser_feed_ex(parser, input.data(), input.size(), &consumed);
+	while (status == JSAXPARSER_PAUSED) {
+		++pauses;
+		EXPECT_EQ(0, context.number_counter % 100);
+		EXPECT_LE(prev_consumed, consumed);
+		EXPECT_GE(input.size(), consumed);
+		prev_consumed = consumed;
+
+		// Nothing is parsed or reported while paused
+		int numbers = context.number_counter;
+		EXPECT_FALSE(jsaxparser_feed(parser, "1", 1));
+		EXPECT_FALSE(jsaxparser_end(parser));
+		EXPECT_EQ(numbers, context.number_counter);
+
+		status = jsaxparser_resume(parser, &consumed);
+	}
+	EXPECT_EQ(JSAXPARSER_OK, status);
+	EXPECT_EQ(input.size(), consumed);
+	EXPECT_EQ(30, pauses);
+	EXPECT_EQ(JSAXPARSER_ERROR, jsaxparser_resume(parser, &consumed));
+	EXPECT_TRUE(jsaxparser_end(parser));
+	jsaxparser_release(&parser);
+
+	EXPECT_EQ(3000, context.number_counter);
+	EXPECT_EQ(1, context.boolean_counter);
+	EXPECT_EQ(1, context.object_end_counter);
+	EXPECT_EQ(1, context.array_end_counter);
+}
+
+TEST(TestParse, parseDeduplicate)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+
+	const char *input =
+		"{\"a\": {\"x\": 1, \"y\": \"on\"},"
+		" \"b\": {\"x\": 1, \"y\": \"on\"},"
+		" \"c\": [{\"x\": 1, \"y\": \"on\"}, [1, 2], [1, 2], [1, [\"on\"]], [1, [\"on\"]]],"
+		" \"d\": {\"y\": \"on\", \"x\": 2},"
+		" \"e\": [{\"x\": 1, \"y\": \"on\"}, {\"x\": 1, \"y\": \"on\"}]}";
+	jvalue_ref expected = jdom_parse(j_cstr_to_buffer(input), DOMOPT_NOOPT, &schemaInfo);
+	jvalue_ref parsed = jdom_parse(j_cstr_to_buffer(input), DOMOPT_DEDUPLICATE, &schemaInfo);
+	ASSERT_TRUE(jis_object(parsed));
+	EXPECT_TRUE(jvalue_equal(expected, parsed));
+
+	// The equal scalars are one instance, the equal containers are copies of one
+	jvalue_ref a = jobject_get(parsed, j_cstr_to_buffer("a"));
+	jvalue_ref b = jobject_get(parsed, j_cstr_to_buffer("b"));
+	jvalue_ref c = jobject_get(parsed, j_cstr_to_buffer("c"));
+	jvalue_ref d = jobject_get(parsed, j_cstr_to_buffer("d"));
+	jvalue_ref e = jobject_get(parsed, j_cstr_to_buffer("e"));
+	EXPECT_TRUE(jvalue_equal(a, b));
+	EXPECT_TRUE(jvalue_equal(jarray_get(c, 0), jarray_get(e, 1)));
+	EXPECT_EQ(jobject_get(a, j_cstr_to_buffer("y")), jobject_get(d, j_cstr_to_buffer("y")));
+	EXPECT_EQ(jobject_get(a, j_cstr_to_buffer("y")), jarray_get(jarray_get(jarray_get(c, 3), 1), 0));
+	EXPECT_TRUE(jis_frozen(jobject_get(a, j_cstr_to_buffer("y"))));
+
+	// The containers are modified as usual, the other copies don't change
+	EXPECT_FALSE(jis_frozen(a));
+	EXPECT_FALSE(jis_frozen(parsed));
+	EXPECT_TRUE(jobject_put(a, J_CSTR_TO_JVAL("z"), jnull()));
+	EXPECT_EQ(3u, jobject_size(a));
+	EXPECT_EQ(2u, jobject_size(b));
+	EXPECT_EQ(2u, jobject_size(jarray_get(e, 0)));
+	ASSERT_TRUE(jarray_append(jarray_get(jarray_get(c, 3), 1), jnumber_create_i32(3)));
+	EXPECT_EQ(2, jarray_size(jarray_get(jarray_get(c, 3), 1)));
+	EXPECT_EQ(1, jarray_size(jarray_get(jarray_get(c, 4), 1)));
+	ASSERT_TRUE(jarray_set(jarray_get(c, 1), 0, jnull()));
+	EXPECT_TRUE(jis_number(jarray_get(jarray_get(c, 2), 0)));
+	jvalue_ref modified = jdom_parse(j_cstr_to_buffer(
+		"{\"a\": {\"x\": 1, \"y\": \"on\", \"z\": null},"
+		" \"b\": {\"x\": 1, \"y\": \"on\"},"
+		" \"c\": [{\"x\": 1, \"y\": \"on\"}, [null, 2], [1, 2], [1, [\"on\", 3]], [1, [\"on\"]]],"
+		" \"d\": {\"y\": \"on\", \"x\": 2},"
+		" \"e\": [{\"x\": 1, \"y\": \"on\"}, {\"x\": 1, \"y\": \"on\"}]}"), DOMOPT_NOOPT, &schemaInfo);
+	EXPECT_TRUE(jvalue_equal(modified, parsed));
+	j_release(&modified);
+
+	j_release(&parsed);
+	j_release(&expected);
+}
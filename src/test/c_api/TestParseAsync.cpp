@@ -0,0 +1,198 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <gtest/gtest.h>
+#include <pbnjson.h>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Stand-in for a slow client: writes the input in small pieces and closes the socket
+void slowWriter(int fd, string input, size_t piece)
+{
+	for (size_t pos = 0; pos < input.size(); pos += piece) {
+		size_t len = min(piece, input.size() - pos);
+		ASSERT_EQ((ssize_t) len, write(fd, input.data() + pos, len));
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	close(fd);
+}
+
+class TestParseAsync : public ::testing::Test
+{
+protected:
+	int fds[2];
+	jvalue_ref result;
+	string error;
+	int finished;
+	GMainLoop *loop;
+	JSchemaInfo schemaInfo;
+
+	virtual void SetUp()
+	{
+		ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+		result = NULL;
+		finished = 0;
+		loop = NULL;
+		jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	}
+
+	virtual void TearDown()
+	{
+		close(fds[0]);
+		j_release(&result);
+		if (loop)
+			g_main_loop_unref(loop);
+	}
+
+	static void onFinished(void *ctxt, jvalue_ref value, const char *error)
+	{
+		TestParseAsync *self = static_cast<TestParseAsync *>(ctxt);
+		++self->finished;
+		if (value)
+			self->result = jvalue_copy(value);
+		if (error)
+			self->error = error;
+		if (self->loop)
+			g_main_loop_quit(self->loop);
+	}
+
+	// Drive the parser by epoll until it finishes
+	void runEpoll(jparse_async_ref async)
+	{
+		int epfd = epoll_create1(0);
+		ASSERT_NE(-1, epfd);
+		ASSERT_TRUE(jparse_async_epoll_add(async, epfd));
+
+		bool more = true;
+		while (more) {
+			struct epoll_event event;
+			int n = epoll_wait(epfd, &event, 1, 5000);
+			ASSERT_EQ(1, n);
+			ASSERT_EQ(async, event.data.ptr);
+			more = jparse_async_dispatch(static_cast<jparse_async_ref>(event.data.ptr));
+		}
+		jparse_async_free(async);
+		close(epfd);
+	}
+};
+
+static int sax_numbers(JSAXContextRef ctxt, const char *number, size_t numberLen)
+{
+	++*static_cast<int *>(jsax_getContext(ctxt));
+	return 1;
+}
+
+} // namespace
+
+TEST_F(TestParseAsync, domGMainLoop)
+{
+	string input = "{\"array\": [";
+	for (int i = 0; i < 1000; ++i)
+		input += (i ? ", " : "") + to_string(i);
+	input += "], \"str\": \"hello\"}";
+
+	jparse_async_ref async = jparse_async_dom_new(fds[0], DOMOPT_NOOPT, &schemaInfo, onFinished, this);
+	ASSERT_TRUE(async != NULL);
+
+	loop = g_main_loop_new(NULL, FALSE);
+	GSource *source = jparse_async_source_new(async);
+	g_source_attach(source, NULL);
+	g_source_unref(source);
+
+	thread writer(slowWriter, fds[1], input, 100);
+	g_main_loop_run(loop);
+	writer.join();
+
+	EXPECT_EQ(1, finished);
+	EXPECT_TRUE(error.empty()) << error;
+	ASSERT_TRUE(jis_object(result));
+	jvalue_ref array = jobject_get(result, J_CSTR_TO_BUF("array"));
+	ASSERT_TRUE(jis_array(array));
+	EXPECT_EQ(1000, jarray_size(array));
+	EXPECT_TRUE(jstring_equal2(jobject_get(result, J_CSTR_TO_BUF("str")), J_CSTR_TO_BUF("hello")));
+}
+
+TEST_F(TestParseAsync, domEpoll)
+{
+	jparse_async_ref async = jparse_async_dom_new(fds[0], DOMOPT_NOOPT, &schemaInfo, onFinished, this);
+	ASSERT_TRUE(async != NULL);
+
+	thread writer(slowWriter, fds[1], string("[true, false, null, \"abc\", 3.5]"), 3);
+	runEpoll(async);
+	writer.join();
+
+	EXPECT_EQ(1, finished);
+	EXPECT_TRUE(error.empty()) << error;
+	ASSERT_TRUE(jis_array(result));
+	EXPECT_EQ(5, jarray_size(result));
+}
+
+TEST_F(TestParseAsync, domEpollInvalid)
+{
+	jparse_async_ref async = jparse_async_dom_new(fds[0], DOMOPT_NOOPT, &schemaInfo, onFinished, this);
+	ASSERT_TRUE(async != NULL);
+
+	thread writer(slowWriter, fds[1], string("{\"a\": [1, 2,, 3]}"), 4);
+	runEpoll(async);
+	writer.join();
+
+	EXPECT_EQ(1, finished);
+	EXPECT_FALSE(error.empty());
+	EXPECT_FALSE(jis_valid(result));
+}
+
+TEST_F(TestParseAsync, domEpollTruncated)
+{
+	jparse_async_ref async = jparse_async_dom_new(fds[0], DOMOPT_NOOPT, &schemaInfo, onFinished, this);
+	ASSERT_TRUE(async != NULL);
+
+	thread writer(slowWriter, fds[1], string("{\"a\": [1, 2"), 4);
+	runEpoll(async);
+	writer.join();
+
+	EXPECT_EQ(1, finished);
+	EXPECT_FALSE(error.empty());
+	EXPECT_FALSE(jis_valid(result));
+}
+
+TEST_F(TestParseAsync, saxEpoll)
+{
+	int numbers = 0;
+	PJSAXCallbacks callbacks = {};
+	callbacks.m_number = sax_numbers;
+
+	jparse_async_ref async = jparse_async_sax_new(fds[0], &schemaInfo, &callbacks, &numbers, onFinished, this);
+	ASSERT_TRUE(async != NULL);
+
+	thread writer(slowWriter, fds[1], string("[1, 2, 3, {\"x\": 4}, [5]]"), 2);
+	runEpoll(async);
+	writer.join();
+
+	EXPECT_EQ(1, finished);
+	EXPECT_TRUE(error.empty()) << error;
+	EXPECT_TRUE(result == NULL);
+	EXPECT_EQ(5, numbers);
+}
@@ -99,6 +99,16 @@ void ParseSax(raw_buffer const &input, jschema_ref schema)
 	ASSERT_TRUE(jsax_parse(NULL, input, &schemaInfo));
 }
 
+void ParseTape(raw_buffer const &input, jschema_ref schema)
+{
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+
+	jtape_ref tape = jtape_parse(input, &schemaInfo);
+	ASSERT_TRUE(tape);
+	jtape_release(&tape);
+}
+
 #define ITERATION_STEP 5
 
 void ParseSaxIterate(raw_buffer const &input, jschema_ref schema)
@@ -215,6 +225,16 @@ TEST(Performance, ParseSmallInput)
 		});
 	cout << "pbnjson-sax:\t\t" << ConvertToMBps(small_inputs_size, s_sax) << endl;
 
+	double s_tape = BenchmarkPerform([&](size_t n)
+		{
+			for (; n > 0; --n)
+			{
+				for (auto const &rb : small_inputs)
+					ParseTape(rb, jschema_all());
+			}
+		});
+	cout << "pbnjson-tape:\t\t" << ConvertToMBps(small_inputs_size, s_tape) << endl;
+
 	double s_pbnjson = BenchmarkPerform([&](size_t n)
 		{
 			for (; n > 0; --n)
@@ -333,6 +353,13 @@ TEST(Performance, ParseBigInput)
 		});
 	cout << "pbnjson-sax:\t\t" << ConvertToMBps(big_input_size, s_sax) << endl;
 
+	double s_tape = BenchmarkPerform([&](size_t n)
+		{
+			for (; n > 0; --n)
+				ParseTape(input, jschema_all());
+		});
+	cout << "pbnjson-tape:\t\t" << ConvertToMBps(big_input_size, s_tape) << endl;
+
 	double s_pbnjson = BenchmarkPerform([&](size_t n)
 		{
 			for (; n > 0; --n)
@@ -354,6 +381,13 @@ TEST(Performance, ParseBigInput)
 		});
 	cout << "pbnjson (+opts):\t" << ConvertToMBps(big_input_size, s_pbnjson2) << endl;
 
+	double s_pbnjson_utf8 = BenchmarkPerform([&](size_t n)
+		{
+			for (; n > 0; --n)
+				ParsePbnjson(input, OPT_ALL | DOMOPT_VALIDATE_UTF8, jschema_all());
+		});
+	cout << "pbnjson (+opts, utf8):\t" << ConvertToMBps(big_input_size, s_pbnjson_utf8) << endl;
+
 	double s_pbnjsonpp2 = BenchmarkPerform([&](size_t n)
 		{
 			for (; n > 0; --n)
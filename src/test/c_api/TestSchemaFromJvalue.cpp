@@ -23,6 +23,8 @@
  */
 
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -140,3 +142,44 @@ INSTANTIATE_TEST_CASE_P(Samples, SchemaFromJvalue,
 		)
 	)
 );
+
+TEST(SchemaDefaults, PrivateCopies)
+{
+	auto schema = schema_str("{\"properties\":{\"foo\":{\"default\":{\"a\":[1,\"s\",2.5],\"b\":true}}}}");
+	ASSERT_TRUE( !!schema );
+
+	// Every document gets a default of its own, the threads modify them independently
+	std::vector<std::thread> threads;
+	std::vector<int> failures(4, 0);
+	for (size_t i = 0; i < failures.size(); ++i)
+	{
+		threads.emplace_back([&schema, &failures, i]() {
+			JSchemaInfo schemaInfo;
+			jschema_info_init(&schemaInfo, schema.get(), NULL, NULL);
+			for (int n = 0; n < 200; ++n)
+			{
+				jvalue_ref doc = jobject_create();
+				if (!jvalue_apply_schema(doc, &schemaInfo))
+					++failures[i];
+				jvalue_ref foo = jobject_get(doc, J_CSTR_TO_BUF("foo"));
+				jvalue_ref a = jobject_get(foo, J_CSTR_TO_BUF("a"));
+				if (!jobject_put(foo, J_CSTR_TO_JVAL("c"), jnumber_create_i32(n)) ||
+				    !jarray_append(a, jstring_create("t")) ||
+				    jarray_size(a) != 4)
+					++failures[i];
+				j_release(&doc);
+			}
+		});
+	}
+	for (auto &thread : threads)
+		thread.join();
+
+	for (int f : failures)
+		EXPECT_EQ( 0, f );
+
+	// The schema still injects the original default
+	auto doc = jvalue_str("{}", schema.get());
+	ASSERT_TRUE( jis_valid(doc.get()) );
+	EXPECT_STREQ( "{\"foo\":{\"a\":[1,\"s\",2.5],\"b\":true}}",
+	              jvalue_tostring(doc.get(), jschema_all()) );
+}
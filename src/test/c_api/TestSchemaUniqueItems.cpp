@@ -160,3 +160,21 @@ TEST_F(TestUniqueItems, Invalid3)
 	EXPECT_EQ(1, errorCounter);
 	EXPECT_EQ(VEC_ARRAY_HAS_DUPLICATES, errorCode);
 }
+
+TEST_F(TestUniqueItems, PackedNumbers)
+{
+	// Arrays of numbers are stored unboxed by the parser
+	auto res = mk_ptr(jdom_parse(j_cstr_to_buffer("[1, 2, 3, 2.5]"), DOMOPT_NOOPT, &schema_info));
+	EXPECT_TRUE(jis_array(res.get()));
+	EXPECT_TRUE(jvalue_check_schema(res.get(), &schema_info));
+
+	const raw_buffer INPUT = j_cstr_to_buffer("[1, 2.5, 3, 2.5]");
+	res = mk_ptr(jdom_parse(INPUT, DOMOPT_NOOPT, &schema_info));
+	EXPECT_FALSE(jis_valid(res.get()));
+	res = mk_ptr(jdom_parse(INPUT, DOMOPT_NOOPT, &schema_info_all));
+	ASSERT_TRUE(jis_array(res.get()));
+	errorCounter = 0;
+	EXPECT_FALSE(jvalue_check_schema(res.get(), &schema_info));
+	EXPECT_EQ(1, errorCounter);
+	EXPECT_EQ(VEC_ARRAY_HAS_DUPLICATES, errorCode);
+}
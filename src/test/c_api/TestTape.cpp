@@ -0,0 +1,196 @@
+// @@@LICENSE
+//
+//      Copyright (c) 2014 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LICENSE@@@
+
+#include <gtest/gtest.h>
+#include <pbnjson.h>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+class TestTape : public ::testing::Test
+{
+protected:
+	jtape_ref tape;
+
+	virtual void SetUp()
+	{
+		tape = NULL;
+	}
+
+	virtual void TearDown()
+	{
+		jtape_release(&tape);
+	}
+
+	jtape_ref Parse(const char *input)
+	{
+		JSchemaInfo schemaInfo;
+		jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+		jtape_release(&tape);
+		tape = jtape_parse(j_cstr_to_buffer(input), &schemaInfo);
+		return tape;
+	}
+
+	static string GetString(jtape_cursor cur)
+	{
+		raw_buffer buf;
+		if (!jtape_get_string(cur, &buf))
+			return "<not a string>";
+		return string(buf.m_str, buf.m_len);
+	}
+};
+
+} // namespace
+
+TEST_F(TestTape, navigation)
+{
+	ASSERT_TRUE(Parse(
+		"{\"a\": 1, \"b\": [true, false, null, \"x\\ny\"], \"c\": {\"d\": -2.5}, \"e\": {}, \"f\": []}"));
+
+	jtape_cursor root = jtape_root(tape);
+	ASSERT_TRUE(jtape_is_valid(root));
+	EXPECT_EQ(JV_OBJECT, jtape_get_type(root));
+	EXPECT_EQ(5u, jtape_size(root));
+
+	int32_t i32 = 0;
+	jtape_cursor a = jtape_find_key(root, J_CSTR_TO_BUF("a"));
+	EXPECT_EQ(JV_NUM, jtape_get_type(a));
+	EXPECT_EQ(CONV_OK, jtape_get_i32(a, &i32));
+	EXPECT_EQ(1, i32);
+
+	jtape_cursor b = jtape_find_key(root, J_CSTR_TO_BUF("b"));
+	EXPECT_EQ(JV_ARRAY, jtape_get_type(b));
+	EXPECT_EQ(4u, jtape_size(b));
+
+	bool flag = false;
+	EXPECT_TRUE(jtape_get_boolean(jtape_index(b, 0), &flag));
+	EXPECT_TRUE(flag);
+	EXPECT_TRUE(jtape_get_boolean(jtape_index(b, 1), &flag));
+	EXPECT_FALSE(flag);
+	EXPECT_TRUE(jtape_is_valid(jtape_index(b, 2)));
+	EXPECT_EQ(JV_NULL, jtape_get_type(jtape_index(b, 2)));
+	EXPECT_EQ("x\ny", GetString(jtape_index(b, 3)));
+	EXPECT_FALSE(jtape_is_valid(jtape_index(b, 4)));
+	EXPECT_FALSE(jtape_get_boolean(jtape_index(b, 3), &flag));
+
+	double f64 = 0;
+	jtape_cursor d = jtape_find_key(jtape_find_key(root, J_CSTR_TO_BUF("c")), J_CSTR_TO_BUF("d"));
+	EXPECT_EQ(CONV_OK, jtape_get_f64(d, &f64));
+	EXPECT_EQ(-2.5, f64);
+	EXPECT_NE(CONV_OK, jtape_get_i32(d, &i32));
+
+	EXPECT_EQ(0u, jtape_size(jtape_find_key(root, J_CSTR_TO_BUF("e"))));
+	EXPECT_EQ(0u, jtape_size(jtape_find_key(root, J_CSTR_TO_BUF("f"))));
+
+	jtape_cursor missing = jtape_find_key(root, J_CSTR_TO_BUF("z"));
+	EXPECT_FALSE(jtape_is_valid(missing));
+	EXPECT_FALSE(jtape_is_valid(jtape_find_key(b, J_CSTR_TO_BUF("a"))));
+	EXPECT_FALSE(jtape_is_valid(jtape_index(root, 0)));
+}
+
+TEST_F(TestTape, iteration)
+{
+	ASSERT_TRUE(Parse("{\"one\": 1, \"two\": [2, 3], \"three\": 3}"));
+
+	jtape_iter it;
+	jtape_cursor key, value;
+	ASSERT_TRUE(jtape_iter_init(&it, jtape_root(tape)));
+
+	string keys;
+	int64_t sum = 0;
+	while (jtape_iter_next(&it, &key, &value))
+	{
+		keys += GetString(key) + ";";
+		int64_t i64;
+		if (jtape_get_i64(value, &i64) == CONV_OK)
+			sum += i64;
+	}
+	EXPECT_EQ("one;two;three;", keys);
+	EXPECT_EQ(4, sum);
+
+	ASSERT_TRUE(jtape_iter_init(&it, jtape_find_key(jtape_root(tape), J_CSTR_TO_BUF("two"))));
+	size_t count = 0;
+	while (jtape_iter_next(&it, &key, NULL))
+	{
+		EXPECT_FALSE(jtape_is_valid(key));
+		++count;
+	}
+	EXPECT_EQ(2u, count);
+
+	EXPECT_FALSE(jtape_iter_init(&it, jtape_find_key(jtape_root(tape), J_CSTR_TO_BUF("one"))));
+}
+
+TEST_F(TestTape, numbers)
+{
+	ASSERT_TRUE(Parse("[9223372036854775807, 123456789012345678901234567890, 1e2, -7]"));
+	jtape_cursor root = jtape_root(tape);
+
+	int64_t i64 = 0;
+	EXPECT_EQ(CONV_OK, jtape_get_i64(jtape_index(root, 0), &i64));
+	EXPECT_EQ(INT64_MAX, i64);
+
+	EXPECT_TRUE(CONV_HAS_POSITIVE_OVERFLOW(jtape_get_i64(jtape_index(root, 1), &i64)));
+
+	double f64 = 0;
+	EXPECT_EQ(CONV_OK, jtape_get_f64(jtape_index(root, 2), &f64));
+	EXPECT_EQ(100.0, f64);
+
+	int32_t i32 = 0;
+	EXPECT_EQ(CONV_OK, jtape_get_i32(jtape_index(root, 3), &i32));
+	EXPECT_EQ(-7, i32);
+}
+
+TEST_F(TestTape, toDom)
+{
+	const char *input =
+		"{\"a\": [1, 2.5, \"s\", {\"b\": null}], \"c\": true, \"d\": 123456789012345678901234567890}";
+	ASSERT_TRUE(Parse(input));
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, jschema_all(), NULL, NULL);
+	jvalue_ref expected = jdom_parse(j_cstr_to_buffer(input), DOMOPT_NOOPT, &schemaInfo);
+	jvalue_ref actual = jvalue_from_tape(jtape_root(tape));
+	EXPECT_TRUE(jvalue_equal(expected, actual));
+	j_release(&actual);
+
+	jvalue_ref sub = jvalue_from_tape(jtape_find_key(jtape_root(tape), J_CSTR_TO_BUF("a")));
+	EXPECT_TRUE(jvalue_equal(jobject_get(expected, J_CSTR_TO_BUF("a")), sub));
+	j_release(&sub);
+	j_release(&expected);
+
+	jtape_cursor missing = jtape_find_key(jtape_root(tape), J_CSTR_TO_BUF("z"));
+	EXPECT_FALSE(jis_valid(jvalue_from_tape(missing)));
+}
+
+TEST_F(TestTape, invalidInput)
+{
+	EXPECT_FALSE(Parse("{\"a\": [1, 2}"));
+	EXPECT_FALSE(Parse(""));
+	EXPECT_FALSE(jtape_is_valid(jtape_root(NULL)));
+
+	JSchemaInfo schemaInfo;
+	jschema_ref schema = jschema_parse(j_cstr_to_buffer("{\"type\": \"array\"}"), JSCHEMA_DOM_NOOPT, NULL);
+	ASSERT_TRUE(schema);
+	jschema_info_init(&schemaInfo, schema, NULL, NULL);
+	EXPECT_FALSE(jtape_parse(j_cstr_to_buffer("{}"), &schemaInfo));
+	tape = jtape_parse(j_cstr_to_buffer("[{}]"), &schemaInfo);
+	EXPECT_TRUE(tape);
+	jschema_release(&schema);
+}
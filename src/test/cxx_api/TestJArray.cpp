@@ -66,3 +66,36 @@ TEST(TestJArray, TestEqual2)
 
 	EXPECT_FALSE(val1 == val2);
 }
+
+TEST(TestJArray, Index)
+{
+	using namespace pbnjson;
+
+	JValue users = Array();
+	for (int i = 0; i < 100; ++i)
+	{
+		JValue user = Object();
+		user.put("id", i * 10);
+		user.put("name", "user" + to_string(i));
+		users << user;
+	}
+
+	JArrayIndex byId(users, "/id");
+	ASSERT_TRUE(byId.isValid());
+	EXPECT_EQ(5, byId.find(50));
+	EXPECT_EQ("user5", byId[50]["name"].asString());
+	EXPECT_EQ(-1, byId.find(55));
+	EXPECT_FALSE(byId[55].isValid());
+
+	JArrayIndex byName(users, "/name");
+	EXPECT_EQ(99, byName.find("user99"));
+
+	// The elements appended are found
+	JValue user = Object();
+	user.put("id", 1000);
+	users << user;
+	EXPECT_EQ(100, byId.find(1000));
+
+	EXPECT_FALSE(JArrayIndex(users, "id").isValid());
+	EXPECT_FALSE(JArrayIndex(Object(), "/id").isValid());
+}
@@ -18,6 +18,7 @@
 
 #include <gtest/gtest.h>
 #include <pbnjson.hpp>
+#include <pbnjson.h>
 
 using namespace pbnjson;
 using namespace std;
@@ -338,6 +339,72 @@ TEST(TestJValue, Duplicate)
 	EXPECT_TRUE(v2.hasKey("key2"));
 }
 
+TEST(TestJValue, DuplicateFrozen)
+{
+	JValue v1(Object());
+	v1.put("key1", Object());
+	v1["key1"].put("key2", "val2");
+	v1.freeze();
+	EXPECT_TRUE(v1.isFrozen());
+	EXPECT_TRUE(v1["key1"].isFrozen());
+	EXPECT_FALSE(v1.put("key3", "val3"));
+
+	JValue v2(v1.duplicate());
+	EXPECT_FALSE(v2.isFrozen());
+	EXPECT_TRUE(v1 == v2);
+	EXPECT_TRUE(v2["key1"].put("key2", "changed"));
+	EXPECT_TRUE(v1 != v2);
+	EXPECT_EQ("val2", v1["key1"]["key2"].asString());
+	EXPECT_EQ("changed", v2["key1"]["key2"].asString());
+}
+
+TEST(TestJValue, DeferRelease)
+{
+	JValue::deferRelease(10);
+	JValue kept;
+	{
+		JValue arr(Array());
+		for (int i = 0; i < 100; ++i)
+			arr.append(Object() << JValue::KeyValue("id", i));
+		kept = arr[50];
+	}
+	JValue::deferRelease(0);
+	j_release_wait();
+
+	EXPECT_EQ(50, kept["id"].asNumber<int>());
+}
+
+TEST(TestJValue, Key)
+{
+	JKey id("id");
+	JKey name = JKey::intern("name");
+	ASSERT_TRUE(id.isValid());
+	EXPECT_EQ("id", id.name());
+	EXPECT_EQ("name", JKey::intern("name").name());
+
+	JValue arr(Array());
+	for (int i = 0; i < 10; ++i)
+	{
+		JValue record(Object());
+		EXPECT_TRUE(record.put(id, i));
+		EXPECT_TRUE(record.put(name, "record" + to_string(i)));
+		arr.append(record);
+	}
+	for (int i = 0; i < 10; ++i)
+	{
+		EXPECT_EQ(i, arr[i][id].asNumber<int>());
+		EXPECT_EQ("record" + to_string(i), arr[i][name].asString());
+		EXPECT_EQ(i, arr[i]["id"].asNumber<int>());
+	}
+
+	JKey copy(id);
+	copy = name;
+	EXPECT_EQ("name", copy.name());
+	EXPECT_FALSE(arr[0][JKey("other")].isValid());
+	EXPECT_FALSE(arr[id].isValid());
+	EXPECT_FALSE(JValue(5).put(id, 1));
+}
+
 TEST(TestJValue, IteratorAdvance)
 {
 	JValue obj = Object();
@@ -108,6 +108,15 @@ struct SAXCallbacks : public JParser
 	NumberType conversionToUse() const {return JNUM_CONV_NATIVE;}
 };
 
+struct PausingParser : public SAXCallbacks
+{
+	bool jsonString(const std::string& s) {
+		// Every string pauses, e.g. while it's being processed elsewhere
+		pause();
+		return SAXCallbacks::jsonString(s);
+	}
+};
+
 template<class T>
 std::vector<T> MultVector(const std::vector<T>& vec, int times) {
 	std::vector<T> newVec;
@@ -207,3 +216,38 @@ TEST(TestParse, invalid_json) {
 	// Get root JValue
 	pbnjson::JValue json = parser.getDom();
 }
+
+TEST(TestParse, saxparserPause)
+{
+	std::string input = "[";
+	for (int i = 0; i < 1000; ++i)
+		input += "\"s" + std::to_string(i) + "\", " + std::to_string(i) + ", ";
+	input += "null]";
+
+	PausingParser parser;
+	ASSERT_TRUE(parser.begin(JSchema::AllSchema()));
+
+	size_t consumed = 0;
+	size_t pauses = 0;
+	JParser::FeedStatus status = parser.feed(input.data(), input.size(), consumed);
+	while (status == JParser::FEED_PAUSED) {
+		++pauses;
+		EXPECT_EQ(pauses, parser.jsonStringStorage.size());
+		EXPECT_GE(input.size(), consumed);
+		status = parser.resume(consumed);
+	}
+	EXPECT_EQ(JParser::FEED_DONE, status);
+	EXPECT_EQ(input.size(), consumed);
+	EXPECT_EQ(1000u, pauses);
+	ASSERT_TRUE(parser.end());
+
+	EXPECT_EQ("s999", parser.jsonStringStorage.back());
+	EXPECT_EQ(1000u, parser.jsonNumberInt64Storage.size());
+	EXPECT_EQ(1, parser.jsonNullCount);
+
+	// The plain feed ignores pauses
+	ASSERT_TRUE(parser.begin(JSchema::AllSchema()));
+	EXPECT_TRUE(parser.feed(input));
+	EXPECT_TRUE(parser.end());
+	EXPECT_EQ(2000u, parser.jsonStringStorage.size());
+}